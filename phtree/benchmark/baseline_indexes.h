@@ -0,0 +1,789 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_BENCHMARK_BASELINE_INDEXES_H
+#define PHTREE_BENCHMARK_BASELINE_INDEXES_H
+
+#include "phtree/common/common.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Simple reference indexes for comparing the PH-Tree with other approaches in the benchmarks:
+ * - UniformGrid: a uniform grid with hashed cells.
+ * - StaticKdTree: a kd-tree that is rebuilt after a number of modifications.
+ * - BruteForceScan: a linear scan over coordinates in SoA layout.
+ *
+ * All indexes store point keys (PhPointD) with one value per key and implement the subset of the
+ * PhTreeD API that is used by the benchmarks:
+ * emplace(key, args...), erase(key), count(key), for_each(query_box, callback),
+ * begin_knn_query(min_results, center, distance), end(), size(), empty() and clear().
+ *
+ * The indexes are not meant for production use. They are reasonably tuned, but do not attempt to
+ * be optimal. Iterators and references are invalidated by any modification of an index.
+ */
+namespace improbable::phtree::phbenchmark {
+
+/*
+ * Iterator over the result of a kNN query of a baseline index. The results are precomputed and
+ * ordered by distance.
+ */
+template <dimension_t DIM, typename T>
+class BaselineKnnIterator {
+  public:
+    struct Result {
+        const PhPointD<DIM>* key_;
+        T* value_;
+        double distance_;
+    };
+
+    BaselineKnnIterator() = default;
+
+    explicit BaselineKnnIterator(std::vector<Result>&& results) : results_{std::move(results)} {}
+
+    T& operator*() const {
+        return *results_[pos_].value_;
+    }
+
+    T* operator->() const {
+        return results_[pos_].value_;
+    }
+
+    [[nodiscard]] const PhPointD<DIM>& first() const {
+        return *results_[pos_].key_;
+    }
+
+    [[nodiscard]] T& second() const {
+        return *results_[pos_].value_;
+    }
+
+    [[nodiscard]] double distance() const {
+        return results_[pos_].distance_;
+    }
+
+    BaselineKnnIterator& operator++() {
+        ++pos_;
+        return *this;
+    }
+
+    // All finished iterators are equal to end().
+    friend bool operator==(const BaselineKnnIterator& left, const BaselineKnnIterator& right) {
+        return left.IsEnd() && right.IsEnd();
+    }
+
+    friend bool operator!=(const BaselineKnnIterator& left, const BaselineKnnIterator& right) {
+        return !(left == right);
+    }
+
+  private:
+    [[nodiscard]] bool IsEnd() const {
+        return pos_ >= results_.size();
+    }
+
+    std::vector<Result> results_{};
+    size_t pos_ = 0;
+};
+
+namespace detail {
+
+/*
+ * Keeps the 'k' nearest results of a kNN query in a max-heap.
+ */
+template <dimension_t DIM, typename T>
+class KnnCandidates {
+    using Result = typename BaselineKnnIterator<DIM, T>::Result;
+
+  public:
+    explicit KnnCandidates(size_t k) : k_{k} {
+        heap_.reserve(k + 1);
+    }
+
+    void Add(const PhPointD<DIM>& key, T& value, double distance) {
+        if (heap_.size() < k_) {
+            heap_.emplace_back(Result{&key, &value, distance});
+            std::push_heap(heap_.begin(), heap_.end(), Less);
+        } else if (k_ > 0 && distance < heap_.front().distance_) {
+            std::pop_heap(heap_.begin(), heap_.end(), Less);
+            heap_.back() = Result{&key, &value, distance};
+            std::push_heap(heap_.begin(), heap_.end(), Less);
+        }
+    }
+
+    [[nodiscard]] bool IsFull() const {
+        return heap_.size() >= k_;
+    }
+
+    // The distance of the k-th nearest candidate, i.e. the maximum distance of any improvement.
+    [[nodiscard]] double MaxDistance() const {
+        return IsFull() && k_ > 0 ? heap_.front().distance_
+                                  : std::numeric_limits<double>::infinity();
+    }
+
+    BaselineKnnIterator<DIM, T> ToIterator() {
+        std::sort_heap(heap_.begin(), heap_.end(), Less);
+        return BaselineKnnIterator<DIM, T>(std::move(heap_));
+    }
+
+  private:
+    static bool Less(const Result& left, const Result& right) {
+        return left.distance_ < right.distance_;
+    }
+
+    const size_t k_;
+    std::vector<Result> heap_;
+};
+
+template <dimension_t DIM>
+bool IsInBox(const PhPointD<DIM>& key, const PhBoxD<DIM>& box) {
+    for (dimension_t d = 0; d < DIM; ++d) {
+        if (key[d] < box.min()[d] || key[d] > box.max()[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename ARRAY>
+struct ArrayHash {
+    size_t operator()(const ARRAY& array) const {
+        size_t h = 0;
+        for (auto x : array) {
+            std::uint64_t bits;
+            if constexpr (std::is_floating_point_v<decltype(x)>) {
+                // Normalize -0.0 to +0.0 because they compare equal
+                double v = x == 0 ? 0. : x;
+                std::memcpy(&bits, &v, sizeof(bits));
+            } else {
+                bits = static_cast<std::uint64_t>(x);
+            }
+            h = (h ^ bits) * 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+};
+
+}  // namespace detail
+
+/*
+ * Uniform grid with fixed cell size. Only non-empty cells are stored, in a hash map.
+ *
+ * Window queries visit all cells that overlap with the query box, or all non-empty cells if that
+ * is cheaper. kNN queries visit cells in rings of increasing (L-infinity) distance around the
+ * center. This requires that the distance function is never smaller than the L-infinity
+ * distance, which is true for all L-p norms.
+ */
+template <dimension_t DIM, typename T>
+class UniformGrid {
+    using Key = PhPointD<DIM>;
+    using CellKey = std::array<std::int64_t, DIM>;
+    struct Entry {
+        Key key_;
+        T value_;
+    };
+    using Cell = std::vector<Entry>;
+
+  public:
+    explicit UniformGrid(double cell_length = 100) : cell_length_{cell_length} {
+        assert(cell_length > 0);
+    }
+
+    template <typename... Args>
+    std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
+        auto& cell = cells_[ToCell(key)];
+        for (auto& entry : cell) {
+            if (entry.key_ == key) {
+                return {entry.value_, false};
+            }
+        }
+        cell.emplace_back(Entry{key, T(std::forward<Args>(args)...)});
+        ++size_;
+        return {cell.back().value_, true};
+    }
+
+    size_t erase(const Key& key) {
+        auto it = cells_.find(ToCell(key));
+        if (it == cells_.end()) {
+            return 0;
+        }
+        auto& cell = it->second;
+        for (size_t i = 0; i < cell.size(); ++i) {
+            if (cell[i].key_ == key) {
+                if (i + 1 < cell.size()) {
+                    cell[i] = std::move(cell.back());
+                }
+                cell.pop_back();
+                if (cell.empty()) {
+                    cells_.erase(it);
+                }
+                --size_;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    [[nodiscard]] size_t count(const Key& key) const {
+        auto it = cells_.find(ToCell(key));
+        if (it != cells_.end()) {
+            for (auto& entry : it->second) {
+                if (entry.key_ == key) {
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    template <typename CALLBACK>
+    void for_each(const PhBoxD<DIM>& query_box, CALLBACK& callback) {
+        CellKey min = ToCell(query_box.min());
+        CellKey max = ToCell(query_box.max());
+        double n_query_cells = 1;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            n_query_cells *= (double)(max[d] - min[d] + 1);
+        }
+        if (n_query_cells > (double)cells_.size()) {
+            for (auto& cell : cells_) {
+                QueryCell(cell.second, query_box, callback);
+            }
+            return;
+        }
+        CellKey pos = min;
+        while (true) {
+            auto it = cells_.find(pos);
+            if (it != cells_.end()) {
+                QueryCell(it->second, query_box, callback);
+            }
+            if (!Increment(pos, min, max)) {
+                return;
+            }
+        }
+    }
+
+    template <typename DISTANCE>
+    auto begin_knn_query(size_t min_results, const Key& center, DISTANCE distance_function) {
+        detail::KnnCandidates<DIM, T> candidates{min_results};
+        CellKey center_cell = ToCell(center);
+        size_t n_visited = 0;
+        for (std::int64_t r = 0; n_visited < size_; ++r) {
+            // Entries in ring 'r' and beyond are at least '(r - 1) * cell_length' away.
+            if (candidates.MaxDistance() <= (double)(r - 1) * cell_length_) {
+                break;
+            }
+            if (std::pow(2. * (double)r + 1., (double)DIM) > (double)cells_.size()) {
+                // The ring is larger than the whole grid: check all remaining cells directly.
+                for (auto& cell : cells_) {
+                    if (Distance(cell.first, center_cell) >= r) {
+                        AddCandidates(cell.second, center, distance_function, candidates);
+                    }
+                }
+                break;
+            }
+            CellKey min, max;
+            for (dimension_t d = 0; d < DIM; ++d) {
+                min[d] = center_cell[d] - r;
+                max[d] = center_cell[d] + r;
+            }
+            CellKey pos = min;
+            do {
+                if (Distance(pos, center_cell) == r) {
+                    auto it = cells_.find(pos);
+                    if (it != cells_.end()) {
+                        n_visited += it->second.size();
+                        AddCandidates(it->second, center, distance_function, candidates);
+                    }
+                }
+            } while (Increment(pos, min, max));
+        }
+        return candidates.ToIterator();
+    }
+
+    auto end() const {
+        return BaselineKnnIterator<DIM, T>();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    void clear() {
+        cells_.clear();
+        size_ = 0;
+    }
+
+  private:
+    CellKey ToCell(const Key& key) const {
+        CellKey cell;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            cell[d] = static_cast<std::int64_t>(std::floor(key[d] / cell_length_));
+        }
+        return cell;
+    }
+
+    // L-infinity distance between two cells.
+    static std::int64_t Distance(const CellKey& c1, const CellKey& c2) {
+        std::int64_t max = 0;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            max = std::max(max, std::abs(c1[d] - c2[d]));
+        }
+        return max;
+    }
+
+    // Moves 'pos' to the next cell in [min, max], returns 'false' if there is no next cell.
+    static bool Increment(CellKey& pos, const CellKey& min, const CellKey& max) {
+        for (dimension_t d = 0; d < DIM; ++d) {
+            if (pos[d] < max[d]) {
+                ++pos[d];
+                return true;
+            }
+            pos[d] = min[d];
+        }
+        return false;
+    }
+
+    template <typename CALLBACK>
+    static void QueryCell(Cell& cell, const PhBoxD<DIM>& query_box, CALLBACK& callback) {
+        for (auto& entry : cell) {
+            if (detail::IsInBox(entry.key_, query_box)) {
+                callback(entry.key_, entry.value_);
+            }
+        }
+    }
+
+    template <typename DISTANCE>
+    static void AddCandidates(
+        Cell& cell,
+        const Key& center,
+        const DISTANCE& distance_function,
+        detail::KnnCandidates<DIM, T>& candidates) {
+        for (auto& entry : cell) {
+            candidates.Add(entry.key_, entry.value_, distance_function(center, entry.key_));
+        }
+    }
+
+    const double cell_length_;
+    std::unordered_map<CellKey, Cell, detail::ArrayHash<CellKey>> cells_;
+    size_t size_ = 0;
+};
+
+/*
+ * Kd-tree with an implicit, balanced layout: every node is the median element of its range in a
+ * sorted array, the left and right subtrees are the ranges before and after the median. The
+ * splitting dimension cycles with the depth.
+ *
+ * The tree is static: new entries are appended to an unsorted buffer and erased entries are
+ * marked as deleted. Both are cleaned up by rebuilding the whole tree once the buffer and the
+ * deleted entries exceed 1/16 of the tree. Queries rebuild the tree if there are more than 256
+ * buffered or deleted entries, otherwise they check the tree and the buffer. A hash map from keys
+ * to positions makes emplace(), erase() and count() O(1) (amortized).
+ */
+template <dimension_t DIM, typename T>
+class StaticKdTree {
+    using Key = PhPointD<DIM>;
+    struct Entry {
+        Key key_;
+        T value_;
+        bool deleted_;
+    };
+    static constexpr size_t MIN_REBUILD_SIZE = 256;
+    // Positions in the buffer are marked with this bit.
+    static constexpr size_t IN_BUFFER = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+  public:
+    template <typename... Args>
+    std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
+        auto result = positions_.emplace(key, buffer_.size() | IN_BUFFER);
+        if (!result.second) {
+            return {At(result.first->second).value_, false};
+        }
+        buffer_.emplace_back(Entry{key, T(std::forward<Args>(args)...), false});
+        if (NeedsRebuild()) {
+            Rebuild();
+            return {At(positions_.at(key)).value_, true};
+        }
+        return {buffer_.back().value_, true};
+    }
+
+    size_t erase(const Key& key) {
+        auto it = positions_.find(key);
+        if (it == positions_.end()) {
+            return 0;
+        }
+        size_t pos = it->second;
+        positions_.erase(it);
+        if ((pos & IN_BUFFER) == 0) {
+            tree_[pos].deleted_ = true;
+            ++n_deleted_;
+        } else {
+            pos &= ~IN_BUFFER;
+            if (pos + 1 != buffer_.size()) {
+                buffer_[pos] = std::move(buffer_.back());
+                positions_[buffer_[pos].key_] = pos | IN_BUFFER;
+            }
+            buffer_.pop_back();
+        }
+        if (NeedsRebuild()) {
+            Rebuild();
+        }
+        return 1;
+    }
+
+    [[nodiscard]] size_t count(const Key& key) const {
+        return positions_.count(key);
+    }
+
+    template <typename CALLBACK>
+    void for_each(const PhBoxD<DIM>& query_box, CALLBACK& callback) {
+        RebuildBeforeQuery();
+        QueryTree(query_box, callback, 0, tree_.size(), 0);
+        for (auto& entry : buffer_) {
+            if (detail::IsInBox(entry.key_, query_box)) {
+                callback(entry.key_, entry.value_);
+            }
+        }
+    }
+
+    template <typename DISTANCE>
+    auto begin_knn_query(size_t min_results, const Key& center, DISTANCE distance_function) {
+        RebuildBeforeQuery();
+        detail::KnnCandidates<DIM, T> candidates{min_results};
+        for (auto& entry : buffer_) {
+            candidates.Add(entry.key_, entry.value_, distance_function(center, entry.key_));
+        }
+        KnnTree(center, distance_function, candidates, 0, tree_.size(), 0);
+        return candidates.ToIterator();
+    }
+
+    auto end() const {
+        return BaselineKnnIterator<DIM, T>();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return positions_.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return positions_.empty();
+    }
+
+    void clear() {
+        positions_.clear();
+        tree_.clear();
+        buffer_.clear();
+        n_deleted_ = 0;
+    }
+
+    /*
+     * Rebuilds the tree from all entries, i.e. the buffer is empty afterwards.
+     */
+    void Rebuild() {
+        std::vector<Entry> entries;
+        entries.reserve(size());
+        for (auto& entry : tree_) {
+            if (!entry.deleted_) {
+                entries.emplace_back(std::move(entry));
+            }
+        }
+        for (auto& entry : buffer_) {
+            entries.emplace_back(std::move(entry));
+        }
+        tree_ = std::move(entries);
+        buffer_.clear();
+        n_deleted_ = 0;
+        Build(0, tree_.size(), 0);
+        for (size_t i = 0; i < tree_.size(); ++i) {
+            positions_[tree_[i].key_] = i;
+        }
+    }
+
+  private:
+    [[nodiscard]] bool NeedsRebuild() const {
+        return buffer_.size() + n_deleted_ > std::max(MIN_REBUILD_SIZE, tree_.size() / 16);
+    }
+
+    void RebuildBeforeQuery() {
+        if (buffer_.size() + n_deleted_ > MIN_REBUILD_SIZE) {
+            Rebuild();
+        }
+    }
+
+    Entry& At(size_t pos) {
+        return (pos & IN_BUFFER) == 0 ? tree_[pos] : buffer_[pos & ~IN_BUFFER];
+    }
+
+    void Build(size_t begin, size_t end, dimension_t dim) {
+        if (end - begin <= 1) {
+            return;
+        }
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(
+            tree_.begin() + begin,
+            tree_.begin() + mid,
+            tree_.begin() + end,
+            [dim](const Entry& left, const Entry& right) {
+                return left.key_[dim] < right.key_[dim];
+            });
+        dimension_t next = (dim + 1) % DIM;
+        Build(begin, mid, next);
+        Build(mid + 1, end, next);
+    }
+
+    template <typename CALLBACK>
+    void QueryTree(
+        const PhBoxD<DIM>& box, CALLBACK& callback, size_t begin, size_t end, dimension_t dim) {
+        while (begin < end) {
+            size_t mid = begin + (end - begin) / 2;
+            Entry& entry = tree_[mid];
+            if (!entry.deleted_ && detail::IsInBox(entry.key_, box)) {
+                callback(entry.key_, entry.value_);
+            }
+            dimension_t next = (dim + 1) % DIM;
+            bool go_left = box.min()[dim] <= entry.key_[dim];
+            bool go_right = box.max()[dim] >= entry.key_[dim];
+            if (go_left && go_right) {
+                QueryTree(box, callback, begin, mid, next);
+                begin = mid + 1;
+            } else if (go_left) {
+                end = mid;
+            } else {
+                begin = mid + 1;
+            }
+            dim = next;
+        }
+    }
+
+    template <typename DISTANCE>
+    void KnnTree(
+        const Key& center,
+        const DISTANCE& distance_function,
+        detail::KnnCandidates<DIM, T>& candidates,
+        size_t begin,
+        size_t end,
+        dimension_t dim) {
+        if (begin >= end) {
+            return;
+        }
+        size_t mid = begin + (end - begin) / 2;
+        Entry& entry = tree_[mid];
+        if (!entry.deleted_) {
+            candidates.Add(entry.key_, entry.value_, distance_function(center, entry.key_));
+        }
+        dimension_t next = (dim + 1) % DIM;
+        double delta = center[dim] - entry.key_[dim];
+        // Visit the closer side first, then the other side only if it can contain candidates.
+        if (delta < 0) {
+            KnnTree(center, distance_function, candidates, begin, mid, next);
+            if (-delta <= candidates.MaxDistance()) {
+                KnnTree(center, distance_function, candidates, mid + 1, end, next);
+            }
+        } else {
+            KnnTree(center, distance_function, candidates, mid + 1, end, next);
+            if (delta <= candidates.MaxDistance()) {
+                KnnTree(center, distance_function, candidates, begin, mid, next);
+            }
+        }
+    }
+
+    std::unordered_map<Key, size_t, detail::ArrayHash<Key>> positions_;
+    std::vector<Entry> tree_;
+    std::vector<Entry> buffer_;
+    size_t n_deleted_ = 0;
+};
+
+/*
+ * Brute force index that scans all entries for every query. Coordinates are stored per dimension
+ * (SoA layout) and are compared in blocks without branches, so that the compiler can vectorize
+ * the scan. A hash map from keys to positions makes emplace() and erase() O(1).
+ */
+template <dimension_t DIM, typename T>
+class BruteForceScan {
+    using Key = PhPointD<DIM>;
+    static constexpr size_t BLOCK_SIZE = 64;
+
+  public:
+    template <typename... Args>
+    std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
+        auto result = positions_.emplace(key, keys_.size());
+        if (!result.second) {
+            return {values_[result.first->second], false};
+        }
+        keys_.emplace_back(key);
+        values_.emplace_back(std::forward<Args>(args)...);
+        for (dimension_t d = 0; d < DIM; ++d) {
+            coordinates_[d].emplace_back(key[d]);
+        }
+        return {values_.back(), true};
+    }
+
+    size_t erase(const Key& key) {
+        auto it = positions_.find(key);
+        if (it == positions_.end()) {
+            return 0;
+        }
+        size_t pos = it->second;
+        positions_.erase(it);
+        size_t last = keys_.size() - 1;
+        if (pos != last) {
+            keys_[pos] = keys_[last];
+            values_[pos] = std::move(values_[last]);
+            for (dimension_t d = 0; d < DIM; ++d) {
+                coordinates_[d][pos] = coordinates_[d][last];
+            }
+            positions_[keys_[pos]] = pos;
+        }
+        keys_.pop_back();
+        values_.pop_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            coordinates_[d].pop_back();
+        }
+        return 1;
+    }
+
+    [[nodiscard]] size_t count(const Key& key) const {
+        return positions_.count(key);
+    }
+
+    template <typename CALLBACK>
+    void for_each(const PhBoxD<DIM>& query_box, CALLBACK& callback) {
+        std::uint8_t match[BLOCK_SIZE];
+        for (size_t begin = 0; begin < keys_.size(); begin += BLOCK_SIZE) {
+            size_t n = std::min(BLOCK_SIZE, keys_.size() - begin);
+            std::fill(match, match + n, 1);
+            for (dimension_t d = 0; d < DIM; ++d) {
+                const double* c = coordinates_[d].data() + begin;
+                double min = query_box.min()[d];
+                double max = query_box.max()[d];
+                for (size_t i = 0; i < n; ++i) {
+                    match[i] &= (c[i] >= min) & (c[i] <= max);
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (match[i]) {
+                    callback(keys_[begin + i], values_[begin + i]);
+                }
+            }
+        }
+    }
+
+    template <typename DISTANCE>
+    auto begin_knn_query(size_t min_results, const Key& center, DISTANCE distance_function) {
+        detail::KnnCandidates<DIM, T> candidates{min_results};
+        if constexpr (std::is_same_v<DISTANCE, DistanceEuclidean<DIM>>) {
+            // Calculate squared distances block-wise, only candidates need a square root.
+            double dist2[BLOCK_SIZE];
+            for (size_t begin = 0; begin < keys_.size(); begin += BLOCK_SIZE) {
+                size_t n = std::min(BLOCK_SIZE, keys_.size() - begin);
+                std::fill(dist2, dist2 + n, 0.);
+                for (dimension_t d = 0; d < DIM; ++d) {
+                    const double* c = coordinates_[d].data() + begin;
+                    for (size_t i = 0; i < n; ++i) {
+                        double delta = c[i] - center[d];
+                        dist2[i] += delta * delta;
+                    }
+                }
+                double max = candidates.MaxDistance();
+                double max2 = max * max;
+                for (size_t i = 0; i < n; ++i) {
+                    if (dist2[i] < max2) {
+                        candidates.Add(keys_[begin + i], values_[begin + i], std::sqrt(dist2[i]));
+                        max = candidates.MaxDistance();
+                        max2 = max * max;
+                    }
+                }
+            }
+        } else {
+            for (size_t i = 0; i < keys_.size(); ++i) {
+                candidates.Add(keys_[i], values_[i], distance_function(center, keys_[i]));
+            }
+        }
+        return candidates.ToIterator();
+    }
+
+    auto end() const {
+        return BaselineKnnIterator<DIM, T>();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return keys_.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return keys_.empty();
+    }
+
+    void clear() {
+        positions_.clear();
+        keys_.clear();
+        values_.clear();
+        for (auto& c : coordinates_) {
+            c.clear();
+        }
+    }
+
+  private:
+    std::unordered_map<Key, size_t, detail::ArrayHash<Key>> positions_;
+    std::vector<Key> keys_;
+    std::vector<T> values_;
+    std::array<std::vector<double>, DIM> coordinates_;
+};
+
+/*
+ * Creates indexes for the benchmarks. For UniformGrid, the cell size is chosen such that a cell
+ * contains on average two entries if 'num_entities' are distributed uniformly in a cube with edge
+ * length 'world_length'.
+ */
+template <typename INDEX>
+struct IndexFactory {
+    static INDEX Create(size_t, double) {
+        return INDEX();
+    }
+};
+
+template <dimension_t DIM, typename T>
+struct IndexFactory<UniformGrid<DIM, T>> {
+    static UniformGrid<DIM, T> Create(size_t num_entities, double world_length) {
+        double n_cells = std::max(1., (double)num_entities / 2.);
+        return UniformGrid<DIM, T>(world_length / std::pow(n_cells, 1. / (double)DIM));
+    }
+};
+
+/*
+ * Called by the benchmarks after the initial entries were inserted, so that static indexes are
+ * not built during the first timed query.
+ */
+template <typename INDEX>
+void FinishSetup(INDEX&) {}
+
+template <dimension_t DIM, typename T>
+void FinishSetup(StaticKdTree<DIM, T>& index) {
+    index.Rebuild();
+}
+
+}  // namespace improbable::phtree::phbenchmark
+
+#endif  // PHTREE_BENCHMARK_BASELINE_INDEXES_H
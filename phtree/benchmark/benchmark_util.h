@@ -18,6 +18,7 @@
 #define PHTREE_BENCHMARK_UTIL_H
 
 #include "phtree/common/common.h"
+#include <algorithm>
 #include <random>
 #include <vector>
 
@@ -25,6 +26,34 @@ namespace improbable::phtree::phbenchmark {
 
 using namespace improbable::phtree;
 
+/*
+ * Zipf distribution over {0, ..., n-1}: The probability of 'i' is proportional to 1/(i+1)^s.
+ */
+class ZipfDistribution {
+  public:
+    ZipfDistribution(size_t n, double exponent) : cdf_(n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1. / std::pow(i + 1., exponent);
+            cdf_[i] = sum;
+        }
+        for (auto& p : cdf_) {
+            p /= sum;
+        }
+    }
+
+    template <typename RANDOM_ENGINE>
+    size_t operator()(RANDOM_ENGINE& random_engine) {
+        double u = uniform_(random_engine);
+        auto pos = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return std::min(static_cast<size_t>(pos), cdf_.size() - 1);
+    }
+
+  private:
+    std::vector<double> cdf_;
+    std::uniform_real_distribution<> uniform_{0., 1.};
+};
+
 namespace {
 template <dimension_t DIM>
 auto CreateDataCUBE = [](auto& points,
@@ -80,6 +109,63 @@ auto CreateDataCLUSTER = [](auto& points,
     }
 };
 
+/*
+ * Points are placed around hotspots. The hotspots are uniformly distributed but their popularity
+ * follows a Zipf distribution, i.e. a few hotspots are very crowded and most are sparse.
+ */
+template <dimension_t DIM>
+auto CreateDataHOTSPOT = [](auto& points,
+                            size_t num_entities,
+                            std::uint32_t seed,
+                            double world_mininum,
+                            double world_maximum,
+                            auto set_coordinate) {
+    std::default_random_engine random_engine{seed};
+    std::uniform_real_distribution<> distribution(world_mininum, world_maximum);
+    const double world_length = world_maximum - world_mininum;
+    std::normal_distribution<> gauss_distribution(0, world_length * 0.01);
+    const size_t NUM_PT_PER_HOTSPOT = 1000;
+    size_t num_hotspots = std::max(size_t(1), num_entities / NUM_PT_PER_HOTSPOT);
+    std::vector<PhPointD<DIM>> hotspots(num_hotspots);
+    for (auto& hotspot : hotspots) {
+        for (dimension_t d = 0; d < DIM; ++d) {
+            hotspot[d] = distribution(random_engine);
+        }
+    }
+    ZipfDistribution zipf(num_hotspots, 1.);
+    for (size_t i = 0; i < num_entities; ++i) {
+        auto& hotspot = hotspots[zipf(random_engine)];
+        auto& p = points[i];
+        for (dimension_t d = 0; d < DIM; ++d) {
+            set_coordinate(p, d, hotspot[d] + gauss_distribution(random_engine));
+        }
+    }
+};
+
+/*
+ * The density of points decreases along the first dimension: The lowest 10% of the range contain
+ * roughly 46% of all points. All other dimensions are uniformly distributed.
+ */
+template <dimension_t DIM>
+auto CreateDataGRADIENT = [](auto& points,
+                             size_t num_entities,
+                             std::uint32_t seed,
+                             double world_mininum,
+                             double world_maximum,
+                             auto set_coordinate) {
+    std::default_random_engine random_engine{seed};
+    std::uniform_real_distribution<> distribution(0, 1);
+    const double world_length = world_maximum - world_mininum;
+    for (size_t i = 0; i < num_entities; ++i) {
+        auto& p = points[i];
+        for (dimension_t d = 0; d < DIM; ++d) {
+            double x = distribution(random_engine);
+            x = d == 0 ? x * x * x : x;
+            set_coordinate(p, d, world_mininum + x * world_length);
+        }
+    }
+};
+
 auto CreateDuplicates =
     [](auto& points, size_t num_unique_entries, size_t num_total_entities, std::uint32_t seed) {
         std::default_random_engine random_engine{seed};
@@ -91,7 +177,7 @@ auto CreateDuplicates =
     };
 }  // namespace
 
-enum TestGenerator { CUBE, CLUSTER };
+enum TestGenerator { CUBE, CLUSTER, HOTSPOT, GRADIENT };
 
 template <dimension_t DIM>
 auto CreatePointDataMinMax = [](auto& points,
@@ -116,6 +202,14 @@ auto CreatePointDataMinMax = [](auto& points,
         CreateDataCLUSTER<DIM>(
             points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
         break;
+    case HOTSPOT:
+        CreateDataHOTSPOT<DIM>(
+            points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
+        break;
+    case GRADIENT:
+        CreateDataGRADIENT<DIM>(
+            points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
+        break;
     default:
         assert(false);
     }
@@ -151,6 +245,14 @@ auto CreateBoxDataMinMax = [](auto& points,
         CreateDataCLUSTER<DIM>(
             points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
         break;
+    case HOTSPOT:
+        CreateDataHOTSPOT<DIM>(
+            points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
+        break;
+    case GRADIENT:
+        CreateDataGRADIENT<DIM>(
+            points, num_unique_entries, seed, world_minimum, world_maximum, set_coordinate_lambda);
+        break;
     default:
         assert(false);
     }
@@ -189,6 +291,165 @@ auto CreateBoxData = [](auto& points,
         fraction_of_duplicates);
 };
 
+enum BoxSizeType { FIXED_SIZE, PARETO_SIZE };
+
+/*
+ * Replaces the edge lengths of boxes with lengths that follow a Pareto distribution (heavy tail):
+ * most boxes keep roughly 'min_length' but a few are very large. The boxes remain cubes and keep
+ * their 'min' corner. Lengths are capped at 'max_length'.
+ *
+ * @param alpha The shape of the distribution, smaller values give heavier tails.
+ */
+template <dimension_t DIM>
+auto ApplyBoxSizes = [](auto& boxes,
+                        BoxSizeType box_sizes,
+                        int seed,
+                        double min_length,
+                        double max_length,
+                        double alpha = 1.5) {
+    if (box_sizes == FIXED_SIZE) {
+        return;
+    }
+    std::default_random_engine random_engine{static_cast<std::uint32_t>(seed)};
+    std::uniform_real_distribution<> distribution(0, 1);
+    for (auto& box : boxes) {
+        // Inverse CDF of the Pareto distribution, 1-u is in (0, 1].
+        double length = min_length / std::pow(1. - distribution(random_engine), 1. / alpha);
+        length = std::min(length, max_length);
+        for (dimension_t d = 0; d < DIM; ++d) {
+            box.max()[d] = box.min()[d] + length;
+        }
+    }
+};
+
+enum MovementType { FIXED_STEP, RANDOM_WALK, WAYPOINT };
+
+/*
+ * Movement of entities for update benchmarks.
+ * - FIXED_STEP: The benchmarks move entities by their own fixed distances, this class is not used.
+ * - RANDOM_WALK: Every step moves an entity in a random direction, entities are reflected at the
+ *   boundaries of the world.
+ * - WAYPOINT: Every entity moves towards a waypoint with constant speed. Once it arrives, it
+ *   chooses a new waypoint. Most waypoints are close to Zipf-distributed hotspots, so crowds form
+ *   around popular hotspots. Hotspots are relocated over time, so crowds also dissolve again.
+ */
+template <dimension_t DIM>
+class MovementModel {
+    static constexpr size_t NUM_HOTSPOTS = 100;
+    static constexpr double HOTSPOT_PROBABILITY = 0.8;
+
+  public:
+    MovementModel(
+        MovementType type,
+        size_t num_entities,
+        std::uint32_t seed,
+        double world_minimum,
+        double world_maximum,
+        double step_length)
+    : type_{type}
+    , world_minimum_{world_minimum}
+    , world_maximum_{world_maximum}
+    , step_length_{step_length}
+    , waypoints_(type == WAYPOINT ? num_entities : 0)
+    , has_waypoint_(type == WAYPOINT ? num_entities : 0, false)
+    , hotspots_(NUM_HOTSPOTS)
+    , n_waypoints_{0}
+    , random_engine_{seed}
+    , world_distribution_{world_minimum, world_maximum}
+    , step_distribution_{-step_length, step_length}
+    , hotspot_distribution_{0, (world_maximum - world_minimum) * 0.01}
+    , zipf_{NUM_HOTSPOTS, 1.} {
+        for (auto& hotspot : hotspots_) {
+            hotspot = RandomPoint();
+        }
+    }
+
+    /*
+     * Calculates the next step of an entity.
+     * @param id The ID of the entity, must be smaller than 'num_entities'.
+     * @param position The current position of the entity (or the 'min' corner of a box).
+     * @param delta Output: The movement vector for this step.
+     */
+    void Move(size_t id, const PhPointD<DIM>& position, PhPointD<DIM>& delta) {
+        switch (type_) {
+        case RANDOM_WALK:
+            for (dimension_t d = 0; d < DIM; ++d) {
+                double x = step_distribution_(random_engine_);
+                double next = position[d] + x;
+                delta[d] = next < world_minimum_ || next > world_maximum_ ? -x : x;
+            }
+            break;
+        case WAYPOINT:
+            MoveToWaypoint(id, position, delta);
+            break;
+        default:
+            for (dimension_t d = 0; d < DIM; ++d) {
+                delta[d] = step_length_;
+            }
+        }
+    }
+
+  private:
+    void MoveToWaypoint(size_t id, const PhPointD<DIM>& position, PhPointD<DIM>& delta) {
+        if (!has_waypoint_[id]) {
+            waypoints_[id] = NextWaypoint();
+            has_waypoint_[id] = true;
+        }
+        double dist_sq = 0;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            delta[d] = waypoints_[id][d] - position[d];
+            dist_sq += delta[d] * delta[d];
+        }
+        double dist = std::sqrt(dist_sq);
+        if (dist <= step_length_) {
+            // Arrived, 'delta' moves the entity exactly to the waypoint.
+            waypoints_[id] = NextWaypoint();
+            return;
+        }
+        for (dimension_t d = 0; d < DIM; ++d) {
+            delta[d] *= step_length_ / dist;
+        }
+    }
+
+    PhPointD<DIM> NextWaypoint() {
+        if (++n_waypoints_ % NUM_HOTSPOTS == 0) {
+            // Relocate a random hotspot, this dissolves the crowd around it
+            hotspots_[zipf_(random_engine_)] = RandomPoint();
+        }
+        if (std::uniform_real_distribution<>(0, 1)(random_engine_) >= HOTSPOT_PROBABILITY) {
+            return RandomPoint();
+        }
+        PhPointD<DIM> p = hotspots_[zipf_(random_engine_)];
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] += hotspot_distribution_(random_engine_);
+            p[d] = std::min(std::max(p[d], world_minimum_), world_maximum_);
+        }
+        return p;
+    }
+
+    PhPointD<DIM> RandomPoint() {
+        PhPointD<DIM> p;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = world_distribution_(random_engine_);
+        }
+        return p;
+    }
+
+    const MovementType type_;
+    const double world_minimum_;
+    const double world_maximum_;
+    const double step_length_;
+    std::vector<PhPointD<DIM>> waypoints_;
+    std::vector<bool> has_waypoint_;
+    std::vector<PhPointD<DIM>> hotspots_;
+    size_t n_waypoints_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> world_distribution_;
+    std::uniform_real_distribution<> step_distribution_;
+    std::normal_distribution<> hotspot_distribution_;
+    ZipfDistribution zipf_;
+};
+
 }  // namespace improbable::phtree::phbenchmark
 
 #endif  // PHTREE_BENCHMARK_UTIL_H
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <random>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+namespace {
+
+const double GLOBAL_MAX = 10000;
+// Number of updates per entity before the queries are measured
+const size_t UPDATES_PER_ENTITY = 2;
+// Number of nodes per call for incremental compaction
+const size_t NODES_PER_STEP = 1000;
+
+enum CompactType { FRAGMENTED, COMPACTED, COMPACTED_INCREMENTAL };
+
+template <dimension_t DIM>
+using BoxType = PhBoxD<DIM>;
+
+template <dimension_t DIM>
+using PointType = PhPointD<DIM>;
+
+template <dimension_t DIM>
+using TreeType = PhTreeD<DIM, size_t>;
+
+/*
+ * Benchmark for window queries on trees that have been fragmented by many updates, with and
+ * without compact().
+ */
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+class IndexBenchmark {
+  public:
+    IndexBenchmark(
+        benchmark::State& state,
+        TestGenerator data_type,
+        int num_entities,
+        double avg_query_result_size_ = 100);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+    void Fragment();
+    void Compact(benchmark::State& state);
+    void QueryWorld(benchmark::State& state, BoxType<DIM>& query_box);
+    void CreateQuery(BoxType<DIM>& query_box);
+
+    const TestGenerator data_type_;
+    const size_t num_entities_;
+    const double avg_query_result_size_;
+
+    constexpr double query_edge_length() {
+        return GLOBAL_MAX * pow(avg_query_result_size_ / (double)num_entities_, 1. / (double)DIM);
+    };
+
+    TreeType<DIM> tree_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> cube_distribution_;
+    std::vector<PointType<DIM>> points_;
+};
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+IndexBenchmark<DIM, COMPACT_TYPE>::IndexBenchmark(
+    benchmark::State& state,
+    TestGenerator data_type,
+    int num_entities,
+    double avg_query_result_size)
+: data_type_{data_type}
+, num_entities_(num_entities)
+, avg_query_result_size_(avg_query_result_size)
+, tree_{}
+, random_engine_{1}
+, cube_distribution_{0, GLOBAL_MAX}
+, points_(num_entities) {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        BoxType<DIM> query_box;
+        CreateQuery(query_box);
+        state.ResumeTiming();
+
+        QueryWorld(state, query_box);
+    }
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::SetupWorld(benchmark::State& state) {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    for (size_t i = 0; i < num_entities_; ++i) {
+        tree_.emplace(points_[i], i);
+    }
+    Fragment();
+    Compact(state);
+
+    state.counters["total_result_count"] = benchmark::Counter(0);
+    state.counters["query_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    state.counters["result_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    state.counters["avg_result_count"] = benchmark::Counter(0, benchmark::Counter::kAvgIterations);
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::Fragment() {
+    // Move random entities to random new positions. Every move deletes and allocates nodes, so
+    // the nodes end up scattered across the heap.
+    std::uniform_int_distribution<size_t> entity_distribution{0, num_entities_ - 1};
+    for (size_t i = 0; i < num_entities_ * UPDATES_PER_ENTITY; ++i) {
+        size_t id = entity_distribution(random_engine_);
+        PointType<DIM> p;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = cube_distribution_(random_engine_);
+        }
+        if (tree_.count(p) == 0) {
+            tree_.erase(points_[id]);
+            tree_.emplace(p, id);
+            points_[id] = p;
+        }
+    }
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::Compact(benchmark::State& state) {
+    if (COMPACT_TYPE == FRAGMENTED) {
+        return;
+    }
+    size_t steps = 0;
+    auto t_start = std::chrono::steady_clock::now();
+    if (COMPACT_TYPE == COMPACTED) {
+        tree_.compact();
+        steps = 1;
+    } else {
+        while (!tree_.compact(NODES_PER_STEP)) {
+            ++steps;
+        }
+        ++steps;
+    }
+    auto t_end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t_end - t_start).count();
+    state.counters["compact_ms"] = ms;
+    state.counters["compact_steps"] = (double)steps;
+    logging::info("Compacted tree in {} ms and {} steps.", ms, steps);
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::QueryWorld(
+    benchmark::State& state, BoxType<DIM>& query_box) {
+    size_t n = 0;
+    auto callback = [&n](const PointType<DIM>&, const size_t&) { ++n; };
+    tree_.for_each(query_box, callback);
+
+    state.counters["total_result_count"] += n;
+    state.counters["query_rate"] += 1;
+    state.counters["result_rate"] += n;
+    state.counters["avg_result_count"] += n;
+}
+
+template <dimension_t DIM, CompactType COMPACT_TYPE>
+void IndexBenchmark<DIM, COMPACT_TYPE>::CreateQuery(BoxType<DIM>& query_box) {
+    double length = query_edge_length();
+    // scale to ensure query lies within boundary
+    double scale = (GLOBAL_MAX - length) / GLOBAL_MAX;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        auto s = cube_distribution_(random_engine_);
+        s = s * scale;
+        query_box.min()[d] = s;
+        query_box.max()[d] = s + length;
+    }
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTree3D_Fragmented(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, FRAGMENTED> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_Compacted(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, COMPACTED> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_CompactedIncremental(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, COMPACTED_INCREMENTAL> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_type, num_entities, query_result_size
+BENCHMARK_CAPTURE(PhTree3D_Fragmented, WQ_CU_100_of_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Fragmented, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Fragmented, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Compacted, WQ_CU_100_of_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Compacted, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Compacted, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_CompactedIncremental, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Command line tool that reports the fastest node container per DIM, based on the JSON output
+ * of the dim_sweep benchmarks (--benchmark_out=FILE), see dim_sweep_benchmark.cc:
+ *
+ * dim_sweep_array_map_benchmark --benchmark_out=array_map.json
+ * dim_sweep_sparse_map_benchmark --benchmark_out=sparse_map.json
+ * dim_sweep_std_map_benchmark --benchmark_out=std_map.json
+ * container_report_tool [--op insert|find|erase|window_query|knn_query] *.json
+ *
+ * For every DIM, the containers are compared by the geometric mean of the time per operation over
+ * all operations and dataset sizes that were measured for all containers of that DIM. If a
+ * benchmark was measured more than once, the fastest measurement is used. Finally, the tool
+ * suggests values for PHTREE_ARRAY_MAP_MAX_DIM and PHTREE_SPARSE_MAP_MAX_DIM.
+ */
+namespace {
+
+const std::vector<std::string> CONTAINERS = {"array_map", "sparse_map", "std_map"};
+
+struct Measurement {
+    std::string container;
+    std::string op;
+    int dim;
+    std::string size;
+};
+
+// Parses benchmark names like "sparse_map/find/DIM:5/N:100000".
+bool ParseName(const std::string& name, Measurement& m) {
+    auto p1 = name.find('/');
+    auto p2 = name.find("/DIM:", p1 + 1);
+    auto p3 = name.find("/N:", p2 + 1);
+    if (p1 == std::string::npos || p2 == std::string::npos || p3 == std::string::npos) {
+        return false;
+    }
+    m.container = name.substr(0, p1);
+    m.op = name.substr(p1 + 1, p2 - p1 - 1);
+    m.dim = std::stoi(name.substr(p2 + 5, p3 - p2 - 5));
+    m.size = name.substr(p3 + 3);
+    return true;
+}
+
+// Returns the string value of a line like '"name": "value",'.
+std::string StringValue(const std::string& line) {
+    auto p1 = line.find('"', line.find(':') + 1);
+    auto p2 = line.rfind('"');
+    return p1 == std::string::npos || p2 <= p1 ? "" : line.substr(p1 + 1, p2 - p1 - 1);
+}
+
+// Returns the numeric value of a line like '"op_time": 1.23e-07,'.
+double NumberValue(const std::string& line) {
+    return std::stod(line.substr(line.find(':') + 1));
+}
+
+// (dim, op/size) -> container -> op_time
+using Results = std::map<int, std::map<std::string, std::map<std::string, double>>>;
+
+/*
+ * Google Benchmark writes one JSON key per line, so a simple line based scan is sufficient.
+ */
+bool ReadResults(const std::string& path, const std::string& op_filter, Results& results) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    Measurement m;
+    bool valid = false;
+    while (std::getline(in, line)) {
+        if (line.find("\"name\":") != std::string::npos) {
+            valid = ParseName(StringValue(line), m) && (op_filter.empty() || op_filter == m.op);
+        } else if (line.find("\"run_type\":") != std::string::npos) {
+            valid = valid && StringValue(line) == "iteration";
+        } else if (valid && line.find("\"op_time\":") != std::string::npos) {
+            auto& entry = results[m.dim][m.op + "/" + m.size];
+            double op_time = NumberValue(line);
+            auto it = entry.find(m.container);
+            if (it == entry.end() || op_time < it->second) {
+                entry[m.container] = op_time;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string op_filter;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--op" && i + 1 < argc) {
+            op_filter = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--op insert|find|erase|window_query|knn_query] FILE.json..." << std::endl;
+        return 1;
+    }
+
+    Results results;
+    for (auto& file : files) {
+        if (!ReadResults(file, op_filter, results)) {
+            std::cerr << "Could not read " << file << std::endl;
+            return 1;
+        }
+    }
+
+    // Geometric mean of the time per operation, relative to the fastest container of each DIM.
+    std::printf("%4s  %-10s", "DIM", "best");
+    for (auto& c : CONTAINERS) {
+        std::printf("  %10s", c.c_str());
+    }
+    std::printf("\n");
+    int array_map_max_dim = 0;
+    int sparse_map_max_dim = 0;
+    bool array_map_best = true;
+    bool sparse_map_best = true;
+    for (auto& [dim, benchmarks] : results) {
+        std::vector<std::string> containers;
+        for (auto& c : CONTAINERS) {
+            for (auto& [name, times] : benchmarks) {
+                if (times.count(c) > 0) {
+                    containers.push_back(c);
+                    break;
+                }
+            }
+        }
+        // Only benchmarks that were measured for all containers of this DIM can be compared.
+        std::map<std::string, double> log_sum;
+        size_t n = 0;
+        for (auto& [name, times] : benchmarks) {
+            bool all = true;
+            for (auto& c : containers) {
+                all &= times.count(c) > 0;
+            }
+            if (!all) {
+                continue;
+            }
+            for (auto& c : containers) {
+                log_sum[c] += std::log(times.at(c));
+            }
+            ++n;
+        }
+        if (n == 0 || containers.empty()) {
+            continue;
+        }
+        std::string best = containers[0];
+        for (auto& c : containers) {
+            if (log_sum[c] < log_sum[best]) {
+                best = c;
+            }
+        }
+        std::printf("%4d  %-10s", dim, best.c_str());
+        for (auto& c : CONTAINERS) {
+            if (log_sum.count(c) == 0) {
+                std::printf("  %10s", "-");
+            } else {
+                std::printf("  %10.2f", std::exp((log_sum[c] - log_sum[best]) / n));
+            }
+        }
+        std::printf("\n");
+
+        array_map_best &= best == "array_map";
+        sparse_map_best &= best != "std_map";
+        array_map_max_dim = array_map_best ? dim : array_map_max_dim;
+        sparse_map_max_dim = sparse_map_best ? dim : sparse_map_max_dim;
+    }
+    std::printf(
+        "\nSuggested: -DPHTREE_ARRAY_MAP_MAX_DIM=%d -DPHTREE_SPARSE_MAP_MAX_DIM=%d\n",
+        array_map_max_dim,
+        std::max(array_map_max_dim, sparse_map_max_dim));
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <utility>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+/*
+ * Sweeps the dimensionality (DIM = 1..32) and the dataset size (1K..10M) for insert, find, erase,
+ * window queries and kNN queries.
+ *
+ * The node container of the PH-Tree depends on DIM, see EntryMap in node.h. To compare containers,
+ * this benchmark is built several times with different PHTREE_ARRAY_MAP_MAX_DIM and
+ * PHTREE_SPARSE_MAP_MAX_DIM (see BUILD). The benchmark names start with the container, e.g.
+ * "sparse_map/find/DIM:5/N:100000". array_map supports only DIM <= 6, higher DIMs of the array_map
+ * build fall back to the other containers.
+ *
+ * The full sweep takes hours, use --benchmark_filter to select containers, operations, DIMs or
+ * sizes, e.g. --benchmark_filter=^sparse_map/find/DIM:5/ runs all sizes of one
+ * operation, container and DIM.
+ *
+ * Every benchmark reports 'op_time', the time per operation in seconds. container_report_tool
+ * reads the JSON output (--benchmark_out=FILE) of the different builds and reports the best
+ * container per DIM.
+ */
+namespace {
+
+const double GLOBAL_MAX = 10000;
+const size_t FIND_PER_ITERATION = 1000;
+const size_t QUERY_RESULT_SIZE = 100;
+const size_t KNN_SIZE = 10;
+const dimension_t MAX_DIM = 32;
+
+enum OpType { INSERT, FIND, ERASE, WINDOW_QUERY, KNN_QUERY };
+
+const char* OP_NAMES[] = {"insert", "find", "erase", "window_query", "knn_query"};
+
+template <dimension_t DIM>
+const char* ContainerName() {
+    if (DIM <= PHTREE_ARRAY_MAP_MAX_DIM) {
+        return "array_map";
+    }
+    return DIM <= PHTREE_SPARSE_MAP_MAX_DIM ? "sparse_map" : "std_map";
+}
+
+template <dimension_t DIM>
+class IndexBenchmark {
+    using TreeType = PhTreeD<DIM, size_t>;
+
+  public:
+    IndexBenchmark(OpType op_type, size_t num_entities);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld();
+
+    void Insert(TreeType& tree);
+
+    void CreateQuery(PhBoxD<DIM>& query_box);
+
+    const OpType op_type_;
+    const size_t num_entities_;
+    const double query_edge_length_;
+
+    TreeType tree_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> cube_distribution_;
+    std::uniform_int_distribution<size_t> entity_distribution_;
+    std::vector<PhPointD<DIM>> points_;
+};
+
+template <dimension_t DIM>
+IndexBenchmark<DIM>::IndexBenchmark(OpType op_type, size_t num_entities)
+: op_type_{op_type}
+, num_entities_{num_entities}
+, query_edge_length_{
+      GLOBAL_MAX * pow(QUERY_RESULT_SIZE / (double)num_entities, 1. / (double)DIM)}
+, tree_{}
+, random_engine_{1}
+, cube_distribution_{0, GLOBAL_MAX}
+, entity_distribution_{0, num_entities - 1}
+, points_(num_entities) {
+    logging::SetupDefaultLogging();
+    SetupWorld();
+}
+
+template <dimension_t DIM>
+void IndexBenchmark<DIM>::Benchmark(benchmark::State& state) {
+    size_t n = 0;
+    size_t ops_per_iteration = 1;
+    for (auto _ : state) {
+        switch (op_type_) {
+        case INSERT: {
+            state.PauseTiming();
+            auto* tree = new TreeType();
+            state.ResumeTiming();
+            Insert(*tree);
+            // avoid measuring deallocation
+            state.PauseTiming();
+            delete tree;
+            state.ResumeTiming();
+            ops_per_iteration = num_entities_;
+            break;
+        }
+        case FIND: {
+            state.PauseTiming();
+            size_t id = entity_distribution_(random_engine_);
+            state.ResumeTiming();
+            for (size_t i = 0; i < FIND_PER_ITERATION; ++i) {
+                n += tree_.count(points_[(id + i * 7919) % num_entities_]);
+            }
+            ops_per_iteration = FIND_PER_ITERATION;
+            break;
+        }
+        case ERASE: {
+            state.PauseTiming();
+            auto* tree = new TreeType();
+            Insert(*tree);
+            state.ResumeTiming();
+            for (auto& p : points_) {
+                n += tree->erase(p);
+            }
+            state.PauseTiming();
+            delete tree;
+            state.ResumeTiming();
+            ops_per_iteration = num_entities_;
+            break;
+        }
+        case WINDOW_QUERY: {
+            state.PauseTiming();
+            PhBoxD<DIM> query_box;
+            CreateQuery(query_box);
+            state.ResumeTiming();
+            auto callback = [&n](const PhPointD<DIM>&, const size_t&) { ++n; };
+            tree_.for_each(query_box, callback);
+            break;
+        }
+        case KNN_QUERY: {
+            state.PauseTiming();
+            auto& center = points_[entity_distribution_(random_engine_)];
+            state.ResumeTiming();
+            auto q = tree_.begin_knn_query(KNN_SIZE, center, DistanceEuclidean<DIM>());
+            for (; q != tree_.end(); ++q) {
+                ++n;
+            }
+            break;
+        }
+        }
+    }
+    benchmark::DoNotOptimize(n);
+    state.counters["op_time"] = benchmark::Counter(
+        ops_per_iteration,
+        benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+template <dimension_t DIM>
+void IndexBenchmark<DIM>::SetupWorld() {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    CreatePointData<DIM>(points_, TestGenerator::CUBE, num_entities_, 0, GLOBAL_MAX);
+    if (op_type_ == FIND || op_type_ == WINDOW_QUERY || op_type_ == KNN_QUERY) {
+        Insert(tree_);
+    }
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM>
+void IndexBenchmark<DIM>::Insert(TreeType& tree) {
+    for (size_t i = 0; i < num_entities_; ++i) {
+        tree.emplace(points_[i], i);
+    }
+}
+
+template <dimension_t DIM>
+void IndexBenchmark<DIM>::CreateQuery(PhBoxD<DIM>& query_box) {
+    double length = std::min(query_edge_length_, GLOBAL_MAX);
+    // scale to ensure query lies within boundary
+    double scale = (GLOBAL_MAX - length) / GLOBAL_MAX;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        auto s = cube_distribution_(random_engine_) * scale;
+        query_box.min()[d] = s;
+        query_box.max()[d] = s + length;
+    }
+}
+
+template <dimension_t DIM>
+void RegisterDim() {
+    for (int op = INSERT; op <= KNN_QUERY; ++op) {
+        for (size_t num_entities = 1000; num_entities <= 10 * 1000 * 1000; num_entities *= 10) {
+            std::string name = std::string(ContainerName<DIM>()) + "/" + OP_NAMES[op] +
+                "/DIM:" + std::to_string(DIM) + "/N:" + std::to_string(num_entities);
+            benchmark::RegisterBenchmark(
+                name.c_str(),
+                [op, num_entities](benchmark::State& state) {
+                    IndexBenchmark<DIM> benchmark{static_cast<OpType>(op), num_entities};
+                    benchmark.Benchmark(state);
+                })
+                ->Unit(benchmark::kMicrosecond);
+        }
+    }
+}
+
+template <dimension_t... DIMS>
+void RegisterDims(std::integer_sequence<dimension_t, DIMS...>) {
+    (RegisterDim<DIMS + 1>(), ...);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    RegisterDims(std::make_integer_sequence<dimension_t, MAX_DIM>{});
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
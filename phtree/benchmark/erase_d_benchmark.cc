@@ -15,6 +15,7 @@
  */
 #include "logging.h"
 #include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/perf_counters.h"
 #include "phtree/phtree.h"
 #include <benchmark/benchmark.h>
 #include <random>
@@ -48,6 +49,7 @@ class IndexBenchmark {
     std::default_random_engine random_engine_;
     std::uniform_real_distribution<> cube_distribution_;
     std::vector<PhPointD<DIM>> points_;
+    PerfCounters perf_;
 };
 
 template <dimension_t DIM>
@@ -68,15 +70,18 @@ void IndexBenchmark<DIM>::Benchmark(benchmark::State& state) {
         state.PauseTiming();
         auto* tree = new PhTreeD<DIM, int>();
         Insert(state, *tree);
+        perf_.Start();
         state.ResumeTiming();
 
         Remove(state, *tree);
 
         state.PauseTiming();
+        perf_.Stop();
         // avoid measuring deallocation
         delete tree;
         state.ResumeTiming();
     }
+    perf_.Report(state, (double)num_entities_ * state.iterations());
 }
 
 template <dimension_t DIM>
@@ -87,6 +92,9 @@ void IndexBenchmark<DIM>::SetupWorld(benchmark::State& state) {
     state.counters["total_remove_count"] = benchmark::Counter(0);
     state.counters["remove_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
 
+    if (!perf_.IsAvailable()) {
+        logging::info("Hardware performance counters are not available: {}", perf_.GetError());
+    }
     logging::info("World setup complete.");
 }
 
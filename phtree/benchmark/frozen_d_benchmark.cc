@@ -0,0 +1,271 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include "phtree/phtree_frozen.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+namespace {
+
+const double GLOBAL_MAX = 10000;
+
+enum Scenario { MUTABLE, FROZEN };
+
+enum QueryType { WQ_ITER, WQ_FOR_EACH, KNN };
+
+/*
+ * Benchmark for queries on a frozen tree (see freeze() in phtree_frozen.h), compared to the
+ * mutable tree.
+ */
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+class IndexBenchmark {
+  public:
+    IndexBenchmark(
+        benchmark::State& state,
+        TestGenerator data_type,
+        int num_entities,
+        double avg_query_result_size_ = 100);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+
+    template <typename TREE>
+    void QueryWorld(benchmark::State& state, TREE& tree);
+
+    void CreateQuery(PhBoxD<DIM>& query_box);
+
+    const TestGenerator data_type_;
+    const int num_entities_;
+    const double avg_query_result_size_;
+
+    constexpr int query_endge_length() {
+        return GLOBAL_MAX * pow(avg_query_result_size_ / (double)num_entities_, 1. / (double)DIM);
+    };
+
+    PhTreeD<DIM, int> tree_;
+    PhTreeFrozenD<DIM, int> frozen_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> cube_distribution_;
+    std::vector<PhPointD<DIM>> points_;
+};
+
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+IndexBenchmark<DIM, SCENARIO, QUERY_TYPE>::IndexBenchmark(
+    benchmark::State& state,
+    TestGenerator data_type,
+    int num_entities,
+    double avg_query_result_size)
+: data_type_{data_type}
+, num_entities_(num_entities)
+, avg_query_result_size_(avg_query_result_size)
+, tree_{}
+, frozen_{}
+, random_engine_{1}
+, cube_distribution_{0, GLOBAL_MAX}
+, points_(num_entities) {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+}
+
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+void IndexBenchmark<DIM, SCENARIO, QUERY_TYPE>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        if (SCENARIO == MUTABLE) {
+            QueryWorld(state, tree_);
+        } else {
+            QueryWorld(state, frozen_);
+        }
+    }
+}
+
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+void IndexBenchmark<DIM, SCENARIO, QUERY_TYPE>::SetupWorld(benchmark::State& state) {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    for (int i = 0; i < num_entities_; ++i) {
+        tree_.emplace(points_[i], i);
+    }
+    if (SCENARIO == FROZEN) {
+        frozen_ = freeze(tree_);
+        state.counters["frozen_bytes"] = benchmark::Counter((double)frozen_.memory_size());
+    }
+
+    state.counters["total_result_count"] = benchmark::Counter(0);
+    state.counters["query_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    state.counters["result_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    state.counters["avg_result_count"] = benchmark::Counter(0, benchmark::Counter::kAvgIterations);
+
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM>
+struct Counter {
+    void operator()(const PhPointD<DIM>&, const int&) {
+        ++n_;
+    }
+
+    size_t n_ = 0;
+};
+
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+template <typename TREE>
+void IndexBenchmark<DIM, SCENARIO, QUERY_TYPE>::QueryWorld(benchmark::State& state, TREE& tree) {
+    state.PauseTiming();
+    PhBoxD<DIM> query_box;
+    CreateQuery(query_box);
+    state.ResumeTiming();
+
+    size_t n = 0;
+    switch (QUERY_TYPE) {
+    case WQ_ITER:
+        for (auto q = tree.begin_query(query_box); q != tree.end(); ++q) {
+            ++n;
+        }
+        break;
+    case WQ_FOR_EACH: {
+        Counter<DIM> callback;
+        tree.for_each(query_box, callback);
+        n = callback.n_;
+        break;
+    }
+    case KNN:
+        auto q = tree.begin_knn_query(
+            avg_query_result_size_, query_box.min(), DistanceEuclidean<DIM>());
+        for (; q != tree.end(); ++q) {
+            ++n;
+        }
+        break;
+    }
+
+    state.counters["total_result_count"] += n;
+    state.counters["query_rate"] += 1;
+    state.counters["result_rate"] += n;
+    state.counters["avg_result_count"] += n;
+}
+
+template <dimension_t DIM, Scenario SCENARIO, QueryType QUERY_TYPE>
+void IndexBenchmark<DIM, SCENARIO, QUERY_TYPE>::CreateQuery(PhBoxD<DIM>& query_box) {
+    int length = query_endge_length();
+    // scale to ensure query lies within boundary
+    double scale = (GLOBAL_MAX - (double)length) / GLOBAL_MAX;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        auto s = cube_distribution_(random_engine_);
+        s = s * scale;
+        query_box.min()[d] = s;
+        query_box.max()[d] = s + length;
+    }
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTree3D_WQ(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MUTABLE, WQ_ITER> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_WQ_FROZEN(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, FROZEN, WQ_ITER> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_FE(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MUTABLE, WQ_FOR_EACH> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_FE_FROZEN(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, FROZEN, WQ_FOR_EACH> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_KNN(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MUTABLE, KNN> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_KNN_FROZEN(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, FROZEN, KNN> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D_FE(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, MUTABLE, WQ_FOR_EACH> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D_FE_FROZEN(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, FROZEN, WQ_FOR_EACH> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_type, num_entities, query_result_size
+// PhTree 3D CUBE, window queries
+BENCHMARK_CAPTURE(PhTree3D_WQ, CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_WQ_FROZEN, CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_FE, CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_FE_FROZEN, CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 3D CLUSTER, window queries
+BENCHMARK_CAPTURE(PhTree3D_FE, CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_FE_FROZEN, CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 3D CUBE, kNN
+BENCHMARK_CAPTURE(PhTree3D_KNN, CU_1_of_1M, TestGenerator::CUBE, 1000000, 1.)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_KNN_FROZEN, CU_1_of_1M, TestGenerator::CUBE, 1000000, 1.)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_KNN, CU_10_of_1M, TestGenerator::CUBE, 1000000, 10.)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_KNN_FROZEN, CU_10_of_1M, TestGenerator::CUBE, 1000000, 10.)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 10D CLUSTER
+BENCHMARK_CAPTURE(PhTree10D_FE, CL_100_of_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree10D_FE_FROZEN, CL_100_of_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 #include "logging.h"
+#include "phtree/benchmark/baseline_indexes.h"
 #include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/perf_counters.h"
 #include "phtree/phtree.h"
 #include <benchmark/benchmark.h>
 
@@ -29,7 +31,7 @@ const double GLOBAL_MAX = 10000;
 /*
  * Benchmark for adding entries to the index.
  */
-template <dimension_t DIM>
+template <dimension_t DIM, typename INDEX = PhTreeD<DIM, int>>
 class IndexBenchmark {
   public:
     IndexBenchmark(benchmark::State& state, TestGenerator data_type, int num_entities);
@@ -39,50 +41,57 @@ class IndexBenchmark {
   private:
     void SetupWorld(benchmark::State& state);
 
-    void Insert(benchmark::State& state, PhTreeD<DIM, int>& tree);
+    void Insert(benchmark::State& state, INDEX& tree);
 
     const TestGenerator data_type_;
     const int num_entities_;
     std::vector<PhPointD<DIM>> points_;
+    PerfCounters perf_;
 };
 
-template <dimension_t DIM>
-IndexBenchmark<DIM>::IndexBenchmark(
+template <dimension_t DIM, typename INDEX>
+IndexBenchmark<DIM, INDEX>::IndexBenchmark(
     benchmark::State& state, TestGenerator data_type, int num_entities)
 : data_type_{data_type}, num_entities_(num_entities), points_(num_entities) {
     logging::SetupDefaultLogging();
     SetupWorld(state);
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::Benchmark(benchmark::State& state) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::Benchmark(benchmark::State& state) {
     for (auto _ : state) {
         state.PauseTiming();
-        auto* tree = new PhTreeD<DIM, int>();
+        auto* tree = new INDEX(IndexFactory<INDEX>::Create(num_entities_, GLOBAL_MAX));
+        perf_.Start();
         state.ResumeTiming();
 
         Insert(state, *tree);
 
         // we do this top avoid measuring deallocation
         state.PauseTiming();
+        perf_.Stop();
         delete tree;
         state.ResumeTiming();
     }
+    perf_.Report(state, (double)num_entities_ * state.iterations());
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::SetupWorld(benchmark::State& state) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
 
     state.counters["total_put_count"] = benchmark::Counter(0);
     state.counters["put_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
 
+    if (!perf_.IsAvailable()) {
+        logging::info("Hardware performance counters are not available: {}", perf_.GetError());
+    }
     logging::info("World setup complete.");
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::Insert(benchmark::State& state, PhTreeD<DIM, int>& tree) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::Insert(benchmark::State& state, INDEX& tree) {
     for (int i = 0; i < num_entities_; ++i) {
         PhPointD<DIM>& p = points_[i];
         tree.emplace(p, i);
@@ -118,6 +127,24 @@ void PhTree20D(benchmark::State& state, Arguments&&... arguments) {
     benchmark.Benchmark(state);
 }
 
+template <typename... Arguments>
+void Grid3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, UniformGrid<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void KdTree3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, StaticKdTree<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void Scan3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, BruteForceScan<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
 // index type, scenario name, data_generator, num_entities
 // PhTree 3D CUBE
 BENCHMARK_CAPTURE(PhTree3D, INS_CU_1K, TestGenerator::CUBE, 1000)->Unit(benchmark::kMillisecond);
@@ -164,4 +191,28 @@ BENCHMARK_CAPTURE(PhTree20D, INS_CL_100K, TestGenerator::CLUSTER, 100000)
 BENCHMARK_CAPTURE(PhTree20D, INS_CL_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
+// Baseline indexes 3D
+BENCHMARK_CAPTURE(Grid3D, INS_CU_100K, TestGenerator::CUBE, 100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D, INS_CU_1M, TestGenerator::CUBE, 1000000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D, INS_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, INS_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, INS_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, INS_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, INS_CU_100K, TestGenerator::CUBE, 100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, INS_CU_1M, TestGenerator::CUBE, 1000000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, INS_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
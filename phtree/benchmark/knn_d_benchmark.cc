@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 #include "logging.h"
+#include "phtree/benchmark/baseline_indexes.h"
 #include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/perf_counters.h"
 #include "phtree/phtree.h"
 #include <benchmark/benchmark.h>
 #include <random>
@@ -30,7 +32,7 @@ const double GLOBAL_MAX = 10000;
 /*
  * Benchmark for k-nearest-neighbour queries.
  */
-template <dimension_t DIM>
+template <dimension_t DIM, typename INDEX = PhTreeD<DIM, int>>
 class IndexBenchmark {
   public:
     IndexBenchmark(
@@ -47,18 +49,20 @@ class IndexBenchmark {
     const int num_entities_;
     const double knn_result_size_;
 
-    PhTreeD<DIM, int> tree_;
+    INDEX tree_;
     std::default_random_engine random_engine_;
     std::uniform_real_distribution<> cube_distribution_;
     std::vector<PhPointD<DIM>> points_;
+    PerfCounters perf_;
 };
 
-template <dimension_t DIM>
-IndexBenchmark<DIM>::IndexBenchmark(
+template <dimension_t DIM, typename INDEX>
+IndexBenchmark<DIM, INDEX>::IndexBenchmark(
     benchmark::State& state, TestGenerator data_type, int num_entities, int knn_result_size)
 : data_type_{data_type}
 , num_entities_(num_entities)
 , knn_result_size_(knn_result_size)
+, tree_{IndexFactory<INDEX>::Create(num_entities, GLOBAL_MAX)}
 , random_engine_{1}
 , cube_distribution_{0, GLOBAL_MAX}
 , points_(num_entities) {
@@ -66,25 +70,31 @@ IndexBenchmark<DIM>::IndexBenchmark(
     SetupWorld(state);
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::Benchmark(benchmark::State& state) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::Benchmark(benchmark::State& state) {
+    perf_.Start();
     for (auto _ : state) {
         state.PauseTiming();
+        perf_.Stop();
         PhPointD<DIM> center;
         CreateQuery(center);
+        perf_.Start();
         state.ResumeTiming();
 
         QueryWorld(state, center);
     }
+    perf_.Stop();
+    perf_.Report(state, state.iterations());
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::SetupWorld(benchmark::State& state) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
     for (int i = 0; i < num_entities_; ++i) {
         tree_.emplace(points_[i], i);
     }
+    FinishSetup(tree_);
 
     state.counters["total_result_count"] = benchmark::Counter(0);
     state.counters["total_query_count"] = benchmark::Counter(0);
@@ -92,11 +102,14 @@ void IndexBenchmark<DIM>::SetupWorld(benchmark::State& state) {
     state.counters["result_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
     state.counters["avg_result_count"] = benchmark::Counter(0, benchmark::Counter::kAvgIterations);
 
+    if (!perf_.IsAvailable()) {
+        logging::info("Hardware performance counters are not available: {}", perf_.GetError());
+    }
     logging::info("World setup complete.");
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::QueryWorld(benchmark::State& state, PhPointD<DIM>& center) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::QueryWorld(benchmark::State& state, PhPointD<DIM>& center) {
     int n = 0;
     for (auto q = tree_.begin_knn_query(knn_result_size_, center, DistanceEuclidean<3>());
          q != tree_.end();
@@ -111,10 +124,10 @@ void IndexBenchmark<DIM>::QueryWorld(benchmark::State& state, PhPointD<DIM>& cen
     state.counters["avg_result_count"] += n;
 }
 
-template <dimension_t DIM>
-void IndexBenchmark<DIM>::CreateQuery(PhPointD<DIM>& center) {
+template <dimension_t DIM, typename INDEX>
+void IndexBenchmark<DIM, INDEX>::CreateQuery(PhPointD<DIM>& center) {
     for (dimension_t d = 0; d < DIM; ++d) {
-        center[d] = cube_distribution_(random_engine_) * GLOBAL_MAX;
+        center[d] = cube_distribution_(random_engine_);
     }
 }
 
@@ -126,6 +139,24 @@ void PhTree3D(benchmark::State& state, Arguments&&... arguments) {
     benchmark.Benchmark(state);
 }
 
+template <typename... Arguments>
+void Grid3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, UniformGrid<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void KdTree3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, StaticKdTree<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void Scan3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, BruteForceScan<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
 // index type, scenario name, data_type, num_entities, query_result_size
 // PhTree 3D CUBE
 BENCHMARK_CAPTURE(PhTree3D, KNN_CU_1_of_10K, TestGenerator::CUBE, 10000, 1)
@@ -154,4 +185,33 @@ BENCHMARK_CAPTURE(PhTree3D, KNN_CL_10_of_10K, TestGenerator::CLUSTER, 10000, 10)
 BENCHMARK_CAPTURE(PhTree3D, KNN_CL_10_of_1M, TestGenerator::CLUSTER, 1000000, 10)
     ->Unit(benchmark::kMillisecond);
 
+// index type, scenario name, data_type, num_entities, query_result_size
+// Baseline indexes 3D
+BENCHMARK_CAPTURE(Grid3D, KNN_CU_10_of_10K, TestGenerator::CUBE, 10000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D, KNN_CU_10_of_1M, TestGenerator::CUBE, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D, KNN_CL_10_of_1M, TestGenerator::CLUSTER, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, KNN_CU_10_of_10K, TestGenerator::CUBE, 10000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, KNN_CU_10_of_1M, TestGenerator::CUBE, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, KNN_CL_10_of_1M, TestGenerator::CLUSTER, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, KNN_CU_10_of_10K, TestGenerator::CUBE, 10000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, KNN_CU_10_of_1M, TestGenerator::CUBE, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, KNN_CL_10_of_1M, TestGenerator::CLUSTER, 1000000, 10)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
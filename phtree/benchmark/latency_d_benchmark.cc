@@ -0,0 +1,373 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/latency_histogram.h"
+#include "phtree/phtree.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+namespace {
+
+constexpr size_t OPS_PER_ROUND = 1000;
+// Insertions cycle through this many rounds of new points
+constexpr size_t INSERT_ROUNDS = 10;
+constexpr double MOVE_DISTANCE = 10;
+constexpr double QUERY_RESULT_SIZE = 100;
+constexpr size_t KNN_RESULT_SIZE = 10;
+
+const double GLOBAL_MAX = 10000;
+
+enum OpType { INSERT, ERASE, RELOCATE, WINDOW_QUERY, KNN_QUERY };
+
+template <dimension_t DIM>
+using PointType = PhPointD<DIM>;
+
+template <dimension_t DIM>
+using BoxType = PhBoxD<DIM>;
+
+template <dimension_t DIM>
+using TreeType = PhTreeD<DIM, size_t>;
+
+/*
+ * Benchmark for the latency distribution of single operations.
+ *
+ * Every operation is timed individually and recorded in a LatencyHistogram. The percentiles are
+ * reported as counters (in nanoseconds) in addition to Google Benchmark's mean time per round.
+ * Operations that restore the tree between rounds (e.g. erasing inserted entries) are not timed.
+ */
+template <dimension_t DIM, OpType OP>
+class IndexBenchmark {
+  public:
+    IndexBenchmark(
+        benchmark::State& state,
+        TestGenerator data_type,
+        int num_entities,
+        size_t ops_per_round = OPS_PER_ROUND);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+    void PrepareRound();
+    void RunRound();
+    void RestoreRound();
+    void Report(benchmark::State& state);
+
+    BoxType<DIM> CreateQueryBox();
+    PointType<DIM> CreateQueryPoint();
+
+    const TestGenerator data_type_;
+    const size_t num_entities_;
+    const size_t ops_per_round_;
+    size_t tree_size_;
+
+    TreeType<DIM> tree_;
+    std::vector<PointType<DIM>> points_;
+    std::vector<PointType<DIM>> new_points_;
+    std::vector<size_t> ids_;
+    std::vector<BoxType<DIM>> query_boxes_;
+    std::vector<PointType<DIM>> query_points_;
+    size_t round_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> cube_distribution_;
+    std::uniform_real_distribution<> move_distribution_;
+    LatencyHistogram<> histogram_;
+};
+
+template <dimension_t DIM, OpType OP>
+IndexBenchmark<DIM, OP>::IndexBenchmark(
+    benchmark::State& state, TestGenerator data_type, int num_entities, size_t ops_per_round)
+: data_type_{data_type}
+, num_entities_(num_entities)
+, ops_per_round_(ops_per_round)
+, tree_size_{0}
+, points_(num_entities)
+, round_{0}
+, random_engine_{1}
+, cube_distribution_{0, GLOBAL_MAX}
+, move_distribution_{-MOVE_DISTANCE, MOVE_DISTANCE} {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        PrepareRound();
+        state.ResumeTiming();
+
+        RunRound();
+
+        state.PauseTiming();
+        RestoreRound();
+        state.ResumeTiming();
+    }
+    Report(state);
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::SetupWorld(benchmark::State& state) {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    for (size_t i = 0; i < num_entities_; ++i) {
+        tree_.emplace(points_[i], i);
+    }
+    // This may be smaller than num_entities_ if the generator created duplicates
+    tree_size_ = tree_.size();
+    if (OP == INSERT) {
+        // Use a different seed to get points that are not in the tree
+        new_points_.resize(ops_per_round_ * INSERT_ROUNDS);
+        CreatePointData<DIM>(new_points_, data_type_, new_points_.size(), 1, GLOBAL_MAX);
+    }
+    ids_.resize(num_entities_);
+    for (size_t i = 0; i < num_entities_; ++i) {
+        ids_[i] = i;
+    }
+    std::shuffle(ids_.begin(), ids_.end(), random_engine_);
+
+    state.counters["total_op_count"] = benchmark::Counter(0);
+    state.counters["op_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::PrepareRound() {
+    switch (OP) {
+    case WINDOW_QUERY:
+        query_boxes_.clear();
+        for (size_t i = 0; i < ops_per_round_; ++i) {
+            query_boxes_.emplace_back(CreateQueryBox());
+        }
+        break;
+    case KNN_QUERY:
+        query_points_.clear();
+        for (size_t i = 0; i < ops_per_round_; ++i) {
+            query_points_.emplace_back(CreateQueryPoint());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::RunRound() {
+    // Erase and relocate use a different window of distinct entities in every round.
+    size_t id_offset = (round_ * ops_per_round_) % num_entities_;
+    size_t insert_offset = (round_ % INSERT_ROUNDS) * ops_per_round_;
+    size_t n = 0;
+    for (size_t i = 0; i < ops_per_round_; ++i) {
+        size_t id = ids_[(id_offset + i) % num_entities_];
+        switch (OP) {
+        case INSERT: {
+            LatencyTimer timer;
+            n += tree_.emplace(new_points_[insert_offset + i], num_entities_ + i).second;
+            histogram_.Record(timer.ElapsedNanos());
+            break;
+        }
+        case ERASE: {
+            LatencyTimer timer;
+            n += tree_.erase(points_[id]);
+            histogram_.Record(timer.ElapsedNanos());
+            break;
+        }
+        case RELOCATE: {
+            PointType<DIM> new_point = points_[id];
+            for (dimension_t d = 0; d < DIM; ++d) {
+                new_point[d] += move_distribution_(random_engine_);
+            }
+            LatencyTimer timer;
+            auto iter = tree_.find(points_[id]);
+            tree_.erase(iter);
+            n += tree_.emplace_hint(iter, new_point, id).second;
+            histogram_.Record(timer.ElapsedNanos());
+            points_[id] = new_point;
+            break;
+        }
+        case WINDOW_QUERY: {
+            size_t n_found = 0;
+            auto callback = [&n_found](const PointType<DIM>&, const size_t&) { ++n_found; };
+            LatencyTimer timer;
+            tree_.for_each(query_boxes_[i], callback);
+            histogram_.Record(timer.ElapsedNanos());
+            n += n_found > 0;
+            break;
+        }
+        case KNN_QUERY: {
+            LatencyTimer timer;
+            auto q = tree_.begin_knn_query(
+                KNN_RESULT_SIZE, query_points_[i], DistanceEuclidean<DIM>());
+            for (; q != tree_.end(); ++q) {
+                ++n;
+            }
+            histogram_.Record(timer.ElapsedNanos());
+            break;
+        }
+        }
+    }
+    benchmark::DoNotOptimize(n);
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::RestoreRound() {
+    size_t id_offset = (round_ * ops_per_round_) % num_entities_;
+    size_t insert_offset = (round_ % INSERT_ROUNDS) * ops_per_round_;
+    for (size_t i = 0; i < ops_per_round_; ++i) {
+        switch (OP) {
+        case INSERT: {
+            // Only remove entries that were inserted, new points may collide with existing ones.
+            auto iter = tree_.find(new_points_[insert_offset + i]);
+            if (iter != tree_.end() && *iter >= num_entities_) {
+                tree_.erase(iter);
+            }
+            break;
+        }
+        case ERASE: {
+            size_t id = ids_[(id_offset + i) % num_entities_];
+            tree_.emplace(points_[id], id);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (tree_.size() != tree_size_) {
+        logging::error("Invalid index size after round: {}/{}", tree_.size(), tree_size_);
+    }
+    ++round_;
+}
+
+template <dimension_t DIM, OpType OP>
+void IndexBenchmark<DIM, OP>::Report(benchmark::State& state) {
+    state.counters["total_op_count"] += histogram_.Count();
+    state.counters["op_rate"] += histogram_.Count();
+    state.counters["mean_ns"] = histogram_.Mean();
+    state.counters["p50_ns"] = histogram_.Percentile(50);
+    state.counters["p90_ns"] = histogram_.Percentile(90);
+    state.counters["p99_ns"] = histogram_.Percentile(99);
+    state.counters["p999_ns"] = histogram_.Percentile(99.9);
+    state.counters["max_ns"] = histogram_.Max();
+    logging::info("Latency [ns]: {}", histogram_.ToString());
+}
+
+template <dimension_t DIM, OpType OP>
+BoxType<DIM> IndexBenchmark<DIM, OP>::CreateQueryBox() {
+    double length = GLOBAL_MAX * pow(QUERY_RESULT_SIZE / (double)num_entities_, 1. / (double)DIM);
+    // scale to ensure query lies within boundary
+    double scale = (GLOBAL_MAX - length) / GLOBAL_MAX;
+    BoxType<DIM> query_box;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        auto s = cube_distribution_(random_engine_) * scale;
+        query_box.min()[d] = s;
+        query_box.max()[d] = s + length;
+    }
+    return query_box;
+}
+
+template <dimension_t DIM, OpType OP>
+PointType<DIM> IndexBenchmark<DIM, OP>::CreateQueryPoint() {
+    PointType<DIM> center;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        center[d] = cube_distribution_(random_engine_);
+    }
+    return center;
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTreeInsert3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, INSERT> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTreeErase3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, ERASE> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTreeRelocate3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, RELOCATE> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTreeWindowQuery3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, WINDOW_QUERY> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTreeKnnQuery3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, KNN_QUERY> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_type, num_entities
+BENCHMARK_CAPTURE(PhTreeInsert3D, LATENCY_CU_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeInsert3D, LATENCY_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeInsert3D, LATENCY_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeErase3D, LATENCY_CU_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeErase3D, LATENCY_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeErase3D, LATENCY_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeRelocate3D, LATENCY_CU_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeRelocate3D, LATENCY_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeRelocate3D, LATENCY_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeWindowQuery3D, LATENCY_CU_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeWindowQuery3D, LATENCY_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeWindowQuery3D, LATENCY_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeKnnQuery3D, LATENCY_CU_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeKnnQuery3D, LATENCY_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeKnnQuery3D, LATENCY_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_MAIN();
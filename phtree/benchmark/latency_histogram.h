@@ -0,0 +1,167 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_BENCHMARK_LATENCY_HISTOGRAM_H
+#define PHTREE_BENCHMARK_LATENCY_HISTOGRAM_H
+
+#include "phtree/common/common.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace improbable::phtree::phbenchmark {
+
+/*
+ * A histogram of latencies in nanoseconds in the style of HdrHistogram.
+ *
+ * Buckets are log-linear: every power of two is split into 2^SUB_BUCKET_BITS linear sub-buckets.
+ * With the default of 7 bits, any recorded value can be reported with a relative error below 1%
+ * while the histogram covers the whole range of std::uint64_t with a fixed 60 KB array.
+ * Recording a value is O(1) and does not allocate.
+ */
+template <int SUB_BUCKET_BITS = 7>
+class LatencyHistogram {
+    static_assert(SUB_BUCKET_BITS >= 1 && SUB_BUCKET_BITS <= 16);
+    static constexpr std::uint64_t SUB_BUCKETS = std::uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t N_BUCKETS = (65 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  public:
+    void Record(std::uint64_t value) {
+        ++counts_[IndexOf(value)];
+        ++total_count_;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < N_BUCKETS; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void Reset() {
+        counts_.fill(0);
+        total_count_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<std::uint64_t>::max();
+        max_ = 0;
+    }
+
+    [[nodiscard]] std::uint64_t Count() const {
+        return total_count_;
+    }
+
+    [[nodiscard]] std::uint64_t Min() const {
+        return total_count_ == 0 ? 0 : min_;
+    }
+
+    [[nodiscard]] std::uint64_t Max() const {
+        return max_;
+    }
+
+    [[nodiscard]] double Mean() const {
+        return total_count_ == 0 ? 0. : (double)sum_ / (double)total_count_;
+    }
+
+    /*
+     * @param percentile A value between 0 and 100, e.g. 99.9.
+     * @return The highest value that is equivalent (within the histogram's precision) to the
+     * value at the given percentile. The result is never larger than Max().
+     */
+    [[nodiscard]] std::uint64_t Percentile(double percentile) const {
+        if (total_count_ == 0) {
+            return 0;
+        }
+        percentile = std::min(std::max(percentile, 0.), 100.);
+        auto rank = static_cast<std::uint64_t>(percentile / 100. * (double)total_count_ + 0.5);
+        rank = std::max(rank, std::uint64_t{1});
+        std::uint64_t n = 0;
+        for (size_t i = 0; i < N_BUCKETS; ++i) {
+            n += counts_[i];
+            if (n >= rank) {
+                return std::min(HighestEquivalentValue(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    [[nodiscard]] std::string ToString() const {
+        std::ostringstream s;
+        s << "n=" << Count() << " mean=" << Mean() << " min=" << Min()
+          << " p50=" << Percentile(50) << " p90=" << Percentile(90) << " p99=" << Percentile(99)
+          << " p99.9=" << Percentile(99.9) << " max=" << Max();
+        return s.str();
+    }
+
+  private:
+    static size_t IndexOf(std::uint64_t value) {
+        // Values below 2*SUB_BUCKETS are stored exactly, larger values are shifted such that they
+        // fall into [SUB_BUCKETS, 2*SUB_BUCKETS).
+        bit_width_t magnitude = 63 - CountLeadingZeros(value | 1);
+        bit_width_t shift = magnitude > SUB_BUCKET_BITS ? magnitude - SUB_BUCKET_BITS : 0;
+        return shift * SUB_BUCKETS + (value >> shift);
+    }
+
+    static std::uint64_t HighestEquivalentValue(size_t index) {
+        if (index < 2 * SUB_BUCKETS) {
+            return index;
+        }
+        size_t shift = index / SUB_BUCKETS - 1;
+        std::uint64_t sub_bucket = index - shift * SUB_BUCKETS;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, N_BUCKETS> counts_{};
+    std::uint64_t total_count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t max_ = 0;
+};
+
+/*
+ * Measures the latency of a single operation in nanoseconds, for example:
+ *
+ * LatencyTimer timer;
+ * tree.emplace(key, value);
+ * histogram.Record(timer.ElapsedNanos());
+ */
+class LatencyTimer {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    LatencyTimer() : start_{Clock::now()} {}
+
+    [[nodiscard]] std::uint64_t ElapsedNanos() const {
+        auto elapsed = Clock::now() - start_;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+  private:
+    Clock::time_point start_;
+};
+
+}  // namespace improbable::phtree::phbenchmark
+
+#endif  // PHTREE_BENCHMARK_LATENCY_HISTOGRAM_H
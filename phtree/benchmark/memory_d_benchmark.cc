@@ -0,0 +1,329 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+/*
+ * Memory footprint benchmark. This benchmark replaces the global operator new/delete in order to
+ * count the heap memory (including allocator rounding) and the number of allocations of a tree.
+ * The reported counters are:
+ * - heap_bytes_per_entry: Heap memory that is allocated while building the tree, per entry.
+ * - total_bytes_per_entry: heap_bytes_per_entry plus sizeof(tree).
+ * - allocs_per_entry: Number of heap allocations that are alive after building the tree.
+ * - stats_bytes_per_entry: The memory size that is calculated by PhTreeStats.
+ * - nodes, entries_per_node, avg_depth: Node statistics from PhTreeStats.
+ *
+ * The time that is reported is the time to build and destroy the tree.
+ */
+namespace {
+
+std::atomic<std::int64_t> heap_bytes{0};
+std::atomic<std::int64_t> heap_allocations{0};
+
+size_t AllocationSize(void* ptr) {
+#if defined(__APPLE__)
+    return malloc_size(ptr);
+#elif defined(_WIN32)
+    return _msize(ptr);
+#else
+    return malloc_usable_size(ptr);
+#endif
+}
+
+void* Allocate(size_t size) {
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    heap_bytes.fetch_add(AllocationSize(ptr), std::memory_order_relaxed);
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return ptr;
+}
+
+void Deallocate(void* ptr) {
+    if (ptr != nullptr) {
+        heap_bytes.fetch_sub(AllocationSize(ptr), std::memory_order_relaxed);
+        heap_allocations.fetch_sub(1, std::memory_order_relaxed);
+        std::free(ptr);
+    }
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    Deallocate(ptr);
+}
+
+namespace {
+
+const double GLOBAL_MAX = 10000;
+const double BOX_LEN = 10;
+
+enum KeyType { POINT_KEY, BOX_KEY };
+
+/*
+ * A value type with a 64 byte payload.
+ */
+struct Payload64 {
+    double data_[8];
+};
+
+template <typename T>
+T CreateValue(size_t id) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        // Long enough to avoid short string optimization.
+        return "value-" + std::to_string(id) + "-0123456789012345678901234567890123456789";
+    } else if constexpr (std::is_same_v<T, Payload64>) {
+        return Payload64{{(double)id}};
+    } else {
+        return static_cast<T>(id);
+    }
+}
+
+template <typename T>
+size_t ValueHeapSize(const T& value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        return value.capacity() + 1;
+    } else {
+        (void)value;
+        return 0;
+    }
+}
+
+/*
+ * Benchmark for the memory footprint of trees.
+ */
+template <dimension_t DIM, KeyType KEY_TYPE, typename T>
+class IndexBenchmark {
+    using TreeType = typename std::
+        conditional_t<KEY_TYPE == POINT_KEY, PhTreeD<DIM, T>, PhTreeBoxD<DIM, T>>;
+    using KeyT = typename std::conditional_t<KEY_TYPE == POINT_KEY, PhPointD<DIM>, PhBoxD<DIM>>;
+
+  public:
+    IndexBenchmark(benchmark::State& state, TestGenerator data_type, int num_entities);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+
+    void Insert(TreeType& tree);
+
+    const TestGenerator data_type_;
+    const size_t num_entities_;
+    std::vector<KeyT> keys_;
+    std::vector<T> values_;
+};
+
+template <dimension_t DIM, KeyType KEY_TYPE, typename T>
+IndexBenchmark<DIM, KEY_TYPE, T>::IndexBenchmark(
+    benchmark::State& state, TestGenerator data_type, int num_entities)
+: data_type_{data_type}, num_entities_(num_entities), keys_(num_entities) {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+}
+
+template <dimension_t DIM, KeyType KEY_TYPE, typename T>
+void IndexBenchmark<DIM, KEY_TYPE, T>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        std::int64_t bytes_before = heap_bytes.load();
+        std::int64_t allocs_before = heap_allocations.load();
+        auto* tree = new TreeType();
+        Insert(*tree);
+
+        state.PauseTiming();
+        double n = (double)tree->size();
+        // The tree object itself is not counted as heap memory.
+        auto tree_alloc = (std::int64_t)AllocationSize(tree);
+        double heap = (double)(heap_bytes.load() - bytes_before - tree_alloc);
+        double allocs = (double)(heap_allocations.load() - allocs_before - 1);
+        auto stats =
+            PhTreeDebugHelper::GetStats(*tree, [](const T& v) { return ValueHeapSize(v); });
+        state.counters["entries"] = n;
+        state.counters["heap_bytes_per_entry"] = heap / n;
+        state.counters["total_bytes_per_entry"] = (heap + sizeof(TreeType)) / n;
+        state.counters["allocs_per_entry"] = allocs / n;
+        state.counters["stats_bytes_per_entry"] = stats.GetBytesPerEntry();
+        state.counters["nodes"] = (double)stats.GetNodeCount();
+        state.counters["entries_per_node"] = (double)stats.n_total_children_ / stats.GetNodeCount();
+        state.counters["avg_depth"] = (double)stats.q_total_depth_ / stats.GetNodeCount();
+        state.ResumeTiming();
+
+        delete tree;
+    }
+}
+
+template <dimension_t DIM, KeyType KEY_TYPE, typename T>
+void IndexBenchmark<DIM, KEY_TYPE, T>::SetupWorld(benchmark::State&) {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    if constexpr (KEY_TYPE == POINT_KEY) {
+        CreatePointData<DIM>(keys_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    } else {
+        CreateBoxData<DIM>(keys_, data_type_, num_entities_, 0, GLOBAL_MAX, BOX_LEN);
+    }
+    values_.reserve(num_entities_);
+    for (size_t i = 0; i < num_entities_; ++i) {
+        values_.emplace_back(CreateValue<T>(i));
+    }
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM, KeyType KEY_TYPE, typename T>
+void IndexBenchmark<DIM, KEY_TYPE, T>::Insert(TreeType& tree) {
+    for (size_t i = 0; i < num_entities_; ++i) {
+        tree.emplace(keys_[i], values_[i]);
+    }
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTree3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, POINT_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree2D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<2, POINT_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree6D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<6, POINT_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, POINT_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree20D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<20, POINT_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_Payload64(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, POINT_KEY, Payload64> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_String(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, POINT_KEY, std::string> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTreeBox3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, BOX_KEY, int> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_generator, num_entities
+// PhTree 3D CUBE
+BENCHMARK_CAPTURE(PhTree3D, MEM_CU_1K, TestGenerator::CUBE, 1000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D, MEM_CU_10K, TestGenerator::CUBE, 10000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D, MEM_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 3D CLUSTER / HOTSPOT
+BENCHMARK_CAPTURE(PhTree3D, MEM_CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D, MEM_CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D, MEM_HS_100K, TestGenerator::HOTSPOT, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Dimensionality
+BENCHMARK_CAPTURE(PhTree2D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree6D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree10D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree20D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Value types
+BENCHMARK_CAPTURE(PhTree3D_Payload64, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_String, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Box keys
+BENCHMARK_CAPTURE(PhTreeBox3D, MEM_CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeBox3D, MEM_CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTreeBox3D, MEM_CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
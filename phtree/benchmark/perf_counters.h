@@ -0,0 +1,265 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_BENCHMARK_PERF_COUNTERS_H
+#define PHTREE_BENCHMARK_PERF_COUNTERS_H
+
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace improbable::phtree::phbenchmark {
+
+/*
+ * Hardware performance counters for benchmarks, based on Linux perf_event.
+ *
+ * The counters only count while they are started. Start() and Stop() are system calls, so
+ * benchmarks should only call them while the timing is paused, i.e. around the untimed parts of
+ * an iteration:
+ *
+ * PerfCounters perf;
+ * perf.Start();
+ * for (auto _ : state) {
+ *     state.PauseTiming();
+ *     perf.Stop();
+ *     ... // setup
+ *     perf.Start();
+ *     state.ResumeTiming();
+ *     ... // measured operations
+ * }
+ * perf.Stop();
+ * perf.Report(state, number_of_operations);
+ *
+ * Report() adds instructions, cycles, cache misses, L1 data cache misses and branch misses per
+ * operation as well as instructions per cycle to the benchmark counters. Counters that are not
+ * supported by the CPU (e.g. in many VMs) are omitted. If perf_event is not available at all (not
+ * Linux, restricted by /proc/sys/kernel/perf_event_paranoid or by a container), or if the
+ * environment variable PHTREE_PERF_COUNTERS is set to "0", Start()/Stop() do nothing and Report()
+ * does not add any counters. Only user space events of the calling thread are counted.
+ *
+ * Values are scaled if the kernel had to multiplex the counters.
+ */
+class PerfCounters {
+  public:
+    enum CounterType { INSTRUCTIONS, CYCLES, CACHE_MISSES, L1D_MISSES, BRANCH_MISSES, NUM_TYPES };
+
+    PerfCounters() {
+        fds_.fill(-1);
+        const char* env = std::getenv("PHTREE_PERF_COUNTERS");
+        if (env != nullptr && std::string(env) == "0") {
+            error_ = "disabled by PHTREE_PERF_COUNTERS=0";
+            return;
+        }
+#if defined(__linux__)
+        // The first counter is the group leader, all counters of a group are scheduled together.
+        for (int type = 0; type < NUM_TYPES; ++type) {
+            fds_[type] = Open(static_cast<CounterType>(type), fds_[INSTRUCTIONS]);
+            if (type == INSTRUCTIONS && fds_[type] < 0) {
+                error_ = std::string("perf_event_open() failed: ") + std::strerror(errno);
+                return;
+            }
+            if (fds_[type] >= 0) {
+                index_[type] = n_open_++;
+            }
+        }
+        Reset();
+#else
+        error_ = "perf_event is only supported on Linux";
+#endif
+    }
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /*
+     * @return 'true' if at least the instruction counter is available.
+     */
+    [[nodiscard]] bool IsAvailable() const {
+        return fds_[INSTRUCTIONS] >= 0;
+    }
+
+    /*
+     * @return 'true' if the given counter is available.
+     */
+    [[nodiscard]] bool IsAvailable(CounterType type) const {
+        return fds_[type] >= 0;
+    }
+
+    /*
+     * @return The reason why the counters are not available.
+     */
+    [[nodiscard]] const std::string& GetError() const {
+        return error_;
+    }
+
+    void Start() {
+#if defined(__linux__)
+        if (IsAvailable()) {
+            ioctl(fds_[INSTRUCTIONS], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    void Stop() {
+#if defined(__linux__)
+        if (IsAvailable()) {
+            ioctl(fds_[INSTRUCTIONS], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    /*
+     * Sets all counters to zero.
+     */
+    void Reset() {
+        ReadGroup(baseline_);
+    }
+
+    /*
+     * @return The value of a counter since the last Reset(), or 0 if the counter is not available.
+     */
+    [[nodiscard]] double Get(CounterType type) const {
+        if (!IsAvailable(type)) {
+            return 0;
+        }
+        GroupData data;
+        ReadGroup(data);
+        return Get(data, type);
+    }
+
+    /*
+     * Adds the counters per operation to the benchmark's counters. The counters are read once.
+     */
+    void Report(benchmark::State& state, double num_operations) const {
+        if (!IsAvailable() || num_operations <= 0) {
+            return;
+        }
+        GroupData data;
+        ReadGroup(data);
+        const char* names[NUM_TYPES] = {
+            "instructions_per_op",
+            "cycles_per_op",
+            "cache_misses_per_op",
+            "l1d_misses_per_op",
+            "branch_misses_per_op"};
+        for (int type = 0; type < NUM_TYPES; ++type) {
+            if (IsAvailable(static_cast<CounterType>(type))) {
+                state.counters[names[type]] =
+                    Get(data, static_cast<CounterType>(type)) / num_operations;
+            }
+        }
+        double cycles = Get(data, CYCLES);
+        if (IsAvailable(CYCLES) && cycles > 0) {
+            state.counters["ipc"] = Get(data, INSTRUCTIONS) / cycles;
+        }
+    }
+
+  private:
+    struct GroupData {
+        std::uint64_t time_enabled = 0;
+        std::uint64_t time_running = 0;
+        std::uint64_t values[NUM_TYPES]{};
+    };
+
+    // Calculates the value of a counter since the last Reset() from a group read.
+    [[nodiscard]] double Get(const GroupData& data, CounterType type) const {
+        double enabled = (double)(data.time_enabled - baseline_.time_enabled);
+        double running = (double)(data.time_running - baseline_.time_running);
+        double value = (double)(data.values[index_[type]] - baseline_.values[index_[type]]);
+        return running > 0 ? value * enabled / running : value;
+    }
+
+    // read() with PERF_FORMAT_GROUP returns: nr, time_enabled, time_running, value[nr]
+    void ReadGroup(GroupData& data) const {
+        data = GroupData{};
+#if defined(__linux__)
+        if (IsAvailable()) {
+            std::uint64_t buffer[3 + NUM_TYPES]{};
+            if (read(fds_[INSTRUCTIONS], buffer, sizeof(buffer)) > 0) {
+                data.time_enabled = buffer[1];
+                data.time_running = buffer[2];
+                for (std::uint64_t i = 0; i < buffer[0] && i < NUM_TYPES; ++i) {
+                    data.values[i] = buffer[3 + i];
+                }
+            }
+        }
+#endif
+    }
+
+#if defined(__linux__)
+    static int Open(CounterType type, int group_fd) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (type) {
+        case INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case CACHE_MISSES:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        }
+        attr.disabled = group_fd < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+#endif
+
+    std::array<int, NUM_TYPES> fds_;
+    std::array<int, NUM_TYPES> index_{};
+    int n_open_ = 0;
+    GroupData baseline_;
+    std::string error_;
+};
+
+}  // namespace improbable::phtree::phbenchmark
+
+#endif  // PHTREE_BENCHMARK_PERF_COUNTERS_H
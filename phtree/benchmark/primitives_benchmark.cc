@@ -0,0 +1,266 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "phtree/common/common.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+using namespace improbable;
+using namespace improbable::phtree;
+
+/*
+ * Microbenchmarks for the primitives that are used on the hot paths of all tree operations:
+ * bit operations on keys, scalar conversion and the lookup functions of the node containers.
+ *
+ * Every benchmark iterates over a pre-generated set of random inputs so that the branch predictor
+ * cannot simply learn the outcome. Results are reported as time per call and as items per second.
+ */
+namespace {
+
+// Number of pre-generated inputs, must be a power of two.
+constexpr size_t NUM_INPUTS = 1024;
+constexpr size_t INPUT_MASK = NUM_INPUTS - 1;
+
+template <dimension_t DIM, typename SCALAR>
+struct KeyPair {
+    PhPoint<DIM, SCALAR> a_;
+    PhPoint<DIM, SCALAR> b_;
+    bit_width_t postfix_len_;
+};
+
+/*
+ * Creates pairs of keys where 'b' shares a random number of leading bits with 'a'. This resembles
+ * the keys that are compared during tree navigation, where the common prefix grows with the depth
+ * of a node.
+ */
+template <dimension_t DIM, typename SCALAR>
+std::vector<KeyPair<DIM, SCALAR>> CreateKeyPairs() {
+    constexpr bit_width_t BITS = MAX_BIT_WIDTH<SCALAR>;
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<SCALAR> scalar_distribution{
+        std::numeric_limits<SCALAR>::min(), std::numeric_limits<SCALAR>::max()};
+    std::uniform_int_distribution<bit_width_t> bits_distribution{0, BITS - 1};
+    std::vector<KeyPair<DIM, SCALAR>> pairs(NUM_INPUTS);
+    for (auto& pair : pairs) {
+        pair.postfix_len_ = bits_distribution(random_engine);
+        auto mask = ~bit_mask_t<SCALAR>(0) << pair.postfix_len_;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            pair.a_[d] = scalar_distribution(random_engine);
+            bit_mask_t<SCALAR> prefix = pair.a_[d] & mask;
+            bit_mask_t<SCALAR> postfix = scalar_distribution(random_engine) & ~mask;
+            pair.b_[d] = static_cast<SCALAR>(prefix | postfix);
+        }
+    }
+    return pairs;
+}
+
+template <dimension_t DIM, typename SCALAR>
+void CalcPos(benchmark::State& state) {
+    auto pairs = CreateKeyPairs<DIM, SCALAR>();
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& pair = pairs[i++ & INPUT_MASK];
+        benchmark::DoNotOptimize(CalcPosInArray(pair.a_, pair.postfix_len_));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <dimension_t DIM, typename SCALAR>
+void DivergingBits(benchmark::State& state) {
+    auto pairs = CreateKeyPairs<DIM, SCALAR>();
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& pair = pairs[i++ & INPUT_MASK];
+        benchmark::DoNotOptimize(NumberOfDivergingBits(pair.a_, pair.b_));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <dimension_t DIM, typename SCALAR>
+void KeyEq(benchmark::State& state) {
+    auto pairs = CreateKeyPairs<DIM, SCALAR>();
+    // Use the postfix length of the next pair for the mask, so about half of the calls succeed.
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& pair = pairs[i & INPUT_MASK];
+        auto mask = ~bit_mask_t<SCALAR>(0) << pairs[++i & INPUT_MASK].postfix_len_;
+        benchmark::DoNotOptimize(KeyEquals(pair.a_, pair.b_, mask));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <dimension_t DIM, typename SCALAR>
+void InRange(benchmark::State& state) {
+    auto pairs = CreateKeyPairs<DIM, SCALAR>();
+    // Query boxes are formed by the keys of a pair, candidates are keys of other pairs.
+    for (auto& pair : pairs) {
+        for (dimension_t d = 0; d < DIM; ++d) {
+            if (pair.a_[d] > pair.b_[d]) {
+                std::swap(pair.a_[d], pair.b_[d]);
+            }
+        }
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& box = pairs[i & INPUT_MASK];
+        auto& candidate = pairs[(i * 7 + 1) & INPUT_MASK].b_;
+        ++i;
+        benchmark::DoNotOptimize(IsInRange(candidate, box.a_, box.b_));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename BITS>
+void Clz(benchmark::State& state) {
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<BITS> bits_distribution{};
+    std::uniform_int_distribution<int> shift_distribution{0, sizeof(BITS) * 8 - 1};
+    std::vector<BITS> values(NUM_INPUTS);
+    for (auto& value : values) {
+        value = bits_distribution(random_engine) >> shift_distribution(random_engine);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CountLeadingZeros(values[i++ & INPUT_MASK]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename FLOAT>
+std::vector<FLOAT> CreateFloats() {
+    std::default_random_engine random_engine{0};
+    std::uniform_real_distribution<FLOAT> distribution{-1000, 1000};
+    std::vector<FLOAT> values(NUM_INPUTS);
+    for (auto& value : values) {
+        value = distribution(random_engine);
+    }
+    return values;
+}
+
+template <typename FLOAT>
+void ConvertPre(benchmark::State& state) {
+    auto values = CreateFloats<FLOAT>();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ScalarConverterIEEE::pre(values[i++ & INPUT_MASK]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename FLOAT>
+void ConvertPost(benchmark::State& state) {
+    using SCALAR = decltype(ScalarConverterIEEE::pre(FLOAT{}));
+    auto floats = CreateFloats<FLOAT>();
+    std::vector<SCALAR> values(NUM_INPUTS);
+    for (size_t n = 0; n < NUM_INPUTS; ++n) {
+        values[n] = ScalarConverterIEEE::pre(floats[n]);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ScalarConverterIEEE::post(values[i++ & INPUT_MASK]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Creates random positions in a node with 2^DIM quadrants.
+ */
+template <dimension_t DIM>
+std::vector<size_t> CreatePositions() {
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<size_t> distribution{0, (size_t(1) << DIM) - 1};
+    std::vector<size_t> positions(NUM_INPUTS);
+    for (auto& pos : positions) {
+        pos = distribution(random_engine);
+    }
+    return positions;
+}
+
+/*
+ * The maps are filled with every other position, so about half of the lookups find an entry.
+ */
+template <dimension_t DIM>
+void ArrayMapLowerBound(benchmark::State& state) {
+    array_map<size_t, (size_t(1) << DIM)> map;
+    for (size_t pos = 0; pos < (size_t(1) << DIM); pos += 2) {
+        map.try_emplace(pos, pos);
+    }
+    auto positions = CreatePositions<DIM>();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.lower_bound(positions[i++ & INPUT_MASK]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <dimension_t DIM>
+void SparseMapFind(benchmark::State& state) {
+    sparse_map<size_t> map;
+    for (size_t pos = 0; pos < (size_t(1) << DIM); pos += 2) {
+        map.try_emplace(pos, pos);
+    }
+    auto positions = CreatePositions<DIM>();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(positions[i++ & INPUT_MASK]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+#define PRIMITIVE_BENCHMARK_DIMS(FUNCTION, SCALAR) \
+    BENCHMARK_TEMPLATE(FUNCTION, 1, SCALAR);       \
+    BENCHMARK_TEMPLATE(FUNCTION, 2, SCALAR);       \
+    BENCHMARK_TEMPLATE(FUNCTION, 3, SCALAR);       \
+    BENCHMARK_TEMPLATE(FUNCTION, 6, SCALAR);       \
+    BENCHMARK_TEMPLATE(FUNCTION, 10, SCALAR);      \
+    BENCHMARK_TEMPLATE(FUNCTION, 20, SCALAR);
+
+// Key primitives for 64 bit and 32 bit scalars.
+#define PRIMITIVE_BENCHMARK(FUNCTION)               \
+    PRIMITIVE_BENCHMARK_DIMS(FUNCTION, scalar_64_t) \
+    PRIMITIVE_BENCHMARK_DIMS(FUNCTION, scalar_32_t)
+
+PRIMITIVE_BENCHMARK(CalcPos)
+PRIMITIVE_BENCHMARK(DivergingBits)
+PRIMITIVE_BENCHMARK(KeyEq)
+PRIMITIVE_BENCHMARK(InRange)
+
+BENCHMARK_TEMPLATE(Clz, std::uint64_t);
+BENCHMARK_TEMPLATE(Clz, std::uint32_t);
+
+BENCHMARK_TEMPLATE(ConvertPre, double);
+BENCHMARK_TEMPLATE(ConvertPre, float);
+BENCHMARK_TEMPLATE(ConvertPost, double);
+BENCHMARK_TEMPLATE(ConvertPost, float);
+
+// array_map is used for DIM <= PHTREE_ARRAY_MAP_MAX_DIM (at most 6), sparse_map for DIM <= 8 by
+// default.
+BENCHMARK_TEMPLATE(ArrayMapLowerBound, 1);
+BENCHMARK_TEMPLATE(ArrayMapLowerBound, 2);
+BENCHMARK_TEMPLATE(ArrayMapLowerBound, 3);
+BENCHMARK_TEMPLATE(ArrayMapLowerBound, 4);
+BENCHMARK_TEMPLATE(ArrayMapLowerBound, 6);
+
+BENCHMARK_TEMPLATE(SparseMapFind, 1);
+BENCHMARK_TEMPLATE(SparseMapFind, 2);
+BENCHMARK_TEMPLATE(SparseMapFind, 3);
+BENCHMARK_TEMPLATE(SparseMapFind, 4);
+BENCHMARK_TEMPLATE(SparseMapFind, 6);
+BENCHMARK_TEMPLATE(SparseMapFind, 8);
+BENCHMARK_TEMPLATE(SparseMapFind, 10);
+
+BENCHMARK_MAIN();
@@ -27,6 +27,8 @@ namespace {
 
 const double GLOBAL_MAX = 10000;
 const double BOX_LEN = GLOBAL_MAX / 100.;
+// Maximum edge length for heavy-tailed box sizes
+const double BOX_LEN_MAX = GLOBAL_MAX / 10.;
 
 enum QueryType { MIN_MAX_ITER, MIN_MAX_FOR_EACH };
 
@@ -49,6 +51,7 @@ class IndexBenchmark {
         benchmark::State& state,
         TestGenerator data_type,
         int num_entities,
+        BoxSizeType box_sizes = FIXED_SIZE,
         double avg_query_result_size_ = 100);
 
     void Benchmark(benchmark::State& state);
@@ -62,6 +65,7 @@ class IndexBenchmark {
 
     const TestGenerator data_type_;
     const int num_entities_;
+    const BoxSizeType box_sizes_;
     const double avg_query_result_size_;
 
     constexpr int query_endge_length() {
@@ -79,9 +83,11 @@ IndexBenchmark<DIM, QUERY_TYPE>::IndexBenchmark(
     benchmark::State& state,
     TestGenerator data_type,
     int num_entities,
+    BoxSizeType box_sizes,
     double avg_query_result_size)
 : data_type_{data_type}
 , num_entities_(num_entities)
+, box_sizes_{box_sizes}
 , avg_query_result_size_(avg_query_result_size)
 , random_engine_{1}
 , cube_distribution_{0, GLOBAL_MAX}
@@ -106,6 +112,7 @@ template <dimension_t DIM, QueryType QUERY_TYPE>
 void IndexBenchmark<DIM, QUERY_TYPE>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreateBoxData<DIM>(boxes_, data_type_, num_entities_, 0, GLOBAL_MAX, BOX_LEN);
+    ApplyBoxSizes<DIM>(boxes_, box_sizes_, 0, BOX_LEN, BOX_LEN_MAX);
     for (int i = 0; i < num_entities_; ++i) {
         tree_.emplace(boxes_[i], i);
     }
@@ -244,4 +251,20 @@ BENCHMARK_CAPTURE(PhTree3D_MMI, WQ_CL_100_of_100K, TestGenerator::CLUSTER, 10000
 BENCHMARK_CAPTURE(PhTree3D_MMI, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
+// index type, scenario name, data_type, num_entities, box_sizes, query_result_size
+// PhTree 3D HOTSPOT / GRADIENT
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_GR_100_of_1M, TestGenerator::GRADIENT, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 3D heavy-tailed box sizes
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_PARETO_CU_100_of_1M, TestGenerator::CUBE, 1000000, PARETO_SIZE)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(
+    PhTree3D_MMFE, WQ_PARETO_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000, PARETO_SIZE)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 #include "logging.h"
+#include "phtree/benchmark/baseline_indexes.h"
 #include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/perf_counters.h"
 #include "phtree/phtree.h"
 #include <benchmark/benchmark.h>
 #include <random>
@@ -41,7 +43,7 @@ using TreeType = PhTreeD<DIM, int>;
 /*
  * Benchmark for window queries.
  */
-template <dimension_t DIM, QueryType QUERY_TYPE>
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX = TreeType<DIM>>
 class IndexBenchmark {
   public:
     IndexBenchmark(
@@ -67,14 +69,15 @@ class IndexBenchmark {
         return GLOBAL_MAX * pow(avg_query_result_size_ / (double)num_entities_, 1. / (double)DIM);
     };
 
-    TreeType<DIM> tree_;
+    INDEX tree_;
     std::default_random_engine random_engine_;
     std::uniform_real_distribution<> cube_distribution_;
     std::vector<PointType<DIM>> points_;
+    PerfCounters perf_;
 };
 
-template <dimension_t DIM, QueryType QUERY_TYPE>
-IndexBenchmark<DIM, QUERY_TYPE>::IndexBenchmark(
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX>
+IndexBenchmark<DIM, QUERY_TYPE, INDEX>::IndexBenchmark(
     benchmark::State& state,
     TestGenerator data_type,
     int num_entities,
@@ -82,7 +85,7 @@ IndexBenchmark<DIM, QUERY_TYPE>::IndexBenchmark(
 : data_type_{data_type}
 , num_entities_(num_entities)
 , avg_query_result_size_(avg_query_result_size)
-, tree_{}
+, tree_{IndexFactory<INDEX>::Create(num_entities, GLOBAL_MAX)}
 , random_engine_{1}
 , cube_distribution_{0, GLOBAL_MAX}
 , points_(num_entities) {
@@ -90,31 +93,40 @@ IndexBenchmark<DIM, QUERY_TYPE>::IndexBenchmark(
     SetupWorld(state);
 }
 
-template <dimension_t DIM, QueryType QUERY_TYPE>
-void IndexBenchmark<DIM, QUERY_TYPE>::Benchmark(benchmark::State& state) {
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX>
+void IndexBenchmark<DIM, QUERY_TYPE, INDEX>::Benchmark(benchmark::State& state) {
+    perf_.Start();
     for (auto _ : state) {
         state.PauseTiming();
+        perf_.Stop();
         BoxType<DIM> query_box;
         CreateQuery(query_box);
+        perf_.Start();
         state.ResumeTiming();
 
         QueryWorld(state, query_box);
     }
+    perf_.Stop();
+    perf_.Report(state, state.iterations());
 }
 
-template <dimension_t DIM, QueryType QUERY_TYPE>
-void IndexBenchmark<DIM, QUERY_TYPE>::SetupWorld(benchmark::State& state) {
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX>
+void IndexBenchmark<DIM, QUERY_TYPE, INDEX>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
     for (int i = 0; i < num_entities_; ++i) {
         tree_.emplace(points_[i], i);
     }
+    FinishSetup(tree_);
 
     state.counters["total_result_count"] = benchmark::Counter(0);
     state.counters["query_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
     state.counters["result_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
     state.counters["avg_result_count"] = benchmark::Counter(0, benchmark::Counter::kAvgIterations);
 
+    if (!perf_.IsAvailable()) {
+        logging::info("Hardware performance counters are not available: {}", perf_.GetError());
+    }
     logging::info("World setup complete.");
 }
 
@@ -136,23 +148,22 @@ size_t Count_MMI(TreeType<DIM>& tree, BoxType<DIM>& query_box) {
     return n;
 }
 
-template <dimension_t DIM>
-size_t Count_MMFE(TreeType<DIM>& tree, BoxType<DIM>& query_box) {
+template <dimension_t DIM, typename INDEX>
+size_t Count_MMFE(INDEX& tree, BoxType<DIM>& query_box) {
     Counter<DIM, int> callback;
     tree.for_each(query_box, callback);
     return callback.n_;
 }
 
-template <dimension_t DIM, QueryType QUERY_TYPE>
-void IndexBenchmark<DIM, QUERY_TYPE>::QueryWorld(benchmark::State& state, BoxType<DIM>& query_box) {
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX>
+void IndexBenchmark<DIM, QUERY_TYPE, INDEX>::QueryWorld(
+    benchmark::State& state, BoxType<DIM>& query_box) {
     int n = 0;
-    switch (QUERY_TYPE) {
-    case MIN_MAX_ITER:
+    // Iterator queries are only supported by the PH-Tree.
+    if constexpr (QUERY_TYPE == MIN_MAX_ITER) {
         n = Count_MMI(tree_, query_box);
-        break;
-    case MIN_MAX_FOR_EACH:
-        n = Count_MMFE(tree_, query_box);
-        break;
+    } else {
+        n = Count_MMFE<DIM>(tree_, query_box);
     }
 
     state.counters["total_result_count"] += n;
@@ -161,8 +172,8 @@ void IndexBenchmark<DIM, QUERY_TYPE>::QueryWorld(benchmark::State& state, BoxTyp
     state.counters["avg_result_count"] += n;
 }
 
-template <dimension_t DIM, QueryType QUERY_TYPE>
-void IndexBenchmark<DIM, QUERY_TYPE>::CreateQuery(BoxType<DIM>& query_box) {
+template <dimension_t DIM, QueryType QUERY_TYPE, typename INDEX>
+void IndexBenchmark<DIM, QUERY_TYPE, INDEX>::CreateQuery(BoxType<DIM>& query_box) {
     int length = query_endge_length();
     // scale to ensure query lies within boundary
     double scale = (GLOBAL_MAX - (double)length) / GLOBAL_MAX;
@@ -188,6 +199,24 @@ void PhTree3D_MMFE(benchmark::State& state, Arguments&&... arguments) {
     benchmark.Benchmark(state);
 }
 
+template <typename... Arguments>
+void Grid3D_MMFE(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MIN_MAX_FOR_EACH, UniformGrid<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void KdTree3D_MMFE(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MIN_MAX_FOR_EACH, StaticKdTree<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void Scan3D_MMFE(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, MIN_MAX_FOR_EACH, BruteForceScan<3, int>> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
 // index type, scenario name, data_type, num_entities, query_result_size
 // PhTree 3D CUBE
 BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_CU_100_of_1K, TestGenerator::CUBE, 1000)
@@ -244,4 +273,47 @@ BENCHMARK_CAPTURE(PhTree3D_MMI, WQ_CL_100_of_100K, TestGenerator::CLUSTER, 10000
 BENCHMARK_CAPTURE(PhTree3D_MMI, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
+// index type, scenario name, data_type, num_entities, query_result_size
+// PhTree 3D HOTSPOT / GRADIENT
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_HS_100_of_10K, TestGenerator::HOTSPOT, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_GR_100_of_10K, TestGenerator::GRADIENT, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_MMFE, WQ_GR_100_of_1M, TestGenerator::GRADIENT, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// index type, scenario name, data_type, num_entities, query_result_size
+// Baseline indexes 3D
+BENCHMARK_CAPTURE(Grid3D_MMFE, WQ_CU_100_of_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D_MMFE, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D_MMFE, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D_MMFE, WQ_CU_100_of_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D_MMFE, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D_MMFE, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D_MMFE, WQ_CU_100_of_10K, TestGenerator::CUBE, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D_MMFE, WQ_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D_MMFE, WQ_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include "phtree/phtree_serialization.h"
+#include <benchmark/benchmark.h>
+#include <sstream>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+namespace {
+
+const double GLOBAL_MAX = 10000;
+
+enum Scenario { REBUILD, DESERIALIZE, SERIALIZE, DESERIALIZE_COMPRESSED, SERIALIZE_COMPRESSED };
+
+constexpr bool IsCompressed(Scenario scenario) {
+    return scenario == DESERIALIZE_COMPRESSED || scenario == SERIALIZE_COMPRESSED;
+}
+
+/*
+ * Benchmark for loading a tree from a binary stream, compared to rebuilding it with emplace().
+ */
+template <dimension_t DIM, Scenario SCENARIO>
+class IndexBenchmark {
+  public:
+    IndexBenchmark(benchmark::State& state, TestGenerator data_type, int num_entities);
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+
+    void Load(benchmark::State& state, PhTreeD<DIM, int>& tree);
+
+    const TestGenerator data_type_;
+    const int num_entities_;
+    std::vector<PhPointD<DIM>> points_;
+    PhTreeD<DIM, int> tree_;
+    std::string data_;
+};
+
+template <dimension_t DIM, Scenario SCENARIO>
+IndexBenchmark<DIM, SCENARIO>::IndexBenchmark(
+    benchmark::State& state, TestGenerator data_type, int num_entities)
+: data_type_{data_type}, num_entities_(num_entities), points_(num_entities) {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+}
+
+template <dimension_t DIM, Scenario SCENARIO>
+void IndexBenchmark<DIM, SCENARIO>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        if (SCENARIO == SERIALIZE || SCENARIO == SERIALIZE_COMPRESSED) {
+            std::stringstream ss;
+            if (IsCompressed(SCENARIO)) {
+                serialize_compressed(tree_, ss);
+            } else {
+                serialize(tree_, ss);
+            }
+            benchmark::DoNotOptimize(ss);
+            state.counters["total_entry_count"] += num_entities_;
+            state.counters["entry_rate"] += num_entities_;
+            continue;
+        }
+
+        state.PauseTiming();
+        auto* tree = new PhTreeD<DIM, int>();
+        state.ResumeTiming();
+
+        Load(state, *tree);
+
+        // we do this top avoid measuring deallocation
+        state.PauseTiming();
+        delete tree;
+        state.ResumeTiming();
+    }
+}
+
+template <dimension_t DIM, Scenario SCENARIO>
+void IndexBenchmark<DIM, SCENARIO>::SetupWorld(benchmark::State& state) {
+    logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
+    CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    for (int i = 0; i < num_entities_; ++i) {
+        tree_.emplace(points_[i], i);
+    }
+    std::stringstream ss;
+    if (IsCompressed(SCENARIO)) {
+        serialize_compressed(tree_, ss);
+    } else {
+        serialize(tree_, ss);
+    }
+    data_ = ss.str();
+
+    state.counters["total_entry_count"] = benchmark::Counter(0);
+    state.counters["entry_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    state.counters["stream_bytes"] = benchmark::Counter((double)data_.size());
+
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM, Scenario SCENARIO>
+void IndexBenchmark<DIM, SCENARIO>::Load(benchmark::State& state, PhTreeD<DIM, int>& tree) {
+    if (SCENARIO == REBUILD) {
+        for (int i = 0; i < num_entities_; ++i) {
+            PhPointD<DIM>& p = points_[i];
+            tree.emplace(p, i);
+        }
+    } else {
+        state.PauseTiming();
+        std::istringstream is(data_);
+        state.ResumeTiming();
+        bool success = deserialize(tree, is);
+        assert(success);
+        (void)success;
+    }
+
+    state.counters["total_entry_count"] += num_entities_;
+    state.counters["entry_rate"] += num_entities_;
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTree3D_REB(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, REBUILD> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_DES(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, DESERIALIZE> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_SER(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, SERIALIZE> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_DES_C(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, DESERIALIZE_COMPRESSED> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_SER_C(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, SERIALIZE_COMPRESSED> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D_REB(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, REBUILD> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D_DES(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, DESERIALIZE> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree10D_DES_C(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<10, DESERIALIZE_COMPRESSED> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_generator, num_entities
+// PhTree 3D CUBE
+BENCHMARK_CAPTURE(PhTree3D_REB, CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES, CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_SER, CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES_C, CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_SER_C, CU_100K, TestGenerator::CUBE, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_REB, CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES, CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_SER, CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES_C, CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_SER_C, CU_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 3D CLUSTER
+BENCHMARK_CAPTURE(PhTree3D_REB, CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES, CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_REB, CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES, CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_DES_C, CL_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree 10D CLUSTER
+BENCHMARK_CAPTURE(PhTree10D_REB, CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree10D_DES, CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree10D_DES_C, CL_100K, TestGenerator::CLUSTER, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,451 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/latency_histogram.h"
+#include "phtree/phtree.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+namespace {
+
+const double GLOBAL_MAX = 10000;
+constexpr double MOVE_DISTANCE = 10;
+constexpr double QUERY_RESULT_SIZE = 100;
+constexpr size_t KNN_RESULT_SIZE = 10;
+constexpr size_t TICKS = 1000;
+
+/*
+ * The number of operations per tick. Operations are distributed evenly over all threads.
+ */
+struct TickProfile {
+    size_t relocates_;
+    size_t inserts_;
+    size_t erases_;
+    size_t window_queries_;
+    size_t knn_queries_;
+};
+
+// A typical server tick: many moving entities, some spawning/despawning and interest queries.
+const TickProfile PROFILE_DEFAULT = {5000, 50, 50, 1000, 200};
+const TickProfile PROFILE_UPDATE_HEAVY = {20000, 200, 200, 200, 50};
+const TickProfile PROFILE_QUERY_HEAVY = {1000, 10, 10, 5000, 1000};
+
+/*
+ * EXCLUSIVE_LOCK: All operations acquire the same exclusive lock.
+ * SHARED_LOCK: Queries acquire a shared (reader) lock, modifications acquire an exclusive lock.
+ */
+enum LockType { EXCLUSIVE_LOCK, SHARED_LOCK };
+
+enum OpType { RELOCATE, INSERT, ERASE, WINDOW_QUERY, KNN_QUERY };
+
+template <dimension_t DIM>
+using PointType = PhPointD<DIM>;
+
+template <dimension_t DIM>
+using BoxType = PhBoxD<DIM>;
+
+template <dimension_t DIM>
+using TreeType = PhTreeD<DIM, size_t>;
+
+template <dimension_t DIM>
+struct TickOp {
+    OpType type_;
+    size_t id_;
+    PointType<DIM> old_;
+    PointType<DIM> new_;  // New position, query center or min corner of the query box.
+};
+
+/*
+ * A tree with an external lock.
+ */
+template <dimension_t DIM, LockType LOCK>
+class LockedTree {
+  public:
+    template <typename FN>
+    auto Write(FN&& fn) {
+        std::unique_lock<std::shared_mutex> lock{mutex_};
+        return fn(tree_);
+    }
+
+    template <typename FN>
+    auto Read(FN&& fn) {
+        if constexpr (LOCK == SHARED_LOCK) {
+            std::shared_lock<std::shared_mutex> lock{mutex_};
+            return fn(static_cast<const TreeType<DIM>&>(tree_));
+        } else {
+            std::unique_lock<std::shared_mutex> lock{mutex_};
+            return fn(static_cast<const TreeType<DIM>&>(tree_));
+        }
+    }
+
+    TreeType<DIM>& Unsafe() {
+        return tree_;
+    }
+
+  private:
+    std::shared_mutex mutex_;
+    TreeType<DIM> tree_;
+};
+
+/*
+ * Reusable barrier for a fixed number of threads.
+ */
+class Barrier {
+  public:
+    explicit Barrier(size_t num_threads) : num_threads_{num_threads}, waiting_{0}, generation_{0} {}
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock{mutex_};
+        size_t generation = generation_;
+        if (++waiting_ == num_threads_) {
+            waiting_ = 0;
+            ++generation_;
+            condition_.notify_all();
+        } else {
+            condition_.wait(lock, [this, generation] { return generation != generation_; });
+        }
+    }
+
+  private:
+    const size_t num_threads_;
+    size_t waiting_;
+    size_t generation_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+};
+
+/*
+ * Macro benchmark that simulates server ticks.
+ *
+ * Every tick executes a mix of relocations (entities move along waypoints), inserts, erases,
+ * window queries and kNN queries on a shared tree. The operations are executed by a pool of
+ * worker threads that share the tree via an external lock. Every thread only modifies its own
+ * entities. One benchmark iteration is one tick, the reported time is the tick time.
+ *
+ * The operations of a tick are generated before the tick starts and are not timed.
+ */
+template <dimension_t DIM, LockType LOCK>
+class IndexBenchmark {
+  public:
+    IndexBenchmark(
+        benchmark::State& state,
+        TickProfile profile,
+        int num_entities,
+        int num_threads,
+        TestGenerator data_type = TestGenerator::HOTSPOT);
+
+    ~IndexBenchmark();
+
+    void Benchmark(benchmark::State& state);
+
+  private:
+    void SetupWorld(benchmark::State& state);
+    void BuildTick();
+    void RunWorker(size_t thread_id);
+    size_t Execute(const TickOp<DIM>& op);
+    void Report(benchmark::State& state);
+
+    PointType<DIM> RandomPoint();
+
+    const TickProfile profile_;
+    const size_t num_entities_;
+    const size_t num_threads_;
+    const TestGenerator data_type_;
+    const double query_edge_length_;
+
+    LockedTree<DIM, LOCK> tree_;
+    std::vector<PointType<DIM>> points_;
+    // Entities that were inserted by INSERT operations, per thread
+    std::vector<std::deque<std::pair<size_t, PointType<DIM>>>> transients_;
+    std::vector<std::vector<TickOp<DIM>>> ops_;
+    // The last tick in which an entity was relocated
+    std::vector<size_t> relocated_in_tick_;
+    size_t tick_;
+    size_t next_transient_id_;
+    std::default_random_engine random_engine_;
+    std::uniform_real_distribution<> cube_distribution_;
+    MovementModel<DIM> movement_;
+    LatencyHistogram<> tick_histogram_;
+
+    Barrier barrier_;
+    bool is_stopped_;
+    std::vector<std::thread> workers_;
+};
+
+template <dimension_t DIM, LockType LOCK>
+IndexBenchmark<DIM, LOCK>::IndexBenchmark(
+    benchmark::State& state,
+    TickProfile profile,
+    int num_entities,
+    int num_threads,
+    TestGenerator data_type)
+: profile_{profile}
+, num_entities_(num_entities)
+, num_threads_(num_threads)
+, data_type_{data_type}
+, query_edge_length_{
+      GLOBAL_MAX * pow(QUERY_RESULT_SIZE / (double)num_entities, 1. / (double)DIM)}
+, points_(num_entities)
+, transients_(num_threads)
+, ops_(num_threads)
+, relocated_in_tick_(num_entities, 0)
+, tick_{0}
+, next_transient_id_{(size_t)num_entities}
+, random_engine_{1}
+, cube_distribution_{0, GLOBAL_MAX}
+, movement_{WAYPOINT, num_entities_, 1, 0, GLOBAL_MAX, MOVE_DISTANCE}
+, barrier_{num_threads_ + 1}
+, is_stopped_{false} {
+    logging::SetupDefaultLogging();
+    SetupWorld(state);
+    for (size_t i = 0; i < num_threads_; ++i) {
+        workers_.emplace_back([this, i] { RunWorker(i); });
+    }
+}
+
+template <dimension_t DIM, LockType LOCK>
+IndexBenchmark<DIM, LOCK>::~IndexBenchmark() {
+    is_stopped_ = true;
+    barrier_.Wait();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+template <dimension_t DIM, LockType LOCK>
+void IndexBenchmark<DIM, LOCK>::Benchmark(benchmark::State& state) {
+    for (auto _ : state) {
+        BuildTick();
+        LatencyTimer timer;
+        // Start the tick and wait for all workers to finish
+        barrier_.Wait();
+        barrier_.Wait();
+        auto tick_time = timer.ElapsedNanos();
+        tick_histogram_.Record(tick_time);
+        state.SetIterationTime(tick_time * 1e-9);
+    }
+    Report(state);
+}
+
+template <dimension_t DIM, LockType LOCK>
+void IndexBenchmark<DIM, LOCK>::SetupWorld(benchmark::State& state) {
+    logging::info(
+        "Setting up world with {} entities, {} dimensions and {} threads.",
+        num_entities_,
+        DIM,
+        num_threads_);
+    CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
+    for (size_t i = 0; i < num_entities_; ++i) {
+        tree_.Unsafe().emplace(points_[i], i);
+    }
+
+    state.counters["op_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    logging::info("World setup complete.");
+}
+
+template <dimension_t DIM, LockType LOCK>
+void IndexBenchmark<DIM, LOCK>::BuildTick() {
+    for (auto& ops : ops_) {
+        ops.clear();
+    }
+    // Entities are assigned to threads by 'id % num_threads_'. 'relocated_in_tick_' ensures that
+    // every entity is relocated at most once per tick. This is required because the operations of
+    // a thread are shuffled, while 'op.old_' assumes that they are executed in order.
+    ++tick_;
+    std::uniform_int_distribution<size_t> id_distribution(0, num_entities_ - 1);
+    for (size_t i = 0; i < std::min(profile_.relocates_, num_entities_); ++i) {
+        size_t id = id_distribution(random_engine_);
+        while (relocated_in_tick_[id] == tick_) {
+            id = id_distribution(random_engine_);
+        }
+        relocated_in_tick_[id] = tick_;
+        TickOp<DIM> op{RELOCATE, id, points_[id], points_[id]};
+        PointType<DIM> delta;
+        movement_.Move(id, op.old_, delta);
+        for (dimension_t d = 0; d < DIM; ++d) {
+            op.new_[d] += delta[d];
+        }
+        points_[id] = op.new_;
+        ops_[id % num_threads_].emplace_back(op);
+    }
+    // Only erase entities that were inserted in previous ticks
+    for (size_t t = 0; t < num_threads_; ++t) {
+        size_t n_erase = std::min(profile_.erases_ / num_threads_, transients_[t].size());
+        for (size_t i = 0; i < n_erase; ++i) {
+            auto& transient = transients_[t].front();
+            ops_[t].emplace_back(TickOp<DIM>{ERASE, transient.first, transient.second, {}});
+            transients_[t].pop_front();
+        }
+        for (size_t i = 0; i < profile_.inserts_ / num_threads_; ++i) {
+            auto p = RandomPoint();
+            ops_[t].emplace_back(TickOp<DIM>{INSERT, next_transient_id_, {}, p});
+            transients_[t].emplace_back(next_transient_id_++, p);
+        }
+        for (size_t i = 0; i < profile_.window_queries_ / num_threads_; ++i) {
+            ops_[t].emplace_back(TickOp<DIM>{WINDOW_QUERY, 0, {}, RandomPoint()});
+        }
+        for (size_t i = 0; i < profile_.knn_queries_ / num_threads_; ++i) {
+            ops_[t].emplace_back(TickOp<DIM>{KNN_QUERY, 0, {}, RandomPoint()});
+        }
+        // Interleave modifications and queries
+        std::shuffle(ops_[t].begin(), ops_[t].end(), random_engine_);
+    }
+}
+
+template <dimension_t DIM, LockType LOCK>
+void IndexBenchmark<DIM, LOCK>::RunWorker(size_t thread_id) {
+    while (true) {
+        barrier_.Wait();
+        if (is_stopped_) {
+            return;
+        }
+        size_t n = 0;
+        for (auto& op : ops_[thread_id]) {
+            n += Execute(op);
+        }
+        benchmark::DoNotOptimize(n);
+        barrier_.Wait();
+    }
+}
+
+template <dimension_t DIM, LockType LOCK>
+size_t IndexBenchmark<DIM, LOCK>::Execute(const TickOp<DIM>& op) {
+    switch (op.type_) {
+    case RELOCATE:
+        return tree_.Write([&op](TreeType<DIM>& tree) {
+            auto iter = tree.find(op.old_);
+            tree.erase(iter);
+            return (size_t)tree.emplace_hint(iter, op.new_, op.id_).second;
+        });
+    case INSERT:
+        return tree_.Write([&op](TreeType<DIM>& tree) {
+            return (size_t)tree.emplace(op.new_, op.id_).second;
+        });
+    case ERASE:
+        return tree_.Write([&op](TreeType<DIM>& tree) { return tree.erase(op.old_); });
+    case WINDOW_QUERY: {
+        BoxType<DIM> query_box{op.new_, op.new_};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            query_box.max()[d] += query_edge_length_;
+        }
+        return tree_.Read([&query_box](const TreeType<DIM>& tree) {
+            size_t n = 0;
+            auto callback = [&n](const PointType<DIM>&, const size_t&) { ++n; };
+            tree.for_each(query_box, callback);
+            return n;
+        });
+    }
+    case KNN_QUERY:
+        return tree_.Read([&op](const TreeType<DIM>& tree) {
+            size_t n = 0;
+            auto q = tree.begin_knn_query(KNN_RESULT_SIZE, op.new_, DistanceEuclidean<DIM>());
+            for (; q != tree.end(); ++q) {
+                ++n;
+            }
+            return n;
+        });
+    }
+    return 0;
+}
+
+template <dimension_t DIM, LockType LOCK>
+void IndexBenchmark<DIM, LOCK>::Report(benchmark::State& state) {
+    auto& p = profile_;
+    size_t ops_per_tick =
+        p.relocates_ + p.inserts_ + p.erases_ + p.window_queries_ + p.knn_queries_;
+    state.counters["op_rate"] += ops_per_tick * tick_histogram_.Count();
+    state.counters["tick_mean_us"] = tick_histogram_.Mean() * 1e-3;
+    state.counters["tick_p50_us"] = tick_histogram_.Percentile(50) * 1e-3;
+    state.counters["tick_p99_us"] = tick_histogram_.Percentile(99) * 1e-3;
+    state.counters["tick_p999_us"] = tick_histogram_.Percentile(99.9) * 1e-3;
+    state.counters["tick_max_us"] = tick_histogram_.Max() * 1e-3;
+    auto stats = PhTreeDebugHelper::GetStats(tree_.Unsafe());
+    state.counters["memory_bytes"] = stats.mem_size_;
+    state.counters["bytes_per_entry"] = stats.GetBytesPerEntry();
+    logging::info("Tick time [ns]: {}", tick_histogram_.ToString());
+}
+
+template <dimension_t DIM, LockType LOCK>
+PointType<DIM> IndexBenchmark<DIM, LOCK>::RandomPoint() {
+    PointType<DIM> p;
+    for (dimension_t d = 0; d < DIM; ++d) {
+        p[d] = cube_distribution_(random_engine_);
+    }
+    return p;
+}
+
+}  // namespace
+
+template <typename... Arguments>
+void PhTree3D_Exclusive(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, EXCLUSIVE_LOCK> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void PhTree3D_Shared(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, SHARED_LOCK> benchmark{state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, tick profile, num_entities, num_threads, data_type
+BENCHMARK_CAPTURE(PhTree3D_Exclusive, TICK_DEFAULT_100K_T1, PROFILE_DEFAULT, 100000, 1)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Exclusive, TICK_DEFAULT_100K_T4, PROFILE_DEFAULT, 100000, 4)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Shared, TICK_DEFAULT_100K_T4, PROFILE_DEFAULT, 100000, 4)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Exclusive, TICK_DEFAULT_1M_T1, PROFILE_DEFAULT, 1000000, 1)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Shared, TICK_DEFAULT_1M_T4, PROFILE_DEFAULT, 1000000, 4)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Shared, TICK_UPDATE_HEAVY_1M_T4, PROFILE_UPDATE_HEAVY, 1000000, 4)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(PhTree3D_Shared, TICK_QUERY_HEAVY_1M_T4, PROFILE_QUERY_HEAVY, 1000000, 4)
+    ->Iterations(TICKS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/phtree.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+/*
+ * Command line tool that creates a tree with one of the benchmark data generators and writes the
+ * tree statistics (see PhTreeStats::ToJson()) as JSON to a file or to stdout.
+ *
+ * Usage: tree_stats_tool [--dim 2|3|6|10] [--entries N] [--generator cube|cluster] [--box]
+ *                        [--world_length L] [--box_length L] [--output FILE]
+ */
+namespace {
+
+struct Options {
+    dimension_t dim = 3;
+    size_t num_entities = 1000000;
+    TestGenerator generator = TestGenerator::CUBE;
+    bool is_box = false;
+    double world_length = 10000;
+    double box_length = 10;
+    std::string output;
+};
+
+template <dimension_t DIM>
+std::string CreateStats(const Options& options) {
+    logging::info(
+        "Creating {} tree with {} entities and {} dimensions.",
+        options.is_box ? "box" : "point",
+        options.num_entities,
+        DIM);
+    if (options.is_box) {
+        std::vector<PhBoxD<DIM>> boxes(options.num_entities);
+        CreateBoxData<DIM>(
+            boxes,
+            options.generator,
+            options.num_entities,
+            0,
+            options.world_length,
+            options.box_length);
+        PhTreeBoxD<DIM, size_t> tree;
+        for (size_t i = 0; i < options.num_entities; ++i) {
+            tree.emplace(boxes[i], i);
+        }
+        return PhTreeDebugHelper::GetStats(tree).ToJson();
+    }
+    std::vector<PhPointD<DIM>> points(options.num_entities);
+    CreatePointData<DIM>(
+        points, options.generator, options.num_entities, 0, options.world_length);
+    PhTreeD<DIM, size_t> tree;
+    for (size_t i = 0; i < options.num_entities; ++i) {
+        tree.emplace(points[i], i);
+    }
+    return PhTreeDebugHelper::GetStats(tree).ToJson();
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--box") {
+            options.is_box = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dim") {
+            options.dim = static_cast<dimension_t>(std::stoul(value));
+        } else if (arg == "--entries") {
+            options.num_entities = std::stoul(value);
+        } else if (arg == "--generator") {
+            if (value != "cube" && value != "cluster") {
+                return false;
+            }
+            options.generator = value == "cube" ? TestGenerator::CUBE : TestGenerator::CLUSTER;
+        } else if (arg == "--world_length") {
+            options.world_length = std::stod(value);
+        } else if (arg == "--box_length") {
+            options.box_length = std::stod(value);
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    logging::SetupDefaultLogging();
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--dim 2|3|6|10] [--entries N] [--generator cube|cluster] [--box]"
+                     " [--world_length L] [--box_length L] [--output FILE]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string json;
+    switch (options.dim) {
+    case 2:
+        json = CreateStats<2>(options);
+        break;
+    case 3:
+        json = CreateStats<3>(options);
+        break;
+    case 6:
+        json = CreateStats<6>(options);
+        break;
+    case 10:
+        json = CreateStats<10>(options);
+        break;
+    default:
+        std::cerr << "Unsupported number of dimensions: " << options.dim << std::endl;
+        return 1;
+    }
+
+    if (options.output.empty()) {
+        std::cout << json << std::endl;
+        return 0;
+    }
+    std::ofstream out(options.output);
+    out << json << std::endl;
+    if (!out) {
+        std::cerr << "Could not write to " << options.output << std::endl;
+        return 1;
+    }
+    logging::info("Statistics written to {}", options.output);
+    return 0;
+}
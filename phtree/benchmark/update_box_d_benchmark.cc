@@ -29,6 +29,8 @@ constexpr double MOVE_DISTANCE = 10;
 
 const double GLOBAL_MAX = 10000;
 const double BOX_LEN = 10;
+// Maximum edge length for heavy-tailed box sizes
+const double BOX_LEN_MAX = 1000;
 
 template <dimension_t DIM>
 using BoxType = PhBoxD<DIM>;
@@ -53,6 +55,8 @@ class IndexBenchmark {
         benchmark::State& state,
         TestGenerator data_type,
         int num_entities,
+        MovementType movement = FIXED_STEP,
+        BoxSizeType box_sizes = FIXED_SIZE,
         int updates_per_round = UPDATES_PER_ROUND,
         double move_distance = MOVE_DISTANCE);
 
@@ -67,12 +71,14 @@ class IndexBenchmark {
     const size_t num_entities_;
     const size_t updates_per_round_;
     const double move_distance_;
+    const BoxSizeType box_sizes_;
 
     TreeType<DIM> tree_;
     std::vector<BoxType<DIM>> boxes_;
     std::vector<UpdateOp<DIM>> updates_;
     std::default_random_engine random_engine_;
     std::uniform_int_distribution<> entity_id_distribution_;
+    MovementModel<DIM> movement_;
 };
 
 template <dimension_t DIM>
@@ -80,16 +86,20 @@ IndexBenchmark<DIM>::IndexBenchmark(
     benchmark::State& state,
     TestGenerator data_type,
     int num_entities,
+    MovementType movement,
+    BoxSizeType box_sizes,
     int updates_per_round,
     double move_distance)
 : data_type_{data_type}
 , num_entities_(num_entities)
 , updates_per_round_(updates_per_round)
 , move_distance_(move_distance)
+, box_sizes_{box_sizes}
 , boxes_(num_entities)
 , updates_(updates_per_round)
 , random_engine_{0}
-, entity_id_distribution_{0, num_entities - 1} {
+, entity_id_distribution_{0, num_entities - 1}
+, movement_{movement, num_entities_, 0, 0, GLOBAL_MAX, move_distance} {
     logging::SetupDefaultLogging();
     SetupWorld(state);
 }
@@ -109,6 +119,7 @@ template <dimension_t DIM>
 void IndexBenchmark<DIM>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreateBoxData<DIM>(boxes_, data_type_, num_entities_, 0, GLOBAL_MAX, BOX_LEN);
+    ApplyBoxSizes<DIM>(boxes_, box_sizes_, 0, BOX_LEN, BOX_LEN_MAX);
     for (size_t i = 0; i < num_entities_; ++i) {
         tree_.emplace(boxes_[i], i);
     }
@@ -124,9 +135,11 @@ void IndexBenchmark<DIM>::BuildUpdates() {
         int box_id = entity_id_distribution_(random_engine_);
         update.id_ = box_id;
         update.old_ = boxes_[box_id];
+        PhPointD<DIM> delta;
+        movement_.Move(box_id, update.old_.min(), delta);
         for (dimension_t d = 0; d < DIM; ++d) {
-            update.new_.min()[d] = update.old_.min()[d] + move_distance_;
-            update.new_.max()[d] = update.old_.max()[d] + move_distance_;
+            update.new_.min()[d] = update.old_.min()[d] + delta[d];
+            update.new_.max()[d] = update.old_.max()[d] + delta[d];
         }
         // update reference data
         boxes_[box_id] = update.new_;
@@ -165,7 +178,8 @@ void PhTree3D(benchmark::State& state, Arguments&&... arguments) {
     benchmark.Benchmark(state);
 }
 
-// index type, scenario name, data_type, num_entities, updates_per_round, move_distance
+// index type, scenario name, data_type, num_entities, movement, box_sizes, updates_per_round,
+// move_distance
 // PhTree3D CUBE
 BENCHMARK_CAPTURE(PhTree3D, UPDATE_CU_100_of_1K, TestGenerator::CUBE, 1000)
     ->Unit(benchmark::kMillisecond);
@@ -192,4 +206,22 @@ BENCHMARK_CAPTURE(PhTree3D, UPDATE_CL_100_of_100K, TestGenerator::CLUSTER, 10000
 BENCHMARK_CAPTURE(PhTree3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
+// PhTree3D moving entities
+BENCHMARK_CAPTURE(PhTree3D, UPDATE_WALK_CU_100_of_1M, TestGenerator::CUBE, 1000000, RANDOM_WALK)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(
+    PhTree3D, UPDATE_WAYPOINT_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000, WAYPOINT)
+    ->Unit(benchmark::kMillisecond);
+
+// PhTree3D heavy-tailed box sizes
+BENCHMARK_CAPTURE(
+    PhTree3D,
+    UPDATE_WAYPOINT_PARETO_HS_100_of_1M,
+    TestGenerator::HOTSPOT,
+    1000000,
+    WAYPOINT,
+    PARETO_SIZE)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
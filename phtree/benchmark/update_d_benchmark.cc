@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 #include "logging.h"
+#include "phtree/benchmark/baseline_indexes.h"
 #include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/perf_counters.h"
 #include "phtree/phtree.h"
 #include <benchmark/benchmark.h>
 
@@ -47,13 +49,14 @@ struct UpdateOp {
 /*
  * Benchmark for updating the position of entries.
  */
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX = TreeType<DIM>>
 class IndexBenchmark {
   public:
     IndexBenchmark(
         benchmark::State& state,
         TestGenerator data_type,
         int num_entities,
+        MovementType movement = FIXED_STEP,
         int updates_per_round = UPDATES_PER_ROUND,
         std::vector<double> move_distance = MOVE_DISTANCE);
 
@@ -68,66 +71,96 @@ class IndexBenchmark {
     const size_t num_entities_;
     const size_t updates_per_round_;
     const std::vector<double> move_distance_;
+    const MovementType movement_type_;
 
-    TreeType<DIM> tree_;
+    INDEX tree_;
     std::vector<PointType<DIM>> points_;
     std::vector<UpdateOp<DIM>> updates_;
     std::default_random_engine random_engine_;
     std::uniform_int_distribution<> entity_id_distribution_;
+    MovementModel<DIM> movement_;
+    PerfCounters perf_;
 };
 
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
-IndexBenchmark<DIM, UPDATE_TYPE>::IndexBenchmark(
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX>
+IndexBenchmark<DIM, UPDATE_TYPE, INDEX>::IndexBenchmark(
     benchmark::State& state,
     TestGenerator data_type,
     int num_entities,
+    MovementType movement,
     int updates_per_round,
     std::vector<double> move_distance)
 : data_type_{data_type}
 , num_entities_(num_entities)
 , updates_per_round_(updates_per_round)
 , move_distance_(std::move(move_distance))
+, movement_type_{movement}
+, tree_{IndexFactory<INDEX>::Create(num_entities, GLOBAL_MAX)}
 , points_(num_entities)
 , updates_(updates_per_round)
 , random_engine_{0}
-, entity_id_distribution_{0, num_entities - 1} {
+, entity_id_distribution_{0, num_entities - 1}
+, movement_{
+      movement,
+      num_entities_,
+      0,
+      0,
+      GLOBAL_MAX,
+      *std::max_element(move_distance_.begin(), move_distance_.end())} {
     logging::SetupDefaultLogging();
     SetupWorld(state);
 }
 
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
-void IndexBenchmark<DIM, UPDATE_TYPE>::Benchmark(benchmark::State& state) {
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX>
+void IndexBenchmark<DIM, UPDATE_TYPE, INDEX>::Benchmark(benchmark::State& state) {
+    perf_.Start();
     for (auto _ : state) {
         state.PauseTiming();
+        perf_.Stop();
         BuildUpdates();
+        perf_.Start();
         state.ResumeTiming();
 
         UpdateWorld(state);
     }
+    perf_.Stop();
+    perf_.Report(state, (double)updates_per_round_ * state.iterations());
 }
 
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
-void IndexBenchmark<DIM, UPDATE_TYPE>::SetupWorld(benchmark::State& state) {
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX>
+void IndexBenchmark<DIM, UPDATE_TYPE, INDEX>::SetupWorld(benchmark::State& state) {
     logging::info("Setting up world with {} entities and {} dimensions.", num_entities_, DIM);
     CreatePointData<DIM>(points_, data_type_, num_entities_, 0, GLOBAL_MAX);
     for (size_t i = 0; i < num_entities_; ++i) {
         tree_.emplace(points_[i], i);
     }
+    FinishSetup(tree_);
 
     state.counters["total_upd_count"] = benchmark::Counter(0);
     state.counters["update_rate"] = benchmark::Counter(0, benchmark::Counter::kIsRate);
+    if (!perf_.IsAvailable()) {
+        logging::info("Hardware performance counters are not available: {}", perf_.GetError());
+    }
     logging::info("World setup complete.");
 }
 
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
-void IndexBenchmark<DIM, UPDATE_TYPE>::BuildUpdates() {
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX>
+void IndexBenchmark<DIM, UPDATE_TYPE, INDEX>::BuildUpdates() {
     size_t move_id = 0;
     for (auto& update : updates_) {
         int point_id = entity_id_distribution_(random_engine_);
         update.id_ = point_id;
         update.old_ = points_[point_id];
-        for (dimension_t d = 0; d < DIM; ++d) {
-            update.new_[d] = update.old_[d] + move_distance_[move_id];
+        if (movement_type_ == FIXED_STEP) {
+            for (dimension_t d = 0; d < DIM; ++d) {
+                update.new_[d] = update.old_[d] + move_distance_[move_id];
+            }
+        } else {
+            PointType<DIM> delta;
+            movement_.Move(point_id, update.old_, delta);
+            for (dimension_t d = 0; d < DIM; ++d) {
+                update.new_[d] = update.old_[d] + delta[d];
+            }
         }
         // update reference data
         points_[point_id] = update.new_;
@@ -136,8 +169,8 @@ void IndexBenchmark<DIM, UPDATE_TYPE>::BuildUpdates() {
     }
 }
 
-template <dimension_t DIM>
-size_t UpdateByKey(TreeType<DIM>& tree, std::vector<UpdateOp<DIM>>& updates) {
+template <dimension_t DIM, typename INDEX>
+size_t UpdateByKey(INDEX& tree, std::vector<UpdateOp<DIM>>& updates) {
     size_t n = 0;
     for (auto& update : updates) {
         // naive erase + emplace
@@ -176,20 +209,17 @@ size_t UpdateByIterHint(TreeType<DIM>& tree, std::vector<UpdateOp<DIM>>& updates
     return n;
 }
 
-template <dimension_t DIM, UpdateType UPDATE_TYPE>
-void IndexBenchmark<DIM, UPDATE_TYPE>::UpdateWorld(benchmark::State& state) {
+template <dimension_t DIM, UpdateType UPDATE_TYPE, typename INDEX>
+void IndexBenchmark<DIM, UPDATE_TYPE, INDEX>::UpdateWorld(benchmark::State& state) {
     size_t initial_tree_size = tree_.size();
     size_t n = 0;
-    switch (UPDATE_TYPE) {
-    case UpdateType::ERASE_BY_KEY:
-        n = UpdateByKey(tree_, updates_);
-        break;
-    case UpdateType::ERASE_BY_ITER:
+    // Updates via iterators are only supported by the PH-Tree.
+    if constexpr (UPDATE_TYPE == UpdateType::ERASE_BY_KEY) {
+        n = UpdateByKey<DIM>(tree_, updates_);
+    } else if constexpr (UPDATE_TYPE == UpdateType::ERASE_BY_ITER) {
         n = UpdateByIter(tree_, updates_);
-        break;
-    case UpdateType::EMPLACE_HINT:
+    } else {
         n = UpdateByIterHint(tree_, updates_);
-        break;
     }
 
     if (n != updates_.size()) {
@@ -226,7 +256,28 @@ void PhTreeEmplaceHint3D(benchmark::State& state, Arguments&&... arguments) {
     benchmark.Benchmark(state);
 }
 
-// index type, scenario name, data_type, num_entities, updates_per_round, move_distance
+template <typename... Arguments>
+void Grid3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, UpdateType::ERASE_BY_KEY, UniformGrid<3, size_t>> benchmark{
+        state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void KdTree3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, UpdateType::ERASE_BY_KEY, StaticKdTree<3, size_t>> benchmark{
+        state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+template <typename... Arguments>
+void Scan3D(benchmark::State& state, Arguments&&... arguments) {
+    IndexBenchmark<3, UpdateType::ERASE_BY_KEY, BruteForceScan<3, size_t>> benchmark{
+        state, arguments...};
+    benchmark.Benchmark(state);
+}
+
+// index type, scenario name, data_type, num_entities, movement, updates_per_round, move_distance
 // PhTree3D CUBE
 BENCHMARK_CAPTURE(PhTreeEraseKey3D, UPDATE_CU_100_of_1K, TestGenerator::CUBE, 1000)
     ->Unit(benchmark::kMillisecond);
@@ -253,7 +304,7 @@ BENCHMARK_CAPTURE(PhTreeEraseKey3D, UPDATE_CL_100_of_100K, TestGenerator::CLUSTE
 BENCHMARK_CAPTURE(PhTreeEraseKey3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
-// index type, scenario name, data_type, num_entities, updates_per_round, move_distance
+// index type, scenario name, data_type, num_entities, movement, updates_per_round, move_distance
 // PhTree3D CUBE
 BENCHMARK_CAPTURE(PhTreeEraseIter3D, UPDATE_CU_100_of_1K, TestGenerator::CUBE, 1000)
     ->Unit(benchmark::kMillisecond);
@@ -280,7 +331,7 @@ BENCHMARK_CAPTURE(PhTreeEraseIter3D, UPDATE_CL_100_of_100K, TestGenerator::CLUST
 BENCHMARK_CAPTURE(PhTreeEraseIter3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
 
-// index type, scenario name, data_type, num_entities, updates_per_round, move_distance
+// index type, scenario name, data_type, num_entities, movement, updates_per_round, move_distance
 // PhTree3D CUBE
 BENCHMARK_CAPTURE(PhTreeEmplaceHint3D, UPDATE_CU_100_of_1K, TestGenerator::CUBE, 1000)
     ->Unit(benchmark::kMillisecond);
@@ -306,4 +357,40 @@ BENCHMARK_CAPTURE(PhTreeEmplaceHint3D, UPDATE_CL_100_of_100K, TestGenerator::CLU
 
 BENCHMARK_CAPTURE(PhTreeEmplaceHint3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
     ->Unit(benchmark::kMillisecond);
+// PhTree3D moving entities
+BENCHMARK_CAPTURE(
+    PhTreeEmplaceHint3D, UPDATE_WALK_CU_100_of_1M, TestGenerator::CUBE, 1000000, RANDOM_WALK)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(
+    PhTreeEmplaceHint3D, UPDATE_WAYPOINT_CU_100_of_1M, TestGenerator::CUBE, 1000000, WAYPOINT)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(
+    PhTreeEmplaceHint3D, UPDATE_WAYPOINT_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000, WAYPOINT)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(
+    PhTreeEraseKey3D, UPDATE_WAYPOINT_HS_100_of_1M, TestGenerator::HOTSPOT, 1000000, WAYPOINT)
+    ->Unit(benchmark::kMillisecond);
+
+// Baseline indexes 3D
+BENCHMARK_CAPTURE(Grid3D, UPDATE_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Grid3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, UPDATE_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(KdTree3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, UPDATE_CU_100_of_1M, TestGenerator::CUBE, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(Scan3D, UPDATE_CL_100_of_1M, TestGenerator::CLUSTER, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
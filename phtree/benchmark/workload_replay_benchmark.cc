@@ -0,0 +1,325 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logging.h"
+#include "phtree/benchmark/benchmark_util.h"
+#include "phtree/benchmark/latency_histogram.h"
+#include "phtree/phtree.h"
+#include "phtree/phtree_multimap.h"
+#include "phtree/phtree_workload.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace improbable;
+using namespace improbable::phtree;
+using namespace improbable::phtree::phbenchmark;
+
+/*
+ * Replays a recorded workload (see PhTreeWorkloadRecorder) and reports the latency of every type
+ * of operation. The workload is loaded into memory before the benchmark starts, every benchmark
+ * iteration replays the whole workload on an empty tree.
+ *
+ * Workloads with point or box keys with `double` coordinates (PhTreeD, PhTreeBoxD,
+ * PhTreeMultiMapD, PhTreeMultiMapBoxD) and 2, 3 or 6 dimensions are supported. Values are replaced
+ * by their value ids.
+ *
+ * Usage: workload_replay_benchmark --workload FILE [benchmark options]
+ *        workload_replay_benchmark --generate FILE [--entries N] [--ticks N]
+ *
+ * --generate writes a synthetic workload of a 3D point tree with moving entities, window queries
+ * and kNN queries.
+ */
+namespace {
+
+const std::array<PhTreeWorkloadOperation, 8> OPS = {
+    PhTreeWorkloadOperation::EMPLACE,
+    PhTreeWorkloadOperation::ERASE,
+    PhTreeWorkloadOperation::RELOCATE,
+    PhTreeWorkloadOperation::CLEAR,
+    PhTreeWorkloadOperation::UPDATE,
+    PhTreeWorkloadOperation::FIND,
+    PhTreeWorkloadOperation::WINDOW_QUERY,
+    PhTreeWorkloadOperation::KNN_QUERY};
+const std::array<const char*, OPS.size()> OP_NAMES = {
+    "emplace", "erase", "relocate", "clear", "update", "find", "window_query", "knn_query"};
+
+size_t OpIndex(PhTreeWorkloadOperation op) {
+    return std::find(OPS.begin(), OPS.end(), op) - OPS.begin();
+}
+
+template <typename TREE, typename KEY, typename QUERY_BOX, bool IS_MULTIMAP>
+class WorkloadBenchmark {
+    using Record = PhTreeWorkloadRecord<KEY, QUERY_BOX>;
+    static constexpr bool IS_BOX = std::is_same_v<KEY, QUERY_BOX>;
+
+  public:
+    explicit WorkloadBenchmark(std::vector<Record> records) : records_{std::move(records)} {}
+
+    void Benchmark(benchmark::State& state) {
+        for (auto& histogram : histograms_) {
+            histogram.Reset();
+        }
+        size_t n = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            tree_.clear();
+            state.ResumeTiming();
+
+            for (auto& record : records_) {
+                auto& histogram = histograms_[OpIndex(record.op_)];
+                LatencyTimer timer;
+                n += Execute(record);
+                histogram.Record(timer.ElapsedNanos());
+            }
+        }
+        benchmark::DoNotOptimize(n);
+        Report(state);
+    }
+
+  private:
+    size_t Execute(const Record& r) {
+        switch (r.op_) {
+        case PhTreeWorkloadOperation::EMPLACE:
+            return tree_.emplace(r.key_, r.value_id_).second;
+        case PhTreeWorkloadOperation::ERASE:
+            if constexpr (IS_MULTIMAP) {
+                return tree_.erase(r.key_, r.value_id_);
+            } else {
+                return tree_.erase(r.key_);
+            }
+        case PhTreeWorkloadOperation::RELOCATE:
+            if constexpr (IS_MULTIMAP) {
+                return tree_.relocate(r.key_, r.new_key_, r.value_id_);
+            } else {
+                tree_.erase(r.key_);
+                return tree_.emplace(r.new_key_, r.value_id_).second;
+            }
+        case PhTreeWorkloadOperation::UPDATE:
+            if constexpr (!IS_MULTIMAP) {
+                tree_.insert_or_assign(r.key_, r.value_id_);
+            }
+            return 1;
+        case PhTreeWorkloadOperation::CLEAR:
+            tree_.clear();
+            return 0;
+        case PhTreeWorkloadOperation::FIND:
+            return tree_.count(r.key_);
+        case PhTreeWorkloadOperation::WINDOW_QUERY: {
+            size_t n = 0;
+            auto callback = [&n](const KEY&, const std::uint64_t&) { ++n; };
+            tree_.for_each(r.query_box_, callback);
+            return n;
+        }
+        case PhTreeWorkloadOperation::KNN_QUERY: {
+            size_t n = 0;
+            if constexpr (!IS_BOX) {
+                constexpr dimension_t DIM = sizeof(KEY) / sizeof(double);
+                auto q = tree_.begin_knn_query(r.k_, r.key_, DistanceEuclidean<DIM>());
+                for (; q != tree_.end(); ++q) {
+                    ++n;
+                }
+            }
+            return n;
+        }
+        }
+        return 0;
+    }
+
+    void Report(benchmark::State& state) {
+        for (size_t i = 0; i < histograms_.size(); ++i) {
+            auto& histogram = histograms_[i];
+            if (histogram.Count() == 0) {
+                continue;
+            }
+            std::string name = OP_NAMES[i];
+            state.counters[name + "_count"] = histogram.Count();
+            state.counters[name + "_mean_ns"] = histogram.Mean();
+            state.counters[name + "_p99_ns"] = histogram.Percentile(99);
+            logging::info("{} [ns]: {}", name, histogram.ToString());
+        }
+    }
+
+    std::vector<Record> records_;
+    TREE tree_;
+    std::array<LatencyHistogram<>, OP_NAMES.size()> histograms_;
+};
+
+template <typename TREE, typename KEY, typename QUERY_BOX, bool IS_MULTIMAP>
+bool RegisterWorkload(PhTreeWorkloadReader<KEY, QUERY_BOX>& reader, const std::string& name) {
+    std::vector<PhTreeWorkloadRecord<KEY, QUERY_BOX>> records;
+    PhTreeWorkloadRecord<KEY, QUERY_BOX> record;
+    while (reader.Next(record)) {
+        records.push_back(record);
+    }
+    logging::info("Loaded {} operations.", records.size());
+    auto benchmark =
+        std::make_shared<WorkloadBenchmark<TREE, KEY, QUERY_BOX, IS_MULTIMAP>>(std::move(records));
+    benchmark::RegisterBenchmark(name.c_str(), [benchmark](benchmark::State& state) {
+        benchmark->Benchmark(state);
+    })->Unit(benchmark::kMillisecond);
+    return true;
+}
+
+template <dimension_t DIM>
+bool RegisterWorkload(std::istream& is, const PhTreeWorkloadHeader& header) {
+    std::string name = "Replay" + std::to_string(DIM) + "D";
+    if (header.IsBoxKeys()) {
+        PhTreeWorkloadReader<PhBoxD<DIM>, PhBoxD<DIM>> reader(is);
+        if (!reader.IsValid()) {
+            return false;
+        }
+        if (header.IsMultiMap()) {
+            using TreeT = PhTreeMultiMapBoxD<DIM, std::uint64_t>;
+            return RegisterWorkload<TreeT, PhBoxD<DIM>, PhBoxD<DIM>, true>(reader, name + "_MMBox");
+        }
+        using TreeT = PhTreeBoxD<DIM, std::uint64_t>;
+        return RegisterWorkload<TreeT, PhBoxD<DIM>, PhBoxD<DIM>, false>(reader, name + "_Box");
+    }
+    PhTreeWorkloadReader<PhPointD<DIM>, PhBoxD<DIM>> reader(is);
+    if (!reader.IsValid()) {
+        return false;
+    }
+    if (header.IsMultiMap()) {
+        using TreeT = PhTreeMultiMapD<DIM, std::uint64_t>;
+        return RegisterWorkload<TreeT, PhPointD<DIM>, PhBoxD<DIM>, true>(reader, name + "_MM");
+    }
+    using TreeT = PhTreeD<DIM, std::uint64_t>;
+    return RegisterWorkload<TreeT, PhPointD<DIM>, PhBoxD<DIM>, false>(reader, name);
+}
+
+bool RegisterWorkload(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    // Read the header once to find the types, the typed reader reads and validates it again.
+    PhTreeWorkloadReader<PhPointD<1>, PhBoxD<1>> header_reader(is);
+    PhTreeWorkloadHeader header = header_reader.GetHeader();
+    is.clear();
+    is.seekg(0);
+    switch (header.dim_) {
+    case 2:
+        return RegisterWorkload<2>(is, header);
+    case 3:
+        return RegisterWorkload<3>(is, header);
+    case 6:
+        return RegisterWorkload<6>(is, header);
+    default:
+        return false;
+    }
+}
+
+/*
+ * Writes a workload of a 3D point tree. Every tick relocates 10% of the entities, and performs
+ * window queries and kNN queries for 1% of the entities.
+ */
+bool GenerateWorkload(const std::string& path, size_t num_entities, size_t num_ticks) {
+    const double GLOBAL_MAX = 10000;
+    const double query_length = GLOBAL_MAX * std::pow(100. / (double)num_entities, 1. / 3.);
+    std::ofstream os(path, std::ios::binary);
+    PhTreeD<3, size_t> tree;
+    PhTreeWorkloadRecorder recorder(tree, os);
+    tree.set_listener(&recorder);
+
+    std::vector<PhPointD<3>> points(num_entities);
+    CreatePointData<3>(points, TestGenerator::HOTSPOT, num_entities, 0, GLOBAL_MAX);
+    for (size_t i = 0; i < num_entities; ++i) {
+        tree.emplace(points[i], i);
+    }
+    MovementModel<3> movement{WAYPOINT, num_entities, 0, 0, GLOBAL_MAX, 10};
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<size_t> id_distribution(0, num_entities - 1);
+    for (size_t tick = 0; tick < num_ticks; ++tick) {
+        for (size_t i = 0; i < num_entities / 10; ++i) {
+            size_t id = id_distribution(random_engine);
+            PhPointD<3> delta;
+            movement.Move(id, points[id], delta);
+            PhPointD<3> new_point = points[id];
+            for (dimension_t d = 0; d < 3; ++d) {
+                new_point[d] += delta[d];
+            }
+            tree.erase(points[id]);
+            tree.emplace(new_point, id);
+            points[id] = new_point;
+        }
+        for (size_t i = 0; i < num_entities / 100; ++i) {
+            auto& center = points[id_distribution(random_engine)];
+            PhBoxD<3> query_box{center, center};
+            for (dimension_t d = 0; d < 3; ++d) {
+                query_box.min()[d] -= query_length / 2;
+                query_box.max()[d] += query_length / 2;
+            }
+            size_t n = 0;
+            auto callback = [&n](const PhPointD<3>&, const size_t&) { ++n; };
+            recorder.for_each(query_box, callback);
+            auto q = recorder.begin_knn_query(10, center, DistanceEuclidean<3>());
+            for (; q != recorder.end(); ++q) {
+                ++n;
+            }
+        }
+    }
+    return os.good();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    logging::SetupDefaultLogging();
+    std::string workload;
+    std::string generate;
+    size_t num_entities = 100000;
+    size_t num_ticks = 100;
+    // Extract our own options, all other options are passed to Google Benchmark.
+    int n_args = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--workload") {
+            workload = argv[++i];
+        } else if (i + 1 < argc && arg == "--generate") {
+            generate = argv[++i];
+        } else if (i + 1 < argc && arg == "--entries") {
+            num_entities = std::stoul(argv[++i]);
+        } else if (i + 1 < argc && arg == "--ticks") {
+            num_ticks = std::stoul(argv[++i]);
+        } else {
+            argv[n_args++] = argv[i];
+        }
+    }
+    argc = n_args;
+
+    if (!generate.empty()) {
+        if (!GenerateWorkload(generate, num_entities, num_ticks)) {
+            std::cerr << "Could not write workload: " << generate << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (workload.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --workload FILE [benchmark options]" << std::endl;
+        std::cerr << "       " << argv[0] << " --generate FILE [--entries N] [--ticks N]"
+                  << std::endl;
+        return 1;
+    }
+    if (!RegisterWorkload(workload)) {
+        std::cerr << "Invalid or unsupported workload: " << workload << std::endl;
+        return 1;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
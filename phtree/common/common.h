@@ -24,6 +24,11 @@
 #include "filter.h"
 #include "flat_array_map.h"
 #include "flat_sparse_map.h"
+#include "prefetch.h"
+#include "query_stats.h"
+#include "trace.h"
+#include "tracking.h"
+#include "tree_access.h"
 #include "tree_stats.h"
 #include <cassert>
 #include <cmath>
@@ -115,6 +120,32 @@ static bool KeyEquals(
     return true;
 }
 
+// ************************************************************************
+// Hashing
+// ************************************************************************
+
+/*
+ * Mixes the bits of a 64 bit value (finalizer of splitmix64).
+ */
+inline std::uint64_t MixHash(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * @return The hash of a key/value entry. Node hashes are the sum of the hashes of all entries in
+ * the subtree, see PhTreeV16::hash().
+ */
+template <dimension_t DIM, typename SCALAR>
+static std::uint64_t HashEntry(const PhPoint<DIM, SCALAR>& key, std::uint64_t value_hash) {
+    std::uint64_t hash = MixHash(value_hash);
+    for (dimension_t i = 0; i < DIM; ++i) {
+        hash = MixHash(hash ^ static_cast<bit_mask_t<SCALAR>>(key[i]));
+    }
+    return hash;
+}
+
 // ************************************************************************
 // String helpers
 // ************************************************************************
@@ -51,6 +51,22 @@ class PhTreeDebugHelper {
         return tree.GetInternalTree().GetDebugHelper().GetStats();
     }
 
+    /*
+     * Collects statistics, including the memory size of the tree. Memory that is allocated by
+     * values, e.g. strings or vectors, is reported by the value size function, for example:
+     * GetStats(tree, [](const std::string& value) { return value.capacity(); });
+     *
+     * For PhTreeMultiMap, the function is called with the internal buckets of the multimap. Without
+     * value size function, the storage of the buckets is counted, see ValueHeapSizeDefault.
+     *
+     * @param value_size_fn Returns the heap memory in bytes that is owned by a value.
+     * @return some statistics about the tree.
+     */
+    template <typename TREE, typename VALUE_SIZE>
+    static PhTreeStats GetStats(const TREE& tree, const VALUE_SIZE& value_size_fn) {
+        return tree.GetInternalTree().GetDebugHelper().GetStats(value_size_fn);
+    }
+
     /*
      * Depending on the detail parameter this returns:
      * - "name"    : a string that identifies the tree implementation type.
@@ -54,6 +54,35 @@ namespace improbable::phtree {
  *   have any value.
  */
 
+/*
+ * Calculates the region of a node, i.e. the smallest and the largest key that can be stored in the
+ * subtree of a node with the given prefix.
+ *
+ * @param bits_to_ignore The number of trailing bits that are not fixed by the prefix, i.e. the
+ * postfix length of the node + 1. This is the 'bits_to_ignore' argument of IsNodeValid().
+ */
+template <dimension_t DIM, typename SCALAR>
+static void CalcNodeBounds(
+    const PhPoint<DIM, SCALAR>& prefix,
+    bit_width_t bits_to_ignore,
+    PhPoint<DIM, SCALAR>& min,
+    PhPoint<DIM, SCALAR>& max) {
+    if (bits_to_ignore >= MAX_BIT_WIDTH<SCALAR>) {
+        // root node
+        for (dimension_t i = 0; i < DIM; ++i) {
+            min[i] = std::numeric_limits<SCALAR>::lowest();
+            max[i] = std::numeric_limits<SCALAR>::max();
+        }
+        return;
+    }
+    SCALAR node_min_bits = MAX_MASK<SCALAR> << bits_to_ignore;
+    SCALAR node_max_bits = ~node_min_bits;
+    for (dimension_t i = 0; i < DIM; ++i) {
+        min[i] = prefix[i] & node_min_bits;
+        max[i] = prefix[i] | node_max_bits;
+    }
+}
+
 /*
  * The no-op filter is the default filter for the PH-Tree. It always returns 'true'.
  */
@@ -131,12 +160,11 @@ class FilterAABB {
         if (bits_to_ignore >= (MAX_BIT_WIDTH<ScalarInternal> - 1)) {
             return true;
         }
-        ScalarInternal node_min_bits = MAX_MASK<ScalarInternal> << bits_to_ignore;
-        ScalarInternal node_max_bits = ~node_min_bits;
-
+        KeyInternal node_min;
+        KeyInternal node_max;
+        CalcNodeBounds(prefix, static_cast<bit_width_t>(bits_to_ignore), node_min, node_max);
         for (dimension_t i = 0; i < DIM; ++i) {
-            if ((prefix[i] | node_max_bits) < min_internal_[i] ||
-                (prefix[i] & node_min_bits) > max_internal_[i]) {
+            if (node_max[i] < min_internal_[i] || node_min[i] > max_internal_[i]) {
                 return false;
             }
         }
@@ -188,23 +216,20 @@ class FilterSphere {
      * sphere.
      */
     [[nodiscard]] bool IsNodeValid(const KeyInternal& prefix, int bits_to_ignore) const {
-        // we always want to traverse the root node (bits_to_ignore == 64)
-
+        // We always traverse the root node (bits_to_ignore == 64) and its direct children. Their
+        // bounds are the limits of the internal key space, which may not be valid external
+        // coordinates (e.g. NaN for IEEE converters), so distances cannot be calculated.
         if (bits_to_ignore >= (MAX_BIT_WIDTH<ScalarInternal> - 1)) {
             return true;
         }
 
-        ScalarInternal node_min_bits = MAX_MASK<ScalarInternal> << bits_to_ignore;
-        ScalarInternal node_max_bits = ~node_min_bits;
-
+        KeyInternal node_min;
+        KeyInternal node_max;
+        CalcNodeBounds(prefix, static_cast<bit_width_t>(bits_to_ignore), node_min, node_max);
         KeyInternal closest_in_bounds;
         for (dimension_t i = 0; i < DIM; ++i) {
-            // calculate lower and upper bound for dimension for given node
-            ScalarInternal lo = prefix[i] & node_min_bits;
-            ScalarInternal hi = prefix[i] | node_max_bits;
-
             // choose value closest to center for dimension
-            closest_in_bounds[i] = std::clamp(center_internal_[i], lo, hi);
+            closest_in_bounds[i] = std::clamp(center_internal_[i], node_min[i], node_max[i]);
         }
 
         KeyExternal closest_point = converter_.post(closest_in_bounds);
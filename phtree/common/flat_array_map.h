@@ -122,6 +122,14 @@ class array_map {
         return std::bitset<64>(occupancy).count();
     }
 
+    /*
+     * @return The start of the (inline) storage of SIZE slots. Unoccupied slots must not be
+     * accessed, this is meant for prefetching.
+     */
+    [[nodiscard]] const void* data() const {
+        return &data_[0];
+    }
+
   private:
     template <typename... Args>
     std::pair<PhFlatMapPair<T>*, bool> try_emplace_base(size_t index, Args&&... args) {
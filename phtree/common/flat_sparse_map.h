@@ -123,6 +123,24 @@ class sparse_map {
         return data_.size();
     }
 
+    /*
+     * @return the number of entries that fit into the currently allocated storage.
+     */
+    [[nodiscard]] size_t capacity() const {
+        return data_.capacity();
+    }
+
+    void reserve(size_t size) {
+        data_.reserve(size);
+    }
+
+    /*
+     * @return The start of the storage of size() entries, may be nullptr if the map is empty.
+     */
+    [[nodiscard]] const PhFlatMapPair<T>* data() const {
+        return data_.data();
+    }
+
   private:
     template <typename... Args>
     auto emplace_base(size_t key, Args&&... args) {
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_COMMON_PREFETCH_H
+#define PHTREE_COMMON_PREFETCH_H
+
+#include <cstddef>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+/*
+ * PLEASE do not include this file directly, it is included via common.h.
+ *
+ * This file defines software prefetching of child nodes. Queries that traverse many nodes spend
+ * much of their time waiting for child nodes to be loaded into the cache. To hide this latency,
+ * window queries, full iterators and kNN queries issue prefetches for child nodes before they
+ * visit them.
+ *
+ * PHTREE_PREFETCH_DISTANCE is the number of entries that window queries and full iterators look
+ * ahead of the current entry when prefetching child nodes. kNN queries prefetch all child nodes
+ * of a node before calculating their distances. Prefetching can be disabled by defining
+ * PHTREE_PREFETCH_DISTANCE=0 before including any PH-Tree header.
+ *
+ * Memory: full iterators (begin()) and window query iterators (begin_query()) keep one prefetch
+ * iterator per tree level. For PhTreeD<3> this increases the size of full iterators by ~50%
+ * (2104 -> 3128 bytes) and the size of window query iterators by ~38% (2664 -> 3688 bytes). kNN
+ * iterators do not need additional memory. With PHTREE_PREFETCH_DISTANCE=0 the prefetch iterators
+ * are removed.
+ *
+ * Prefetching a node loads the node and the storage of its entries (all cache lines of an inline
+ * array_map, or the heap array of a sparse_map), see Node::Prefetch().
+ *
+ * The default of 4 was chosen with query_d_benchmark, knn_d_benchmark (3D, 1M entries, array_map)
+ * and dim_sweep_benchmark (6D, 1M entries, sparse_map), GCC -O3, time per query for distance 0
+ * vs 4:
+ * - query_d  WQ_CU_100_of_1M (MMI):  45us -> 31us
+ * - query_d  WQ_CL_100_of_1M (MMI):  15us -> 12us
+ * - knn_d    KNN_CU_10_of_1M:        30us -> 21us
+ * - knn_d    KNN_CL_10_of_1M:        28us -> 17us
+ * - dim_sweep sparse_map window_query DIM:6:  227us -> 178us
+ * - dim_sweep sparse_map knn_query DIM:6:     398us -> 245us
+ */
+#if !defined(PHTREE_PREFETCH_DISTANCE)
+#define PHTREE_PREFETCH_DISTANCE 4
+#endif
+
+namespace improbable::phtree {
+
+static constexpr size_t PREFETCH_DISTANCE = PHTREE_PREFETCH_DISTANCE;
+
+/*
+ * Hints the CPU to load the cache line at the given address. This never faults, the address does
+ * not need to be valid.
+ */
+inline void PrefetchRead([[maybe_unused]] const void* address) {
+#if PHTREE_PREFETCH_DISTANCE > 0
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+#endif
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_PREFETCH_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_COMMON_QUERY_STATS_H
+#define PHTREE_COMMON_QUERY_STATS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+/*
+ * PLEASE do not include this file directly, it is included via common.h.
+ *
+ * This file defines per-query traversal statistics. They are only collected if PHTREE_QUERY_STATS
+ * is defined, otherwise all counting macros are empty. PHTREE_QUERY_STATS must be defined (or not)
+ * consistently for all translation units of a program.
+ *
+ * Queries record their statistics in the PhTreeQueryStats object that is passed to the query, e.g.:
+ *
+ * PhTreeQueryStats stats;
+ * tree.for_each(query_box, callback, FilterNoOp(), QueryPoint(), &stats);
+ * auto it = tree.begin_query(query_box, FilterNoOp(), QueryPoint(), &stats);  // kept by 'it'
+ * std::cout << stats.ToString();
+ *
+ * Iterators keep a pointer to the stats object, so it must outlive them. If no stats object is
+ * passed, the statistics are added to the thread-local fallback of GetQueryStats().
+ */
+#if defined(PHTREE_QUERY_STATS)
+#define PHTREE_QUERY_STATS_INC(stats, counter) (++(stats)->counter)
+#define PHTREE_QUERY_STATS_INC_IF(stats, condition, counter) \
+    do {                                                      \
+        if (condition) {                                      \
+            PHTREE_QUERY_STATS_INC(stats, counter);           \
+        }                                                     \
+    } while (false)
+#define PHTREE_QUERY_STATS_VISIT_NODE(stats, depth) (stats)->VisitNode(depth)
+#else
+#define PHTREE_QUERY_STATS_INC(stats, counter) ((void)(stats))
+#define PHTREE_QUERY_STATS_INC_IF(stats, condition, counter) ((void)(stats))
+#define PHTREE_QUERY_STATS_VISIT_NODE(stats, depth) ((void)(stats))
+#endif
+
+namespace improbable::phtree {
+
+class PhTreeQueryStats {
+  public:
+#if defined(PHTREE_QUERY_STATS)
+    static constexpr bool IS_ENABLED = true;
+#else
+    static constexpr bool IS_ENABLED = false;
+#endif
+
+    void Reset() {
+        *this = PhTreeQueryStats();
+    }
+
+    /*
+     * @param depth The depth of the node in bits, i.e. the length of the node's prefix.
+     */
+    void VisitNode(size_t depth) {
+        ++n_nodes_visited_;
+        max_depth_ = std::max(max_depth_, depth);
+    }
+
+    [[nodiscard]] std::string ToString() const {
+        std::ostringstream s;
+        s << "  nodesVisited = " << n_nodes_visited_ << std::endl;
+        s << "  nodesPrunedHC = " << n_nodes_pruned_hc_ << "  nodesPrunedPrefix = "
+          << n_nodes_pruned_prefix_ << "  nodesPrunedFilter = " << n_nodes_pruned_filter_
+          << std::endl;
+        s << "  entriesTested = " << n_entries_tested_
+          << "  entriesReturned = " << n_entries_returned_ << std::endl;
+        s << "  maxDepth = " << max_depth_ << std::endl;
+        return s.str();
+    }
+
+    size_t n_nodes_visited_ = 0;
+    size_t n_nodes_pruned_hc_ = 0;      // child nodes outside the hypercube masks of their parent
+    size_t n_nodes_pruned_prefix_ = 0;  // child nodes whose prefix does not overlap with the query
+    size_t n_nodes_pruned_filter_ = 0;  // child nodes that were rejected by FILTER::IsNodeValid()
+    size_t n_entries_tested_ = 0;       // entries that were compared with the query or filter
+    size_t n_entries_returned_ = 0;
+    size_t max_depth_ = 0;  // maximum depth of visited nodes in bits
+};
+
+/*
+ * @return The query statistics of the current thread. They collect the statistics of all queries
+ * that are not given a stats object. The statistics are always zero if PHTREE_QUERY_STATS is not
+ * defined.
+ */
+inline PhTreeQueryStats& GetQueryStats() {
+    thread_local PhTreeQueryStats stats;
+    return stats;
+}
+
+/*
+ * @return The stats object of a query: 'stats' if it is not 'nullptr', otherwise the thread-local
+ * statistics of GetQueryStats(). Without PHTREE_QUERY_STATS, 'stats' is returned unchanged.
+ */
+inline PhTreeQueryStats* ResolveQueryStats(PhTreeQueryStats* stats) {
+#if defined(PHTREE_QUERY_STATS)
+    return stats != nullptr ? stats : &GetQueryStats();
+#else
+    return stats;
+#endif
+}
+
+}  // namespace improbable::phtree
+#endif  // PHTREE_COMMON_QUERY_STATS_H
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_COMMON_SERIALIZATION_H
+#define PHTREE_COMMON_SERIALIZATION_H
+
+#include "base_types.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+/*
+ * This file is not included via common.h, it is only needed by the opt-in headers for
+ * serialization, e.g. phtree_serialization.h and phtree_operation_log.h.
+ *
+ * This file contains helpers for writing PH-Tree content to binary streams and for reading it
+ * back, including the value codecs that are used by serialize() and deserialize().
+ *
+ * All scalars are written in native byte order, i.e. streams can only be read on machines with the
+ * same endianness as the machine that wrote them.
+ */
+namespace improbable::phtree {
+
+template <typename T>
+static void WriteRaw(std::ostream& os, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/*
+ * @return 'true' if the value could be read, otherwise 'false'.
+ */
+template <typename T>
+static bool ReadRaw(std::istream& is, T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    is.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return !is.fail();
+}
+
+/*
+ * Writes an unsigned integer with 7 bits per byte (LEB128), small values require fewer bytes.
+ */
+inline void WriteVarInt(std::ostream& os, std::uint64_t value) {
+    while (value >= 0x80) {
+        os.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    os.put(static_cast<char>(value));
+}
+
+/*
+ * @return 'true' if the value could be read, otherwise 'false'.
+ */
+inline bool ReadVarInt(std::istream& is, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        auto c = is.get();
+        if (is.fail()) {
+            return false;
+        }
+        value |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Writes bit fields of arbitrary length (up to 64 bit) into a byte buffer. Bits are collected in a
+ * 64 bit word that is appended to the buffer whenever it is full. Flush() must be called to append
+ * the remaining bits.
+ *
+ * Words are appended byte by byte, starting with the lowest byte, so the encoding does not depend
+ * on the byte order of the machine.
+ */
+class BitWriter {
+  public:
+    explicit BitWriter(std::string& buffer) : buffer_{buffer} {}
+
+    void Write(std::uint64_t value, bit_width_t bits) {
+        assert(bits <= 64);
+        if (bits < 64) {
+            value &= (std::uint64_t{1} << bits) - 1;
+        }
+        if (word_bits_ + bits < 64) {
+            word_ |= value << word_bits_;
+            word_bits_ += bits;
+            return;
+        }
+        // fill up the word and append it
+        bit_width_t n = 64 - word_bits_;
+        word_ |= value << word_bits_;
+        AppendBytes(8);
+        word_ = n == 64 ? 0 : value >> n;
+        word_bits_ = bits - n;
+    }
+
+    /*
+     * Appends any pending bits, padded to a full byte.
+     */
+    void Flush() {
+        AppendBytes((word_bits_ + 7) / 8);
+        word_ = 0;
+        word_bits_ = 0;
+    }
+
+  private:
+    void AppendBytes(int n) {
+        char bytes[8];
+        for (int i = 0; i < n; ++i) {
+            bytes[i] = static_cast<char>(word_ >> (i * 8));
+        }
+        buffer_.append(bytes, n);
+    }
+
+    std::string& buffer_;
+    std::uint64_t word_ = 0;
+    bit_width_t word_bits_ = 0;
+};
+
+/*
+ * Reads bit fields from a byte buffer that was written with BitWriter.
+ * Reading beyond the end of the buffer returns '0' bits and IsValid() returns 'false' afterwards.
+ */
+class BitReader {
+  public:
+    BitReader(const char* data, size_t size) : data_{data}, remaining_{size} {}
+
+    std::uint64_t Read(bit_width_t bits) {
+        assert(bits <= 64);
+        if (bits <= word_bits_) {
+            std::uint64_t value = word_ & Mask(bits);
+            word_ = bits == 64 ? 0 : word_ >> bits;
+            word_bits_ -= bits;
+            return value;
+        }
+        // use the remaining bits and then load the next word
+        std::uint64_t value = word_;
+        bit_width_t have = word_bits_;
+        bit_width_t missing = bits - have;
+        int n_bytes = static_cast<int>(std::min<size_t>(8, remaining_));
+        if (n_bytes * 8 < missing) {
+            valid_ = false;
+            word_ = 0;
+            word_bits_ = 0;
+            return 0;
+        }
+        std::uint64_t next = LoadBytes(n_bytes);
+        value |= (next & Mask(missing)) << have;
+        word_ = missing == 64 ? 0 : next >> missing;
+        word_bits_ = n_bytes * 8 - missing;
+        return value;
+    }
+
+    [[nodiscard]] bool IsValid() const {
+        return valid_;
+    }
+
+  private:
+    static std::uint64_t Mask(bit_width_t bits) {
+        return bits == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+    }
+
+    std::uint64_t LoadBytes(int n) {
+        std::uint64_t result = 0;
+        for (int i = 0; i < n; ++i) {
+            result |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data_[i])) << (i * 8);
+        }
+        data_ += n;
+        remaining_ -= n;
+        return result;
+    }
+
+    const char* data_;
+    size_t remaining_;
+    std::uint64_t word_ = 0;
+    bit_width_t word_bits_ = 0;
+    bool valid_ = true;
+};
+
+/*
+ * Value codecs translate values of type T into bytes and back. They are used by the serialize()
+ * and deserialize() functions of the PH-Tree.
+ *
+ * Every codec needs to provide two functions:
+ * - void write(std::ostream& os, const T& value) const;
+ *   This function should write the value to the output stream.
+ * - T read(std::istream& is) const;
+ *   This function should read a value that was written by write() and return it. Errors should be
+ *   signalled by setting the stream's failbit, for example by reading beyond the end of the stream.
+ *
+ * The default codec writes the bytes of the value as they are. This works only for trivially
+ * copyable types that are not pointers. Other types, such as std::string, require a custom codec.
+ */
+template <typename T>
+struct ValueCodec {
+    using ValueT = std::remove_const_t<T>;
+    static_assert(
+        std::is_trivially_copyable_v<ValueT>,
+        "The default ValueCodec supports only trivially copyable types, please provide a codec.");
+    static_assert(
+        !std::is_pointer_v<ValueT>,
+        "Pointers cannot be serialized with the default ValueCodec, please provide a codec.");
+
+    void write(std::ostream& os, const T& value) const {
+        WriteRaw(os, value);
+    }
+
+    ValueT read(std::istream& is) const {
+        ValueT value;
+        ReadRaw(is, value);
+        return value;
+    }
+};
+
+/*
+ * The bucket codec is used by the PhTreeMultiMap. It writes the number of values in a bucket,
+ * followed by the values, which are written with the codec provided by the user.
+ * read() fails if a bucket contains duplicate values. It adds the number of values that were read
+ * to 'num_values_' (if not null) so the caller can verify the total number of values.
+ */
+template <typename BUCKET, typename CODEC>
+struct BucketCodec {
+    void write(std::ostream& os, const BUCKET& bucket) const {
+        WriteRaw<std::uint64_t>(os, bucket.size());
+        for (auto& value : bucket) {
+            codec_.write(os, value);
+        }
+    }
+
+    BUCKET read(std::istream& is) const {
+        BUCKET bucket;
+        std::uint64_t size = 0;
+        ReadRaw(is, size);
+        for (std::uint64_t i = 0; i < size && !is.fail(); ++i) {
+            bucket.emplace(codec_.read(is));
+        }
+        if (bucket.size() != size) {
+            is.setstate(std::ios::failbit);
+        }
+        if (num_values_ != nullptr) {
+            *num_values_ += bucket.size();
+        }
+        return bucket;
+    }
+
+    const CODEC& codec_;
+    std::uint64_t* num_values_ = nullptr;
+};
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_SERIALIZATION_H
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_COMMON_SHARED_MEMORY_H
+#define PHTREE_COMMON_SHARED_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * This file is NOT included via common.h because it requires OS headers.
+ */
+namespace improbable::phtree {
+
+/*
+ * A named, writable shared memory region that can be mapped by multiple processes.
+ * On POSIX systems, names should start with '/', e.g. "/my_tree".
+ */
+class SharedMemory {
+  public:
+    SharedMemory() = default;
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    SharedMemory(SharedMemory&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)} {
+#if defined(_WIN32)
+        handle_ = std::exchange(other.handle_, nullptr);
+#endif
+    }
+
+    SharedMemory& operator=(SharedMemory&& other) noexcept {
+        if (this != &other) {
+            close();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+#if defined(_WIN32)
+            handle_ = std::exchange(other.handle_, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    ~SharedMemory() {
+        close();
+    }
+
+    /*
+     * Creates a new region and maps it into memory. An existing region with the same name is
+     * replaced. The content of the region is zero initialized.
+     * @return 'false' if the region could not be created or mapped.
+     */
+    bool create(const std::string& name, size_t size) {
+        close();
+#if defined(_WIN32)
+        auto size64 = static_cast<unsigned long long>(size);
+        HANDLE mapping = CreateFileMappingA(
+            INVALID_HANDLE_VALUE,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(size64 >> 32),
+            static_cast<DWORD>(size64),
+            name.c_str());
+        return Map(mapping, size);
+#else
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        return Map(fd, size);
+#endif
+    }
+
+    /*
+     * Maps an existing region into memory.
+     * @return 'false' if the region does not exist or could not be mapped.
+     */
+    bool open(const std::string& name) {
+        close();
+#if defined(_WIN32)
+        HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+        return Map(mapping, 0);
+#else
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        return Map(fd, static_cast<size_t>(st.st_size));
+#endif
+    }
+
+    void close() {
+        if (data_ != nullptr) {
+#if defined(_WIN32)
+            UnmapViewOfFile(data_);
+            CloseHandle(handle_);
+            handle_ = nullptr;
+#else
+            munmap(data_, size_);
+#endif
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    /*
+     * Removes the name of a region. Processes that have mapped the region can continue to use it.
+     * On Windows, regions are removed automatically when they are not mapped anymore.
+     */
+    static void remove(const std::string& name) {
+#if !defined(_WIN32)
+        shm_unlink(name.c_str());
+#else
+        (void)name;
+#endif
+    }
+
+    [[nodiscard]] char* data() const {
+        return data_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+  private:
+#if defined(_WIN32)
+    bool Map(HANDLE mapping, size_t size) {
+        if (mapping == nullptr) {
+            return false;
+        }
+        void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (data == nullptr) {
+            CloseHandle(mapping);
+            return false;
+        }
+        if (size == 0) {
+            MEMORY_BASIC_INFORMATION info;
+            VirtualQuery(data, &info, sizeof(info));
+            size = info.RegionSize;
+        }
+        handle_ = mapping;
+        data_ = static_cast<char*>(data);
+        size_ = size;
+        return true;
+    }
+
+    HANDLE handle_ = nullptr;
+#else
+    bool Map(int fd, size_t size) {
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        data_ = static_cast<char*>(data);
+        size_ = size;
+        return true;
+    }
+#endif
+
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/*
+ * @return The id of the current process.
+ */
+inline std::uint32_t CurrentProcessId() {
+#if defined(_WIN32)
+    return static_cast<std::uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<std::uint32_t>(getpid());
+#endif
+}
+
+/*
+ * @return 'false' if no process with the given id exists. Note that process ids may be reused, so
+ * 'true' does not guarantee that it is still the same process.
+ */
+inline bool IsProcessAlive(std::uint32_t pid) {
+#if defined(_WIN32)
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (process == nullptr) {
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    // Signal '0' only checks whether the process exists. EPERM means that it exists but belongs
+    // to another user.
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_SHARED_MEMORY_H
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_COMMON_TRACE_H
+#define PHTREE_COMMON_TRACE_H
+
+#include "base_types.h"
+#include <cstddef>
+
+/*
+ * PLEASE do not include this file directly, it is included via common.h.
+ *
+ * This file defines hooks for tracing structural modifications of trees: node splits, node merges,
+ * node allocation/deallocation and changes of the root node.
+ *
+ * The hooks are static functions of a policy type that is selected at compile time. By default
+ * this is PhTreeTraceNoOp, all calls are removed by the compiler. A custom policy can be selected
+ * by defining PHTREE_TRACE_POLICY before including any PH-Tree header, for example:
+ *
+ * struct MyTrace {
+ *     static void OnNodeAlloc(const void* node, std::uint16_t postfix_len) {}
+ *     static void OnNodeFree(const void* node, std::uint16_t postfix_len) {}
+ *     static void OnSplit(const void* node, std::uint16_t postfix_len) { ++n_splits; }
+ *     static void OnMerge(const void* node, std::uint16_t postfix_len) { ++n_merges; }
+ *     static void OnRootChange(const void* root) {}
+ * };
+ * #define PHTREE_TRACE_POLICY MyTrace
+ * #include "phtree/phtree.h"
+ *
+ * Custom policies must implement all hooks of PhTreeTraceNoOp because the policy has to be
+ * declared before any PH-Tree header is included.
+ *
+ * PHTREE_TRACE_POLICY must be defined consistently for all translation units of a program.
+ * The policy applies to all trees of a program. Hooks may be called concurrently if trees are
+ * modified concurrently.
+ */
+namespace improbable::phtree {
+
+/*
+ * The default tracing policy, all hooks are empty.
+ */
+struct PhTreeTraceNoOp {
+    /*
+     * Called after a node was constructed.
+     * @param postfix_len The postfix length of the node, i.e. its level in the tree.
+     */
+    static void OnNodeAlloc(const void* /* node */, bit_width_t /* postfix_len */) {}
+
+    /*
+     * Called before a node is destructed.
+     */
+    static void OnNodeFree(const void* /* node */, bit_width_t /* postfix_len */) {}
+
+    /*
+     * Called after an insertion has split an entry into a new child node with two entries.
+     * @param node The new child node.
+     */
+    static void OnSplit(const void* /* node */, bit_width_t /* postfix_len */) {}
+
+    /*
+     * Called before a child node with a single remaining entry is merged into its parent node.
+     * @param node The child node, it is deleted by the merge.
+     */
+    static void OnMerge(const void* /* node */, bit_width_t /* postfix_len */) {}
+
+    /*
+     * Called after the root node of a tree was created or replaced, i.e. when a tree is
+     * constructed or cleared.
+     */
+    static void OnRootChange(const void* /* root */) {}
+};
+
+}  // namespace improbable::phtree
+
+#if !defined(PHTREE_TRACE_POLICY)
+#define PHTREE_TRACE_POLICY ::improbable::phtree::PhTreeTraceNoOp
+#endif
+
+namespace improbable::phtree {
+using PhTreeTrace = PHTREE_TRACE_POLICY;
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_TRACE_H
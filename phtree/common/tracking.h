@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_COMMON_TRACKING_H
+#define PHTREE_COMMON_TRACKING_H
+
+/*
+ * PLEASE do not include this file directly, it is included via common.h.
+ *
+ * This file defines compile-time switches for modification tracking. Tracking requires additional
+ * fields in every node and additional work in every modification, so it is only compiled if the
+ * corresponding macro is defined before including any PH-Tree header. The macros must be defined
+ * (or not) consistently for all translation units of a program.
+ *
+ * PHTREE_HASH_TRACKING enables cached node hashes (16 bytes per node), see
+ * PhTree::set_hash_tracking(). Without it, hash() and diff() work but recalculate all hashes on
+ * every call and set_hash_tracking() does not compile. hash() and diff() update the cached hashes,
+ * so they are not 'const' and must not run concurrently with any other method of the tree.
+ *
+ * PHTREE_GENERATION_TRACKING enables node generations (16 bytes per node), see
+ * PhTree::set_generation_tracking(). They are required for for_each_dirty_node().
+ * Without it, set_generation_tracking() and for_each_dirty_node() do not compile.
+ */
+namespace improbable::phtree {
+
+#if defined(PHTREE_HASH_TRACKING)
+static constexpr bool HASH_TRACKING_ENABLED = true;
+#else
+static constexpr bool HASH_TRACKING_ENABLED = false;
+#endif
+
+#if defined(PHTREE_GENERATION_TRACKING)
+static constexpr bool GENERATION_TRACKING_ENABLED = true;
+#else
+static constexpr bool GENERATION_TRACKING_ENABLED = false;
+#endif
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_TRACKING_H
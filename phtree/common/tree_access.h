@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_COMMON_TREE_ACCESS_H
+#define PHTREE_COMMON_TREE_ACCESS_H
+
+namespace improbable::phtree {
+
+/*
+ * Gives the free functions of opt-in headers, such as phtree_frozen.h or phtree_serialization.h,
+ * access to the internals of the trees. This keeps the tree classes free of the includes and
+ * member functions of features that most users do not need.
+ *
+ * PLEASE do not use this class in application code.
+ */
+struct PhTreeAccess {
+    // The internal tree of PhTree and PhTreeMultiMap.
+    template <typename TREE>
+    static auto& GetInternalTree(TREE& tree) {
+        return tree.tree_;
+    }
+
+    // The converter of PhTree and PhTreeMultiMap.
+    template <typename TREE>
+    static auto& GetConverter(TREE& tree) {
+        return tree.converter_;
+    }
+
+    // The root entry of PhTreeV16.
+    template <typename TREE>
+    static auto& GetRoot(TREE& tree) {
+        return tree.root_;
+    }
+
+    // The number of entries of PhTreeV16.
+    template <typename TREE>
+    static auto& GetNumEntries(TREE& tree) {
+        return tree.num_entries_;
+    }
+
+    // The number of values of PhTreeMultiMap.
+    template <typename TREE>
+    static auto& GetSize(TREE& tree) {
+        return tree.size_;
+    }
+};
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_COMMON_TREE_ACCESS_H
@@ -18,7 +18,9 @@
 #define PHTREE_COMMON_TREE_STATS_H
 
 #include "base_types.h"
+#include <set>
 #include <sstream>
+#include <unordered_set>
 #include <vector>
 
 /*
@@ -29,6 +31,48 @@
  */
 namespace improbable::phtree {
 
+/*
+ * Default for the value size function of PhTreeDebugHelper::GetStats(): values do not own any
+ * heap memory.
+ */
+struct ValueHeapSizeNoOp {
+    template <typename T>
+    [[nodiscard]] size_t operator()(const T&) const noexcept {
+        return 0;
+    }
+};
+
+/*
+ * Default for the value size function of PhTreeDebugHelper::GetStats(): counts the storage of
+ * std::unordered_set, std::set and std::vector values, such as the buckets of PhTreeMultiMap.
+ * Heap memory that is owned by the elements of these containers is not counted. Other values
+ * do not own any heap memory.
+ */
+struct ValueHeapSizeDefault {
+    template <typename T>
+    [[nodiscard]] size_t operator()(const T&) const noexcept {
+        return 0;
+    }
+
+    template <typename T, typename... Args>
+    [[nodiscard]] size_t operator()(const std::unordered_set<T, Args...>& set) const noexcept {
+        // Every element is allocated in a node with a next pointer and, usually, the hash code.
+        return set.bucket_count() * sizeof(void*) +
+            set.size() * (sizeof(T) + sizeof(void*) + sizeof(size_t));
+    }
+
+    template <typename T, typename... Args>
+    [[nodiscard]] size_t operator()(const std::set<T, Args...>& set) const noexcept {
+        // Every element is allocated in a tree node with a color and three pointers.
+        return set.size() * (sizeof(T) + 4 * sizeof(void*));
+    }
+
+    template <typename T, typename... Args>
+    [[nodiscard]] size_t operator()(const std::vector<T, Args...>& vector) const noexcept {
+        return vector.capacity() * sizeof(T);
+    }
+};
+
 class PhTreeStats {
     using SCALAR = scalar_64_t;
 
@@ -36,8 +80,13 @@ class PhTreeStats {
     std::string ToString() {
         std::ostringstream s;
         s << "  nNodes = " << std::to_string(n_nodes_) << std::endl;
+        s << "  nEntries = " << std::to_string(n_entries_) << std::endl;
         s << "  avgNodeDepth = " << ((double)q_total_depth_ / (double)n_nodes_) << std::endl;
         s << "  AHC=" << n_AHC_ << "  NI=" << n_nt_ << "  nNtNodes_=" << n_nt_nodes_ << std::endl;
+        s << "  memory = " << mem_size_ << " bytes (nodes = " << node_size_
+          << ", entry containers = " << entry_container_size_
+          << ", value heap = " << value_heap_size_ << ")" << std::endl;
+        s << "  bytes/entry = " << GetBytesPerEntry() << std::endl;
         double apl = GetAvgPostlen();
         s << "  avgPostLen = " << apl << " (" << (MAX_BIT_WIDTH<SCALAR> - apl) << ")" << std::endl;
         return s.str();
@@ -56,10 +105,41 @@ class PhTreeStats {
         return s.str();
     }
 
+    /*
+     * @return the statistics as JSON object, including all histograms. Histograms are arrays that
+     * are indexed by depth (in bits), infix length or log2(number of entries) respectively.
+     */
+    [[nodiscard]] std::string ToJson() const {
+        std::ostringstream s;
+        s << "{";
+        s << "\"n_nodes\":" << n_nodes_ << ",";
+        s << "\"n_entries\":" << n_entries_ << ",";
+        s << "\"n_total_children\":" << n_total_children_ << ",";
+        s << "\"avg_node_depth\":" << Divide(q_total_depth_, n_nodes_) << ",";
+        s << "\"avg_node_fanout\":" << Divide(n_total_children_, n_nodes_) << ",";
+        s << "\"avg_postfix_len\":" << (n_entries_ == 0 ? 0. : GetAvgPostlen()) << ",";
+        s << "\"memory\":{";
+        s << "\"total_bytes\":" << mem_size_ << ",";
+        s << "\"node_bytes\":" << node_size_ << ",";
+        s << "\"entry_container_bytes\":" << entry_container_size_ << ",";
+        s << "\"value_heap_bytes\":" << value_heap_size_ << ",";
+        s << "\"bytes_per_entry\":" << Divide(mem_size_, n_entries_) << "},";
+        s << "\"hist_nodes_per_depth\":";
+        to_json(s, node_depth_hist_) << ",";
+        s << "\"hist_entries_per_depth\":";
+        to_json(s, q_n_post_fix_n_) << ",";
+        s << "\"hist_infix_len\":";
+        to_json(s, infix_hist_) << ",";
+        s << "\"hist_node_size_log2\":";
+        to_json(s, node_size_log_hist_);
+        s << "}";
+        return s.str();
+    }
+
     /*
      * @return average postfix_len, including the HC/LHC bit.
      */
-    double GetAvgPostlen() {
+    double GetAvgPostlen() const {
         size_t total = 0;
         size_t num_entry = 0;
         for (bit_width_t i = 0; i < MAX_BIT_WIDTH<SCALAR>; ++i) {
@@ -73,11 +153,35 @@ class PhTreeStats {
         return n_nodes_;
     }
 
+    size_t GetEntryCount() {
+        return n_entries_;
+    }
+
+    /*
+     * @return the calculated memory size of the tree in bytes, see mem_size_.
+     */
     size_t GetCalculatedMemSize() {
-        return size_;
+        return mem_size_;
+    }
+
+    double GetBytesPerEntry() {
+        return Divide(mem_size_, n_entries_);
     }
 
   private:
+    static double Divide(size_t a, size_t b) {
+        return b == 0 ? 0. : (double)a / (double)b;
+    }
+
+    static std::ostringstream& to_json(std::ostringstream& s, const std::vector<size_t>& data) {
+        s << "[";
+        for (size_t i = 0; i < data.size(); ++i) {
+            s << (i == 0 ? "" : ",") << data[i];
+        }
+        s << "]";
+        return s;
+    }
+
     static std::ostringstream& to_string(std::ostringstream& s, std::vector<size_t>& data) {
         s << "[";
         for (size_t x : data) {
@@ -92,8 +196,18 @@ class PhTreeStats {
     size_t n_AHC_ = 0;       // AHC nodes (formerly Nodes with AHC-postfix representation)
     size_t n_nt_nodes_ = 0;  // NtNodes (formerly Nodes with sub-HC representation)
     size_t n_nt_ = 0;        // nodes with NT representation
+    size_t n_entries_ = 0;   // number of key/value entries
     size_t n_total_children_ = 0;
-    size_t size_ = 0;  // calculated size in bytes
+    // Deprecated, use n_entries_. The number of entries, will be removed in the next release.
+    size_t size_ = 0;
+    // Calculated memory size in bytes: node_size_ + entry_container_size_ + value_heap_size_.
+    size_t mem_size_ = 0;
+    // Node objects, including entries that are stored inline, e.g. in array_map.
+    size_t node_size_ = 0;
+    // Heap memory of the entry containers, i.e. vectors for sparse_map and tree nodes for std::map.
+    size_t entry_container_size_ = 0;
+    // Heap memory owned by values, as reported by the value size function.
+    size_t value_heap_size_ = 0;
     size_t q_total_depth_ = 0;
     std::vector<size_t> q_n_post_fix_n_ =
         std::vector(MAX_BIT_WIDTH<SCALAR>, (size_t)0);  // filled with  x[current_depth] = nPost;
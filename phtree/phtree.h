@@ -18,6 +18,7 @@
 #define PHTREE_PHTREE_H
 
 #include "common/common.h"
+#include "phtree_listener.h"
 #include "v16/phtree_v16.h"
 
 namespace improbable::phtree {
@@ -32,6 +33,7 @@ namespace improbable::phtree {
 template <dimension_t DIM, typename T, typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>>
 class PhTree {
     friend PhTreeDebugHelper;
+    friend PhTreeAccess;
     using KeyInternal = typename CONVERTER::KeyInternal;
     using QueryBox = typename CONVERTER::QueryBoxExternal;
     using Key = typename CONVERTER::KeyExternal;
@@ -60,7 +62,9 @@ class PhTree {
      */
     template <typename... Args>
     std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
-        return tree_.emplace(converter_.pre(key), std::forward<Args>(args)...);
+        auto result = tree_.emplace(converter_.pre(key), std::forward<Args>(args)...);
+        NotifyEmplace(key, result);
+        return result;
     }
 
     /*
@@ -80,7 +84,10 @@ class PhTree {
      */
     template <typename ITERATOR, typename... Args>
     std::pair<T&, bool> emplace_hint(const ITERATOR& iterator, const Key& key, Args&&... args) {
-        return tree_.emplace_hint(iterator, converter_.pre(key), std::forward<Args>(args)...);
+        auto result =
+            tree_.emplace_hint(iterator, converter_.pre(key), std::forward<Args>(args)...);
+        NotifyEmplace(key, result);
+        return result;
     }
 
     /*
@@ -90,15 +97,49 @@ class PhTree {
      * insertion) and a bool denoting whether the insertion took place.
      */
     std::pair<T&, bool> insert(const Key& key, const T& value) {
-        return tree_.insert(converter_.pre(key), value);
+        return emplace(key, value);
+    }
+
+    /*
+     * See std::map::insert_or_assign(). Inserts 'value' or, if an entry with the same key exists,
+     * assigns 'value' to the existing entry.
+     *
+     * Unlike assignments via operator[], assignments via insert_or_assign() are reported to the
+     * listener, see set_listener().
+     *
+     * @return a pair consisting of the inserted or updated element and a bool that is 'true' if
+     * the insertion took place and 'false' if the assignment took place.
+     */
+    template <typename M>
+    std::pair<T&, bool> insert_or_assign(const Key& key, M&& value) {
+        // emplace() does not consume 'value' if the key exists.
+        auto result = tree_.emplace(converter_.pre(key), std::forward<M>(value));
+        if (result.second) {
+            NotifyEmplace(key, result);
+        } else {
+            result.first = std::forward<M>(value);
+            tree_.mark_modified(converter_.pre(key));
+            if (listener_ != nullptr) {
+                listener_->OnUpdate(key, result.first);
+            }
+        }
+        return result;
     }
 
     /*
      * @return the value stored at position 'key'. If no such value exists, one is added to the tree
      * and returned.
+     *
+     * NOTE: A listener is only notified of the insertion of the default-constructed value, not of
+     * assignments to the returned reference. Use insert_or_assign() if the tree has a listener.
      */
     T& operator[](const Key& key) {
-        return tree_[converter_.pre(key)];
+        auto result = emplace(key);
+        if (!result.second) {
+            // The returned value may be modified
+            tree_.mark_modified(converter_.pre(key));
+        }
+        return result.first;
     }
 
     /*
@@ -128,6 +169,14 @@ class PhTree {
      * @return '1' if a value was found, otherwise '0'.
      */
     size_t erase(const Key& key) {
+        if (listener_ != nullptr) {
+            auto iter = tree_.find(converter_.pre(key));
+            if (iter == tree_.end()) {
+                return 0;
+            }
+            listener_->OnErase(key, *iter);
+            return tree_.erase(iter);
+        }
         return tree_.erase(converter_.pre(key));
     }
 
@@ -144,6 +193,9 @@ class PhTree {
      */
     template <typename ITERATOR>
     size_t erase(const ITERATOR& iterator) {
+        if (listener_ != nullptr && iterator != end()) {
+            listener_->OnErase(iterator.first(), *iterator);
+        }
         return tree_.erase(iterator);
     }
 
@@ -157,10 +209,14 @@ class PhTree {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h.
      */
     template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
-    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) const {
-        tree_.for_each(callback, filter);
+    void for_each(
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
+        tree_.for_each(callback, filter, stats);
     }
 
     /*
@@ -173,6 +229,7 @@ class PhTree {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h.
      */
     template <
         typename CALLBACK_FN,
@@ -182,8 +239,9 @@ class PhTree {
         QueryBox query_box,
         CALLBACK_FN& callback,
         FILTER filter = FILTER(),
-        QUERY_TYPE query_type = QUERY_TYPE()) const {
-        tree_.for_each(query_type(converter_.pre_query(query_box)), callback, filter);
+        QUERY_TYPE query_type = QUERY_TYPE(),
+        PhTreeQueryStats* stats = nullptr) const {
+        tree_.for_each(query_type(converter_.pre_query(query_box)), callback, filter, stats);
     }
 
     /*
@@ -191,11 +249,12 @@ class PhTree {
      * (=sub-trees) before returning / traversing them. By default all entries are returned. Filter
      * functions must implement the same signature as the default 'FilterNoOp'.
      *
+     * @param stats Optional statistics of the query, see begin_query().
      * @return an iterator over all (filtered) entries in the tree,
      */
     template <typename FILTER = FilterNoOp>
-    auto begin(FILTER filter = FILTER()) const {
-        return tree_.begin(filter);
+    auto begin(FILTER filter = FILTER(), PhTreeQueryStats* stats = nullptr) const {
+        return tree_.begin(filter, stats);
     }
 
     /*
@@ -206,14 +265,17 @@ class PhTree {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h. The iterator keeps the
+     * pointer, so 'stats' must outlive it.
      * @return Result iterator.
      */
     template <typename FILTER = FilterNoOp, typename QUERY_TYPE = DEFAULT_QUERY_TYPE>
     auto begin_query(
         const QueryBox& query_box,
         FILTER filter = FILTER(),
-        QUERY_TYPE query_type = DEFAULT_QUERY_TYPE()) const {
-        return tree_.begin_query(query_type(converter_.pre_query(query_box)), filter);
+        QUERY_TYPE query_type = DEFAULT_QUERY_TYPE(),
+        PhTreeQueryStats* stats = nullptr) const {
+        return tree_.begin_query(query_type(converter_.pre_query(query_box)), filter, stats);
     }
 
     /*
@@ -227,6 +289,7 @@ class PhTree {
      * @param distance_function optional distance function, defaults to euclidean distance
      * @param filter optional filter predicate that excludes nodes/entries before their distance is
      * calculated.
+     * @param stats Optional statistics of the query, see begin_query().
      * @return Result iterator.
      */
     template <
@@ -239,11 +302,12 @@ class PhTree {
         size_t min_results,
         const Key& center,
         DISTANCE distance_function = DISTANCE(),
-        FILTER filter = FILTER()) const {
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         // We use pre() instead of pre_query() here because, strictly speaking, we want to
         // find the nearest neighbors of a (fictional) key, which may as well be a box.
         return tree_.begin_knn_query(
-            min_results, converter_.pre(center), distance_function, filter);
+            min_results, converter_.pre(center), distance_function, filter, stats);
     }
 
     /*
@@ -253,10 +317,37 @@ class PhTree {
         return tree_.end();
     }
 
+    /*
+     * Relocates all nodes of the tree to new memory in depth-first (z-order) order. After many
+     * modifications the nodes of a tree are scattered across the heap, which makes queries slower
+     * than on a freshly built tree. Nodes are allocated in the order in which queries traverse
+     * them, so nodes that are close in space tend to be close in memory afterwards. Entries and
+     * values are moved with their nodes, the content of the tree does not change.
+     *
+     * Compaction can be done incrementally by calling compact() repeatedly with a limited number
+     * of nodes, e.g. once per frame, until it returns 'true'. The tree can be modified between
+     * calls.
+     *
+     * NOTE: compact() invalidates all iterators and all references to values in the tree.
+     * NOTE: There is no arena or custom allocator, new nodes are allocated with the default
+     * allocator. The old node of a subtree is deleted when the whole subtree has been relocated.
+     * At any time (also between incremental calls) at most one old node per tree level is kept,
+     * i.e. the memory overhead is bounded by 64 nodes (or the bit width of the scalar).
+     *
+     * @param max_nodes The maximum number of nodes to relocate in this call.
+     * @return 'true' if compaction is complete, 'false' if compact() needs to be called again.
+     */
+    bool compact(size_t max_nodes = std::numeric_limits<size_t>::max()) {
+        return tree_.compact(max_nodes);
+    }
+
     /*
      * Remove all entries from the tree.
      */
     void clear() {
+        if (listener_ != nullptr) {
+            listener_->OnClear();
+        }
         tree_.clear();
     }
 
@@ -281,14 +372,90 @@ class PhTree {
         return converter_;
     }
 
+    /*
+     * Enables or disables incremental hash tracking, see hash() and diff() in phtree_diff.h.
+     * With hash tracking, every modification invalidates the cached hashes of the nodes on the path
+     * to the modified entry. Without hash tracking, hash() and diff() recalculate all hashes.
+     *
+     * NOTE: Hash tracking requires PHTREE_HASH_TRACKING, see tracking.h. Without it, calls of
+     * set_hash_tracking() do not compile.
+     *
+     * NOTE: Modifications of values via iterators or via references returned by emplace() or
+     * find() are not detected. Assignments such as 'tree[key] = value' are detected because
+     * operator[] marks the path to the entry before returning the reference. Listeners do not see
+     * these assignments, see set_listener().
+     */
+    void set_hash_tracking(bool enabled) {
+        tree_.set_hash_tracking(enabled);
+    }
+
+    /*
+     * Calculates a hash of all entries (keys and values) in the tree. Trees with the same entries
+     * have the same hash, independent of the order of insertion.
+     *
+     * NOTE: hash() updates the cached node hashes, so it is not 'const'. Like modifications, it
+     * must not be called concurrently with any other method of the tree, see also diff().
+     *
+     * @param hash_fn The hash function for values.
+     */
+    template <typename HASH = std::hash<T>>
+    [[nodiscard]] std::uint64_t hash(const HASH& hash_fn = HASH()) {
+        return tree_.hash(hash_fn);
+    }
+
+    /*
+     * Enables or disables generation tracking, see for_each_dirty_node() in
+     * phtree_dirty_regions.h.
+     * With generation tracking, every modification increments the generation of the tree and marks
+     * the nodes on the path to the modified entry with the new generation.
+     *
+     * NOTE: Generation tracking requires PHTREE_GENERATION_TRACKING, see tracking.h. Without it,
+     * calls of set_generation_tracking() do not compile.
+     *
+     * NOTE: Modifications of values via iterators or via references returned by emplace() or
+     * find() are not detected. Assignments such as 'tree[key] = value' are detected because
+     * operator[] marks the path to the entry before returning the reference. Listeners do not see
+     * these assignments, see set_listener().
+     */
+    void set_generation_tracking(bool enabled) {
+        tree_.set_generation_tracking(enabled);
+    }
+
+    /*
+     * @return the generation of the latest modification, see set_generation_tracking().
+     */
+    [[nodiscard]] std::uint64_t generation() const {
+        return tree_.generation();
+    }
+
+    /*
+     * Sets a listener that is notified of all modifications of the tree, see PhTreeListener.
+     * The tree does not take ownership of the listener. A tree has only one listener, a new
+     * listener replaces the previous one. Use PhTreeListenerFanOut to attach multiple listeners.
+     *
+     * NOTE: Assignments to values returned by operator[] are not reported, use insert_or_assign().
+     *
+     * @param listener The listener or 'nullptr' to remove the current listener.
+     */
+    void set_listener(PhTreeListener<Key, T>* listener) {
+        listener_ = listener;
+    }
+
   private:
     // This is used by PhTreeDebugHelper
     const auto& GetInternalTree() const {
         return tree_;
     }
 
+    void NotifyEmplace(const Key& key, const std::pair<T&, bool>& result) {
+        if (listener_ != nullptr && result.second) {
+            listener_->OnEmplace(key, result.first);
+        }
+    }
+
     v16::PhTreeV16<DimInternal, T, CONVERTER> tree_;
     CONVERTER converter_;
+    PhTreeListener<Key, T>* listener_ = nullptr;
 };
 
 /*
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_PHTREE_CHANGE_LOG_H
+#define PHTREE_PHTREE_CHANGE_LOG_H
+
+#include "phtree_listener.h"
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace improbable::phtree {
+
+/*
+ * A modification that was recorded by a PhTreeChangeLog.
+ *
+ * 'key_' is the key of the inserted or removed entry. For RELOCATE, 'key_' is the old key and
+ * 'new_key_' is the new key. CLEAR has neither keys nor a value.
+ */
+template <typename KEY, typename T>
+struct PhTreeChange {
+    PhTreeOperation op_;
+    std::uint64_t version_;
+    KEY key_;
+    KEY new_key_;
+    T value_;
+};
+
+/*
+ * Change data capture for PhTree and PhTreeMultiMap, see PhTree::set_listener().
+ *
+ * The change log records all modifications of a tree in a ring buffer with a fixed capacity.
+ * Every change gets a version number, starting with 1. Consumers remember the last version
+ * they have seen and use changes_since() to process all newer changes, e.g. once per tick:
+ *
+ * PhTreeChangeLog<PhPointD<3>, Id> changes{10000};
+ * tree.set_listener(&changes);
+ * ...
+ * bool ok = changes.changes_since(last_seen, [](const PhTreeChange<PhPointD<3>, Id>& change) {
+ *     ...
+ * });
+ * last_seen = changes.version();
+ *
+ * If the consumer falls behind by more than 'capacity' changes, changes_since() returns 'false'
+ * and the consumer has to resynchronize, e.g. with a full query.
+ *
+ * Values are copied into the log, so the value type should be small (IDs or pointers).
+ * The change log is not thread-safe.
+ */
+template <typename KEY, typename T>
+class PhTreeChangeLog : public PhTreeListener<KEY, T> {
+  public:
+    using ChangeT = PhTreeChange<KEY, T>;
+
+    explicit PhTreeChangeLog(size_t capacity) : capacity_{capacity}, version_{0}, head_{0} {
+        assert(capacity > 0);
+        changes_.reserve(capacity);
+    }
+
+    void OnEmplace(const KEY& key, const T& value) override {
+        Record(PhTreeOperation::EMPLACE, key, key, value);
+    }
+
+    void OnErase(const KEY& key, const T& value) override {
+        Record(PhTreeOperation::ERASE, key, key, value);
+    }
+
+    void OnRelocate(const KEY& old_key, const KEY& new_key, const T& value) override {
+        Record(PhTreeOperation::RELOCATE, old_key, new_key, value);
+    }
+
+    void OnUpdate(const KEY& key, const T& value) override {
+        Record(PhTreeOperation::UPDATE, key, key, value);
+    }
+
+    void OnClear() override {
+        Record(PhTreeOperation::CLEAR, KEY{}, KEY{}, T{});
+    }
+
+    /*
+     * Calls the callback for every change with a version larger than 'version', in the order in
+     * which the changes occurred.
+     * The callback requires the following signature: callback(const PhTreeChange<KEY, T>&)
+     *
+     * @return 'false' if some of the requested changes have already been overwritten. In this case
+     * the callback is not called.
+     */
+    template <typename CALLBACK_FN>
+    bool changes_since(std::uint64_t version, CALLBACK_FN&& callback) const {
+        if (version >= version_) {
+            return true;
+        }
+        if (version + 1 < oldest_version()) {
+            return false;
+        }
+        // 'head_' is the position after the latest change.
+        size_t pos = (head_ + capacity_ - (version_ - version)) % capacity_;
+        for (auto v = version + 1; v <= version_; ++v) {
+            callback(changes_[pos]);
+            pos = (pos + 1) % capacity_;
+        }
+        return true;
+    }
+
+    /*
+     * @return the version of the latest change or '0' if nothing has been recorded yet.
+     */
+    [[nodiscard]] std::uint64_t version() const {
+        return version_;
+    }
+
+    /*
+     * @return the version of the oldest change that is still available or 'version() + 1' if the
+     * log is empty.
+     */
+    [[nodiscard]] std::uint64_t oldest_version() const {
+        return version_ + 1 - changes_.size();
+    }
+
+    /*
+     * @return the number of changes that are available.
+     */
+    [[nodiscard]] size_t size() const {
+        return changes_.size();
+    }
+
+    /*
+     * Removes all recorded changes. Version numbers are not reset, so consumers that are behind
+     * will see 'false' from changes_since().
+     */
+    void clear() {
+        changes_.clear();
+        head_ = 0;
+    }
+
+  private:
+    void Record(PhTreeOperation op, const KEY& key, const KEY& new_key, const T& value) {
+        ++version_;
+        if (changes_.size() < capacity_) {
+            changes_.push_back(ChangeT{op, version_, key, new_key, value});
+        } else {
+            changes_[head_] = ChangeT{op, version_, key, new_key, value};
+        }
+        head_ = (head_ + 1) % capacity_;
+    }
+
+    const size_t capacity_;
+    std::uint64_t version_;
+    size_t head_;
+    std::vector<ChangeT> changes_;
+};
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_CHANGE_LOG_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_DIFF_H
+#define PHTREE_PHTREE_DIFF_H
+
+#include "common/common.h"
+#include "phtree.h"
+#include "v16/diff.h"
+
+namespace improbable::phtree {
+
+/*
+ * Reports all entries that differ between two trees, for example to synchronize replicas.
+ *
+ * Both trees are traversed in parallel, subtrees with equal hashes are skipped (see
+ * PhTree::hash()). With hash tracking enabled in both trees (see PhTree::set_hash_tracking()),
+ * the cost is proportional to the number of differences rather than to the size of the trees.
+ *
+ * The callback requires the following signature:
+ * callback(const Key& key, const T* value_a, const T* value_b)
+ * 'value_b' is 'nullptr' if the key exists only in tree_a, 'value_a' is 'nullptr' if the key
+ * exists only in tree_b. If both values are set, their hashes are different.
+ *
+ * NOTE: This updates the cached node hashes of both trees, see PhTree::hash(). It must not be
+ * called concurrently with any other method of either tree.
+ *
+ * @param hash_fn The hash function for values.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename CALLBACK_FN,
+    typename HASH = std::hash<T>>
+void diff(
+    PhTree<DIM, T, CONVERTER>& tree_a,
+    PhTree<DIM, T, CONVERTER>& tree_b,
+    CALLBACK_FN&& callback,
+    const HASH& hash_fn = HASH()) {
+    v16::diff(
+        PhTreeAccess::GetInternalTree(tree_a),
+        PhTreeAccess::GetInternalTree(tree_b),
+        callback,
+        hash_fn);
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_DIFF_H
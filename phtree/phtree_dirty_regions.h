@@ -0,0 +1,95 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_DIRTY_REGIONS_H
+#define PHTREE_PHTREE_DIRTY_REGIONS_H
+
+#include "common/common.h"
+#include "phtree.h"
+#include "v16/for_each_dirty.h"
+
+namespace improbable::phtree {
+
+namespace detail {
+
+// Converts the internal region of a node into an external box. For box keys, the region is
+// the box that contains all boxes that can be stored in the node.
+template <dimension_t DIM, typename CONVERTER>
+typename CONVERTER::QueryBoxExternal ToRegion(
+    const CONVERTER& converter,
+    const typename CONVERTER::KeyInternal& min,
+    const typename CONVERTER::KeyInternal& max) {
+    auto [region_min, region_max] = [&]() {
+        if constexpr (DIM == CONVERTER::DimInternal) {
+            return std::make_pair(converter.post(min), converter.post(max));
+        } else {
+            return std::make_pair(converter.post(min).min(), converter.post(max).max());
+        }
+    }();
+    using ScalarExternal = std::decay_t<decltype(region_min[0])>;
+    if constexpr (std::is_floating_point_v<ScalarExternal>) {
+        // Bit patterns at the edges of the internal range are NaN
+        for (dimension_t i = 0; i < DIM; ++i) {
+            if (std::isnan(region_min[i])) {
+                region_min[i] = -std::numeric_limits<ScalarExternal>::infinity();
+            }
+            if (std::isnan(region_max[i])) {
+                region_max[i] = std::numeric_limits<ScalarExternal>::infinity();
+            }
+        }
+    }
+    return typename CONVERTER::QueryBoxExternal{region_min, region_max};
+}
+
+}  // namespace detail
+
+/*
+ * Reports the regions of all nodes that were modified after 'since_generation', see
+ * PhTree::set_generation_tracking(). This allows consumers to reprocess only the regions of the
+ * tree that have changed, e.g.:
+ *
+ * for_each_dirty_node(tree, last_generation, 4, [](const PhBoxD<3>& region) { ... });
+ * last_generation = tree.generation();
+ *
+ * Regions do not overlap. A node is reported as a whole if its own entries were modified or
+ * if it is at depth 'max_depth' (the root node has depth 0), otherwise only its modified
+ * child nodes are traversed. A smaller 'max_depth' results in fewer but larger regions.
+ * Regions of nodes close to the root may be unbounded, e.g. +/-infinity for floating point
+ * coordinates.
+ *
+ * NOTE: This requires PHTREE_GENERATION_TRACKING, see tracking.h.
+ *
+ * The callback requires the following signature: callback(const QueryBox& region)
+ */
+template <dimension_t DIM, typename T, typename CONVERTER, typename CALLBACK_FN>
+void for_each_dirty_node(
+    const PhTree<DIM, T, CONVERTER>& tree,
+    std::uint64_t since_generation,
+    size_t max_depth,
+    CALLBACK_FN&& callback) {
+    const auto& converter = PhTreeAccess::GetConverter(tree);
+    using KeyInternal = typename CONVERTER::KeyInternal;
+    auto region_callback = [&converter, &callback](
+                               const KeyInternal& min, const KeyInternal& max) {
+        callback(detail::ToRegion<DIM>(converter, min, max));
+    };
+    v16::for_each_dirty_node(
+        PhTreeAccess::GetInternalTree(tree), since_generation, max_depth, region_callback);
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_DIRTY_REGIONS_H
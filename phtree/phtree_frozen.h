@@ -0,0 +1,277 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_FROZEN_H
+#define PHTREE_PHTREE_FROZEN_H
+
+#include "common/common.h"
+#include "phtree.h"
+#include "v16/phtree_frozen_v16.h"
+
+namespace improbable::phtree {
+
+/*
+ * Read-only PH-Tree that is backed by a frozen image. Frozen images are created with freeze()
+ * (in memory) or with write_frozen() (for files or other memory), see below.
+ *
+ * The image is not deserialized, all queries operate directly on the bytes of the image. Files are
+ * opened with PhTreeFrozenFile, see phtree_frozen_file.h. It is not included here because memory
+ * mapping requires OS headers.
+ *
+ * The query API is the same as in PhTree, except that values are returned as const references.
+ * Keys are stored in their internal representation, so the tree must use the same converter that
+ * was used by the tree that wrote the image.
+ *
+ * For more information please refer to the README of this project.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>>
+class PhTreeFrozen {
+    template <dimension_t DIM2, typename T2, typename CONVERTER2>
+    friend PhTreeFrozen<DIM2, T2, CONVERTER2> freeze(const PhTree<DIM2, T2, CONVERTER2>&);
+    using KeyInternal = typename CONVERTER::KeyInternal;
+    using QueryBox = typename CONVERTER::QueryBoxExternal;
+    using Key = typename CONVERTER::KeyExternal;
+    static constexpr dimension_t DimInternal = CONVERTER::DimInternal;
+    using ImageT = v16::FrozenImageV16<DimInternal, T, typename CONVERTER::ScalarInternal>;
+
+    // DimInternal==DIM indicates point keys. Box keys have DimInternal==2*DIM.
+    using DEFAULT_QUERY_TYPE =
+        typename std::conditional<(DIM == DimInternal), QueryPoint, QueryIntersect>::type;
+
+  public:
+    explicit PhTreeFrozen(CONVERTER converter = CONVERTER())
+    : tree_{converter}, converter_{converter} {}
+
+    // Copies would point to the image of the original tree.
+    PhTreeFrozen(const PhTreeFrozen&) = delete;
+    PhTreeFrozen& operator=(const PhTreeFrozen&) = delete;
+    PhTreeFrozen(PhTreeFrozen&&) = default;
+    PhTreeFrozen& operator=(PhTreeFrozen&&) = default;
+    ~PhTreeFrozen() = default;
+
+    /*
+     * Uses an image that is provided by the caller, for example in shared memory. The memory must
+     * be aligned to 64 bytes and must remain valid and unmodified until the tree is closed.
+     *
+     * The structure of the image is validated, i.e. this reads all nodes once, see
+     * v16::FrozenDataV16::IsValidTree().
+     *
+     * @return 'false' if the memory does not contain a valid image for this type of tree. In this
+     * case the tree is empty.
+     */
+    bool attach(const char* data, size_t size) {
+        close();
+        return tree_.attach(data, size);
+    }
+
+    /*
+     * Closes the image, the tree is empty afterwards.
+     */
+    void close() {
+        tree_.detach();
+        image_ = ImageT();
+    }
+
+    /*
+     * Analogous to map:count().
+     *
+     * @return '1', if a value is associated with the provided key, otherwise '0'.
+     */
+    size_t count(const Key& key) const {
+        return tree_.count(converter_.pre(key));
+    }
+
+    /*
+     * Analogous to map:find().
+     *
+     * @return an iterator that points either to the associated value or to end().
+     */
+    auto find(const Key& key) const {
+        return tree_.find(converter_.pre(key));
+    }
+
+    /*
+     * Iterates over all entries in the tree, see PhTree::for_each().
+     * The callback requires the following signature: callback(const Key &, const T &)
+     */
+    template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
+    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) const {
+        tree_.for_each(callback, filter);
+    }
+
+    /*
+     * Performs a rectangular window query, see PhTree::for_each().
+     * The callback requires the following signature: callback(const Key &, const T &)
+     */
+    template <
+        typename CALLBACK_FN,
+        typename FILTER = FilterNoOp,
+        typename QUERY_TYPE = DEFAULT_QUERY_TYPE>
+    void for_each(
+        QueryBox query_box,
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER(),
+        QUERY_TYPE query_type = QUERY_TYPE()) const {
+        tree_.for_each(query_type(converter_.pre_query(query_box)), callback, filter);
+    }
+
+    /*
+     * @return an iterator over all (filtered) entries in the tree.
+     */
+    template <typename FILTER = FilterNoOp>
+    auto begin(FILTER filter = FILTER()) const {
+        return tree_.begin(filter);
+    }
+
+    /*
+     * Performs a rectangular window query, see PhTree::begin_query().
+     */
+    template <typename FILTER = FilterNoOp, typename QUERY_TYPE = DEFAULT_QUERY_TYPE>
+    auto begin_query(
+        const QueryBox& query_box,
+        FILTER filter = FILTER(),
+        QUERY_TYPE query_type = DEFAULT_QUERY_TYPE()) const {
+        return tree_.begin_query(query_type(converter_.pre_query(query_box)), filter);
+    }
+
+    /*
+     * Locate nearest neighbors for a given point in space, see PhTree::begin_knn_query().
+     *
+     * NOTE: This method is not (currently) available for box keys.
+     */
+    template <
+        typename DISTANCE,
+        typename FILTER = FilterNoOp,
+        // Some magic to disable this in case of box keys, i.e. if DIM != DimInternal
+        dimension_t DUMMY = DIM,
+        typename std::enable_if<(DUMMY == DimInternal), int>::type = 0>
+    auto begin_knn_query(
+        size_t min_results,
+        const Key& center,
+        DISTANCE distance_function = DISTANCE(),
+        FILTER filter = FILTER()) const {
+        return tree_.begin_knn_query(
+            min_results, converter_.pre(center), distance_function, filter);
+    }
+
+    /*
+     * @return An iterator representing the tree's 'end'.
+     */
+    auto end() const {
+        return tree_.end();
+    }
+
+    /*
+     * @return the number of entries (key/value pairs) in the tree.
+     */
+    [[nodiscard]] size_t size() const {
+        return tree_.size();
+    }
+
+    /*
+     * @return 'true' if the tree is empty, otherwise 'false'.
+     */
+    [[nodiscard]] bool empty() const {
+        return tree_.empty();
+    }
+
+    /*
+     * @return the converter associated with this tree.
+     */
+    [[nodiscard]] const CONVERTER& converter() const {
+        return converter_;
+    }
+
+    /*
+     * @return The number of bytes that are allocated by a tree that was created with freeze().
+     */
+    [[nodiscard]] size_t memory_size() const {
+        return image_.GetMemorySize();
+    }
+
+  private:
+    // This is used by freeze()
+    PhTreeFrozen(ImageT&& image, CONVERTER converter)
+    : tree_{converter}, converter_{converter}, image_{std::move(image)} {
+        bool success = tree_.attach(image_.data(), image_.size(), image_.values());
+        assert(success);
+        (void)success;
+    }
+
+    v16::PhTreeFrozenV16<DimInternal, T, CONVERTER> tree_;
+    CONVERTER converter_;
+    ImageT image_;
+};
+
+/*
+ * Floating-point `double` version of the frozen PH-Tree, see PhTreeD.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterIEEE<DIM>>
+using PhTreeFrozenD = PhTreeFrozen<DIM, T, CONVERTER>;
+
+/*
+ * Floating-point `float` version of the frozen PH-Tree, see PhTreeF.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterFloatIEEE<DIM>>
+using PhTreeFrozenF = PhTreeFrozen<DIM, T, CONVERTER>;
+
+/*
+ * Frozen version of PhTreeBoxD.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER_BOX = ConverterBoxIEEE<DIM>>
+using PhTreeFrozenBoxD = PhTreeFrozen<DIM, T, CONVERTER_BOX>;
+
+/*
+ * Writes the tree as frozen image to a stream. Frozen images are read-only trees that can be
+ * used without deserialization, for example from a memory mapped file, see PhTreeFrozen.
+ * This requires trivially copyable value types.
+ *
+ * @param os The output stream.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER>
+void write_frozen(const PhTree<DIM, T, CONVERTER>& tree, std::ostream& os) {
+    v16::write_frozen(PhTreeAccess::GetInternalTree(tree), os);
+}
+
+/*
+ * Writes a frozen image of the tree to memory, for example to shared memory, see
+ * write_frozen(tree, std::ostream&) and PhTreeFrozen::attach(). Nothing is written if the image
+ * is larger than 'capacity'.
+ *
+ * @param data Memory that is aligned to 64 bytes.
+ * @return The size of the image.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER>
+size_t write_frozen(const PhTree<DIM, T, CONVERTER>& tree, char* data, size_t capacity) {
+    return v16::write_frozen(PhTreeAccess::GetInternalTree(tree), data, capacity);
+}
+
+/*
+ * Creates an immutable copy of the tree. The copy stores all nodes and entries in a few
+ * contiguous arrays, see PhTreeFrozen. This gives better cache locality and requires less
+ * memory than the original tree. Values are copied, so this requires copyable value types.
+ *
+ * @return a read-only tree with the same content as the tree.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER>
+PhTreeFrozen<DIM, T, CONVERTER> freeze(const PhTree<DIM, T, CONVERTER>& tree) {
+    return PhTreeFrozen<DIM, T, CONVERTER>(
+        v16::freeze(PhTreeAccess::GetInternalTree(tree)), PhTreeAccess::GetConverter(tree));
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_FROZEN_H
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_FROZEN_FILE_H
+#define PHTREE_PHTREE_FROZEN_FILE_H
+
+#include "common/mapped_file.h"
+#include "phtree_frozen.h"
+
+namespace improbable::phtree {
+
+/*
+ * Read-only PH-Tree that memory maps a file with a frozen image, see write_frozen().
+ * Only pages that are touched by queries are loaded into memory.
+ *
+ * This is a separate header because memory mapping requires OS headers, see mapped_file.h.
+ * The query API is the same as in PhTreeFrozen.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>>
+class PhTreeFrozenFile : public PhTreeFrozen<DIM, T, CONVERTER> {
+    using Base = PhTreeFrozen<DIM, T, CONVERTER>;
+
+  public:
+    explicit PhTreeFrozenFile(CONVERTER converter = CONVERTER()) : Base(converter) {}
+
+    /*
+     * Memory maps a file that was written with write_frozen(). Any previously opened image
+     * is closed.
+     *
+     * @return 'false' if the file could not be mapped or if it does not contain a valid image for
+     * this type of tree. In this case the tree is empty.
+     */
+    bool open(const std::string& path) {
+        close();
+        if (!file_.open(path) || !Base::attach(file_.data(), file_.size())) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Uses an image that is provided by the caller, see PhTreeFrozen::attach(). Any previously
+     * opened file is closed.
+     */
+    bool attach(const char* data, size_t size) {
+        close();
+        return Base::attach(data, size);
+    }
+
+    /*
+     * Closes the image and unmaps the file, the tree is empty afterwards.
+     */
+    void close() {
+        Base::close();
+        file_.close();
+    }
+
+  private:
+    MappedFile file_;
+};
+
+/*
+ * Floating-point `double` version of the memory mapped frozen PH-Tree, see PhTreeD.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterIEEE<DIM>>
+using PhTreeFrozenFileD = PhTreeFrozenFile<DIM, T, CONVERTER>;
+
+/*
+ * Floating-point `float` version of the memory mapped frozen PH-Tree, see PhTreeF.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterFloatIEEE<DIM>>
+using PhTreeFrozenFileF = PhTreeFrozenFile<DIM, T, CONVERTER>;
+
+/*
+ * Memory mapped frozen version of PhTreeBoxD.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER_BOX = ConverterBoxIEEE<DIM>>
+using PhTreeFrozenFileBoxD = PhTreeFrozenFile<DIM, T, CONVERTER_BOX>;
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_FROZEN_FILE_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_LISTENER_H
+#define PHTREE_PHTREE_LISTENER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace improbable::phtree {
+
+/*
+ * Types of modifications, as used by operation logs and change logs.
+ */
+enum class PhTreeOperation : std::uint8_t {
+    EMPLACE = 1,
+    ERASE = 2,
+    RELOCATE = 3,
+    CLEAR = 4,
+    UPDATE = 5
+};
+
+/*
+ * Listener for modifications of a PhTree or PhTreeMultiMap, see PhTree::set_listener().
+ *
+ * Listeners are called after an entry has been inserted and before an entry is removed, i.e.
+ * the value reference is valid during the call. Listeners are only called if a modification
+ * actually happened, e.g. emplace() with a key that already exists is not reported.
+ *
+ * Modifications of values via references or iterators are not reported. This includes operator[],
+ * e.g. 'tree[key] = value' reports only the insertion of a default-constructed value. Use
+ * insert_or_assign() instead if the tree has a listener. deserialize() is not reported either.
+ */
+template <typename KEY, typename T>
+class PhTreeListener {
+  public:
+    virtual ~PhTreeListener() = default;
+
+    /*
+     * Called after a new entry has been inserted.
+     */
+    virtual void OnEmplace(const KEY& key, const T& value) = 0;
+
+    /*
+     * Called before an entry is removed.
+     */
+    virtual void OnErase(const KEY& key, const T& value) = 0;
+
+    /*
+     * Called after an entry has been moved from 'old_key' to 'new_key'.
+     */
+    virtual void OnRelocate(const KEY& old_key, const KEY& new_key, const T& value) = 0;
+
+    /*
+     * Called after the value of an existing entry has been replaced with insert_or_assign().
+     */
+    virtual void OnUpdate(const KEY& key, const T& value) = 0;
+
+    /*
+     * Called before all entries are removed with clear().
+     */
+    virtual void OnClear() = 0;
+};
+
+/*
+ * A listener that forwards all notifications to multiple listeners, in the order in which they
+ * were added. Trees have only one listener, this allows using e.g. an operation log and a change
+ * log at the same time:
+ *
+ * PhTreeListenerFanOut<PhPointD<3>, Id> listeners;
+ * listeners.add(&operation_log);
+ * listeners.add(&change_log);
+ * tree.set_listener(&listeners);
+ *
+ * The fan-out does not take ownership of the listeners.
+ */
+template <typename KEY, typename T>
+class PhTreeListenerFanOut : public PhTreeListener<KEY, T> {
+  public:
+    void add(PhTreeListener<KEY, T>* listener) {
+        listeners_.push_back(listener);
+    }
+
+    /*
+     * @return 'false' if the listener was not found.
+     */
+    bool remove(PhTreeListener<KEY, T>* listener) {
+        auto iter = std::find(listeners_.begin(), listeners_.end(), listener);
+        if (iter == listeners_.end()) {
+            return false;
+        }
+        listeners_.erase(iter);
+        return true;
+    }
+
+    void OnEmplace(const KEY& key, const T& value) override {
+        for (auto* listener : listeners_) {
+            listener->OnEmplace(key, value);
+        }
+    }
+
+    void OnErase(const KEY& key, const T& value) override {
+        for (auto* listener : listeners_) {
+            listener->OnErase(key, value);
+        }
+    }
+
+    void OnRelocate(const KEY& old_key, const KEY& new_key, const T& value) override {
+        for (auto* listener : listeners_) {
+            listener->OnRelocate(old_key, new_key, value);
+        }
+    }
+
+    void OnUpdate(const KEY& key, const T& value) override {
+        for (auto* listener : listeners_) {
+            listener->OnUpdate(key, value);
+        }
+    }
+
+    void OnClear() override {
+        for (auto* listener : listeners_) {
+            listener->OnClear();
+        }
+    }
+
+  private:
+    std::vector<PhTreeListener<KEY, T>*> listeners_;
+};
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_LISTENER_H
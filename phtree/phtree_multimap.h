@@ -18,6 +18,7 @@
 #define PHTREE_PHTREE_MULTIMAP_H
 
 #include "common/common.h"
+#include "phtree_listener.h"
 #include "v16/phtree_v16.h"
 #include <unordered_set>
 
@@ -224,6 +225,7 @@ template <
     typename DEFAULT_QUERY_TYPE = QueryPoint>
 class PhTreeMultiMap {
     friend PhTreeDebugHelper;
+    friend PhTreeAccess;
     using KeyInternal = typename CONVERTER::KeyInternal;
     using QueryBox = typename CONVERTER::QueryBoxExternal;
     using Key = typename CONVERTER::KeyExternal;
@@ -254,10 +256,17 @@ class PhTreeMultiMap {
      */
     template <typename... Args>
     std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
-        auto& outer_iter = tree_.emplace(converter_.pre(key)).first;
-        auto bucket_iter = outer_iter.emplace(std::forward<Args>(args)...);
+        auto key_pre = converter_.pre(key);
+        auto outer_result = tree_.emplace(key_pre);
+        auto bucket_iter = outer_result.first.emplace(std::forward<Args>(args)...);
+        if (bucket_iter.second && !outer_result.second) {
+            // Only new buckets are marked by the tree
+            tree_.mark_modified(key_pre);
+        }
         size_ += bucket_iter.second ? 1 : 0;
-        return {const_cast<T&>(*bucket_iter.first), bucket_iter.second};
+        std::pair<T&, bool> result{const_cast<T&>(*bucket_iter.first), bucket_iter.second};
+        NotifyEmplace(key, result);
+        return result;
     }
 
     /*
@@ -283,15 +292,22 @@ class PhTreeMultiMap {
             // new bucket
             auto result = bucket.emplace(std::forward<Args>(args)...);
             size_ += result.second;
-            return {const_cast<T&>(*result.first), result.second};
+            std::pair<T&, bool> result_pair{const_cast<T&>(*result.first), result.second};
+            NotifyEmplace(key, result_pair);
+            return result_pair;
         } else {
             // existing bucket -> we can use emplace_hint with iterator
             size_t old_size = bucket.size();
             auto result =
                 bucket.emplace_hint(iterator.GetIteratorOfBucket(), std::forward<Args>(args)...);
             bool success = old_size < bucket.size();
+            if (success) {
+                tree_.mark_modified(converter_.pre(key));
+            }
             size_ += success;
-            return {const_cast<T&>(*result), success};
+            std::pair<T&, bool> result_pair{const_cast<T&>(*result), success};
+            NotifyEmplace(key, result_pair);
+            return result_pair;
         }
     }
 
@@ -375,9 +391,14 @@ class PhTreeMultiMap {
         auto iter_outer = tree_.find(converter_.pre(key));
         if (iter_outer != tree_.end()) {
             auto& bucket = *iter_outer;
+            if (listener_ != nullptr && bucket.count(value) > 0) {
+                listener_->OnErase(key, value);
+            }
             auto result = bucket.erase(value);
             if (bucket.empty()) {
                 tree_.erase(iter_outer);
+            } else if (result != 0) {
+                tree_.mark_modified(converter_.pre(key));
             }
             size_ -= result;
             return result;
@@ -400,12 +421,17 @@ class PhTreeMultiMap {
             "erase(iterator) requires an iterator argument. For erasing by key please use "
             "erase(key, value).");
         if (iterator != end()) {
+            if (listener_ != nullptr) {
+                listener_->OnErase(iterator.first(), *iterator);
+            }
             auto& bucket = const_cast<BUCKET&>(*iterator.GetIteratorOfPhTree());
             size_t old_size = bucket.size();
             bucket.erase(iterator.GetIteratorOfBucket());
             bool success = bucket.size() < old_size;
             if (bucket.empty()) {
                 success &= tree_.erase(iterator.GetIteratorOfPhTree()) > 0;
+            } else if (success) {
+                tree_.mark_modified(converter_.pre(iterator.first()));
             }
             size_ -= success;
             return success;
@@ -440,8 +466,11 @@ class PhTreeMultiMap {
         const Key& old_key, const Key& new_key, const T& value, bool always_erase = false) {
         // Be smart: insert first, if the target-map already contains the entry we can avoid erase()
         auto new_key_pre = converter_.pre(new_key);
-        auto& new_bucket = tree_.emplace(new_key_pre).first;
-        auto new_result = new_bucket.emplace(value);
+        auto new_bucket_result = tree_.emplace(new_key_pre);
+        auto new_result = new_bucket_result.first.emplace(value);
+        if (new_result.second && !new_bucket_result.second) {
+            tree_.mark_modified(new_key_pre);
+        }
         if (!new_result.second) {
             // Entry is already in correct place -> abort
             // Return '1' if old/new refer to the same bucket, otherwise '0'
@@ -457,18 +486,29 @@ class PhTreeMultiMap {
         auto old_outer_iter = tree_.find(converter_.pre(old_key));
         if (old_outer_iter == tree_.end()) {
             // No entry for old_key -> fail
+            NotifyEmplace(new_key, {const_cast<T&>(*new_result.first), new_result.second});
             return 0;
         }
 
         auto old_bucket_iter = old_outer_iter->find(value);
         if (old_bucket_iter == old_outer_iter->end()) {
+            NotifyEmplace(new_key, {const_cast<T&>(*new_result.first), new_result.second});
             return 0;
         }
+        if (listener_ != nullptr && !new_result.second) {
+            // The value was already at the new position, it is only removed from the old one
+            listener_->OnErase(old_key, value);
+        }
         old_outer_iter->erase(old_bucket_iter);
 
         // clean up
         if (old_outer_iter->empty()) {
             tree_.erase(old_outer_iter);
+        } else {
+            tree_.mark_modified(converter_.pre(old_key));
+        }
+        if (listener_ != nullptr && new_result.second && converter_.pre(old_key) != new_key_pre) {
+            listener_->OnRelocate(old_key, new_key, value);
         }
         return 1;
     }
@@ -484,11 +524,16 @@ class PhTreeMultiMap {
      * sub-nodes before they are passed to the callback or traversed. Any filter function must
      * follow the signature of the default 'FilterNoOp`.
      * The default 'FilterNoOp` filter matches all entries.
+     * @param stats Optional statistics of the query, see query_stats.h. Entries are counted per
+     * bucket, i.e. per key.
      */
     template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
-    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) const {
+    void for_each(
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         CallbackWrapper<CALLBACK_FN, FILTER> inner_callback{callback, filter, converter_};
-        tree_.for_each(inner_callback, WrapFilter(filter));
+        tree_.for_each(inner_callback, WrapFilter(filter), stats);
     }
 
     /*
@@ -503,6 +548,7 @@ class PhTreeMultiMap {
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
      * The default 'FilterNoOp` filter matches all entries.
+     * @param stats Optional statistics of the query, see for_each().
      */
     template <
         typename CALLBACK_FN,
@@ -512,10 +558,14 @@ class PhTreeMultiMap {
         QueryBox query_box,
         CALLBACK_FN& callback,
         const FILTER& filter = FILTER(),
-        QUERY_TYPE query_type = QUERY_TYPE()) const {
+        QUERY_TYPE query_type = QUERY_TYPE(),
+        PhTreeQueryStats* stats = nullptr) const {
         CallbackWrapper<CALLBACK_FN, FILTER> inner_callback{callback, filter, converter_};
         tree_.for_each(
-            query_type(converter_.pre_query(query_box)), inner_callback, WrapFilter(filter));
+            query_type(converter_.pre_query(query_box)),
+            inner_callback,
+            WrapFilter(filter),
+            stats);
     }
 
     /*
@@ -523,11 +573,12 @@ class PhTreeMultiMap {
      * (=sub-trees) before returning / traversing them. By default all entries are returned. Filter
      * functions must implement the same signature as the default 'FilterNoOp'.
      *
+     * @param stats Optional statistics of the query, see begin_query().
      * @return an iterator over all (filtered) entries in the tree,
      */
     template <typename FILTER = FilterNoOp>
-    auto begin(FILTER filter = FILTER()) const {
-        auto outer_iter = tree_.begin(WrapFilter(filter));
+    auto begin(FILTER filter = FILTER(), PhTreeQueryStats* stats = nullptr) const {
+        auto outer_iter = tree_.begin(WrapFilter(filter), stats);
         if (outer_iter == tree_.end()) {
             return CreateIterator(outer_iter, bucket_dummy_end_, filter);
         }
@@ -544,15 +595,18 @@ class PhTreeMultiMap {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see for_each(). The iterator keeps the
+     * pointer, so 'stats' must outlive it.
      * @return Result iterator.
      */
     template <typename FILTER = FilterNoOp, typename QUERY_TYPE = DEFAULT_QUERY_TYPE>
     auto begin_query(
         const QueryBox& query_box,
         FILTER filter = FILTER(),
-        QUERY_TYPE query_type = QUERY_TYPE()) const {
-        auto outer_iter =
-            tree_.begin_query(query_type(converter_.pre_query(query_box)), WrapFilter(filter));
+        QUERY_TYPE query_type = QUERY_TYPE(),
+        PhTreeQueryStats* stats = nullptr) const {
+        auto outer_iter = tree_.begin_query(
+            query_type(converter_.pre_query(query_box)), WrapFilter(filter), stats);
         if (outer_iter == tree_.end()) {
             return CreateIterator(outer_iter, bucket_dummy_end_, filter);
         }
@@ -572,6 +626,7 @@ class PhTreeMultiMap {
      * @param distance_function optional distance function, defaults to euclidean distance
      * @param filter optional filter predicate that excludes nodes/entries before their distance is
      * calculated.
+     * @param stats Optional statistics of the query, see begin_query().
      * @return Result iterator.
      */
     template <
@@ -584,11 +639,12 @@ class PhTreeMultiMap {
         size_t min_results,
         const Key& center,
         DISTANCE distance_function = DISTANCE(),
-        FILTER filter = FILTER()) const {
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         // We use pre() instead of pre_query() here because, strictly speaking, we want to
         // find the nearest neighbors of a (fictional) key, which may as well be a box.
         auto outer_iter = tree_.begin_knn_query(
-            min_results, converter_.pre(center), distance_function, WrapFilter(filter));
+            min_results, converter_.pre(center), distance_function, WrapFilter(filter), stats);
         if (outer_iter == tree_.end()) {
             return CreateIteratorKnn(outer_iter, bucket_dummy_end_, filter);
         }
@@ -604,10 +660,38 @@ class PhTreeMultiMap {
         return the_end_;
     }
 
+    /*
+     * Relocates all nodes of the tree to new memory in depth-first (z-order) order. After many
+     * modifications the nodes of a tree are scattered across the heap, which makes queries slower
+     * than on a freshly built tree. Nodes are allocated in the order in which queries traverse
+     * them, so nodes that are close in space tend to be close in memory afterwards. Entries and
+     * buckets are moved with their nodes, but the values in the buckets are not relocated. The
+     * content of the tree does not change.
+     *
+     * Compaction can be done incrementally by calling compact() repeatedly with a limited number
+     * of nodes, e.g. once per frame, until it returns 'true'. The tree can be modified between
+     * calls.
+     *
+     * NOTE: compact() invalidates all iterators and all references to values in the tree.
+     * NOTE: There is no arena or custom allocator, new nodes are allocated with the default
+     * allocator. The old node of a subtree is deleted when the whole subtree has been relocated.
+     * At any time (also between incremental calls) at most one old node per tree level is kept,
+     * i.e. the memory overhead is bounded by 64 nodes (or the bit width of the scalar).
+     *
+     * @param max_nodes The maximum number of nodes to relocate in this call.
+     * @return 'true' if compaction is complete, 'false' if compact() needs to be called again.
+     */
+    bool compact(size_t max_nodes = std::numeric_limits<size_t>::max()) {
+        return tree_.compact(max_nodes);
+    }
+
     /*
      * Remove all entries from the tree.
      */
     void clear() {
+        if (listener_ != nullptr) {
+            listener_->OnClear();
+        }
         tree_.clear();
         size_ = 0;
     }
@@ -633,12 +717,29 @@ class PhTreeMultiMap {
         return converter_;
     }
 
+    /*
+     * Sets a listener that is notified of all modifications of the tree, see PhTreeListener.
+     * The tree does not take ownership of the listener. A tree has only one listener, a new
+     * listener replaces the previous one. Use PhTreeListenerFanOut to attach multiple listeners.
+     *
+     * @param listener The listener or 'nullptr' to remove the current listener.
+     */
+    void set_listener(PhTreeListener<Key, T>* listener) {
+        listener_ = listener;
+    }
+
   private:
     // This is used by PhTreeDebugHelper
     const auto& GetInternalTree() const {
         return tree_;
     }
 
+    void NotifyEmplace(const Key& key, const std::pair<T&, bool>& result) {
+        if (listener_ != nullptr && result.second) {
+            listener_->OnEmplace(key, result.first);
+        }
+    }
+
     template <typename OUTER_ITER, typename FILTER = FilterNoOp>
     auto CreateIterator(
         OUTER_ITER outer_iter, BucketIterType bucket_iter, FILTER filter = FILTER()) const {
@@ -698,6 +799,7 @@ class PhTreeMultiMap {
     IteratorNormal<EndType, PHTREE, FilterNoOp> the_end_{tree_.end()};
     BucketIterType bucket_dummy_end_;
     size_t size_;
+    PhTreeListener<Key, T>* listener_ = nullptr;
 };
 
 /**
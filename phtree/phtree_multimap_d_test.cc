@@ -257,6 +257,12 @@ TEST(PhTreeMMDTest, TestDebug) {
     ASSERT_EQ(N / NUM_DUPL, Debug::GetStats(tree).size_);
     Debug::CheckConsistency(tree);
 
+    // The storage of the buckets is counted by default
+    auto stats = Debug::GetStats(tree);
+    ASSERT_LT(N * sizeof(Id), stats.value_heap_size_);
+    ASSERT_EQ(stats.node_size_ + stats.entry_container_size_ + stats.value_heap_size_,
+              stats.mem_size_);
+
     tree.clear();
 
     ASSERT_LE(10, Debug::ToString(tree, Debug::PrintDetail::name).length());
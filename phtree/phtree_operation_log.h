@@ -0,0 +1,290 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_PHTREE_OPERATION_LOG_H
+#define PHTREE_PHTREE_OPERATION_LOG_H
+
+#include "common/serialization.h"
+#include "phtree.h"
+#include "phtree_multimap.h"
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace improbable::phtree {
+
+/*
+ * Operation logs record all modifications of a PhTree or PhTreeMultiMap to a binary stream.
+ * Together with a snapshot that was written with serialize() (see phtree_serialization.h), they
+ * allow restoring the state of a tree, for example after a crash:
+ *
+ * 1) Write a snapshot with serialize() and start a new log with set_listener(&log).
+ * 2) After a restart, read the snapshot with deserialize() and apply the log with
+ *    ReplayOperationLog().
+ *
+ * Each record consists of the operation type (one byte), the key, the new key (only for relocate)
+ * and the value (not for clear). Keys are written as they are, values are written with the codec,
+ * see ValueCodec. As with serialize(), logs can only be read on machines with the same endianness.
+ *
+ * PhTreeOperationLogWriter is a listener that writes all modifications of a tree to a stream, see
+ * PhTree::set_listener(). The stream is not flushed by the writer.
+ *
+ * NOTE: Assignments via operator[] are not logged, see PhTreeListener. Use insert_or_assign()
+ * instead, otherwise the replayed tree contains the default-constructed values.
+ */
+template <typename KEY, typename T, typename CODEC = ValueCodec<T>>
+class PhTreeOperationLogWriter : public PhTreeListener<KEY, T> {
+  public:
+    explicit PhTreeOperationLogWriter(std::ostream& os, const CODEC& codec = CODEC())
+    : os_{os}, codec_{codec} {}
+
+    void OnEmplace(const KEY& key, const T& value) override {
+        WriteRaw(os_, PhTreeOperation::EMPLACE);
+        WriteRaw(os_, key);
+        codec_.write(os_, value);
+    }
+
+    void OnErase(const KEY& key, const T& value) override {
+        WriteRaw(os_, PhTreeOperation::ERASE);
+        WriteRaw(os_, key);
+        codec_.write(os_, value);
+    }
+
+    void OnRelocate(const KEY& old_key, const KEY& new_key, const T& value) override {
+        WriteRaw(os_, PhTreeOperation::RELOCATE);
+        WriteRaw(os_, old_key);
+        WriteRaw(os_, new_key);
+        codec_.write(os_, value);
+    }
+
+    void OnUpdate(const KEY& key, const T& value) override {
+        WriteRaw(os_, PhTreeOperation::UPDATE);
+        WriteRaw(os_, key);
+        codec_.write(os_, value);
+    }
+
+    void OnClear() override {
+        WriteRaw(os_, PhTreeOperation::CLEAR);
+    }
+
+  private:
+    std::ostream& os_;
+    const CODEC codec_;
+};
+
+namespace detail {
+
+template <typename KEY, typename T>
+struct LogRecord {
+    PhTreeOperation op_ = PhTreeOperation::CLEAR;
+    KEY key_;
+    KEY new_key_;
+    T value_;
+};
+
+/*
+ * Reads the remainder of a record whose operation type has already been read into 'record.op_'.
+ * Returns 'false' if the record is incomplete or if the operation type is invalid, the failbit is
+ * set in both cases.
+ */
+template <typename KEY, typename T, typename CODEC>
+bool ReadLogRecordBody(std::istream& is, const CODEC& codec, LogRecord<KEY, T>& record) {
+    switch (record.op_) {
+    case PhTreeOperation::CLEAR:
+        return true;
+    case PhTreeOperation::RELOCATE:
+        if (!ReadRaw(is, record.key_) || !ReadRaw(is, record.new_key_)) {
+            return false;
+        }
+        break;
+    case PhTreeOperation::EMPLACE:
+    case PhTreeOperation::ERASE:
+    case PhTreeOperation::UPDATE:
+        if (!ReadRaw(is, record.key_)) {
+            return false;
+        }
+        break;
+    default:
+        is.setstate(std::ios::failbit);
+        return false;
+    }
+    record.value_ = codec.read(is);
+    // Use fail() instead of good(), the last value may end exactly at the end of the stream.
+    return !is.fail();
+}
+
+/*
+ * Reads one record. Returns 'false' at the end of the stream, if the record is incomplete or if the
+ * operation type is invalid. The failbit is set in the latter two cases.
+ */
+template <typename KEY, typename T, typename CODEC>
+bool ReadLogRecord(std::istream& is, const CODEC& codec, LogRecord<KEY, T>& record) {
+    if (is.peek() == std::istream::traits_type::eof()) {
+        // Regular end of the log
+        return false;
+    }
+    std::uint8_t op = 0;
+    ReadRaw(is, op);
+    record.op_ = static_cast<PhTreeOperation>(op);
+    return ReadLogRecordBody(is, codec, record);
+}
+
+/*
+ * Z-order comparison of internal keys, i.e. the order in which entries are stored in the tree.
+ */
+template <dimension_t DIM, typename SCALAR>
+bool IsLessZOrder(const PhPoint<DIM, SCALAR>& a, const PhPoint<DIM, SCALAR>& b) {
+    bit_width_t diverging_bits = NumberOfDivergingBits(a, b);
+    if (diverging_bits == 0) {
+        return false;
+    }
+    return CalcPosInArray(a, diverging_bits - 1) < CalcPosInArray(b, diverging_bits - 1);
+}
+
+template <typename TREE, typename KEY, typename T, typename CODEC, bool IS_MULTIMAP>
+size_t ReplayOperationLog(std::istream& is, TREE& tree, const CODEC& codec, size_t batch_size) {
+    using KeyInternal = std::remove_cv_t<
+        std::remove_reference_t<decltype(tree.converter().pre(std::declval<KEY>()))>>;
+    struct BatchEntry {
+        KeyInternal key_internal_;
+        LogRecord<KEY, T> record_;
+    };
+    std::vector<BatchEntry> batch;
+    std::unordered_set<KeyInternal> touched_keys;
+    size_t n_applied = 0;
+
+    auto apply = [&tree, &n_applied](LogRecord<KEY, T>& record) {
+        switch (record.op_) {
+        case PhTreeOperation::EMPLACE:
+            tree.emplace(record.key_, std::move(record.value_));
+            break;
+        case PhTreeOperation::ERASE:
+            if constexpr (IS_MULTIMAP) {
+                tree.erase(record.key_, record.value_);
+            } else {
+                tree.erase(record.key_);
+            }
+            break;
+        case PhTreeOperation::RELOCATE:
+            if constexpr (IS_MULTIMAP) {
+                tree.relocate(record.key_, record.new_key_, record.value_);
+            } else {
+                tree.erase(record.key_);
+                tree.emplace(record.new_key_, std::move(record.value_));
+            }
+            break;
+        case PhTreeOperation::UPDATE:
+            if constexpr (IS_MULTIMAP) {
+                // Multimaps have no insert_or_assign(), so they never write updates.
+                assert(false && "Update in multimap log");
+            } else {
+                tree.insert_or_assign(record.key_, std::move(record.value_));
+            }
+            break;
+        case PhTreeOperation::CLEAR:
+            tree.clear();
+            break;
+        }
+        ++n_applied;
+    };
+
+    // Operations on different keys are independent of each other, so they can be reordered.
+    // We sort them in z-order to improve locality when applying them to the tree.
+    auto flush = [&]() {
+        std::stable_sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) {
+            return IsLessZOrder(a.key_internal_, b.key_internal_);
+        });
+        for (auto& entry : batch) {
+            apply(entry.record_);
+        }
+        batch.clear();
+        touched_keys.clear();
+    };
+
+    LogRecord<KEY, T> record;
+    while (ReadLogRecord(is, codec, record)) {
+        if (record.op_ == PhTreeOperation::CLEAR) {
+            flush();
+            apply(record);
+            continue;
+        }
+        auto key_internal = tree.converter().pre(record.key_);
+        bool is_relocate = record.op_ == PhTreeOperation::RELOCATE;
+        auto new_key_internal = is_relocate ? tree.converter().pre(record.new_key_) : key_internal;
+        // Operations on the same key must be applied in their original order
+        if (touched_keys.count(key_internal) > 0 || touched_keys.count(new_key_internal) > 0 ||
+            batch.size() >= batch_size) {
+            flush();
+        }
+        touched_keys.emplace(key_internal);
+        touched_keys.emplace(new_key_internal);
+        batch.push_back({key_internal, std::move(record)});
+    }
+    flush();
+    return n_applied;
+}
+
+}  // namespace detail
+
+/*
+ * Applies an operation log to a tree, see PhTreeOperationLogWriter. The tree should have the state
+ * that it had when the log was started, usually it is read from a snapshot with deserialize().
+ *
+ * Operations are applied in batches. Within a batch, operations are sorted in z-order to improve
+ * cache locality, this is possible because a batch never contains two operations on the same key.
+ *
+ * An incomplete record at the end of the log, e.g. after a crash while writing, is ignored.
+ *
+ * @param batch_size The maximum number of operations per batch.
+ * @return The number of applied operations. If the log contains an incomplete or invalid record,
+ * the replay stops and the failbit of the stream is set, all preceding operations are applied.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER, typename CODEC = ValueCodec<T>>
+size_t ReplayOperationLog(
+    std::istream& is,
+    PhTree<DIM, T, CONVERTER>& tree,
+    const CODEC& codec = CODEC(),
+    size_t batch_size = 4096) {
+    using Key = typename CONVERTER::KeyExternal;
+    return detail::ReplayOperationLog<PhTree<DIM, T, CONVERTER>, Key, T, CODEC, false>(
+        is, tree, codec, batch_size);
+}
+
+/*
+ * Applies an operation log to a multimap, see ReplayOperationLog() for PhTree.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename BUCKET,
+    bool POINT_KEYS,
+    typename DEFAULT_QUERY_TYPE,
+    typename CODEC = ValueCodec<T>>
+size_t ReplayOperationLog(
+    std::istream& is,
+    PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>& tree,
+    const CODEC& codec = CODEC(),
+    size_t batch_size = 4096) {
+    using TreeT = PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>;
+    using Key = typename CONVERTER::KeyExternal;
+    return detail::ReplayOperationLog<TreeT, Key, T, CODEC, true>(is, tree, codec, batch_size);
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_OPERATION_LOG_H
@@ -0,0 +1,701 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_PHTREE_PAGED_H
+#define PHTREE_PHTREE_PAGED_H
+
+#include "common/common.h"
+#include "v16/phtree_v16.h"
+#include "v16/serialization_v16.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+
+namespace improbable::phtree {
+
+/*
+ * PH-Tree that keeps only recently used parts of the tree in memory and swaps out the other parts
+ * to a file.
+ *
+ * The key space is split into pages. A page contains all entries whose keys share the same leading
+ * 'page_depth' bits in every dimension, i.e. a page corresponds to a node of the PH-Tree at depth
+ * 'page_depth'. Pages are independent PH-Trees. When the estimated memory of all loaded pages
+ * exceeds the memory budget, the least recently used pages are written to the swap file with
+ * serialize_compressed() and removed from memory. They are loaded back when they are accessed by
+ * any operation. Pages that were not modified since they were loaded are not written again.
+ *
+ * The swap file is created with open(). Without swap file, all pages remain in memory. Every
+ * swapped out page occupies a slot in the swap file. When a modified page does not fit into its
+ * slot anymore, or when a page becomes empty, its slot is released. Released slots are merged
+ * with adjacent free slots and reused by later evictions, so the swap file does not grow with
+ * repeated modifications.
+ *
+ * The API follows PhTree with the following differences:
+ * - Queries are not 'const' because they may load pages.
+ * - References and iterators returned by emplace() or find() are only valid until the next call
+ *   to any other method of the tree, because that call may swap out the page.
+ * - Callbacks of for_each() and for_each_knn() must not modify the tree.
+ * - Iterator based window queries and kNN queries are not supported, use for_each() and
+ *   for_each_knn() instead.
+ * - Values are written with the codec, see ValueCodec.
+ *
+ * I/O errors are reported with fail(). If a page cannot be written to the swap file, it remains in
+ * memory, i.e. the memory budget may be exceeded. If a page cannot be loaded, it remains swapped
+ * out and its entries are not accessible: find() and count() do not find them, erase() does not
+ * remove them, queries skip them and emplace() does not insert the value. Loading is attempted
+ * again at the next access, size() still includes these entries.
+ *
+ * The memory of a page is measured with PhTreeDebugHelper::GetStats() (heap memory that is owned
+ * by values is only counted for containers, see ValueHeapSizeDefault) and cached. Measuring
+ * requires a traversal of the page, so a page is only measured again after the number of its
+ * entries has changed by more than 25%. In between, its memory is scaled with the number of
+ * entries.
+ *
+ * Note that with floating point keys (ConverterIEEE) the leading 12 bits (9 bits for 'float')
+ * consist of the sign and the exponent, so 'page_depth' should be larger than that.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>,
+    typename CODEC = ValueCodec<T>>
+class PhTreePaged {
+    using KeyInternal = typename CONVERTER::KeyInternal;
+    using QueryBox = typename CONVERTER::QueryBoxExternal;
+    using Key = typename CONVERTER::KeyExternal;
+    using ScalarInternal = typename CONVERTER::ScalarInternal;
+    static constexpr dimension_t DimInternal = CONVERTER::DimInternal;
+    static constexpr bit_width_t MAX_BITS = MAX_BIT_WIDTH<ScalarInternal>;
+    using PageTreeT = v16::PhTreeV16<DimInternal, T, CONVERTER>;
+
+    // DimInternal==DIM indicates point keys. Box keys have DimInternal==2*DIM.
+    using DEFAULT_QUERY_TYPE =
+        typename std::conditional<(DIM == DimInternal), QueryPoint, QueryIntersect>::type;
+
+    struct Page {
+        std::unique_ptr<PageTreeT> tree_;  // 'nullptr' if the page is swapped out
+        size_t size_ = 0;
+        // Estimated memory of the page while it is in memory, see UpdateBytes()
+        size_t bytes_ = 0;
+        // Memory of the page, measured when the page had 'measured_size_' entries
+        size_t measured_bytes_ = 0;
+        size_t measured_size_ = 0;
+        bool dirty_ = true;  // 'true' if the page differs from its copy in the swap file
+        std::streamoff file_pos_ = -1;
+        size_t file_capacity_ = 0;
+        typename std::list<Page*>::iterator lru_pos_;
+    };
+    using DirectoryConverter = ConverterNoOp<DimInternal, ScalarInternal>;
+    using DirectoryT = v16::PhTreeV16<DimInternal, std::unique_ptr<Page>, DirectoryConverter>;
+
+    // Adapts a user filter to the page directory. Pages are regions of the key space, i.e. nodes.
+    template <typename FILTER>
+    struct DirectoryFilter {
+        template <typename VALUE>
+        [[nodiscard]] bool IsEntryValid(const KeyInternal& prefix, const VALUE&) const {
+            return page_bits_ == MAX_BITS || filter_.IsNodeValid(prefix, page_bits_);
+        }
+
+        [[nodiscard]] bool IsNodeValid(const KeyInternal& prefix, int bits_to_ignore) const {
+            return filter_.IsNodeValid(prefix, bits_to_ignore);
+        }
+
+        FILTER& filter_;
+        int page_bits_;
+    };
+
+  public:
+    // A rough estimate of the memory per entry, e.g. for choosing a memory budget: every entry is
+    // stored in a node and every node is an entry in its parent node.
+    static constexpr size_t BYTES_PER_ENTRY =
+        2 * sizeof(v16::Entry<DimInternal, T, ScalarInternal>);
+
+    /*
+     * @param page_depth The number of leading bits of every dimension that defines a page. Larger
+     * values result in smaller pages. '0' puts all entries into a single page.
+     * @param memory_budget The maximum memory (in bytes) of all loaded pages. The page that is
+     * currently accessed is always kept in memory, even if it exceeds the budget.
+     */
+    explicit PhTreePaged(
+        bit_width_t page_depth,
+        size_t memory_budget,
+        CONVERTER converter = CONVERTER(),
+        CODEC codec = CODEC())
+    : directory_converter_{}
+    , directory_{directory_converter_}
+    , converter_{converter}
+    , codec_{codec}
+    , page_bits_{static_cast<bit_width_t>(MAX_BITS - page_depth)}
+    , page_mask_{page_depth == 0 ? bit_mask_t<ScalarInternal>{0} : MAX_MASK<ScalarInternal>
+                                                                      << (MAX_BITS - page_depth)}
+    , memory_budget_{memory_budget} {
+        assert(page_depth < MAX_BITS);
+    }
+
+    PhTreePaged(const PhTreePaged&) = delete;
+    PhTreePaged& operator=(const PhTreePaged&) = delete;
+
+    ~PhTreePaged() {
+        close();
+    }
+
+    /*
+     * Creates the swap file. An existing file is overwritten. The swap file is deleted when the
+     * tree is destroyed. This must be called while the tree is empty.
+     *
+     * @return 'false' if the file could not be created. In this case all pages remain in memory.
+     */
+    bool open(const std::string& path) {
+        assert(empty());
+        close();
+        file_.open(path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!file_.is_open()) {
+            return false;
+        }
+        path_ = path;
+        return true;
+    }
+
+    /*
+     * See PhTree::emplace(). The returned reference is only valid until the next call to the tree.
+     *
+     * If the page of the key could not be loaded (see fail()), the value is not inserted and this
+     * returns '{value, false}', where 'value' refers to a placeholder that is constructed from
+     * 'args' but is not part of the tree.
+     */
+    template <typename... Args>
+    std::pair<T&, bool> emplace(const Key& key, Args&&... args) {
+        auto key_internal = converter_.pre(key);
+        Page* page = GetOrCreatePage(key_internal);
+        if (page == nullptr) {
+            failed_value_.emplace(std::forward<Args>(args)...);
+            return {*failed_value_, false};
+        }
+        auto result = page->tree_->emplace(key_internal, std::forward<Args>(args)...);
+        if (result.second) {
+            ++page->size_;
+            ++size_;
+            page->dirty_ = true;
+            UpdateBytes(*page);
+        }
+        EnforceBudget(page);
+        return result;
+    }
+
+    /*
+     * See PhTree::insert() and emplace().
+     */
+    std::pair<T&, bool> insert(const Key& key, const T& value) {
+        return emplace(key, value);
+    }
+
+    /*
+     * See PhTree::count().
+     */
+    size_t count(const Key& key) {
+        auto key_internal = converter_.pre(key);
+        Page* page = FindPage(key_internal);
+        if (page == nullptr) {
+            return 0;
+        }
+        size_t result = page->tree_->count(key_internal);
+        EnforceBudget(page);
+        return result;
+    }
+
+    /*
+     * See PhTree::find(). The returned iterator is only valid until the next call to the tree.
+     */
+    auto find(const Key& key) {
+        auto key_internal = converter_.pre(key);
+        Page* page = FindPage(key_internal);
+        if (page == nullptr) {
+            return end();
+        }
+        EnforceBudget(page);
+        return page->tree_->find(key_internal);
+    }
+
+    /*
+     * See PhTree::erase().
+     */
+    size_t erase(const Key& key) {
+        auto key_internal = converter_.pre(key);
+        Page* page = FindPage(key_internal);
+        if (page == nullptr) {
+            return 0;
+        }
+        size_t result = page->tree_->erase(key_internal);
+        if (result != 0) {
+            --page->size_;
+            --size_;
+            page->dirty_ = true;
+            if (page->size_ == 0) {
+                resident_bytes_ -= page->bytes_;
+                lru_.erase(page->lru_pos_);
+                ReleaseSlot(*page);
+                directory_.erase(PagePrefix(key_internal));
+                return result;
+            }
+            UpdateBytes(*page);
+        }
+        EnforceBudget(page);
+        return result;
+    }
+
+    /*
+     * Iterates over all entries in the tree, see PhTree::for_each(). Pages that are rejected by
+     * the filter's IsNodeValid() are not loaded. Pages that cannot be loaded are skipped.
+     * The callback must not modify the tree.
+     */
+    template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
+    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) {
+        auto page_callback = [this, &callback, &filter](const KeyInternal&, const auto& page_ptr) {
+            Page* page = LoadPage(*page_ptr);
+            if (page != nullptr) {
+                page->tree_->for_each(callback, filter);
+                EnforceBudget(page);
+            }
+        };
+        directory_.for_each(page_callback, DirectoryFilter<FILTER>{filter, page_bits_});
+    }
+
+    /*
+     * Performs a rectangular window query, see PhTree::for_each(). Only pages that intersect with
+     * the query box are loaded.
+     * The callback must not modify the tree.
+     */
+    template <
+        typename CALLBACK_FN,
+        typename FILTER = FilterNoOp,
+        typename QUERY_TYPE = DEFAULT_QUERY_TYPE>
+    void for_each(
+        QueryBox query_box,
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER(),
+        QUERY_TYPE query_type = QUERY_TYPE()) {
+        auto box = query_type(converter_.pre_query(query_box));
+        auto page_callback = [this, &box, &callback, &filter](
+                                 const KeyInternal&, const auto& page_ptr) {
+            Page* page = LoadPage(*page_ptr);
+            if (page != nullptr) {
+                page->tree_->for_each(box, callback, filter);
+                EnforceBudget(page);
+            }
+        };
+        PhBox<DimInternal, ScalarInternal> page_box{PagePrefix(box.min()), PagePrefix(box.max())};
+        directory_.for_each(
+            page_box, page_callback, DirectoryFilter<FILTER>{filter, page_bits_});
+    }
+
+    /*
+     * Locates the nearest neighbors of 'center' and passes them to the callback in order of
+     * increasing distance, see PhTree::begin_knn_query().
+     * The callback requires the following signature: callback(const KEY&, const T&, double dist)
+     *
+     * Pages are loaded in order of their distance to 'center' until no remaining page can contain
+     * a closer entry. Pages that are needed for the result are kept in memory until all results
+     * have been passed to the callback, so the memory budget may be exceeded temporarily. Pages
+     * that cannot be loaded are skipped. The callback must not modify the tree.
+     *
+     * @param min_results The number of entries to be returned (or fewer if the tree is smaller).
+     */
+    template <
+        typename DISTANCE,
+        typename CALLBACK_FN,
+        typename FILTER = FilterNoOp,
+        // Some magic to disable this in case of box keys, i.e. if DIM != DimInternal
+        dimension_t DUMMY = DIM,
+        typename std::enable_if<(DUMMY == DimInternal), int>::type = 0>
+    void for_each_knn(
+        size_t min_results,
+        const Key& center,
+        CALLBACK_FN& callback,
+        DISTANCE distance_function = DISTANCE(),
+        FILTER filter = FILTER()) {
+        if (min_results == 0) {
+            return;
+        }
+        auto center_internal = converter_.pre(center);
+        // All pages that pass the filter, ordered by their distance to 'center'
+        std::vector<std::pair<double, Page*>> pages;
+        auto page_callback = [&](const KeyInternal& prefix, const auto& page_ptr) {
+            double d = DistanceToPage(prefix, center, center_internal, distance_function);
+            pages.emplace_back(d, page_ptr.get());
+        };
+        directory_.for_each(page_callback, DirectoryFilter<FILTER>{filter, page_bits_});
+        std::sort(pages.begin(), pages.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        struct Result {
+            double distance_;
+            Key key_;
+            const T* value_;
+        };
+        auto is_closer = [](const Result& a, const Result& b) {
+            return a.distance_ < b.distance_;
+        };
+        // Max-heap of the closest 'min_results' entries
+        std::vector<Result> results;
+        for (auto& [page_distance, page_ptr] : pages) {
+            if (results.size() == min_results && page_distance > results.front().distance_) {
+                break;
+            }
+            // Do not enforce the budget here, the results refer to values in loaded pages.
+            Page* page = LoadPage(*page_ptr);
+            if (page == nullptr) {
+                continue;
+            }
+            auto it = page->tree_->begin_knn_query(
+                min_results, center_internal, distance_function, filter);
+            for (; it != page->tree_->end(); ++it) {
+                if (results.size() == min_results) {
+                    if (it.distance() >= results.front().distance_) {
+                        break;
+                    }
+                    std::pop_heap(results.begin(), results.end(), is_closer);
+                    results.pop_back();
+                }
+                results.push_back({it.distance(), it.first(), &*it});
+                std::push_heap(results.begin(), results.end(), is_closer);
+            }
+        }
+        std::sort_heap(results.begin(), results.end(), is_closer);
+        for (auto& result : results) {
+            callback(result.key_, *result.value_, result.distance_);
+        }
+        EnforceBudget(nullptr);
+    }
+
+    /*
+     * @return An iterator representing the tree's 'end'.
+     */
+    auto end() const {
+        return v16::IteratorEnd<T, CONVERTER>(converter_);
+    }
+
+    /*
+     * Remove all entries from the tree. The swap file is reused.
+     */
+    void clear() {
+        directory_.clear();
+        lru_.clear();
+        size_ = 0;
+        resident_bytes_ = 0;
+        file_end_ = 0;
+        free_slots_.clear();
+        fail_ = false;
+    }
+
+    /*
+     * @return the number of entries (key/value pairs) in the tree.
+     */
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    /*
+     * @return 'true' if the tree is empty, otherwise 'false'.
+     */
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    /*
+     * @return the converter associated with this tree.
+     */
+    [[nodiscard]] const CONVERTER& converter() const {
+        return converter_;
+    }
+
+    /*
+     * @return The memory of all pages that are currently in memory, see the class comment.
+     */
+    [[nodiscard]] size_t resident_bytes() const {
+        return resident_bytes_;
+    }
+
+    /*
+     * @return The number of pages that are currently in memory.
+     */
+    [[nodiscard]] size_t resident_page_count() const {
+        return lru_.size();
+    }
+
+    /*
+     * @return The number of pages, including swapped out pages.
+     */
+    [[nodiscard]] size_t page_count() const {
+        return directory_.size();
+    }
+
+    /*
+     * @return 'true' if a page could not be written to or loaded from the swap file since the
+     * last call to open() or clear(), e.g. because the disk is full or the file was modified.
+     */
+    [[nodiscard]] bool fail() const {
+        return fail_;
+    }
+
+    /*
+     * @return The number of bytes used in the swap file, including free slots between pages.
+     */
+    [[nodiscard]] size_t file_size() const {
+        return static_cast<size_t>(file_end_);
+    }
+
+  private:
+    void close() {
+        clear();
+        if (file_.is_open()) {
+            file_.close();
+            std::remove(path_.c_str());
+        }
+    }
+
+    KeyInternal PagePrefix(const KeyInternal& key) const {
+        KeyInternal prefix;
+        for (dimension_t i = 0; i < DimInternal; ++i) {
+            prefix[i] = static_cast<ScalarInternal>(
+                static_cast<bit_mask_t<ScalarInternal>>(key[i]) & page_mask_);
+        }
+        return prefix;
+    }
+
+    Page* FindPage(const KeyInternal& key) {
+        auto iter = directory_.find(PagePrefix(key));
+        return iter == directory_.end() ? nullptr : LoadPage(**iter);
+    }
+
+    Page* GetOrCreatePage(const KeyInternal& key) {
+        auto result = directory_.emplace(PagePrefix(key));
+        if (result.second) {
+            result.first = std::make_unique<Page>();
+            auto& page = *result.first;
+            page.tree_ = std::make_unique<PageTreeT>(converter_);
+            lru_.push_front(&page);
+            page.lru_pos_ = lru_.begin();
+            return &page;
+        }
+        return LoadPage(*result.first);
+    }
+
+    // Ensures that the page is in memory and marks it as most recently used.
+    // Returns 'nullptr' if the page could not be loaded, the page then remains swapped out.
+    Page* LoadPage(Page& page) {
+        if (page.tree_ != nullptr) {
+            lru_.splice(lru_.begin(), lru_, page.lru_pos_);
+            return &page;
+        }
+        auto tree = std::make_unique<PageTreeT>(converter_);
+        file_.clear();
+        file_.seekg(page.file_pos_);
+        // This can only fail if the swap file was modified or if there is an I/O error.
+        if (!v16::deserialize(*tree, file_, codec_) || tree->size() != page.size_) {
+            fail_ = true;
+            return nullptr;
+        }
+        page.tree_ = std::move(tree);
+        page.dirty_ = false;
+        // The memory of a deserialized page differs from the memory before it was swapped out.
+        page.measured_size_ = 0;
+        page.bytes_ = 0;
+        UpdateBytes(page);
+        lru_.push_front(&page);
+        page.lru_pos_ = lru_.begin();
+        return &page;
+    }
+
+    void EnforceBudget(const Page* current_page) {
+        if (!file_.is_open()) {
+            return;
+        }
+        while (resident_bytes() > memory_budget_ && lru_.back() != current_page) {
+            if (!Evict(*lru_.back())) {
+                // Exceed the budget rather than losing the page, we try again next time.
+                return;
+            }
+        }
+    }
+
+    // Returns 'false' if the page could not be written, the page then remains in memory.
+    bool Evict(Page& page) {
+        if (page.dirty_) {
+            std::ostringstream os;
+            v16::serialize_compressed(*page.tree_, os, codec_);
+            std::string data = os.str();
+            if (data.size() > page.file_capacity_) {
+                // The old copy is outdated, so its slot can be reused for the new copy.
+                ReleaseSlot(page);
+                AllocateSlot(page, data.size());
+            }
+            file_.clear();
+            file_.seekp(page.file_pos_);
+            file_.write(data.data(), static_cast<std::streamsize>(data.size()));
+            // Flush to detect write errors before the page is discarded
+            file_.flush();
+            if (os.fail() || file_.fail()) {
+                // The page stays in memory and dirty, it does not need a slot.
+                ReleaseSlot(page);
+                fail_ = true;
+                return false;
+            }
+            page.dirty_ = false;
+        }
+        resident_bytes_ -= page.bytes_;
+        page.bytes_ = 0;
+        page.tree_.reset();
+        lru_.erase(page.lru_pos_);
+        return true;
+    }
+
+    // Updates the memory of a page after it was loaded or modified. The page is measured again if
+    // the number of its entries has changed by more than 25% since the last measurement.
+    void UpdateBytes(Page& page) {
+        resident_bytes_ -= page.bytes_;
+        size_t diff = page.size_ > page.measured_size_ ? page.size_ - page.measured_size_
+                                                       : page.measured_size_ - page.size_;
+        if (diff > page.measured_size_ / 4) {
+            auto stats = PhTreeDebugHelper::GetStats(*page.tree_);
+            page.measured_bytes_ = sizeof(PageTreeT) + stats.mem_size_;
+            page.measured_size_ = page.size_;
+        }
+        page.bytes_ = page.measured_size_ == 0
+            ? 0
+            : page.measured_bytes_ * page.size_ / page.measured_size_;
+        resident_bytes_ += page.bytes_;
+    }
+
+    // Calculates the distance from 'center' to the closest point of the page.
+    template <typename DISTANCE>
+    double DistanceToPage(
+        const KeyInternal& prefix,
+        const Key& center,
+        const KeyInternal& center_internal,
+        const DISTANCE& distance_function) const {
+        KeyInternal closest;
+        for (dimension_t i = 0; i < DimInternal; ++i) {
+            auto min = prefix[i];
+            auto max = static_cast<ScalarInternal>(
+                static_cast<bit_mask_t<ScalarInternal>>(prefix[i]) | ~page_mask_);
+            closest[i] = std::clamp(center_internal[i], min, max);
+        }
+        return distance_function(center, converter_.post(closest));
+    }
+
+    // Assigns the best fitting free slot to the page or appends a new slot to the file.
+    void AllocateSlot(Page& page, size_t size) {
+        auto best = free_slots_.end();
+        for (auto it = free_slots_.begin(); it != free_slots_.end(); ++it) {
+            if (it->second >= size && (best == free_slots_.end() || it->second < best->second)) {
+                best = it;
+            }
+        }
+        if (best == free_slots_.end()) {
+            page.file_pos_ = file_end_;
+            file_end_ += static_cast<std::streamoff>(size);
+        } else {
+            page.file_pos_ = best->first;
+            if (best->second > size) {
+                auto rest_pos = best->first + static_cast<std::streamoff>(size);
+                free_slots_.emplace(rest_pos, best->second - size);
+            }
+            free_slots_.erase(best);
+        }
+        page.file_capacity_ = size;
+    }
+
+    // Returns the slot of the page to the free slots, adjacent free slots are merged. A free slot
+    // at the end of the file is removed instead.
+    void ReleaseSlot(Page& page) {
+        if (page.file_capacity_ == 0) {
+            return;
+        }
+        auto pos = page.file_pos_;
+        auto size = page.file_capacity_;
+        page.file_pos_ = -1;
+        page.file_capacity_ = 0;
+        auto next = free_slots_.lower_bound(pos);
+        if (next != free_slots_.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + static_cast<std::streamoff>(prev->second) == pos) {
+                pos = prev->first;
+                size += prev->second;
+                free_slots_.erase(prev);
+            }
+        }
+        if (next != free_slots_.end() && pos + static_cast<std::streamoff>(size) == next->first) {
+            size += next->second;
+            free_slots_.erase(next);
+        }
+        if (pos + static_cast<std::streamoff>(size) == file_end_) {
+            file_end_ = pos;
+        } else {
+            free_slots_.emplace(pos, size);
+        }
+    }
+
+    DirectoryConverter directory_converter_;
+    DirectoryT directory_;
+    CONVERTER converter_;
+    const CODEC codec_;
+    const bit_width_t page_bits_;
+    const bit_mask_t<ScalarInternal> page_mask_;
+    const size_t memory_budget_;
+    size_t size_ = 0;
+    size_t resident_bytes_ = 0;
+    // Least recently used pages are at the end
+    std::list<Page*> lru_;
+    std::fstream file_;
+    std::string path_;
+    std::streamoff file_end_ = 0;
+    // Free slots in the swap file: position -> size
+    std::map<std::streamoff, size_t> free_slots_;
+    bool fail_ = false;
+    // Returned by emplace() if a page could not be loaded
+    std::optional<T> failed_value_;
+};
+
+/*
+ * Floating-point `double` version of the paged PH-Tree.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER = ConverterIEEE<DIM>,
+    typename CODEC = ValueCodec<T>>
+using PhTreePagedD = PhTreePaged<DIM, T, CONVERTER, CODEC>;
+
+/*
+ * Paged version of PhTreeBoxD.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER_BOX = ConverterBoxIEEE<DIM>,
+    typename CODEC = ValueCodec<T>>
+using PhTreePagedBoxD = PhTreePaged<DIM, T, CONVERTER_BOX, CODEC>;
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_PAGED_H
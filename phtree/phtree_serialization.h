@@ -0,0 +1,165 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_SERIALIZATION_H
+#define PHTREE_PHTREE_SERIALIZATION_H
+
+#include "common/common.h"
+#include "common/serialization.h"
+#include "phtree.h"
+#include "phtree_multimap.h"
+#include "v16/serialization_v16.h"
+
+namespace improbable::phtree {
+
+/*
+ * Binary serialization of PhTree and PhTreeMultiMap.
+ *
+ * Streams contain the node structure of the tree, so deserialize() can reconstruct the nodes
+ * directly instead of inserting all entries. Keys are written in their internal representation,
+ * i.e. a tree must be read with the same converter that was used for writing it. Values are
+ * written with a codec, see ValueCodec.
+ */
+
+/*
+ * Writes the tree to a binary stream, see v16::serialize().
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values, see ValueCodec. The default codec supports only
+ * trivially copyable value types.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER, typename CODEC = ValueCodec<T>>
+void serialize(
+    const PhTree<DIM, T, CONVERTER>& tree, std::ostream& os, const CODEC& codec = CODEC()) {
+    v16::serialize(PhTreeAccess::GetInternalTree(tree), os, codec);
+}
+
+/*
+ * Writes the tree to a binary stream in a compressed format, see v16::serialize_compressed().
+ * Compressed streams are usually considerably smaller than streams written with serialize(),
+ * they can also be read with deserialize().
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values, see ValueCodec.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER, typename CODEC = ValueCodec<T>>
+void serialize_compressed(
+    const PhTree<DIM, T, CONVERTER>& tree, std::ostream& os, const CODEC& codec = CODEC()) {
+    v16::serialize_compressed(PhTreeAccess::GetInternalTree(tree), os, codec);
+}
+
+/*
+ * Replaces the content of the tree with a tree that was written with serialize() or
+ * serialize_compressed(). This is considerably faster than inserting all entries with
+ * emplace().
+ * The tree must use the same converter as the tree that was serialized.
+ *
+ * @param is The input stream.
+ * @param codec The codec for reading values, this must match the codec used for writing.
+ * @return 'true' if the tree was read successfully. If the stream is invalid or was written
+ * by a different type of tree, the tree is left empty and 'false' is returned.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER, typename CODEC = ValueCodec<T>>
+bool deserialize(PhTree<DIM, T, CONVERTER>& tree, std::istream& is, const CODEC& codec = CODEC()) {
+    return v16::deserialize(PhTreeAccess::GetInternalTree(tree), is, codec);
+}
+
+/*
+ * Writes the multimap to a binary stream, see v16::serialize(). Buckets are written as the
+ * number of values followed by the values.
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values (not buckets), see ValueCodec. The default codec
+ * supports only trivially copyable value types.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename BUCKET,
+    bool POINT_KEYS,
+    typename DEFAULT_QUERY_TYPE,
+    typename CODEC = ValueCodec<T>>
+void serialize(
+    const PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>& tree,
+    std::ostream& os,
+    const CODEC& codec = CODEC()) {
+    WriteRaw<std::uint64_t>(os, tree.size());
+    v16::serialize(PhTreeAccess::GetInternalTree(tree), os, BucketCodec<BUCKET, CODEC>{codec});
+}
+
+/*
+ * Writes the multimap to a binary stream in a compressed format, see
+ * v16::serialize_compressed(). Buckets are written as in serialize().
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values (not buckets), see ValueCodec.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename BUCKET,
+    bool POINT_KEYS,
+    typename DEFAULT_QUERY_TYPE,
+    typename CODEC = ValueCodec<T>>
+void serialize_compressed(
+    const PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>& tree,
+    std::ostream& os,
+    const CODEC& codec = CODEC()) {
+    WriteRaw<std::uint64_t>(os, tree.size());
+    v16::serialize_compressed(
+        PhTreeAccess::GetInternalTree(tree), os, BucketCodec<BUCKET, CODEC>{codec});
+}
+
+/*
+ * Replaces the content of the multimap with a multimap that was written with serialize() or
+ * serialize_compressed(), see deserialize(PhTree&, ...).
+ *
+ * @param is The input stream.
+ * @param codec The codec for reading values, this must match the codec used for writing.
+ * @return 'true' if the tree was read successfully. If the stream is invalid or was written
+ * by a different type of tree, the tree is left empty and 'false' is returned.
+ */
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename BUCKET,
+    bool POINT_KEYS,
+    typename DEFAULT_QUERY_TYPE,
+    typename CODEC = ValueCodec<T>>
+bool deserialize(
+    PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>& tree,
+    std::istream& is,
+    const CODEC& codec = CODEC()) {
+    tree.clear();
+    std::uint64_t size = 0;
+    std::uint64_t num_values = 0;
+    auto& internal_tree = PhTreeAccess::GetInternalTree(tree);
+    if (!ReadRaw(is, size) ||
+        !v16::deserialize(internal_tree, is, BucketCodec<BUCKET, CODEC>{codec, &num_values}) ||
+        num_values != size) {
+        tree.clear();
+        return false;
+    }
+    PhTreeAccess::GetSize(tree) = size;
+    return true;
+}
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_SERIALIZATION_H
@@ -0,0 +1,493 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_PHTREE_SHARED_H
+#define PHTREE_PHTREE_SHARED_H
+
+#include "common/shared_memory.h"
+#include "phtree.h"
+#include "phtree_frozen.h"
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace improbable::phtree {
+
+/*
+ * Layout of the control region that is written by PhTreeSharedWriter and read by
+ * PhTreeSharedReader.
+ *
+ * The frozen images (see write_frozen() in phtree_frozen.h) are stored in a separate data region
+ * with two slots, see DataRegionName(). Readers use the active slot while the writer writes the next image
+ * into the other slot. The writer then makes the new image active (seqlock on 'sequence_') and
+ * increments the epoch. Readers pin the epoch of the image that they use in their reader slot.
+ * Before the writer overwrites the inactive slot, it waits until no reader has pinned the epoch
+ * of that slot.
+ *
+ * If an image does not fit into a slot, the writer creates a larger data region with a new
+ * index, writes the image into its first slot and makes it active. The old data region is
+ * removed, readers that still use it keep their mapping until they acquire the next image.
+ *
+ * A reader slot contains the process id of the reader. If a reader process terminates without
+ * releasing its slot, e.g. after a crash, the slot is reclaimed by the writer or by new readers
+ * once they find that the process does not exist anymore.
+ */
+struct SharedTreeHeader {
+    static constexpr std::uint32_t MAGIC = 0x50485332;  // "PHS2"
+    static constexpr std::uint32_t MAX_READERS = 64;
+    static constexpr std::uint64_t ALIGNMENT = 64;
+    // Marks a reader slot that is being reclaimed
+    static constexpr std::uint32_t RECLAIMING = ~std::uint32_t{0};
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+    std::atomic<std::uint32_t> magic_;
+    std::uint32_t max_readers_;
+    // Odd while the writer changes the active slot or the data region
+    std::atomic<std::uint64_t> sequence_;
+    // Index of the data region, see DataRegionName()
+    std::atomic<std::uint64_t> data_region_;
+    // Size of a slot in the data region, slot 'i' starts at 'i * slot_capacity_'
+    std::atomic<std::uint64_t> slot_capacity_;
+    std::atomic<std::uint64_t> active_slot_;
+    std::atomic<std::uint64_t> image_size_[2];
+    // Epoch of the image in a slot, '0' if the slot is empty
+    std::atomic<std::uint64_t> epoch_[2];
+    // Process id of the reader, '0' if the slot is free
+    std::atomic<std::uint32_t> reader_claimed_[MAX_READERS];
+    // Epoch of the image that is used by a reader, '0' if the reader uses no image
+    std::atomic<std::uint64_t> reader_epoch_[MAX_READERS];
+
+    static std::uint64_t Align(std::uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /*
+     * @return The name of the data region with index 'data_region' of the control region 'name'.
+     */
+    static std::string DataRegionName(const std::string& name, std::uint64_t data_region) {
+        return name + "_" + std::to_string(data_region);
+    }
+
+    /*
+     * Frees reader slot 'i' if the process that claimed it does not exist anymore.
+     * @return 'true' if the slot was reclaimed.
+     */
+    bool ReclaimStaleReader(std::uint32_t i) {
+        std::uint32_t pid = reader_claimed_[i].load(std::memory_order_acquire);
+        if (pid == 0 || pid == RECLAIMING || IsProcessAlive(pid)) {
+            return false;
+        }
+        // Block the slot while the pin is removed, so that it is not claimed by a new reader.
+        if (!reader_claimed_[i].compare_exchange_strong(pid, RECLAIMING)) {
+            return false;
+        }
+        reader_epoch_[i].store(0, std::memory_order_seq_cst);
+        reader_claimed_[i].store(0, std::memory_order_release);
+        return true;
+    }
+};
+
+/*
+ * Writer that publishes snapshots of a PH-Tree to shared memory, see PhTreeSharedReader.
+ *
+ * The writer owns a normal PhTree that can be modified with tree(). publish() writes a frozen
+ * image (snapshot) of the whole tree into shared memory, where it can be queried by readers in
+ * other processes without copying it. There must be only one writer per region.
+ *
+ * Every call to publish() rebuilds the whole image, i.e. it takes O(n) time, and the nodes are
+ * not updated in place. The writer process holds the tree and the two image slots of the data
+ * region, i.e. up to three copies of the index, while reader processes do not copy the index.
+ * This is therefore suited for trees that are modified in batches and queried by many
+ * processes.
+ *
+ * Values must be trivially copyable, see write_frozen() in phtree_frozen.h.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>>
+class PhTreeSharedWriter {
+    using H = SharedTreeHeader;
+
+  public:
+    explicit PhTreeSharedWriter(CONVERTER converter = CONVERTER()) : tree_{converter} {}
+
+    PhTreeSharedWriter(const PhTreeSharedWriter&) = delete;
+    PhTreeSharedWriter& operator=(const PhTreeSharedWriter&) = delete;
+
+    ~PhTreeSharedWriter() {
+        close();
+    }
+
+    /*
+     * Creates the shared memory regions and publishes the current content of the tree. Existing
+     * regions with the same name are replaced.
+     *
+     * @param slot_capacity The initial size (in bytes) of an image slot. The data region requires
+     * about twice this size. The data region grows when an image does not fit, see publish().
+     * @return 'false' if the regions could not be created.
+     */
+    bool create(const std::string& name, size_t slot_capacity) {
+        close();
+        if (!control_.create(name, sizeof(H))) {
+            return false;
+        }
+        name_ = name;
+        header_ = new (control_.data()) H{};
+        header_->max_readers_ = H::MAX_READERS;
+        header_->active_slot_ = 1;
+        std::uint64_t capacity = H::Align(std::max<size_t>(slot_capacity, 1));
+        if (!CreateDataRegion(capacity)) {
+            close();
+            return false;
+        }
+        header_->data_region_ = data_region_;
+        header_->slot_capacity_ = capacity;
+        if (!publish()) {
+            close();
+            return false;
+        }
+        header_->magic_.store(H::MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Unmaps the regions and removes their names. Readers that have opened the regions can
+     * continue to use them.
+     */
+    void close() {
+        if (header_ != nullptr) {
+            SharedMemory::remove(H::DataRegionName(name_, data_region_));
+            SharedMemory::remove(name_);
+        }
+        data_.close();
+        data_region_ = 0;
+        control_.close();
+        header_ = nullptr;
+    }
+
+    /*
+     * @return The tree of the writer. Modifications become visible to readers with publish().
+     */
+    PhTree<DIM, T, CONVERTER>& tree() {
+        return tree_;
+    }
+
+    /*
+     * Makes the current content of the tree visible to readers. Readers continue to use the
+     * previous image until they call PhTreeSharedReader::acquire().
+     *
+     * This waits until no reader uses the image before the previous image. Pins of reader
+     * processes that do not exist anymore are removed. A reader that is alive but never releases
+     * its image blocks the writer, so use a timeout if readers are not trusted.
+     *
+     * If the image is larger than the slot capacity, a new data region is created with at least
+     * twice the capacity, see SharedTreeHeader.
+     *
+     * @param timeout The maximum time to wait for readers.
+     * @return 'false' if readers still use the previous image after 'timeout' or if a larger
+     * data region could not be created. In this case readers continue to see the previous image.
+     */
+    bool publish(std::chrono::milliseconds timeout = std::chrono::milliseconds::max()) {
+        assert(header_ != nullptr);
+        auto& h = *header_;
+        std::uint64_t slot = 1 - h.active_slot_.load(std::memory_order_relaxed);
+        std::uint64_t old_epoch = h.epoch_[slot].load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        while (old_epoch != 0 && IsPinned(old_epoch)) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed) >= timeout) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+
+        std::uint64_t capacity = h.slot_capacity_.load(std::memory_order_relaxed);
+        size_t size = write_frozen(tree_, data_.data() + slot * capacity, capacity);
+        if (size > capacity) {
+            return Grow(size);
+        }
+
+        h.sequence_.fetch_add(1, std::memory_order_seq_cst);
+        h.image_size_[slot].store(size, std::memory_order_relaxed);
+        h.epoch_[slot].store(++epoch_, std::memory_order_relaxed);
+        h.active_slot_.store(slot, std::memory_order_relaxed);
+        h.sequence_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * @return The epoch of the most recently published image, starting with '1'.
+     */
+    [[nodiscard]] std::uint64_t epoch() const {
+        return epoch_;
+    }
+
+    /*
+     * @return The capacity (in bytes) of an image slot.
+     */
+    [[nodiscard]] size_t slot_capacity() const {
+        return header_ == nullptr ? 0 : header_->slot_capacity_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Replaces the data region with a new region with the next index.
+    bool CreateDataRegion(std::uint64_t slot_capacity) {
+        assert(slot_capacity == H::Align(slot_capacity));
+        SharedMemory data;
+        if (!data.create(H::DataRegionName(name_, data_region_ + 1), 2 * slot_capacity)) {
+            return false;
+        }
+        if (data_.data() != nullptr) {
+            SharedMemory::remove(H::DataRegionName(name_, data_region_));
+        }
+        data_ = std::move(data);
+        ++data_region_;
+        return true;
+    }
+
+    // Publishes the image in slot 0 of a new, larger data region.
+    bool Grow(size_t image_size) {
+        auto& h = *header_;
+        std::uint64_t capacity = H::Align(std::max<std::uint64_t>(
+            image_size, 2 * h.slot_capacity_.load(std::memory_order_relaxed)));
+        if (!CreateDataRegion(capacity)) {
+            return false;
+        }
+        size_t size = write_frozen(tree_, data_.data(), capacity);
+        assert(size <= capacity);
+
+        // Readers of the old data region do not pin slots of the new data region.
+        h.sequence_.fetch_add(1, std::memory_order_seq_cst);
+        h.data_region_.store(data_region_, std::memory_order_relaxed);
+        h.slot_capacity_.store(capacity, std::memory_order_relaxed);
+        h.image_size_[0].store(size, std::memory_order_relaxed);
+        h.epoch_[0].store(++epoch_, std::memory_order_relaxed);
+        h.image_size_[1].store(0, std::memory_order_relaxed);
+        h.epoch_[1].store(0, std::memory_order_relaxed);
+        h.active_slot_.store(0, std::memory_order_relaxed);
+        h.sequence_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsPinned(std::uint64_t epoch) const {
+        for (std::uint32_t i = 0; i < header_->max_readers_; ++i) {
+            if (header_->reader_epoch_[i].load(std::memory_order_seq_cst) == epoch &&
+                !header_->ReclaimStaleReader(i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PhTree<DIM, T, CONVERTER> tree_;
+    SharedMemory control_;
+    SharedMemory data_;
+    SharedTreeHeader* header_ = nullptr;
+    std::string name_;
+    std::uint64_t data_region_ = 0;
+    std::uint64_t epoch_ = 0;
+};
+
+/*
+ * Reader for a PH-Tree in shared memory that is written by a PhTreeSharedWriter, usually in
+ * another process.
+ *
+ * acquire() pins the most recently published image, which can then be queried with tree() until
+ * the next call to acquire() or release(). Queries operate directly on the shared memory.
+ * The writer cannot publish more than one new image while a reader has pinned an image, so
+ * readers should call release() or acquire() regularly.
+ *
+ * Every reader occupies one of SharedTreeHeader::MAX_READERS reader slots of the region. A reader
+ * must only be used by one thread at a time. Slots of reader processes that terminated without
+ * close() are reclaimed, see SharedTreeHeader.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterNoOp<DIM, scalar_64_t>>
+class PhTreeSharedReader {
+    using H = SharedTreeHeader;
+
+  public:
+    explicit PhTreeSharedReader(CONVERTER converter = CONVERTER()) : tree_{converter} {}
+
+    PhTreeSharedReader(const PhTreeSharedReader&) = delete;
+    PhTreeSharedReader& operator=(const PhTreeSharedReader&) = delete;
+
+    ~PhTreeSharedReader() {
+        close();
+    }
+
+    /*
+     * Opens a region that was created by a PhTreeSharedWriter.
+     *
+     * @return 'false' if the region does not exist, if it is invalid or if all reader slots are
+     * in use by existing processes.
+     */
+    bool open(const std::string& name) {
+        close();
+        if (!control_.open(name) || control_.size() < sizeof(H)) {
+            control_.close();
+            return false;
+        }
+        auto* header = reinterpret_cast<H*>(control_.data());
+        if (header->magic_.load(std::memory_order_acquire) != H::MAGIC ||
+            header->max_readers_ > H::MAX_READERS) {
+            control_.close();
+            return false;
+        }
+        std::uint32_t pid = CurrentProcessId();
+        for (std::uint32_t i = 0; i < header->max_readers_; ++i) {
+            header->ReclaimStaleReader(i);
+            std::uint32_t expected = 0;
+            if (header->reader_claimed_[i].compare_exchange_strong(expected, pid)) {
+                header_ = header;
+                reader_ = i;
+                name_ = name;
+                return true;
+            }
+        }
+        control_.close();
+        return false;
+    }
+
+    /*
+     * Releases the reader slot and unmaps the regions.
+     */
+    void close() {
+        if (header_ != nullptr) {
+            release();
+            header_->reader_claimed_[reader_].store(0, std::memory_order_release);
+        }
+        data_.close();
+        data_region_ = 0;
+        control_.close();
+        header_ = nullptr;
+    }
+
+    /*
+     * Pins the most recently published image and releases the previously pinned image.
+     *
+     * @return 'false' if the reader is not open or if the image is invalid.
+     */
+    bool acquire() {
+        if (header_ == nullptr) {
+            return false;
+        }
+        release();
+        auto& h = *header_;
+        auto& pin = h.reader_epoch_[reader_];
+        std::uint64_t slot;
+        std::uint64_t size;
+        std::uint64_t capacity;
+        while (true) {
+            std::uint64_t sequence = h.sequence_.load(std::memory_order_acquire);
+            if (sequence % 2 == 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            slot = h.active_slot_.load(std::memory_order_relaxed);
+            size = h.image_size_[slot].load(std::memory_order_relaxed);
+            capacity = h.slot_capacity_.load(std::memory_order_relaxed);
+            std::uint64_t data_region = h.data_region_.load(std::memory_order_relaxed);
+            epoch_ = h.epoch_[slot].load(std::memory_order_relaxed);
+            pin.store(epoch_, std::memory_order_seq_cst);
+            // If the active slot did not change, the writer will not overwrite the pinned image
+            if (h.sequence_.load(std::memory_order_seq_cst) != sequence) {
+                pin.store(0, std::memory_order_release);
+                continue;
+            }
+            if (data_region == data_region_) {
+                break;
+            }
+            data_.close();
+            data_region_ = 0;
+            if (data_.open(H::DataRegionName(name_, data_region))) {
+                data_region_ = data_region;
+                break;
+            }
+            // The writer may have replaced the data region in the meantime
+            pin.store(0, std::memory_order_release);
+            if (h.data_region_.load(std::memory_order_acquire) == data_region) {
+                epoch_ = 0;
+                return false;
+            }
+        }
+        if (size > capacity || (slot + 1) * capacity > data_.size() ||
+            !tree_.attach(data_.data() + slot * capacity, size)) {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Releases the pinned image. tree() is empty afterwards.
+     */
+    void release() {
+        tree_.close();
+        if (header_ != nullptr) {
+            header_->reader_epoch_[reader_].store(0, std::memory_order_release);
+        }
+        epoch_ = 0;
+    }
+
+    /*
+     * @return The pinned image. The tree is empty if no image is pinned.
+     */
+    [[nodiscard]] const PhTreeFrozen<DIM, T, CONVERTER>& tree() const {
+        return tree_;
+    }
+
+    /*
+     * @return The epoch of the pinned image or '0' if no image is pinned.
+     */
+    [[nodiscard]] std::uint64_t epoch() const {
+        return epoch_;
+    }
+
+    /*
+     * @return 'true' if the writer has published a newer image than the pinned image.
+     */
+    [[nodiscard]] bool has_update() const {
+        if (header_ == nullptr) {
+            return false;
+        }
+        auto slot = header_->active_slot_.load(std::memory_order_relaxed);
+        return header_->epoch_[slot].load(std::memory_order_relaxed) != epoch_;
+    }
+
+  private:
+    PhTreeFrozen<DIM, T, CONVERTER> tree_;
+    SharedMemory control_;
+    SharedMemory data_;
+    SharedTreeHeader* header_ = nullptr;
+    std::string name_;
+    std::uint32_t reader_ = 0;
+    std::uint64_t data_region_ = 0;
+    std::uint64_t epoch_ = 0;
+};
+
+/*
+ * Floating-point `double` versions of the shared PH-Tree.
+ */
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterIEEE<DIM>>
+using PhTreeSharedWriterD = PhTreeSharedWriter<DIM, T, CONVERTER>;
+
+template <dimension_t DIM, typename T, typename CONVERTER = ConverterIEEE<DIM>>
+using PhTreeSharedReaderD = PhTreeSharedReader<DIM, T, CONVERTER>;
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_SHARED_H
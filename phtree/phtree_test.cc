@@ -286,6 +286,53 @@ TEST(PhTreeTest, TestDebug) {
     Debug::CheckConsistency(tree);
 }
 
+template <dimension_t DIM>
+void TestDebugMemorySize() {
+    using Debug = PhTreeDebugHelper;
+    TestTree<DIM, std::string> tree;
+    auto stats = Debug::GetStats(tree);
+    ASSERT_EQ(1, stats.n_nodes_);
+    ASSERT_LT(0, stats.mem_size_);
+    size_t empty_size = stats.mem_size_;
+
+    size_t N = 1000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    size_t value_heap_size = 0;
+    for (size_t i = 0; i < N; i++) {
+        auto& value = tree.emplace(points[i], std::string(100 + i % 10, 'x')).first;
+        value_heap_size += value.capacity();
+    }
+    stats = Debug::GetStats(tree);
+    ASSERT_EQ(N, stats.n_entries_);
+    ASSERT_EQ(0, stats.value_heap_size_);
+    ASSERT_EQ(stats.node_size_ + stats.entry_container_size_, stats.mem_size_);
+    ASSERT_LT(N * (sizeof(TestPoint<DIM>) + sizeof(std::string)), stats.mem_size_);
+    ASSERT_LE(empty_size * stats.n_nodes_, stats.mem_size_);
+    ASSERT_EQ(stats.mem_size_, stats.GetCalculatedMemSize());
+    ASSERT_DOUBLE_EQ((double)stats.mem_size_ / N, stats.GetBytesPerEntry());
+
+    auto stats2 = Debug::GetStats(tree, [](const std::string& value) { return value.capacity(); });
+    ASSERT_EQ(value_heap_size, stats2.value_heap_size_);
+    ASSERT_EQ(stats.mem_size_ + value_heap_size, stats2.mem_size_);
+
+    // The JSON export contains all histograms
+    auto json = stats2.ToJson();
+    ASSERT_EQ('{', json.front());
+    ASSERT_EQ('}', json.back());
+    ASSERT_NE(std::string::npos, json.find("\"n_entries\":" + std::to_string(N) + ","));
+    auto value_heap_json = "\"value_heap_bytes\":" + std::to_string(value_heap_size);
+    ASSERT_NE(std::string::npos, json.find(value_heap_json));
+    ASSERT_NE(std::string::npos, json.find("\"hist_entries_per_depth\":["));
+}
+
+TEST(PhTreeTest, TestDebugMemorySize) {
+    // array_map, sparse_map and std::map nodes
+    TestDebugMemorySize<3>();
+    TestDebugMemorySize<6>();
+    TestDebugMemorySize<10>();
+}
+
 TEST(PhTreeTest, TestInsert) {
     const dimension_t dim = 3;
     TestTree<dim, Id> tree;
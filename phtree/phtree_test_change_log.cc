@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "phtree/phtree_change_log.h"
+#include "phtree/phtree.h"
+#include "phtree/phtree_multimap.h"
+#include "phtree/phtree_operation_log.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_change_log {
+
+using Key = PhPointD<3>;
+using Change = PhTreeChange<Key, int>;
+
+std::vector<Change> GetChanges(const PhTreeChangeLog<Key, int>& log, std::uint64_t version) {
+    std::vector<Change> result;
+    bool ok = log.changes_since(version, [&result](const Change& c) { result.push_back(c); });
+    EXPECT_TRUE(ok);
+    return result;
+}
+
+TEST(PhTreeChangeLogTest, SmokeTest) {
+    PhTreeD<3, int> tree;
+    PhTreeChangeLog<Key, int> log{100};
+    tree.set_listener(&log);
+    ASSERT_EQ(0u, log.version());
+    ASSERT_TRUE(GetChanges(log, 0).empty());
+
+    tree.emplace({1, 2, 3}, 1);
+    tree.emplace({1, 2, 3}, 2);  // not inserted
+    tree.emplace({4, 5, 6}, 3);
+    tree.erase({1, 2, 3});
+    tree.erase({1, 2, 3});  // not found
+    ASSERT_EQ(3u, log.version());
+
+    auto changes = GetChanges(log, 0);
+    ASSERT_EQ(3u, changes.size());
+    ASSERT_EQ(PhTreeOperation::EMPLACE, changes[0].op_);
+    ASSERT_EQ(1u, changes[0].version_);
+    ASSERT_EQ((Key{1, 2, 3}), changes[0].key_);
+    ASSERT_EQ(1, changes[0].value_);
+    ASSERT_EQ(PhTreeOperation::EMPLACE, changes[1].op_);
+    ASSERT_EQ(3, changes[1].value_);
+    ASSERT_EQ(PhTreeOperation::ERASE, changes[2].op_);
+    ASSERT_EQ((Key{1, 2, 3}), changes[2].key_);
+    ASSERT_EQ(3u, changes[2].version_);
+
+    changes = GetChanges(log, 2);
+    ASSERT_EQ(1u, changes.size());
+    ASSERT_EQ(3u, changes[0].version_);
+    ASSERT_TRUE(GetChanges(log, 3).empty());
+
+    tree.clear();
+    changes = GetChanges(log, 3);
+    ASSERT_EQ(1u, changes.size());
+    ASSERT_EQ(PhTreeOperation::CLEAR, changes[0].op_);
+}
+
+TEST(PhTreeChangeLogTest, TestRelocateMultiMap) {
+    PhTreeMultiMapD<3, int> tree;
+    PhTreeChangeLog<Key, int> log{100};
+    tree.set_listener(&log);
+    tree.emplace({1, 1, 1}, 1);
+    tree.emplace({1, 1, 1}, 2);
+    tree.relocate({1, 1, 1}, {2, 2, 2}, 2);
+    tree.erase({1, 1, 1}, 1);
+
+    auto changes = GetChanges(log, 2);
+    ASSERT_EQ(2u, changes.size());
+    ASSERT_EQ(PhTreeOperation::RELOCATE, changes[0].op_);
+    ASSERT_EQ((Key{1, 1, 1}), changes[0].key_);
+    ASSERT_EQ((Key{2, 2, 2}), changes[0].new_key_);
+    ASSERT_EQ(2, changes[0].value_);
+    ASSERT_EQ(PhTreeOperation::ERASE, changes[1].op_);
+    ASSERT_EQ(1, changes[1].value_);
+}
+
+TEST(PhTreeChangeLogTest, TestOverflow) {
+    const size_t CAPACITY = 10;
+    PhTreeD<3, int> tree;
+    PhTreeChangeLog<Key, int> log{CAPACITY};
+    tree.set_listener(&log);
+    std::uint64_t last_seen = 0;
+    for (int i = 0; i < 95; ++i) {
+        tree.emplace({(double)i, 0, 0}, i);
+        if (i % 7 == 0) {
+            // Consumer keeps up
+            auto changes = GetChanges(log, last_seen);
+            ASSERT_FALSE(changes.empty());
+            for (auto& c : changes) {
+                ASSERT_EQ(++last_seen, c.version_);
+                ASSERT_EQ((int)c.version_ - 1, c.value_);
+            }
+        }
+    }
+    ASSERT_EQ(95u, log.version());
+    ASSERT_EQ(CAPACITY, log.size());
+    ASSERT_EQ(86u, log.oldest_version());
+    ASSERT_EQ(CAPACITY, GetChanges(log, 85).size());
+    ASSERT_EQ(3u, GetChanges(log, 92).size());
+    // Consumer fell behind
+    size_t n = 0;
+    ASSERT_FALSE(log.changes_since(84, [&n](const Change&) { ++n; }));
+    ASSERT_EQ(0u, n);
+
+    log.clear();
+    ASSERT_EQ(0u, log.size());
+    ASSERT_TRUE(GetChanges(log, 95).empty());
+    ASSERT_FALSE(log.changes_since(94, [](const Change&) {}));
+    tree.emplace({-1, 0, 0}, 1000);
+    auto changes = GetChanges(log, 95);
+    ASSERT_EQ(1u, changes.size());
+    ASSERT_EQ(1000, changes[0].value_);
+}
+
+TEST(PhTreeChangeLogTest, TestWithOperationLog) {
+    // The change log and the operation log are attached at the same time
+    PhTreeMultiMapD<3, int> tree;
+    PhTreeChangeLog<Key, int> log{100};
+    std::stringstream operations;
+    PhTreeOperationLogWriter<Key, int> writer{operations};
+    PhTreeListenerFanOut<Key, int> listeners;
+    listeners.add(&log);
+    listeners.add(&writer);
+    tree.set_listener(&listeners);
+
+    tree.emplace({1, 2, 3}, 1);
+    tree.emplace({1, 2, 3}, 2);
+    tree.relocate({1, 2, 3}, {4, 5, 6}, 2);
+    tree.erase({1, 2, 3}, 1);
+    ASSERT_EQ(4u, log.version());
+    PhTreeMultiMapD<3, int> tree2;
+    ASSERT_EQ(4u, ReplayOperationLog(operations, tree2));
+    ASSERT_EQ(1u, tree2.size());
+    ASSERT_EQ(1u, tree2.count({4, 5, 6}));
+
+    // Removed listeners are not notified anymore
+    ASSERT_TRUE(listeners.remove(&writer));
+    ASSERT_FALSE(listeners.remove(&writer));
+    tree.clear();
+    ASSERT_EQ(5u, log.version());
+    ASSERT_EQ(PhTreeOperation::CLEAR, GetChanges(log, 4)[0].op_);
+    operations.clear();
+    ASSERT_EQ(0u, ReplayOperationLog(operations, tree2));
+    ASSERT_EQ(1u, tree2.size());
+}
+
+}  // namespace phtree_test_change_log
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define PHTREE_GENERATION_TRACKING
+#define PHTREE_HASH_TRACKING
+#include "phtree/phtree.h"
+#include "phtree/phtree_dirty_regions.h"
+#include "phtree/phtree_multimap.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_compact {
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N) {
+    std::default_random_engine random_engine{0};
+    std::uniform_real_distribution<double> distribution{-1000, 1000};
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = distribution(random_engine);
+        }
+    }
+}
+
+template <dimension_t DIM>
+void CheckContent(const PhTreeD<DIM, size_t>& tree, const std::map<TestPoint<DIM>, size_t>& ref) {
+    PhTreeDebugHelper::CheckConsistency(tree);
+    ASSERT_EQ(ref.size(), tree.size());
+    for (auto& entry : ref) {
+        auto iter = tree.find(entry.first);
+        ASSERT_NE(iter, tree.end());
+        ASSERT_EQ(entry.second, *iter);
+    }
+    size_t n = 0;
+    for (auto iter = tree.begin(); iter != tree.end(); ++iter) {
+        ++n;
+    }
+    ASSERT_EQ(ref.size(), n);
+}
+
+template <dimension_t DIM>
+void SmokeTestCompact() {
+    const size_t N = 10000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    PhTreeD<DIM, size_t> tree;
+    std::map<TestPoint<DIM>, size_t> ref;
+    tree.set_hash_tracking(true);
+    tree.set_generation_tracking(true);
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], i);
+        ref.emplace(points[i], i);
+    }
+    for (size_t i = 0; i < N; i += 2) {
+        tree.erase(points[i]);
+        ref.erase(points[i]);
+    }
+    auto hash = tree.hash();
+    auto generation = tree.generation();
+
+    ASSERT_TRUE(tree.compact());
+
+    CheckContent(tree, ref);
+    // Compaction is not a modification
+    ASSERT_EQ(hash, tree.hash());
+    ASSERT_EQ(generation, tree.generation());
+    size_t n_dirty = 0;
+    for_each_dirty_node(tree, generation, 64, [&n_dirty](const PhBoxD<DIM>&) { ++n_dirty; });
+    ASSERT_EQ(0u, n_dirty);
+
+    // The tree remains usable
+    for (size_t i = 0; i < N; i += 2) {
+        ASSERT_TRUE(tree.emplace(points[i], i).second);
+        ref.emplace(points[i], i);
+    }
+    CheckContent(tree, ref);
+}
+
+TEST(PhTreeCompactTest, SmokeTestCompact1D) {
+    SmokeTestCompact<1>();
+}
+
+TEST(PhTreeCompactTest, SmokeTestCompact3D) {
+    SmokeTestCompact<3>();
+}
+
+TEST(PhTreeCompactTest, SmokeTestCompact6D) {
+    SmokeTestCompact<6>();
+}
+
+TEST(PhTreeCompactTest, SmokeTestCompact10D) {
+    SmokeTestCompact<10>();
+}
+
+TEST(PhTreeCompactTest, TestCompactEmpty) {
+    PhTreeD<3, size_t> tree;
+    ASSERT_FALSE(tree.compact(0));
+    ASSERT_TRUE(tree.compact(1));
+    ASSERT_TRUE(tree.compact());
+    ASSERT_EQ(0u, tree.size());
+    tree.emplace({1, 2, 3}, 42);
+    ASSERT_EQ(42u, tree.find({1, 2, 3}).second());
+}
+
+template <dimension_t DIM>
+void TestCompactIncremental(bool modify_between_steps) {
+    const size_t N = 10000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, 2 * N);
+    PhTreeD<DIM, size_t> tree;
+    std::map<TestPoint<DIM>, size_t> ref;
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], i);
+        ref.emplace(points[i], i);
+    }
+
+    size_t n_steps = 0;
+    size_t next = N;
+    while (!tree.compact(100)) {
+        ++n_steps;
+        if (modify_between_steps) {
+            // insert one point and remove one point
+            tree.emplace(points[next], next);
+            ref.emplace(points[next], next);
+            tree.erase(points[next - N]);
+            ref.erase(points[next - N]);
+            ++next;
+        }
+        PhTreeDebugHelper::CheckConsistency(tree);
+        ASSERT_LT(n_steps, N);
+    }
+    ASSERT_GT(n_steps, 10u);
+    CheckContent(tree, ref);
+
+    // The next compaction starts from the beginning
+    ASSERT_FALSE(tree.compact(1));
+    ASSERT_TRUE(tree.compact());
+    CheckContent(tree, ref);
+}
+
+TEST(PhTreeCompactTest, TestCompactIncremental3D) {
+    TestCompactIncremental<3>(false);
+}
+
+TEST(PhTreeCompactTest, TestCompactIncrementalWithUpdates3D) {
+    TestCompactIncremental<3>(true);
+}
+
+TEST(PhTreeCompactTest, TestCompactIncrementalWithUpdates10D) {
+    TestCompactIncremental<10>(true);
+}
+
+TEST(PhTreeCompactTest, TestCompactClearWhileCompacting) {
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 1000);
+    PhTreeD<3, size_t> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], i);
+    }
+    ASSERT_FALSE(tree.compact(10));
+    tree.clear();
+    ASSERT_TRUE(tree.compact(10));
+    ASSERT_EQ(0u, tree.size());
+}
+
+TEST(PhTreeCompactTest, TestCompactMultiMap) {
+    const size_t N = 10000;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    PhTreeMultiMapD<3, size_t> tree;
+    for (size_t i = 0; i < N; ++i) {
+        // Two values per key
+        tree.emplace(points[i], i);
+        tree.emplace(points[i], i + N);
+    }
+
+    ASSERT_TRUE(tree.compact());
+
+    PhTreeDebugHelper::CheckConsistency(tree);
+    ASSERT_EQ(2 * N, tree.size());
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ(2u, tree.count(points[i]));
+        ASSERT_EQ(1u, tree.erase(points[i], i));
+    }
+    ASSERT_EQ(N, tree.size());
+}
+
+}  // namespace phtree_test_compact
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The container thresholds must be defined before any PH-Tree header is included.
+#define PHTREE_ARRAY_MAP_MAX_DIM 6
+#define PHTREE_SPARSE_MAP_MAX_DIM 10
+
+#include "phtree/phtree.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_container_thresholds {
+
+template <dimension_t DIM>
+using EntryMapT = v16::EntryMap<DIM, v16::Entry<DIM, int, scalar_64_t>>;
+
+static_assert(std::is_same_v<EntryMapT<6>, array_map<v16::Entry<6, int, scalar_64_t>, 64>>);
+static_assert(std::is_same_v<EntryMapT<7>, sparse_map<v16::Entry<7, int, scalar_64_t>>>);
+static_assert(std::is_same_v<EntryMapT<10>, sparse_map<v16::Entry<10, int, scalar_64_t>>>);
+static_assert(std::is_same_v<EntryMapT<11>, std::map<hc_pos_t, v16::Entry<11, int, scalar_64_t>>>);
+
+template <dimension_t DIM>
+void SmokeTest(size_t N) {
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<int> distribution(0, 100);
+    PhTree<DIM, int> tree;
+    std::vector<PhPoint<DIM>> points;
+    for (size_t i = 0; i < N; ++i) {
+        PhPoint<DIM> p{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = distribution(random_engine);
+        }
+        if (tree.emplace(p, (int)i).second) {
+            points.push_back(p);
+        }
+    }
+    ASSERT_EQ(points.size(), tree.size());
+    PhTreeDebugHelper::CheckConsistency(tree);
+
+    size_t n = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        ++n;
+    }
+    ASSERT_EQ(points.size(), n);
+    for (auto& p : points) {
+        ASSERT_EQ(1u, tree.count(p));
+        ASSERT_EQ(1u, tree.erase(p));
+    }
+    ASSERT_EQ(0u, tree.size());
+    PhTreeDebugHelper::CheckConsistency(tree);
+}
+
+TEST(PhTreeContainerThresholdsTest, SmokeTestArrayMap) {
+    SmokeTest<6>(10000);
+}
+
+TEST(PhTreeContainerThresholdsTest, SmokeTestSparseMap) {
+    SmokeTest<9>(10000);
+}
+
+TEST(PhTreeContainerThresholdsTest, SmokeTestStdMap) {
+    SmokeTest<11>(10000);
+}
+
+}  // namespace phtree_test_container_thresholds
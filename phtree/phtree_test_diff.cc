@@ -0,0 +1,214 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Test hash() and diff() with cached node hashes
+#define PHTREE_HASH_TRACKING
+#include "phtree/phtree.h"
+#include "phtree/phtree_diff.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N, double max = 1000.) {
+    DoubleRng rng(-max, max);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+    }
+}
+
+// Expected differences: key -> (value_a, value_b), -1 means missing
+template <dimension_t DIM>
+using DiffMap = std::map<TestPoint<DIM>, std::pair<int, int>>;
+
+template <dimension_t DIM>
+DiffMap<DIM> CalcDiff(PhTreeD<DIM, int>& a, PhTreeD<DIM, int>& b) {
+    DiffMap<DIM> result;
+    diff(a, b, [&result](const TestPoint<DIM>& key, const int* value_a, const int* value_b) {
+        ASSERT_TRUE(value_a != nullptr || value_b != nullptr);
+        ASSERT_EQ(0u, result.count(key));
+        result[key] = {value_a ? *value_a : -1, value_b ? *value_b : -1};
+    });
+    return result;
+}
+
+template <dimension_t DIM>
+void SmokeTestDiff(bool tracking) {
+    const size_t N = 2000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, 2 * N);
+    PhTreeD<DIM, int> a;
+    PhTreeD<DIM, int> b;
+    a.set_hash_tracking(tracking);
+    b.set_hash_tracking(tracking);
+    for (size_t i = 0; i < N; ++i) {
+        a.emplace(points[i], (int)i);
+        b.emplace(points[N - i - 1], (int)(N - i - 1));
+    }
+    ASSERT_EQ(a.hash(), b.hash());
+    ASSERT_TRUE(CalcDiff(a, b).empty());
+
+    DiffMap<DIM> expected;
+    auto expect = [&expected, &a, &b](const TestPoint<DIM>& key) {
+        auto ia = a.find(key);
+        auto ib = b.find(key);
+        int va = ia == a.end() ? -1 : *ia;
+        int vb = ib == b.end() ? -1 : *ib;
+        if (va != vb) {
+            expected[key] = {va, vb};
+        } else {
+            expected.erase(key);
+        }
+    };
+    for (size_t i = 0; i < N; i += 7) {
+        // new entries
+        b.emplace(points[N + i], (int)(N + i));
+        expect(points[N + i]);
+        // erased entries
+        b.erase(points[i]);
+        expect(points[i]);
+    }
+    for (size_t i = 1; i < N; i += 13) {
+        // modified values
+        b[points[i]] = 100000 + (int)i;
+        expect(points[i]);
+        // erase(iterator) and emplace_hint()
+        auto iter = a.find(points[i + 1]);
+        a.erase(iter);
+        a.emplace_hint(iter, points[N + i + 1], 42);
+        expect(points[i + 1]);
+        expect(points[N + i + 1]);
+    }
+    ASSERT_NE(a.hash(), b.hash());
+    ASSERT_EQ(expected, CalcDiff(a, b));
+
+    // Make the trees equal again
+    for (auto& e : expected) {
+        if (e.second.first == -1) {
+            a.emplace(e.first, e.second.second);
+        } else if (e.second.second == -1) {
+            a.erase(e.first);
+        } else {
+            a[e.first] = e.second.second;
+        }
+    }
+    ASSERT_TRUE(CalcDiff(a, b).empty());
+    ASSERT_EQ(a.hash(), b.hash());
+}
+
+TEST(PhTreeDiffTest, SmokeTestDiff) {
+    SmokeTestDiff<1>(true);
+    SmokeTestDiff<3>(true);
+    SmokeTestDiff<3>(false);
+    SmokeTestDiff<6>(true);
+    SmokeTestDiff<10>(true);
+}
+
+TEST(PhTreeDiffTest, TestEmptyTrees) {
+    PhTreeD<3, int> a;
+    PhTreeD<3, int> b;
+    ASSERT_EQ(a.hash(), b.hash());
+    ASSERT_TRUE(CalcDiff(a, b).empty());
+    b.emplace({1, 2, 3}, 5);
+    auto d = CalcDiff(a, b);
+    ASSERT_EQ(1u, d.size());
+    ASSERT_EQ((std::pair<int, int>{-1, 5}), d.begin()->second);
+    a.emplace({1, 2, 3}, 5);
+    ASSERT_EQ(a.hash(), b.hash());
+    b.clear();
+    d = CalcDiff(a, b);
+    ASSERT_EQ(1u, d.size());
+    ASSERT_EQ((std::pair<int, int>{5, -1}), d.begin()->second);
+}
+
+TEST(PhTreeDiffTest, TestHashTracking) {
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 1000);
+    PhTreeD<3, int> a;
+    PhTreeD<3, int> b;
+    for (size_t i = 0; i < points.size(); ++i) {
+        a.emplace(points[i], (int)i);
+        b.emplace(points[i], (int)i);
+    }
+    b.set_hash_tracking(true);
+    auto hash = a.hash();
+    ASSERT_EQ(hash, b.hash());
+    b[points[5]] = 17;
+    ASSERT_NE(hash, b.hash());
+    b[points[5]] = 5;
+    ASSERT_EQ(hash, b.hash());
+    // Hashes are recalculated when tracking is enabled again
+    b.set_hash_tracking(false);
+    b[points[5]] = 17;
+    b.set_hash_tracking(true);
+    ASSERT_NE(hash, b.hash());
+    ASSERT_EQ(1u, CalcDiff(a, b).size());
+}
+
+TEST(PhTreeDiffTest, TestBoxKeysAndCustomHash) {
+    struct Value {
+        int id_;
+        int payload_;
+    };
+    // Only the id is relevant for the diff
+    struct ValueHash {
+        size_t operator()(const Value& v) const {
+            return std::hash<int>{}(v.id_);
+        }
+    };
+    PhTreeBoxD<2, Value> a;
+    PhTreeBoxD<2, Value> b;
+    a.emplace({{1, 1}, {2, 2}}, Value{1, 1});
+    a.emplace({{1, 1}, {3, 3}}, Value{2, 1});
+    b.emplace({{1, 1}, {2, 2}}, Value{1, 2});
+    b.emplace({{1, 1}, {3, 3}}, Value{3, 1});
+    ASSERT_NE(a.hash(ValueHash{}), b.hash(ValueHash{}));
+    std::vector<PhBoxD<2>> keys;
+    diff(
+        a,
+        b,
+        [&keys](const PhBoxD<2>& key, const Value* va, const Value* vb) {
+            ASSERT_EQ(2, va->id_);
+            ASSERT_EQ(3, vb->id_);
+            keys.emplace_back(key);
+        },
+        ValueHash{});
+    ASSERT_EQ(1u, keys.size());
+    ASSERT_EQ((PhBoxD<2>{{1, 1}, {3, 3}}), keys[0]);
+}
@@ -0,0 +1,517 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "phtree/phtree_frozen.h"
+#include "phtree/phtree_frozen_file.h"
+#include "phtree/phtree.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+template <dimension_t DIM, typename T>
+using TestTree = PhTreeD<DIM, T>;
+
+template <dimension_t DIM, typename T>
+using TestFrozenTree = PhTreeFrozenD<DIM, T>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+struct Id {
+    Id() = default;
+
+    explicit Id(const int i) : _i(i), data_{0} {};
+
+    bool operator==(const Id& rhs) const {
+        return _i == rhs._i;
+    }
+
+    int _i;
+    int data_;
+};
+
+/*
+ * The image must be 64 byte aligned.
+ */
+class AlignedImage {
+  public:
+    explicit AlignedImage(const std::string& data) : buffer_((data.size() + 63) / 64 + 1) {
+        std::copy(data.begin(), data.end(), reinterpret_cast<char*>(buffer_.data()));
+        size_ = data.size();
+    }
+
+    char* data() {
+        return reinterpret_cast<char*>(buffer_.data());
+    }
+
+    const char* data() const {
+        return reinterpret_cast<const char*>(buffer_.data());
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+  private:
+    struct alignas(64) Block {
+        char bytes[64];
+    };
+    std::vector<Block> buffer_;
+    size_t size_;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N) {
+    DoubleRng rng(-1000, 1000);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        TestPoint<DIM> point{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            point[d] = rng.next();
+        }
+        points.push_back(point);
+    }
+}
+
+template <dimension_t DIM>
+AlignedImage CreateImage(TestTree<DIM, Id>& tree, std::vector<TestPoint<DIM>>& points, size_t N) {
+    generateCube(points, N);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    write_frozen(tree, ss);
+    return AlignedImage(ss.str());
+}
+
+template <dimension_t DIM>
+void SmokeTestFrozen(size_t N) {
+    TestTree<DIM, Id> tree;
+    std::vector<TestPoint<DIM>> points;
+    AlignedImage image = CreateImage(tree, points, N);
+
+    TestFrozenTree<DIM, Id> frozen;
+    ASSERT_TRUE(frozen.attach(image.data(), image.size()));
+    ASSERT_EQ(tree.size(), frozen.size());
+    ASSERT_EQ(tree.empty(), frozen.empty());
+
+    // find
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ(1, frozen.count(points[i]));
+        auto it = frozen.find(points[i]);
+        ASSERT_NE(frozen.end(), it);
+        ASSERT_EQ((int)i, it->_i);
+        ASSERT_EQ(points[i], it.first());
+    }
+    DoubleRng rng(-1000, 1000);
+    for (size_t i = 0; i < 100; ++i) {
+        TestPoint<DIM> p{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+        ASSERT_EQ(tree.count(p), frozen.count(p));
+        ASSERT_EQ(tree.find(p) == tree.end(), frozen.find(p) == frozen.end());
+    }
+
+    // iterators: must return the same entries in the same order
+    auto it_live = tree.begin();
+    for (auto it = frozen.begin(); it != frozen.end(); ++it, ++it_live) {
+        ASSERT_NE(tree.end(), it_live);
+        ASSERT_EQ(it_live.first(), it.first());
+        ASSERT_EQ(it_live->_i, it->_i);
+    }
+    ASSERT_EQ(tree.end(), it_live);
+
+    // for_each
+    size_t n = 0;
+    auto callback = [&n, &tree](const TestPoint<DIM>& key, const Id& id) {
+        ASSERT_EQ(tree.find(key)->_i, id._i);
+        ++n;
+    };
+    frozen.for_each(callback);
+    ASSERT_EQ(N, n);
+
+    // window queries
+    for (int i = 0; i < 100; ++i) {
+        TestPoint<DIM> min{};
+        TestPoint<DIM> max{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            double a = rng.next();
+            double b = a + std::abs(rng.next()) / 2;
+            min[d] = a;
+            max[d] = b;
+        }
+        PhBoxD<DIM> box{min, max};
+        std::set<int> expected;
+        for (auto it = tree.begin_query(box); it != tree.end(); ++it) {
+            expected.insert(it->_i);
+        }
+        std::set<int> actual;
+        for (auto it = frozen.begin_query(box); it != frozen.end(); ++it) {
+            actual.insert(it->_i);
+        }
+        ASSERT_EQ(expected, actual);
+        std::set<int> actual_for_each;
+        auto collect = [&actual_for_each](const TestPoint<DIM>&, const Id& id) {
+            actual_for_each.insert(id._i);
+        };
+        frozen.for_each(box, collect);
+        ASSERT_EQ(expected, actual_for_each);
+    }
+
+    // kNN
+    for (int i = 0; i < 20; ++i) {
+        TestPoint<DIM> center{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            center[d] = rng.next();
+        }
+        size_t k = 10;
+        std::vector<double> expected;
+        auto it_knn = tree.begin_knn_query(k, center, DistanceEuclidean<DIM>());
+        for (; it_knn != tree.end(); ++it_knn) {
+            expected.push_back(it_knn.distance());
+        }
+        std::vector<double> actual;
+        auto it = frozen.begin_knn_query(k, center, DistanceEuclidean<DIM>());
+        for (; it != frozen.end(); ++it) {
+            ASSERT_DOUBLE_EQ(DistanceEuclidean<DIM>()(center, it.first()), it.distance());
+            actual.push_back(it.distance());
+        }
+        ASSERT_EQ(expected, actual);
+    }
+}
+
+TEST(PhTreeFrozenTest, SmokeTestDims) {
+    SmokeTestFrozen<1>(1000);
+    SmokeTestFrozen<3>(10000);
+    SmokeTestFrozen<6>(10000);
+    SmokeTestFrozen<10>(1000);
+    SmokeTestFrozen<20>(1000);
+}
+
+TEST(PhTreeFrozenTest, TestSmallTrees) {
+    SmokeTestFrozen<3>(0);
+    SmokeTestFrozen<3>(1);
+    SmokeTestFrozen<3>(2);
+}
+
+TEST(PhTreeFrozenTest, TestFilter) {
+    const dimension_t dim = 3;
+    TestTree<dim, Id> tree;
+    std::vector<TestPoint<dim>> points;
+    AlignedImage image = CreateImage(tree, points, 1000);
+    TestFrozenTree<dim, Id> frozen;
+    ASSERT_TRUE(frozen.attach(image.data(), image.size()));
+
+    FilterAABB filter{{-500, -500, -500}, {500, 500, 500}, tree.converter()};
+    size_t expected = 0;
+    for (auto it = tree.begin(filter); it != tree.end(); ++it) {
+        ++expected;
+    }
+    size_t actual = 0;
+    for (auto it = frozen.begin(filter); it != frozen.end(); ++it) {
+        ++actual;
+    }
+    ASSERT_LT(0, expected);
+    ASSERT_EQ(expected, actual);
+}
+
+TEST(PhTreeFrozenTest, TestBoxKeys) {
+    const dimension_t dim = 3;
+    PhTreeBoxD<dim, int> tree;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto max = points[i];
+        for (auto& x : max) {
+            x += 10;
+        }
+        tree.emplace({points[i], max}, (int)i);
+    }
+    std::stringstream ss;
+    write_frozen(tree, ss);
+    AlignedImage image(ss.str());
+    PhTreeFrozenBoxD<dim, int> frozen;
+    ASSERT_TRUE(frozen.attach(image.data(), image.size()));
+
+    PhBoxD<dim> query{{-100, -100, -100}, {300, 300, 300}};
+    std::set<int> expected;
+    for (auto it = tree.begin_query(query); it != tree.end(); ++it) {
+        expected.insert(*it);
+    }
+    std::set<int> actual;
+    for (auto it = frozen.begin_query(query); it != frozen.end(); ++it) {
+        actual.insert(*it);
+    }
+    ASSERT_LT(0u, expected.size());
+    ASSERT_EQ(expected, actual);
+}
+
+TEST(PhTreeFrozenTest, TestMappedFile) {
+    const dimension_t dim = 3;
+    TestTree<dim, Id> tree;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 10000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::string path = testing::TempDir() + "phtree_test_frozen.bin";
+    {
+        std::ofstream out(path, std::ios::binary);
+        write_frozen(tree, out);
+    }
+
+    PhTreeFrozenFileD<dim, Id> frozen;
+    ASSERT_TRUE(frozen.open(path));
+    ASSERT_EQ(tree.size(), frozen.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ((int)i, frozen.find(points[i])->_i);
+    }
+
+    // The tree can be moved
+    PhTreeFrozenFileD<dim, Id> frozen2 = std::move(frozen);
+    ASSERT_EQ(tree.size(), frozen2.size());
+    ASSERT_EQ(0, frozen2.find(points[0])->_i);
+
+    frozen2.close();
+    ASSERT_EQ(0, frozen2.size());
+    ASSERT_EQ(frozen2.end(), frozen2.find(points[0]));
+    ASSERT_FALSE(frozen2.open(path + ".does_not_exist"));
+    std::remove(path.c_str());
+}
+
+TEST(PhTreeFrozenTest, TestInvalidImages) {
+    const dimension_t dim = 3;
+    TestTree<dim, Id> tree;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    write_frozen(tree, ss);
+    std::string data = ss.str();
+
+    TestFrozenTree<dim, Id> frozen;
+    ASSERT_FALSE(frozen.attach(nullptr, 0));
+
+    // truncated
+    AlignedImage truncated(data.substr(0, data.size() - 1));
+    ASSERT_FALSE(frozen.attach(truncated.data(), truncated.size()));
+    ASSERT_EQ(0, frozen.size());
+    ASSERT_EQ(frozen.end(), frozen.begin());
+
+    // wrong dimensionality
+    AlignedImage image(data);
+    TestFrozenTree<dim + 1, Id> frozen4;
+    ASSERT_FALSE(frozen4.attach(image.data(), image.size()));
+
+    // wrong value size
+    TestFrozenTree<dim, int> frozen_int;
+    ASSERT_FALSE(frozen_int.attach(image.data(), image.size()));
+
+    // corrupted header
+    std::string corrupted = data;
+    corrupted[0] = 'x';
+    AlignedImage corrupted_image(corrupted);
+    ASSERT_FALSE(frozen.attach(corrupted_image.data(), corrupted_image.size()));
+
+    // misaligned
+    std::vector<char> misaligned(data.size() + 64 + 1);
+    char* start = misaligned.data();
+    while (reinterpret_cast<std::uintptr_t>(start) % 64 != 1) {
+        ++start;
+    }
+    std::copy(data.begin(), data.end(), start);
+    ASSERT_FALSE(frozen.attach(start, data.size()));
+}
+
+TEST(PhTreeFrozenTest, TestCorruptedNodes) {
+    const dimension_t dim = 3;
+    TestTree<dim, Id> tree;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    write_frozen(tree, ss);
+    const std::string data = ss.str();
+    v16::FrozenHeaderV16 h{};
+    std::copy(data.data(), data.data() + sizeof(h), reinterpret_cast<char*>(&h));
+    ASSERT_GT(h.num_nodes_, 1u);
+
+    // Modifies a copy of the image and checks that it is rejected.
+    auto assert_rejected = [&](auto modify) {
+        AlignedImage image(data);
+        auto* nodes = reinterpret_cast<v16::FrozenNodeV16*>(image.data() + h.nodes_offset_);
+        auto* refs = reinterpret_cast<std::uint64_t*>(image.data() + h.refs_offset_);
+        auto* hc_pos = reinterpret_cast<hc_pos_t*>(image.data() + h.hc_pos_offset_);
+        modify(nodes, refs, hc_pos);
+        TestFrozenTree<dim, Id> frozen;
+        ASSERT_FALSE(frozen.attach(image.data(), image.size()));
+        ASSERT_EQ(0, frozen.size());
+    };
+    AlignedImage image(data);
+    TestFrozenTree<dim, Id> frozen;
+    ASSERT_TRUE(frozen.attach(image.data(), image.size()));
+
+    // Find an entry that references a child node
+    size_t node_entry = 0;
+    while ((reinterpret_cast<const std::uint64_t*>(image.data() + h.refs_offset_)[node_entry] &
+            v16::FrozenHeaderV16::NODE_FLAG) == 0) {
+        ++node_entry;
+    }
+    auto node_flag = v16::FrozenHeaderV16::NODE_FLAG;
+    // cycle: a child node references the root
+    assert_rejected([&](auto*, auto* refs, auto*) { refs[node_entry] = node_flag | 0; });
+    // child node out of bounds
+    assert_rejected([&](auto*, auto* refs, auto*) { refs[node_entry] = node_flag | h.num_nodes_; });
+    // value out of bounds
+    assert_rejected([&](auto* nodes, auto* refs, auto*) {
+        auto& leaf = nodes[h.num_nodes_ - 1];
+        refs[leaf.first_entry_] = h.num_entries_;
+    });
+    // entries out of bounds
+    assert_rejected([&](auto* nodes, auto*, auto*) { nodes[1].entry_count_ = 1u << 30; });
+    assert_rejected([&](auto* nodes, auto*, auto*) { nodes[1].first_entry_ = h.num_slots_; });
+    // hypercube addresses that are not ascending or too large
+    assert_rejected([&](auto* nodes, auto*, auto* hc_pos) {
+        hc_pos[nodes[0].first_entry_ + 1] = hc_pos[nodes[0].first_entry_];
+    });
+    assert_rejected([&](auto* nodes, auto*, auto* hc_pos) {
+        hc_pos[nodes[0].first_entry_ + nodes[0].entry_count_ - 1] = 1 << dim;
+    });
+    // depth larger than the bit width
+    assert_rejected([&](auto* nodes, auto*, auto*) {
+        nodes[0].postfix_len_ = MAX_BIT_WIDTH<scalar_64_t>;
+    });
+}
+
+template <dimension_t DIM>
+void SmokeTestFreeze(size_t N) {
+    TestTree<DIM, Id> tree;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+
+    auto frozen = freeze(tree);
+    ASSERT_EQ(tree.size(), frozen.size());
+    ASSERT_EQ(tree.empty(), frozen.empty());
+    ASSERT_LT(0u, frozen.memory_size());
+
+    // The frozen tree is independent of the original tree
+    auto frozen2 = std::move(frozen);
+    tree.clear();
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto it = frozen2.find(points[i]);
+        ASSERT_NE(frozen2.end(), it);
+        ASSERT_EQ((int)i, it->_i);
+    }
+
+    // window queries
+    DoubleRng rng(-1000, 1000);
+    for (int i = 0; i < 100; ++i) {
+        TestPoint<DIM> min{};
+        TestPoint<DIM> max{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            min[d] = rng.next();
+            max[d] = min[d] + std::abs(rng.next()) / 2;
+        }
+        std::set<int> expected;
+        for (size_t j = 0; j < points.size(); ++j) {
+            bool inside = true;
+            for (dimension_t d = 0; d < DIM; ++d) {
+                inside &= points[j][d] >= min[d] && points[j][d] <= max[d];
+            }
+            if (inside) {
+                expected.insert((int)j);
+            }
+        }
+        std::set<int> actual;
+        for (auto it = frozen2.begin_query({min, max}); it != frozen2.end(); ++it) {
+            actual.insert(it->_i);
+        }
+        ASSERT_EQ(expected, actual);
+    }
+
+    // kNN
+    if (N > 0) {
+        TestPoint<DIM> center{};
+        auto it = frozen2.begin_knn_query(1, center, DistanceEuclidean<DIM>());
+        ASSERT_NE(frozen2.end(), it);
+        double min_dist = std::numeric_limits<double>::max();
+        for (auto& p : points) {
+            min_dist = std::min(min_dist, DistanceEuclidean<DIM>()(center, p));
+        }
+        ASSERT_DOUBLE_EQ(min_dist, it.distance());
+    }
+
+    frozen2.close();
+    ASSERT_EQ(0u, frozen2.size());
+    ASSERT_EQ(0u, frozen2.memory_size());
+}
+
+TEST(PhTreeFrozenTest, TestFreeze) {
+    SmokeTestFreeze<1>(1000);
+    SmokeTestFreeze<3>(10000);
+    SmokeTestFreeze<10>(1000);
+    SmokeTestFreeze<3>(0);
+    SmokeTestFreeze<3>(1);
+}
+
+TEST(PhTreeFrozenTest, TestFreezeNonTrivialValues) {
+    const dimension_t dim = 3;
+    TestTree<dim, std::string> tree;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], "value_" + std::to_string(i));
+    }
+
+    auto frozen = freeze(tree);
+    ASSERT_EQ(tree.size(), frozen.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ("value_" + std::to_string(i), *frozen.find(points[i]));
+    }
+    size_t n = 0;
+    auto callback = [&n, &tree](const TestPoint<dim>& key, const std::string& value) {
+        ASSERT_EQ(*tree.find(key), value);
+        ++n;
+    };
+    frozen.for_each(callback);
+    ASSERT_EQ(points.size(), n);
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define PHTREE_GENERATION_TRACKING
+#include "phtree/phtree.h"
+#include "phtree/phtree_dirty_regions.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_generation {
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+template <dimension_t DIM>
+using TestRegion = PhBoxD<DIM>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N) {
+    DoubleRng rng(-1000, 1000);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+    }
+}
+
+template <dimension_t DIM>
+bool IsInRegion(const TestPoint<DIM>& p, const TestRegion<DIM>& region) {
+    for (dimension_t d = 0; d < DIM; ++d) {
+        if (p[d] < region.min()[d] || p[d] > region.max()[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <dimension_t DIM>
+size_t CountRegions(const std::vector<TestRegion<DIM>>& regions, const TestPoint<DIM>& p) {
+    size_t n = 0;
+    for (auto& r : regions) {
+        n += IsInRegion(p, r);
+    }
+    return n;
+}
+
+template <dimension_t DIM>
+std::vector<TestRegion<DIM>> GetRegions(
+    const PhTreeD<DIM, int>& tree, std::uint64_t since, size_t max_depth) {
+    std::vector<TestRegion<DIM>> regions;
+    for_each_dirty_node(
+        tree, since, max_depth, [&regions](const TestRegion<DIM>& r) { regions.push_back(r); });
+    return regions;
+}
+
+template <dimension_t DIM>
+void SmokeTestDirtyRegions() {
+    const size_t N = 10000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, 2 * N);
+    PhTreeD<DIM, int> tree;
+    tree.set_generation_tracking(true);
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    auto generation = tree.generation();
+    ASSERT_TRUE(GetRegions(tree, generation, 100).empty());
+
+    std::vector<TestPoint<DIM>> modified;
+    for (size_t i = 0; i < N; i += 997) {
+        tree.emplace(points[N + i], 0);
+        modified.emplace_back(points[N + i]);
+        tree.erase(points[i + 1]);
+        modified.emplace_back(points[i + 1]);
+        tree[points[i + 2]] = 42;
+        modified.emplace_back(points[i + 2]);
+    }
+    ASSERT_LT(generation, tree.generation());
+
+    auto regions = GetRegions(tree, generation, 100);
+    ASSERT_FALSE(regions.empty());
+    ASSERT_LE(regions.size(), modified.size());
+    for (auto& p : modified) {
+        ASSERT_LE(1u, CountRegions(regions, p));
+    }
+    // Regions do not overlap
+    for (auto& p : points) {
+        ASSERT_GE(1u, CountRegions(regions, p));
+    }
+
+    // Only the root node
+    regions = GetRegions(tree, generation, 0);
+    ASSERT_EQ(1u, regions.size());
+    for (auto& p : points) {
+        ASSERT_TRUE(IsInRegion(p, regions[0]));
+    }
+
+    // Coarser regions
+    auto coarse_regions = GetRegions(tree, generation, 1);
+    ASSERT_LE(coarse_regions.size(), GetRegions(tree, generation, 100).size());
+    for (auto& p : modified) {
+        ASSERT_EQ(1u, CountRegions(coarse_regions, p));
+    }
+
+    ASSERT_TRUE(GetRegions(tree, tree.generation(), 100).empty());
+}
+
+TEST(PhTreeGenerationTest, SmokeTestDirtyRegions) {
+    SmokeTestDirtyRegions<1>();
+    SmokeTestDirtyRegions<3>();
+    SmokeTestDirtyRegions<6>();
+    SmokeTestDirtyRegions<10>();
+}
+
+TEST(PhTreeGenerationTest, TestTrackingDisabled) {
+    PhTreeD<3, int> tree;
+    tree.emplace({1, 2, 3}, 1);
+    ASSERT_EQ(0u, tree.generation());
+    ASSERT_TRUE(GetRegions(tree, 0, 100).empty());
+
+    tree.set_generation_tracking(true);
+    tree.emplace({4, 5, 6}, 1);
+    ASSERT_EQ(1u, tree.generation());
+    auto regions = GetRegions(tree, 0, 100);
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<3>({4, 5, 6}, regions[0]));
+}
+
+TEST(PhTreeGenerationTest, TestNoModification) {
+    PhTreeD<3, int> tree;
+    tree.set_generation_tracking(true);
+    tree.emplace({1, 2, 3}, 1);
+    tree.emplace({100, 100, 100}, 2);
+    auto generation = tree.generation();
+
+    // Failed insertions and erase() misses do not modify the tree
+    ASSERT_FALSE(tree.emplace({1, 2, 3}, 5).second);
+    ASSERT_FALSE(tree.insert({100, 100, 100}, 5).second);
+    ASSERT_EQ(0u, tree.erase({4, 5, 6}));
+    ASSERT_EQ(0u, tree.erase({1, 2, 4}));
+    ASSERT_EQ(generation, tree.generation());
+    ASSERT_TRUE(GetRegions(tree, generation, 100).empty());
+
+    // Assignments to existing entries are modifications
+    tree[{1, 2, 3}] = 42;
+    ASSERT_EQ(generation + 1, tree.generation());
+    auto regions = GetRegions(tree, generation, 100);
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<3>({1, 2, 3}, regions[0]));
+
+    generation = tree.generation();
+    ASSERT_FALSE(tree.insert_or_assign({100, 100, 100}, 43).second);
+    ASSERT_EQ(generation + 1, tree.generation());
+    regions = GetRegions(tree, generation, 100);
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<3>({100, 100, 100}, regions[0]));
+}
+
+TEST(PhTreeGenerationTest, TestEraseWithMerge) {
+    PhTreeD<3, int> tree;
+    tree.set_generation_tracking(true);
+    tree.emplace({-100, -100, -100}, 1);
+    tree.emplace({100, 100, 100}, 2);
+    tree.emplace({100, 100, 101}, 3);
+    tree.emplace({100, 100, 102}, 4);
+    auto generation = tree.generation();
+
+    // Erase with merge of the sub-node
+    tree.erase({100, 100, 101});
+    tree.erase({100, 100, 102});
+    auto regions = GetRegions(tree, generation, 100);
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<3>({100, 100, 101}, regions[0]));
+    ASSERT_TRUE(IsInRegion<3>({100, 100, 102}, regions[0]));
+
+    // Erase with iterator and emplace_hint()
+    generation = tree.generation();
+    auto iter = tree.find({100, 100, 100});
+    tree.erase(iter);
+    tree.emplace_hint(iter, {100, 100, 103}, 5);
+    regions = GetRegions(tree, generation, 100);
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<3>({100, 100, 100}, regions[0]));
+    ASSERT_TRUE(IsInRegion<3>({100, 100, 103}, regions[0]));
+
+    generation = tree.generation();
+    tree.clear();
+    regions = GetRegions(tree, generation, 100);
+    ASSERT_EQ(1u, regions.size());
+}
+
+TEST(PhTreeGenerationTest, TestBoxKeys) {
+    PhTreeBoxD<2, int> tree;
+    tree.set_generation_tracking(true);
+    for (int i = 0; i < 100; ++i) {
+        tree.emplace({{(double)i, (double)i}, {i + 1., i + 2.}}, i);
+    }
+    auto generation = tree.generation();
+    tree.emplace({{50.5, 50.5}, {51, 52}}, 1000);
+    std::vector<PhBoxD<2>> regions;
+    for_each_dirty_node(
+        tree, generation, 100, [&regions](const PhBoxD<2>& r) { regions.push_back(r); });
+    ASSERT_EQ(1u, regions.size());
+    ASSERT_TRUE(IsInRegion<2>({50.5, 50.5}, regions[0]));
+    ASSERT_TRUE(IsInRegion<2>({51, 52}, regions[0]));
+}
+
+}  // namespace phtree_test_generation
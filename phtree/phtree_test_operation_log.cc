@@ -0,0 +1,328 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "phtree/phtree_change_log.h"
+#include "phtree/phtree_operation_log.h"
+#include "phtree/phtree_serialization.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N, double max = 1000.) {
+    DoubleRng rng(-max, max);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+    }
+}
+
+template <typename TREE>
+void AssertTreesEqual(const TREE& expected, const TREE& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    size_t n = 0;
+    for (auto it = expected.begin(); it != expected.end(); ++it) {
+        auto it2 = actual.find(it.first());
+        ASSERT_NE(it2, actual.end());
+        ASSERT_EQ(*it, *it2);
+        ++n;
+    }
+    ASSERT_EQ(expected.size(), n);
+}
+
+template <typename TREE>
+std::string Snapshot(const TREE& tree) {
+    std::stringstream ss;
+    serialize(tree, ss);
+    return ss.str();
+}
+
+template <dimension_t DIM>
+void SmokeTestReplay(size_t batch_size) {
+    const size_t N = 1000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    PhTreeD<DIM, size_t> tree;
+    for (size_t i = 0; i < N / 2; ++i) {
+        tree.emplace(points[i], i);
+    }
+    std::string snapshot = Snapshot(tree);
+
+    std::stringstream log;
+    PhTreeOperationLogWriter<TestPoint<DIM>, size_t> writer{log};
+    tree.set_listener(&writer);
+    for (size_t i = N / 2; i < N; ++i) {
+        tree.emplace(points[i], i);
+        // existing entry -> no-op
+        tree.emplace(points[i], i + 1);
+    }
+    for (size_t i = 0; i < N; i += 3) {
+        tree.erase(points[i]);
+    }
+    for (size_t i = 0; i < N; i += 5) {
+        // Assignments via references are not logged, only the insertion of the default value
+        tree[points[i]];
+    }
+    auto iter = tree.find(points[1]);
+    tree.erase(iter);
+    tree.insert(points[0], 42);
+    tree.set_listener(nullptr);
+
+    PhTreeD<DIM, size_t> tree2;
+    std::stringstream ss{snapshot};
+    ASSERT_TRUE(deserialize(tree2, ss));
+    ASSERT_EQ(N / 2, tree2.size());
+    size_t n_applied = ReplayOperationLog(log, tree2, ValueCodec<size_t>(), batch_size);
+    ASSERT_FALSE(log.fail());
+    ASSERT_LT(0u, n_applied);
+    AssertTreesEqual(tree, tree2);
+}
+
+TEST(PhTreeOperationLogTest, SmokeTestReplay) {
+    SmokeTestReplay<1>(4096);
+    SmokeTestReplay<3>(4096);
+    SmokeTestReplay<3>(1);
+    SmokeTestReplay<3>(17);
+    SmokeTestReplay<10>(4096);
+}
+
+TEST(PhTreeOperationLogTest, TestReplayClear) {
+    const size_t N = 100;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 2 * N);
+    PhTreeD<3, int> tree;
+    std::stringstream log;
+    PhTreeOperationLogWriter<TestPoint<3>, int> writer{log};
+    tree.set_listener(&writer);
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    tree.clear();
+    for (size_t i = N; i < 2 * N; ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+
+    PhTreeD<3, int> tree2;
+    ASSERT_EQ(2 * N + 1, ReplayOperationLog(log, tree2));
+    AssertTreesEqual(tree, tree2);
+}
+
+TEST(PhTreeOperationLogTest, TestReplayBox) {
+    const size_t N = 500;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    PhTreeBoxD<3, int> tree;
+    std::stringstream log;
+    PhTreeOperationLogWriter<PhBoxD<3>, int> writer{log};
+    tree.set_listener(&writer);
+    for (size_t i = 0; i < N; ++i) {
+        auto max = points[i];
+        max[0] += 10;
+        tree.emplace({points[i], max}, (int)i);
+    }
+    for (size_t i = 0; i < N; i += 2) {
+        tree.erase({points[i], points[i]});
+    }
+
+    PhTreeBoxD<3, int> tree2;
+    ASSERT_EQ(N, ReplayOperationLog(log, tree2));
+    AssertTreesEqual(tree, tree2);
+}
+
+TEST(PhTreeOperationLogTest, TestTruncatedLog) {
+    const size_t N = 100;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    PhTreeD<3, size_t> tree;
+    std::stringstream log;
+    PhTreeOperationLogWriter<TestPoint<3>, size_t> writer{log};
+    tree.set_listener(&writer);
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], i);
+    }
+    std::string data = log.str();
+    size_t record_size = data.size() / N;
+
+    // A partial record at the end is ignored
+    for (size_t cut = 1; cut < record_size; ++cut) {
+        std::stringstream truncated{data.substr(0, data.size() - cut)};
+        PhTreeD<3, size_t> tree2;
+        ASSERT_EQ(N - 1, ReplayOperationLog(truncated, tree2));
+        ASSERT_EQ(N - 1, tree2.size());
+    }
+
+    // Invalid operation type
+    data[record_size * 10] = 17;
+    std::stringstream invalid{data};
+    PhTreeD<3, size_t> tree3;
+    ASSERT_EQ(10u, ReplayOperationLog(invalid, tree3));
+    ASSERT_TRUE(invalid.fail());
+}
+
+TEST(PhTreeOperationLogTest, TestReplayMultiMap) {
+    const size_t N = 1000;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    PhTreeMultiMapD<3, size_t> tree;
+    for (size_t i = 0; i < N / 2; ++i) {
+        tree.emplace(points[i], i);
+        tree.emplace(points[i], i + N);
+    }
+    std::string snapshot = Snapshot(tree);
+
+    std::stringstream log;
+    PhTreeOperationLogWriter<TestPoint<3>, size_t> writer{log};
+    tree.set_listener(&writer);
+    for (size_t i = N / 2; i < N; ++i) {
+        tree.emplace(points[i], i);
+        tree.emplace(points[i], i);
+    }
+    for (size_t i = 0; i < N / 2; i += 3) {
+        tree.erase(points[i], i + N);
+        // Not present -> no-op
+        tree.erase(points[i], i + 2 * N);
+    }
+    for (size_t i = 1; i < N / 2; i += 3) {
+        // Move to an existing and to a new key, the first relocate() is a no-op
+        tree.relocate(points[i], points[i], i);
+        tree.relocate(points[i], points[i + 1], i);
+        tree.relocate(points[i], points[(i + 7) % N], i + N);
+    }
+    for (size_t i = 2; i < N / 2; i += 3) {
+        // Value already exists at the new key
+        tree.emplace(points[i + 1], i);
+        tree.relocate(points[i], points[i + 1], i, true);
+    }
+    auto iter = tree.find(points[N - 1]);
+    tree.erase(iter);
+    tree.set_listener(nullptr);
+
+    PhTreeMultiMapD<3, size_t> tree2;
+    std::stringstream ss{snapshot};
+    ASSERT_TRUE(deserialize(tree2, ss));
+    ReplayOperationLog(log, tree2);
+    ASSERT_FALSE(log.fail());
+    size_t n = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        ASSERT_NE(tree2.find(it.first(), *it), tree2.end());
+        ++n;
+    }
+    size_t n2 = 0;
+    for (auto it = tree2.begin(); it != tree2.end(); ++it) {
+        ++n2;
+    }
+    ASSERT_EQ(n, n2);
+}
+
+TEST(PhTreeOperationLogTest, TestListenerCalls) {
+    struct CountingListener : public PhTreeListener<TestPoint<2>, int> {
+        void OnEmplace(const TestPoint<2>&, const int&) override {
+            ++n_emplace_;
+        }
+        void OnErase(const TestPoint<2>&, const int&) override {
+            ++n_erase_;
+        }
+        void OnRelocate(const TestPoint<2>&, const TestPoint<2>&, const int&) override {
+            ++n_relocate_;
+        }
+        void OnUpdate(const TestPoint<2>&, const int&) override {
+            ++n_update_;
+        }
+        void OnClear() override {
+            ++n_clear_;
+        }
+        int n_emplace_ = 0;
+        int n_erase_ = 0;
+        int n_relocate_ = 0;
+        int n_update_ = 0;
+        int n_clear_ = 0;
+    };
+    CountingListener listener;
+    PhTreeMultiMapD<2, int> tree;
+    tree.set_listener(&listener);
+    tree.emplace({1, 1}, 1);
+    tree.emplace({1, 1}, 1);
+    tree.insert({1, 1}, 2);
+    ASSERT_EQ(2, listener.n_emplace_);
+    ASSERT_EQ(1u, tree.relocate({1, 1}, {2, 2}, 1));
+    ASSERT_EQ(0u, tree.relocate({1, 1}, {2, 2}, 1));
+    ASSERT_EQ(1, listener.n_relocate_);
+    ASSERT_EQ(1u, tree.erase({1, 1}, 2));
+    ASSERT_EQ(0u, tree.erase({1, 1}, 2));
+    ASSERT_EQ(1, listener.n_erase_);
+    tree.clear();
+    ASSERT_EQ(1, listener.n_clear_);
+    ASSERT_EQ(2, listener.n_emplace_);
+}
+
+TEST(PhTreeOperationLogTest, TestInsertOrAssignReplay) {
+    PhTreeD<2, int> tree;
+    std::stringstream log;
+    PhTreeOperationLogWriter<TestPoint<2>, int> writer{log};
+    tree.set_listener(&writer);
+    // 'tree[key] = value' is not logged, assignments must use insert_or_assign().
+    ASSERT_TRUE(tree.insert_or_assign({1, 1}, 42).second);
+    ASSERT_FALSE(tree.insert_or_assign({1, 1}, 43).second);
+    ASSERT_EQ(43, tree.find({1, 1}).second());
+    ASSERT_EQ(1u, tree.size());
+
+    PhTreeD<2, int> tree2;
+    ASSERT_EQ(2u, ReplayOperationLog(log, tree2));
+    ASSERT_FALSE(log.fail());
+    AssertTreesEqual(tree, tree2);
+    ASSERT_EQ(43, tree2.find({1, 1}).second());
+}
+
+TEST(PhTreeOperationLogTest, TestInsertOrAssignListener) {
+    PhTreeChangeLog<TestPoint<2>, int> changes{10};
+    PhTreeD<2, int> tree;
+    tree.set_listener(&changes);
+    tree.insert_or_assign({1, 1}, 42);
+    tree.insert_or_assign({1, 1}, 43);
+    // operator[] reports only the insertion of the default value
+    tree[{2, 2}] = 44;
+    std::vector<PhTreeChange<TestPoint<2>, int>> result;
+    changes.changes_since(0, [&result](const auto& change) { result.push_back(change); });
+    ASSERT_EQ(3u, result.size());
+    ASSERT_EQ(PhTreeOperation::EMPLACE, result[0].op_);
+    ASSERT_EQ(42, result[0].value_);
+    ASSERT_EQ(PhTreeOperation::UPDATE, result[1].op_);
+    ASSERT_EQ(43, result[1].value_);
+    ASSERT_EQ(PhTreeOperation::EMPLACE, result[2].op_);
+    ASSERT_EQ(0, result[2].value_);
+}
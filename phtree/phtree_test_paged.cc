@@ -0,0 +1,431 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "phtree/phtree.h"
+#include "phtree/phtree_paged.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N, double max = 1000.) {
+    DoubleRng rng(-max, max);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+    }
+}
+
+std::string SwapFile() {
+    return testing::TempDir() + "phtree_test_paged.swap";
+}
+
+template <typename TREE, typename PAGED>
+void AssertEqual(TREE& tree, PAGED& paged) {
+    ASSERT_EQ(tree.size(), paged.size());
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        auto it2 = paged.find(it.first());
+        ASSERT_NE(it2, paged.end());
+        ASSERT_EQ(*it, *it2);
+    }
+    size_t n = 0;
+    auto callback = [&n, &tree](const auto& key, const auto& value) {
+        ASSERT_EQ(1u, tree.count(key));
+        ASSERT_EQ(value, *tree.find(key));
+        ++n;
+    };
+    paged.for_each(callback);
+    ASSERT_EQ(tree.size(), n);
+}
+
+template <dimension_t DIM>
+void SmokeTestPaged(bit_width_t page_depth, size_t budget_entries) {
+    using Paged = PhTreePagedD<DIM, size_t>;
+    const size_t N = 5000;
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    PhTreeD<DIM, size_t> tree;
+    Paged paged(page_depth, budget_entries * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+
+    for (size_t i = 0; i < N; ++i) {
+        tree.emplace(points[i], i);
+        ASSERT_TRUE(paged.emplace(points[i], i).second);
+        ASSERT_FALSE(paged.emplace(points[i], i + 1).second);
+        ASSERT_FALSE(paged.insert(points[i], i + 1).second);
+    }
+    ASSERT_EQ(N, paged.size());
+    ASSERT_LT(1u, paged.page_count());
+    // The budget may only be exceeded by the most recently used page
+    ASSERT_LT(paged.resident_page_count(), paged.page_count());
+    ASSERT_LT(0u, paged.file_size());
+    AssertEqual(tree, paged);
+
+    // Window queries
+    DoubleRng rng(-1000, 1000);
+    for (int i = 0; i < 50; ++i) {
+        TestPoint<DIM> min;
+        TestPoint<DIM> max;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            min[d] = rng.next();
+            max[d] = min[d] + 300;
+        }
+        size_t n_expected = 0;
+        size_t n = 0;
+        auto count_expected = [&n_expected](const auto&, const auto&) { ++n_expected; };
+        auto count = [&n, &min, &max](const TestPoint<DIM>& key, const size_t&) {
+            for (dimension_t d = 0; d < DIM; ++d) {
+                ASSERT_LE(min[d], key[d]);
+                ASSERT_GE(max[d], key[d]);
+            }
+            ++n;
+        };
+        tree.for_each({min, max}, count_expected);
+        paged.for_each({min, max}, count);
+        ASSERT_EQ(n_expected, n);
+    }
+
+    // Modify swapped out pages
+    for (size_t i = 0; i < N; i += 2) {
+        ASSERT_EQ(1u, tree.erase(points[i]));
+        ASSERT_EQ(1u, paged.erase(points[i]));
+        ASSERT_EQ(0u, paged.erase(points[i]));
+        ASSERT_EQ(0u, paged.count(points[i]));
+    }
+    for (size_t i = 1; i < N; i += 4) {
+        tree.erase(points[i]);
+        tree.emplace(points[i], i * 3);
+        paged.erase(points[i]);
+        paged.emplace(points[i], i * 3);
+    }
+    AssertEqual(tree, paged);
+
+    for (size_t i = 0; i < N; ++i) {
+        tree.erase(points[i]);
+        paged.erase(points[i]);
+    }
+    ASSERT_TRUE(paged.empty());
+    ASSERT_EQ(0u, paged.page_count());
+    ASSERT_EQ(0u, paged.resident_page_count());
+    ASSERT_EQ(0u, paged.resident_bytes());
+}
+
+TEST(PhTreePagedTest, SmokeTestBasicOps) {
+    // With IEEE keys, the leading 12 bits are the sign and the exponent
+    SmokeTestPaged<1>(18, 500);
+    SmokeTestPaged<2>(15, 100);
+    SmokeTestPaged<3>(14, 1000);
+    SmokeTestPaged<3>(16, 10);
+    SmokeTestPaged<6>(13, 1000);
+    SmokeTestPaged<10>(12, 1000);
+}
+
+TEST(PhTreePagedTest, TestBudget) {
+    using Paged = PhTreePagedD<3, int>;
+    const size_t N = 10000;
+    const size_t BUDGET = 1000 * Paged::BYTES_PER_ENTRY;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    Paged paged(16, BUDGET);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    size_t max_page_bytes = 0;
+    for (size_t i = 0; i < N; ++i) {
+        paged.emplace(points[i], (int)i);
+        // A single page has far fewer than 1000 entries
+        ASSERT_GE(BUDGET, paged.resident_bytes());
+        max_page_bytes = std::max(max_page_bytes, paged.resident_bytes());
+    }
+    ASSERT_LT(BUDGET / 2, max_page_bytes);
+
+    // Reading does not write pages again, except for the pages that were never written before
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ((int)i, *paged.find(points[i]));
+    }
+    size_t file_size = paged.file_size();
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ((int)i, *paged.find(points[i]));
+    }
+    ASSERT_EQ(file_size, paged.file_size());
+
+    paged.clear();
+    ASSERT_TRUE(paged.empty());
+    ASSERT_EQ(0u, paged.file_size());
+    ASSERT_EQ(paged.end(), paged.find(points[0]));
+}
+
+TEST(PhTreePagedTest, TestSwapFileReuse) {
+    using Paged = PhTreePagedD<3, int>;
+    const size_t N = 2000;
+    const size_t N_ROUNDS = 20;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N * (N_ROUNDS + 1));
+    Paged paged(14, 100 * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < N; ++i) {
+        paged.emplace(points[i], (int)i);
+    }
+    size_t initial_file_size = paged.file_size();
+    ASSERT_LT(0u, initial_file_size);
+
+    // Pages grow, shrink and become empty, but slots are reused.
+    for (size_t round = 1; round <= N_ROUNDS; ++round) {
+        for (size_t i = 0; i < N; ++i) {
+            ASSERT_EQ(1u, paged.erase(points[(round - 1) * N + i]));
+            paged.emplace(points[round * N + i], (int)i);
+        }
+        ASSERT_EQ(N, paged.size());
+        ASSERT_GE(2 * initial_file_size, paged.file_size());
+    }
+    ASSERT_FALSE(paged.fail());
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ((int)i, *paged.find(points[N_ROUNDS * N + i]));
+    }
+
+    // Releasing all slots shrinks the file
+    for (size_t i = 0; i < N; ++i) {
+        paged.erase(points[N_ROUNDS * N + i]);
+    }
+    ASSERT_EQ(0u, paged.page_count());
+    ASSERT_EQ(0u, paged.file_size());
+}
+
+TEST(PhTreePagedTest, TestMemoryAccounting) {
+    using Paged = PhTreePagedD<3, int>;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 5000);
+    // A single page without budget
+    Paged paged(0, std::numeric_limits<size_t>::max());
+    PhTreeD<3, int> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        paged.emplace(points[i], (int)i);
+        tree.emplace(points[i], (int)i);
+    }
+    // The resident memory is measured, it is at most 25% off
+    double expected = (double)PhTreeDebugHelper::GetStats(tree).mem_size_;
+    ASSERT_LT(expected * 0.75, (double)paged.resident_bytes());
+    ASSERT_GT(expected * 1.25, (double)paged.resident_bytes());
+
+    for (size_t i = 0; i < points.size() - 1; ++i) {
+        paged.erase(points[i]);
+    }
+    ASSERT_LT(0u, paged.resident_bytes());
+    ASSERT_GT(expected / 100, (double)paged.resident_bytes());
+    paged.erase(points.back());
+    ASSERT_EQ(0u, paged.resident_bytes());
+}
+
+TEST(PhTreePagedTest, TestKnn) {
+    using Paged = PhTreePagedD<3, int>;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 5000);
+    PhTreeD<3, int> tree;
+    Paged paged(14, 100 * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+        paged.emplace(points[i], (int)i);
+    }
+    ASSERT_LT(paged.resident_page_count(), paged.page_count());
+
+    DoubleRng rng(-1000, 1000);
+    for (size_t k : {1, 10, 100}) {
+        for (int i = 0; i < 20; ++i) {
+            TestPoint<3> center{rng.next(), rng.next(), rng.next()};
+            std::vector<double> expected;
+            auto it = tree.begin_knn_query(k, center, DistanceEuclidean<3>());
+            for (; it != tree.end(); ++it) {
+                expected.push_back(it.distance());
+            }
+            std::vector<double> actual;
+            auto callback = [&](const TestPoint<3>& key, const int& value, double distance) {
+                ASSERT_EQ(value, *tree.find(key));
+                ASSERT_DOUBLE_EQ(DistanceEuclidean<3>()(center, key), distance);
+                actual.push_back(distance);
+            };
+            paged.for_each_knn(k, center, callback, DistanceEuclidean<3>());
+            ASSERT_EQ(expected.size(), actual.size());
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_DOUBLE_EQ(expected[j], actual[j]);
+            }
+        }
+    }
+    ASSERT_FALSE(paged.fail());
+}
+
+TEST(PhTreePagedTest, TestWithoutFile) {
+    PhTreePagedD<3, int> paged(4, 0);
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        paged.emplace(points[i], (int)i);
+    }
+    ASSERT_EQ(paged.page_count(), paged.resident_page_count());
+    ASSERT_EQ(0u, paged.file_size());
+    ASSERT_EQ(1u, paged.count(points[0]));
+}
+
+TEST(PhTreePagedTest, TestFilter) {
+    using Paged = PhTreePagedD<2, int>;
+    std::vector<TestPoint<2>> points;
+    generateCube(points, 5000);
+    Paged paged(15, 100 * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < points.size(); ++i) {
+        paged.emplace(points[i], (int)i);
+    }
+    // Load the pages of the first quadrant
+    FilterAABB<ConverterIEEE<2>> filter({0, 0}, {1000, 1000}, paged.converter());
+    size_t n = 0;
+    auto callback = [&n](const TestPoint<2>& key, const int&) {
+        ASSERT_LE(0, key[0]);
+        ASSERT_LE(0, key[1]);
+        ++n;
+    };
+    paged.for_each(callback, filter);
+    ASSERT_LT(0u, n);
+    size_t n_expected = 0;
+    for (auto& p : points) {
+        n_expected += p[0] >= 0 && p[1] >= 0;
+    }
+    ASSERT_EQ(n_expected, n);
+}
+
+TEST(PhTreePagedTest, TestBoxKeys) {
+    using Paged = PhTreePagedBoxD<2, int>;
+    std::vector<TestPoint<2>> points;
+    generateCube(points, 2000);
+    Paged paged(14, 100 * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto max = points[i];
+        max[0] += 5;
+        max[1] += 5;
+        paged.emplace({points[i], max}, (int)i);
+    }
+    size_t n = 0;
+    auto callback = [&n](const PhBoxD<2>&, const int&) { ++n; };
+    paged.for_each({{-1000, -1000}, {1000, 1000}}, callback);
+    ASSERT_EQ(points.size(), n);
+}
+
+// Codec that simulates write errors, e.g. a full disk.
+struct FailingCodec {
+    void write(std::ostream& os, const int& value) const {
+        if (*fail_writes_) {
+            os.setstate(std::ios::badbit);
+        }
+        WriteRaw(os, value);
+    }
+
+    int read(std::istream& is) const {
+        int value;
+        ReadRaw(is, value);
+        return value;
+    }
+
+    bool* fail_writes_;
+};
+
+TEST(PhTreePagedTest, TestWriteFailure) {
+    using Paged = PhTreePaged<3, int, ConverterIEEE<3>, FailingCodec>;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 5000);
+    bool fail_writes = true;
+    Paged paged(14, 100 * Paged::BYTES_PER_ENTRY, ConverterIEEE<3>(), FailingCodec{&fail_writes});
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_TRUE(paged.emplace(points[i], (int)i).second);
+    }
+    // Pages that could not be written remain in memory
+    ASSERT_TRUE(paged.fail());
+    ASSERT_EQ(paged.page_count(), paged.resident_page_count());
+    ASSERT_EQ(0u, paged.file_size());
+
+    fail_writes = false;
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ((int)i, *paged.find(points[i]));
+    }
+    ASSERT_LT(paged.resident_page_count(), paged.page_count());
+    ASSERT_LT(0u, paged.file_size());
+    ASSERT_EQ(points.size(), paged.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ((int)i, *paged.find(points[i]));
+    }
+}
+
+TEST(PhTreePagedTest, TestLoadFailure) {
+    using Paged = PhTreePagedD<3, int>;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 5000);
+    Paged paged(14, 100 * Paged::BYTES_PER_ENTRY);
+    ASSERT_TRUE(paged.open(SwapFile()));
+    for (size_t i = 0; i < points.size(); ++i) {
+        paged.emplace(points[i], (int)i);
+    }
+    ASSERT_FALSE(paged.fail());
+    ASSERT_LT(paged.resident_page_count(), paged.page_count());
+
+    // Truncate the swap file, swapped out pages cannot be loaded anymore
+    std::ofstream(SwapFile(), std::ios::trunc).close();
+    size_t n_found = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        n_found += paged.count(points[i]);
+    }
+    ASSERT_TRUE(paged.fail());
+    ASSERT_LT(0u, n_found);
+    ASSERT_GT(points.size(), n_found);
+    ASSERT_EQ(points.size(), paged.size());
+    ASSERT_LT(0u, paged.resident_bytes());
+
+    // Unavailable pages are skipped by queries and cannot be modified
+    size_t n = 0;
+    auto callback = [&n](const TestPoint<3>&, const int&) { ++n; };
+    paged.for_each(callback);
+    ASSERT_GT(points.size(), n);
+    size_t n_failed = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto result = paged.emplace(points[i], -1);
+        ASSERT_FALSE(result.second);
+        // The value of a page that cannot be loaded is a placeholder
+        n_failed += result.first == -1;
+    }
+    ASSERT_LT(0u, n_failed);
+
+    paged.clear();
+    ASSERT_FALSE(paged.fail());
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define PHTREE_QUERY_STATS
+#include "phtree/phtree.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_query_stats {
+
+using TestPoint = PhPointD<3>;
+using TestTree = PhTreeD<3, int>;
+
+void Populate(TestTree& tree, size_t n) {
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd{-1000, 1000};
+    for (size_t i = 0; i < n; ++i) {
+        tree.emplace({rnd(eng), rnd(eng), rnd(eng)}, (int)i);
+    }
+}
+
+struct FilterEven {
+    template <typename KEY>
+    [[nodiscard]] bool IsEntryValid(const KEY&, const int& value) const {
+        return value % 2 == 0;
+    }
+
+    template <typename KEY>
+    [[nodiscard]] bool IsNodeValid(const KEY&, int) const {
+        return true;
+    }
+};
+
+TEST(PhTreeQueryStatsTest, TestEnabled) {
+    ASSERT_TRUE(PhTreeQueryStats::IS_ENABLED);
+}
+
+TEST(PhTreeQueryStatsTest, TestWindowQuery) {
+    TestTree tree;
+    Populate(tree, 10000);
+    PhBoxD<3> query{{-100, -100, -100}, {300, 300, 300}};
+
+    auto& stats = GetQueryStats();
+    stats.Reset();
+    size_t n = 0;
+    for (auto it = tree.begin_query(query); it != tree.end(); ++it) {
+        ++n;
+    }
+    ASSERT_LT(0u, n);
+    ASSERT_EQ(n, stats.n_entries_returned_);
+    ASSERT_LE(n, stats.n_entries_tested_);
+    ASSERT_LT(0u, stats.n_nodes_visited_);
+    ASSERT_LT(0u, stats.n_nodes_pruned_hc_ + stats.n_nodes_pruned_prefix_);
+    ASSERT_EQ(0u, stats.n_nodes_pruned_filter_);
+    ASSERT_LT(0u, stats.max_depth_);
+    auto stats_iter = stats;
+
+    stats.Reset();
+    size_t n2 = 0;
+    auto callback = [&n2](const TestPoint&, const int&) { ++n2; };
+    tree.for_each(query, callback);
+    ASSERT_EQ(n, n2);
+    ASSERT_EQ(n, stats.n_entries_returned_);
+    // Both traversals visit the same nodes and entries
+    ASSERT_EQ(stats_iter.n_nodes_visited_, stats.n_nodes_visited_);
+    ASSERT_EQ(stats_iter.n_nodes_pruned_hc_, stats.n_nodes_pruned_hc_);
+    ASSERT_EQ(stats_iter.n_nodes_pruned_prefix_, stats.n_nodes_pruned_prefix_);
+    ASSERT_EQ(stats_iter.n_entries_tested_, stats.n_entries_tested_);
+    ASSERT_EQ(stats_iter.max_depth_, stats.max_depth_);
+    ASSERT_FALSE(stats.ToString().empty());
+}
+
+TEST(PhTreeQueryStatsTest, TestFullQuery) {
+    TestTree tree;
+    Populate(tree, 1000);
+    auto& stats = GetQueryStats();
+
+    stats.Reset();
+    size_t n = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        ++n;
+    }
+    ASSERT_EQ(tree.size(), n);
+    ASSERT_EQ(n, stats.n_entries_tested_);
+    ASSERT_EQ(n, stats.n_entries_returned_);
+    auto stats_iter = stats;
+
+    stats.Reset();
+    auto callback = [](const TestPoint&, const int&) {};
+    tree.for_each(callback);
+    ASSERT_EQ(n, stats.n_entries_tested_);
+    ASSERT_EQ(n, stats.n_entries_returned_);
+    ASSERT_EQ(stats_iter.n_nodes_visited_, stats.n_nodes_visited_);
+    ASSERT_EQ(stats_iter.max_depth_, stats.max_depth_);
+
+    stats.Reset();
+    n = 0;
+    for (auto it = tree.begin(FilterEven()); it != tree.end(); ++it) {
+        ++n;
+    }
+    ASSERT_EQ(tree.size() / 2, n);
+    ASSERT_EQ(tree.size(), stats.n_entries_tested_);
+    ASSERT_EQ(n, stats.n_entries_returned_);
+}
+
+TEST(PhTreeQueryStatsTest, TestKnnQuery) {
+    TestTree tree;
+    Populate(tree, 10000);
+    auto& stats = GetQueryStats();
+    stats.Reset();
+    size_t n = 0;
+    for (auto it = tree.begin_knn_query(10, {0, 0, 0}, DistanceEuclidean<3>());
+         it != tree.end();
+         ++it) {
+        ++n;
+    }
+    ASSERT_EQ(10u, n);
+    ASSERT_EQ(10u, stats.n_entries_returned_);
+    ASSERT_LE(10u, stats.n_entries_tested_);
+    ASSERT_LT(0u, stats.n_nodes_visited_);
+    // kNN queries should visit only a small part of the tree
+    ASSERT_GT(tree.size(), stats.n_entries_tested_);
+}
+
+TEST(PhTreeQueryStatsTest, TestStatsPerQuery) {
+    TestTree tree;
+    Populate(tree, 10000);
+    PhBoxD<3> query{{-100, -100, -100}, {300, 300, 300}};
+    GetQueryStats().Reset();
+
+    // Interleaved iterators record their statistics separately
+    PhTreeQueryStats stats1;
+    PhTreeQueryStats stats2;
+    auto it1 = tree.begin_query(query, FilterNoOp(), QueryPoint(), &stats1);
+    auto it2 = tree.begin(FilterNoOp(), &stats2);
+    size_t n1 = 0;
+    size_t n2 = 0;
+    while (it1 != tree.end() || it2 != tree.end()) {
+        if (it1 != tree.end()) {
+            ++it1;
+            ++n1;
+        }
+        if (it2 != tree.end()) {
+            ++it2;
+            ++n2;
+        }
+    }
+    ASSERT_EQ(n1, stats1.n_entries_returned_);
+    ASSERT_EQ(tree.size(), n2);
+    ASSERT_EQ(n2, stats2.n_entries_returned_);
+    ASSERT_EQ(n2, stats2.n_entries_tested_);
+
+    PhTreeQueryStats stats3;
+    auto callback = [](const TestPoint&, const int&) {};
+    tree.for_each(query, callback, FilterNoOp(), QueryPoint(), &stats3);
+    ASSERT_EQ(n1, stats3.n_entries_returned_);
+    ASSERT_EQ(stats1.n_nodes_visited_, stats3.n_nodes_visited_);
+
+    PhTreeQueryStats stats4;
+    size_t n4 = 0;
+    for (auto it = tree.begin_knn_query(
+             10, {0, 0, 0}, DistanceEuclidean<3>(), FilterNoOp(), &stats4);
+         it != tree.end();
+         ++it) {
+        ++n4;
+    }
+    ASSERT_EQ(n4, stats4.n_entries_returned_);
+
+    // The thread-local statistics are only the fallback
+    ASSERT_EQ(0u, GetQueryStats().n_nodes_visited_);
+    ASSERT_EQ(0u, GetQueryStats().n_entries_returned_);
+}
+
+}  // namespace phtree_test_query_stats
@@ -0,0 +1,454 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "phtree/phtree.h"
+#include "phtree/phtree_multimap.h"
+#include "phtree/phtree_serialization.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+template <dimension_t DIM, typename T>
+using TestTree = PhTreeD<DIM, T>;
+
+template <dimension_t DIM, typename T>
+using TestMultiMap = PhTreeMultiMapD<DIM, T>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl, unsigned int seed = 0)
+    : eng(seed), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+struct Id {
+    Id() = default;
+
+    explicit Id(const int i) : _i(i), data_{0} {};
+
+    bool operator==(const Id& rhs) const {
+        return _i == rhs._i;
+    }
+
+    int _i;
+    int data_;
+};
+
+namespace std {
+template <>
+struct hash<Id> {
+    size_t operator()(const Id& x) const {
+        return std::hash<int>{}(x._i);
+    }
+};
+};  // namespace std
+
+// Codec for a type that is not trivially copyable.
+struct StringCodec {
+    void write(std::ostream& os, const std::string& value) const {
+        WriteRaw<std::uint32_t>(os, static_cast<std::uint32_t>(value.size()));
+        os.write(value.data(), value.size());
+    }
+
+    std::string read(std::istream& is) const {
+        std::uint32_t size = 0;
+        ReadRaw(is, size);
+        std::string value(size, ' ');
+        is.read(value.data(), size);
+        return value;
+    }
+};
+
+// Reads values like ValueCodec but peeks at the next byte, this sets eofbit after the last value.
+struct PeekingCodec {
+    void write(std::ostream& os, const int& value) const {
+        WriteRaw(os, value);
+    }
+
+    int read(std::istream& is) const {
+        int value = 0;
+        ReadRaw(is, value);
+        is.peek();
+        return value;
+    }
+};
+
+template <dimension_t DIM>
+void generateCube(
+    std::vector<TestPoint<DIM>>& points, size_t N, size_t num_dupl = 1, unsigned int seed = 0) {
+    DoubleRng rng(-1000, 1000, seed);
+    points.reserve(N);
+    for (size_t i = 0; i < N / num_dupl; i++) {
+        TestPoint<DIM> point{};
+        for (dimension_t d = 0; d < DIM; ++d) {
+            point[d] = rng.next();
+        }
+        for (size_t j = 0; j < num_dupl; ++j) {
+            points.push_back(point);
+        }
+    }
+}
+
+template <typename TREE>
+void AssertEqualTrees(TREE& expected, TREE& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    PhTreeDebugHelper::CheckConsistency(actual);
+    auto it_e = expected.begin();
+    auto it_a = actual.begin();
+    for (; it_e != expected.end(); ++it_e, ++it_a) {
+        ASSERT_NE(it_a, actual.end());
+        ASSERT_EQ(it_e.first(), it_a.first());
+        ASSERT_EQ(*it_e, *it_a);
+    }
+    ASSERT_EQ(it_a, actual.end());
+}
+
+template <dimension_t DIM>
+void SmokeTestSerialize(size_t N, bool compressed = false) {
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N);
+    TestTree<DIM, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+
+    std::stringstream ss;
+    if (compressed) {
+        serialize_compressed(tree, ss);
+    } else {
+        serialize(tree, ss);
+    }
+
+    TestTree<DIM, Id> tree2;
+    tree2.emplace(TestPoint<DIM>{}, 42);
+    ASSERT_TRUE(deserialize(tree2, ss));
+    AssertEqualTrees(tree, tree2);
+
+    // The tree must be fully functional after loading.
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ(1, tree2.count(points[i]));
+        ASSERT_EQ((int)i, tree2.find(points[i])->_i);
+    }
+    for (size_t i = 0; i < points.size(); i += 2) {
+        ASSERT_EQ(1, tree2.erase(points[i]));
+    }
+    ASSERT_EQ(N / 2, tree2.size());
+    PhTreeDebugHelper::CheckConsistency(tree2);
+
+    // Inserting splits loaded nodes
+    std::vector<TestPoint<DIM>> points2;
+    generateCube(points2, N, 1, 42);
+    for (size_t i = 0; i < points2.size(); ++i) {
+        tree.emplace(points2[i], (int)(i + N));
+        tree2.emplace(points2[i], (int)(i + N));
+    }
+    for (size_t i = 0; i < points.size(); i += 2) {
+        tree.erase(points[i]);
+    }
+    AssertEqualTrees(tree, tree2);
+}
+
+TEST(PhTreeSerializationTest, SmokeTestDims) {
+    SmokeTestSerialize<1>(1000);
+    SmokeTestSerialize<3>(10000);
+    SmokeTestSerialize<6>(10000);
+    SmokeTestSerialize<10>(10000);
+    SmokeTestSerialize<20>(1000);
+}
+
+TEST(PhTreeSerializationTest, TestSmallTrees) {
+    SmokeTestSerialize<3>(0);
+    SmokeTestSerialize<3>(1);
+    SmokeTestSerialize<3>(2);
+}
+
+TEST(PhTreeSerializationTest, SmokeTestDimsCompressed) {
+    SmokeTestSerialize<1>(1000, true);
+    SmokeTestSerialize<3>(10000, true);
+    SmokeTestSerialize<6>(10000, true);
+    SmokeTestSerialize<10>(10000, true);
+    SmokeTestSerialize<20>(1000, true);
+    SmokeTestSerialize<63>(100, true);
+}
+
+TEST(PhTreeSerializationTest, TestSmallTreesCompressed) {
+    SmokeTestSerialize<3>(0, true);
+    SmokeTestSerialize<3>(1, true);
+    SmokeTestSerialize<3>(2, true);
+}
+
+TEST(PhTreeSerializationTest, TestCompressedSize) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 10000);
+    TestTree<dim, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    serialize(tree, ss);
+    std::stringstream ss_compressed;
+    serialize_compressed(tree, ss_compressed);
+    ASSERT_LT(ss_compressed.str().size() * 2, ss.str().size());
+}
+
+TEST(PhTreeSerializationTest, TestCompressedFloatAndBox) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    PhTreeF<dim, int> tree_f;
+    PhTreeBoxD<dim, int> tree_box;
+    for (size_t i = 0; i < points.size(); ++i) {
+        PhPointF<dim> p{(float)points[i][0], (float)points[i][1], (float)points[i][2]};
+        tree_f.emplace(p, (int)i);
+        TestPoint<dim> max = points[i];
+        max[0] += 1;
+        tree_box.emplace({points[i], max}, (int)i);
+    }
+    std::stringstream ss;
+    serialize_compressed(tree_f, ss);
+    serialize_compressed(tree_box, ss);
+    PhTreeF<dim, int> tree_f2;
+    PhTreeBoxD<dim, int> tree_box2;
+    ASSERT_TRUE(deserialize(tree_f2, ss));
+    ASSERT_TRUE(deserialize(tree_box2, ss));
+    AssertEqualTrees(tree_f, tree_f2);
+    AssertEqualTrees(tree_box, tree_box2);
+}
+
+TEST(PhTreeSerializationTest, TestCustomCodec) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    TestTree<dim, std::string> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], std::to_string(i));
+    }
+
+    std::stringstream ss;
+    serialize(tree, ss, StringCodec{});
+    serialize_compressed(tree, ss, StringCodec{});
+    TestTree<dim, std::string> tree2;
+    ASSERT_TRUE(deserialize(tree2, ss, StringCodec{}));
+    AssertEqualTrees(tree, tree2);
+    TestTree<dim, std::string> tree3;
+    ASSERT_TRUE(deserialize(tree3, ss, StringCodec{}));
+    AssertEqualTrees(tree, tree3);
+}
+
+TEST(PhTreeSerializationTest, TestCodecSetsEofAfterLastValue) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 100);
+    TestTree<dim, int> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+
+    for (bool compressed : {false, true}) {
+        std::stringstream ss;
+        if (compressed) {
+            serialize_compressed(tree, ss, PeekingCodec{});
+        } else {
+            serialize(tree, ss, PeekingCodec{});
+        }
+        TestTree<dim, int> tree2;
+        ASSERT_TRUE(deserialize(tree2, ss, PeekingCodec{}));
+        ASSERT_TRUE(ss.eof());
+        AssertEqualTrees(tree, tree2);
+    }
+}
+
+TEST(PhTreeSerializationTest, TestInvalidStreams) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 1000);
+    TestTree<dim, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    serialize(tree, ss);
+    std::string data = ss.str();
+
+    // empty stream
+    std::stringstream empty;
+    TestTree<dim, Id> tree2;
+    ASSERT_FALSE(deserialize(tree2, empty));
+    ASSERT_EQ(0, tree2.size());
+
+    // truncated stream
+    std::stringstream truncated(data.substr(0, data.size() / 2));
+    ASSERT_FALSE(deserialize(tree2, truncated));
+    ASSERT_EQ(0, tree2.size());
+    PhTreeDebugHelper::CheckConsistency(tree2);
+
+    // wrong dimensionality
+    std::stringstream ss2(data);
+    TestTree<dim + 1, Id> tree3;
+    ASSERT_FALSE(deserialize(tree3, ss2));
+    ASSERT_EQ(0, tree3.size());
+
+    // corrupted stream
+    std::string corrupted = data;
+    corrupted[0] = 'x';
+    std::stringstream ss3(corrupted);
+    ASSERT_FALSE(deserialize(tree2, ss3));
+    ASSERT_EQ(0, tree2.size());
+}
+
+TEST(PhTreeSerializationTest, TestInvalidCompressedStreams) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 100);
+    TestTree<dim, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    serialize_compressed(tree, ss);
+    std::string data = ss.str();
+
+    // truncated streams
+    for (size_t len = 0; len < data.size(); ++len) {
+        std::stringstream truncated(data.substr(0, len));
+        TestTree<dim, Id> tree2;
+        ASSERT_FALSE(deserialize(tree2, truncated));
+        ASSERT_EQ(0, tree2.size());
+    }
+
+    // corrupted streams must not crash, they are either rejected or result in a valid tree
+    std::default_random_engine random_engine{0};
+    std::uniform_int_distribution<size_t> pos_distribution{0, data.size() - 1};
+    for (int i = 0; i < 1000; ++i) {
+        std::string corrupted = data;
+        corrupted[pos_distribution(random_engine)] ^= (char)(1 << (i % 8));
+        std::stringstream ss2(corrupted);
+        TestTree<dim, Id> tree2;
+        if (deserialize(tree2, ss2)) {
+            PhTreeDebugHelper::CheckConsistency(tree2);
+        } else {
+            ASSERT_EQ(0, tree2.size());
+        }
+    }
+}
+
+TEST(PhTreeSerializationTest, TestMultipleTreesInOneStream) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 100);
+    TestTree<dim, Id> tree1;
+    TestTree<dim, Id> tree2;
+    for (size_t i = 0; i < points.size(); ++i) {
+        (i % 2 == 0 ? tree1 : tree2).emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    serialize(tree1, ss);
+    serialize(tree2, ss);
+
+    TestTree<dim, Id> tree1b;
+    TestTree<dim, Id> tree2b;
+    ASSERT_TRUE(deserialize(tree1b, ss));
+    ASSERT_TRUE(deserialize(tree2b, ss));
+    AssertEqualTrees(tree1, tree1b);
+    AssertEqualTrees(tree2, tree2b);
+}
+
+template <dimension_t DIM>
+void SmokeTestSerializeMultiMap(size_t N, bool compressed = false) {
+    std::vector<TestPoint<DIM>> points;
+    generateCube(points, N, 4);
+    TestMultiMap<DIM, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+
+    std::stringstream ss;
+    if (compressed) {
+        serialize_compressed(tree, ss);
+    } else {
+        serialize(tree, ss);
+    }
+
+    TestMultiMap<DIM, Id> tree2;
+    ASSERT_TRUE(deserialize(tree2, ss));
+    ASSERT_EQ(tree.size(), tree2.size());
+    PhTreeDebugHelper::CheckConsistency(tree2);
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ(4, tree2.count(points[i]));
+        ASSERT_NE(tree2.end(), tree2.find(points[i], Id((int)i)));
+    }
+    size_t n = 0;
+    for (auto it = tree2.begin(); it != tree2.end(); ++it) {
+        ++n;
+    }
+    ASSERT_EQ(tree.size(), n);
+
+    // truncated stream
+    std::string data = ss.str();
+    std::stringstream truncated(data.substr(0, data.size() - 1));
+    ASSERT_FALSE(deserialize(tree2, truncated));
+    ASSERT_EQ(0, tree2.size());
+    ASSERT_TRUE(tree2.empty());
+}
+
+TEST(PhTreeSerializationTest, TestMultiMapInvalidSize) {
+    const dimension_t dim = 3;
+    std::vector<TestPoint<dim>> points;
+    generateCube(points, 100, 4);
+    TestMultiMap<dim, Id> tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    std::stringstream ss;
+    serialize(tree, ss);
+    std::string data = ss.str();
+
+    // The stream starts with the number of values, it must match the number of values read.
+    for (std::uint64_t size : {std::uint64_t{0}, std::uint64_t{99}, std::uint64_t{101}}) {
+        std::string corrupted = data;
+        std::memcpy(corrupted.data(), &size, sizeof(size));
+        std::stringstream ss2(corrupted);
+        TestMultiMap<dim, Id> tree2;
+        ASSERT_FALSE(deserialize(tree2, ss2));
+        ASSERT_EQ(0, tree2.size());
+    }
+
+    std::stringstream ss3(data);
+    TestMultiMap<dim, Id> tree3;
+    ASSERT_TRUE(deserialize(tree3, ss3));
+    ASSERT_EQ(100, tree3.size());
+}
+
+TEST(PhTreeSerializationTest, SmokeTestMultiMap) {
+    SmokeTestSerializeMultiMap<3>(10000);
+    SmokeTestSerializeMultiMap<10>(1000);
+    SmokeTestSerializeMultiMap<3>(10000, true);
+    SmokeTestSerializeMultiMap<10>(1000, true);
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "phtree/phtree_shared.h"
+#include <gtest/gtest.h>
+#include <random>
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#endif
+
+using namespace improbable::phtree;
+
+template <dimension_t DIM>
+using TestPoint = PhPointD<DIM>;
+
+class DoubleRng {
+  public:
+    DoubleRng(double minIncl, double maxExcl) : eng(), rnd{minIncl, maxExcl} {}
+
+    double next() {
+        return rnd(eng);
+    }
+
+  private:
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd;
+};
+
+template <dimension_t DIM>
+void generateCube(std::vector<TestPoint<DIM>>& points, size_t N, double max = 1000.) {
+    DoubleRng rng(-max, max);
+    points.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        auto& p = points.emplace_back();
+        for (dimension_t d = 0; d < DIM; ++d) {
+            p[d] = rng.next();
+        }
+    }
+}
+
+std::string RegionName() {
+    return "/phtree_test_shared_" + std::to_string(getpid());
+}
+
+TEST(PhTreeSharedTest, SmokeTest) {
+    const size_t N = 1000;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 2 * N);
+    PhTreeSharedWriterD<3, size_t> writer;
+    for (size_t i = 0; i < N; ++i) {
+        writer.tree().emplace(points[i], i);
+    }
+    ASSERT_TRUE(writer.create(RegionName(), 1 << 20));
+    ASSERT_EQ(1u, writer.epoch());
+
+    PhTreeSharedReaderD<3, size_t> reader;
+    ASSERT_TRUE(reader.open(RegionName()));
+    ASSERT_TRUE(reader.tree().empty());
+    ASSERT_TRUE(reader.has_update());
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(1u, reader.epoch());
+    ASSERT_FALSE(reader.has_update());
+    ASSERT_EQ(N, reader.tree().size());
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ(i, *reader.tree().find(points[i]));
+    }
+
+    // The reader keeps the old image until it calls acquire()
+    for (size_t i = N; i < 2 * N; ++i) {
+        writer.tree().emplace(points[i], i);
+    }
+    ASSERT_TRUE(writer.publish());
+    ASSERT_EQ(N, reader.tree().size());
+    ASSERT_TRUE(reader.has_update());
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(2u, reader.epoch());
+    ASSERT_EQ(2 * N, reader.tree().size());
+    size_t n = 0;
+    for (auto it = reader.tree().begin_query({{0, 0, 0}, {1000, 1000, 1000}});
+         it != reader.tree().end();
+         ++it) {
+        ASSERT_EQ(points[*it], it.first());
+        ++n;
+    }
+    ASSERT_LT(0u, n);
+
+    reader.release();
+    ASSERT_TRUE(reader.tree().empty());
+    ASSERT_EQ(0u, reader.epoch());
+
+    // Readers can continue after the writer is closed
+    ASSERT_TRUE(reader.acquire());
+    writer.close();
+    ASSERT_EQ(2 * N, reader.tree().size());
+    PhTreeSharedReaderD<3, size_t> reader2;
+    ASSERT_FALSE(reader2.open(RegionName()));
+}
+
+TEST(PhTreeSharedTest, TestGrow) {
+    PhTreeSharedWriterD<3, int> writer;
+    writer.tree().emplace({1, 2, 3}, 42);
+    ASSERT_TRUE(writer.create(RegionName(), 1000));
+    ASSERT_EQ(1024u, writer.slot_capacity());
+    PhTreeSharedReaderD<3, int> reader;
+    ASSERT_TRUE(reader.open(RegionName()));
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(1u, reader.tree().size());
+
+    // The image does not fit into a slot, the writer creates a larger data region
+    std::vector<TestPoint<3>> points;
+    generateCube(points, 1000);
+    for (size_t i = 0; i < points.size(); ++i) {
+        writer.tree().emplace(points[i], (int)i);
+    }
+    ASSERT_TRUE(writer.publish(std::chrono::milliseconds(10)));
+    ASSERT_EQ(2u, writer.epoch());
+    ASSERT_LE(2048u, writer.slot_capacity());
+
+    // The reader continues to use the old data region until it calls acquire()
+    ASSERT_EQ(1u, reader.tree().size());
+    ASSERT_EQ(42, *reader.tree().find({1, 2, 3}));
+    ASSERT_TRUE(reader.has_update());
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(2u, reader.epoch());
+    ASSERT_EQ(points.size() + 1, reader.tree().size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_EQ((int)i, *reader.tree().find(points[i]));
+    }
+
+    // The new data region has two slots
+    writer.tree().erase({1, 2, 3});
+    ASSERT_TRUE(writer.publish(std::chrono::milliseconds(10)));
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(3u, reader.epoch());
+    ASSERT_EQ(points.size(), reader.tree().size());
+
+    // The image of a large tree can be published when the region is created
+    PhTreeSharedWriterD<3, int> writer2;
+    for (size_t i = 0; i < points.size(); ++i) {
+        writer2.tree().emplace(points[i], (int)i);
+    }
+    ASSERT_TRUE(writer2.create(RegionName() + "_2", 1000));
+    PhTreeSharedReaderD<3, int> reader2;
+    ASSERT_TRUE(reader2.open(RegionName() + "_2"));
+    ASSERT_TRUE(reader2.acquire());
+    ASSERT_EQ(points.size(), reader2.tree().size());
+}
+
+TEST(PhTreeSharedTest, TestReaderSlots) {
+    PhTreeSharedWriterD<2, int> writer;
+    ASSERT_TRUE(writer.create(RegionName(), 1000));
+    std::vector<std::unique_ptr<PhTreeSharedReaderD<2, int>>> readers;
+    for (size_t i = 0; i < SharedTreeHeader::MAX_READERS; ++i) {
+        auto& reader = readers.emplace_back(std::make_unique<PhTreeSharedReaderD<2, int>>());
+        ASSERT_TRUE(reader->open(RegionName()));
+    }
+    PhTreeSharedReaderD<2, int> reader;
+    ASSERT_FALSE(reader.open(RegionName()));
+    readers.back()->close();
+    ASSERT_TRUE(reader.open(RegionName()));
+}
+
+TEST(PhTreeSharedTest, TestPublishTimeout) {
+    PhTreeSharedWriterD<2, int> writer;
+    ASSERT_TRUE(writer.create(RegionName(), 1000));
+    PhTreeSharedReaderD<2, int> reader;
+    ASSERT_TRUE(reader.open(RegionName()));
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(1u, reader.epoch());
+    // The other slot is free
+    ASSERT_TRUE(writer.publish(std::chrono::milliseconds(10)));
+    // The reader still uses the image of epoch 1
+    writer.tree().emplace({1, 2}, 42);
+    ASSERT_FALSE(writer.publish(std::chrono::milliseconds(10)));
+    ASSERT_EQ(2u, writer.epoch());
+    reader.release();
+    ASSERT_TRUE(writer.publish(std::chrono::milliseconds(10)));
+    ASSERT_EQ(3u, writer.epoch());
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(1u, reader.tree().size());
+}
+
+#if !defined(_WIN32)
+TEST(PhTreeSharedTest, TestCrashedReader) {
+    // The name depends on the process id
+    std::string name = RegionName();
+    PhTreeSharedWriterD<2, int> writer;
+    ASSERT_TRUE(writer.create(name, 1000));
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0) {
+        // Claim all reader slots, pin the image and terminate without releasing anything.
+        for (size_t i = 0; i < SharedTreeHeader::MAX_READERS; ++i) {
+            auto* reader = new PhTreeSharedReaderD<2, int>();
+            if (!reader->open(name) || !reader->acquire()) {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    // The slots of the terminated process are reclaimed
+    PhTreeSharedReaderD<2, int> reader;
+    ASSERT_TRUE(reader.open(name));
+    ASSERT_TRUE(writer.publish(std::chrono::seconds(10)));
+    ASSERT_TRUE(writer.publish(std::chrono::seconds(10)));
+    ASSERT_TRUE(writer.publish(std::chrono::seconds(10)));
+    ASSERT_TRUE(reader.acquire());
+    ASSERT_EQ(4u, reader.epoch());
+}
+#endif
+
+TEST(PhTreeSharedTest, TestConcurrentReaders) {
+    // The writer publishes trees where all values are equal to the number of the round. Readers
+    // must never see a mix of values from different rounds.
+    const size_t N = 2000;
+    const size_t ROUNDS = 200;
+    std::vector<TestPoint<3>> points;
+    generateCube(points, N);
+    PhTreeSharedWriterD<3, size_t> writer;
+    writer.tree().emplace(points[0], 0);
+    // The data region grows while readers use it
+    ASSERT_TRUE(writer.create(RegionName(), 1000));
+
+    std::atomic<bool> done{false};
+    auto read = [&]() {
+        PhTreeSharedReaderD<3, size_t> reader;
+        ASSERT_TRUE(reader.open(RegionName()));
+        size_t last_round = 0;
+        while (!done.load()) {
+            ASSERT_TRUE(reader.acquire());
+            auto& tree = reader.tree();
+            size_t round = *tree.begin();
+            ASSERT_LE(last_round, round);
+            size_t n = 0;
+            for (auto it = tree.begin(); it != tree.end(); ++it) {
+                ASSERT_EQ(round, *it);
+                ++n;
+            }
+            ASSERT_EQ(round % 100 + 1, n);
+            last_round = round;
+        }
+    };
+    std::thread reader1(read);
+    std::thread reader2(read);
+    for (size_t round = 1; round < ROUNDS; ++round) {
+        writer.tree().clear();
+        for (size_t i = 0; i < round % 100 + 1; ++i) {
+            writer.tree().emplace(points[(i + round) % N], round);
+        }
+        ASSERT_TRUE(writer.publish());
+    }
+    done = true;
+    reader1.join();
+    reader2.join();
+}
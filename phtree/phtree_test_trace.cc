@@ -0,0 +1,144 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+// The tracing policy must be declared before any PH-Tree header is included.
+namespace phtree_test_trace {
+struct CountingTrace {
+    static void OnNodeAlloc(const void*, std::uint16_t) {
+        ++n_alloc_;
+    }
+    static void OnNodeFree(const void*, std::uint16_t) {
+        ++n_free_;
+    }
+    static void OnSplit(const void*, std::uint16_t) {
+        ++n_split_;
+    }
+    static void OnMerge(const void*, std::uint16_t) {
+        ++n_merge_;
+    }
+    static void OnRootChange(const void* root) {
+        ++n_root_change_;
+        root_ = root;
+    }
+
+    static void Reset() {
+        n_alloc_ = n_free_ = n_split_ = n_merge_ = n_root_change_ = 0;
+        root_ = nullptr;
+    }
+
+    static inline size_t n_alloc_ = 0;
+    static inline size_t n_free_ = 0;
+    static inline size_t n_split_ = 0;
+    static inline size_t n_merge_ = 0;
+    static inline size_t n_root_change_ = 0;
+    static inline const void* root_ = nullptr;
+};
+}  // namespace phtree_test_trace
+
+#define PHTREE_TRACE_POLICY phtree_test_trace::CountingTrace
+#include "phtree/phtree.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_trace {
+
+using TestPoint = PhPointD<3>;
+using TestTree = PhTreeD<3, int>;
+
+std::vector<TestPoint> CreatePoints(size_t n) {
+    std::default_random_engine eng;
+    std::uniform_real_distribution<double> rnd{-1000, 1000};
+    std::vector<TestPoint> points;
+    for (size_t i = 0; i < n; ++i) {
+        points.push_back({rnd(eng), rnd(eng), rnd(eng)});
+    }
+    return points;
+}
+
+TEST(PhTreeTraceTest, TestSplitAndMerge) {
+    auto points = CreatePoints(10000);
+    CountingTrace::Reset();
+    {
+        TestTree tree;
+        ASSERT_EQ(1u, CountingTrace::n_alloc_);
+        ASSERT_EQ(1u, CountingTrace::n_root_change_);
+        ASSERT_NE(nullptr, CountingTrace::root_);
+
+        for (size_t i = 0; i < points.size(); ++i) {
+            tree.emplace(points[i], (int)i);
+        }
+        size_t n_nodes = PhTreeDebugHelper::GetStats(tree).n_nodes_;
+        // Every node except the root is created by a split
+        ASSERT_EQ(n_nodes - 1, CountingTrace::n_split_);
+        ASSERT_EQ(n_nodes, CountingTrace::n_alloc_);
+        ASSERT_EQ(0u, CountingTrace::n_merge_);
+        ASSERT_EQ(0u, CountingTrace::n_free_);
+
+        for (auto& p : points) {
+            tree.erase(p);
+        }
+        ASSERT_EQ(0u, tree.size());
+        // All nodes except the root are merged into their parents and deleted
+        ASSERT_EQ(CountingTrace::n_split_, CountingTrace::n_merge_);
+        ASSERT_EQ(CountingTrace::n_merge_, CountingTrace::n_free_);
+        ASSERT_EQ(1u, CountingTrace::n_root_change_);
+    }
+    ASSERT_EQ(CountingTrace::n_alloc_, CountingTrace::n_free_);
+}
+
+TEST(PhTreeTraceTest, TestClear) {
+    auto points = CreatePoints(1000);
+    TestTree tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    CountingTrace::Reset();
+    size_t n_nodes = PhTreeDebugHelper::GetStats(tree).n_nodes_;
+    tree.clear();
+    ASSERT_EQ(1u, CountingTrace::n_root_change_);
+    ASSERT_EQ(1u, CountingTrace::n_alloc_);
+    ASSERT_EQ(n_nodes, CountingTrace::n_free_);
+    ASSERT_EQ(0u, CountingTrace::n_merge_);
+    ASSERT_EQ(0u, CountingTrace::n_split_);
+}
+
+TEST(PhTreeTraceTest, TestMove) {
+    auto points = CreatePoints(1000);
+    TestTree tree;
+    for (size_t i = 0; i < points.size(); ++i) {
+        tree.emplace(points[i], (int)i);
+    }
+    size_t n_nodes_before = PhTreeDebugHelper::GetStats(tree).n_nodes_;
+    CountingTrace::Reset();
+    for (auto& p : points) {
+        TestPoint p2{p[0] + 1, p[1] + 1, p[2] + 1};
+        ASSERT_EQ(1u, tree.erase(p));
+        ASSERT_TRUE(tree.emplace(p2, 0).second);
+    }
+    ASSERT_EQ(CountingTrace::n_split_, CountingTrace::n_alloc_);
+    ASSERT_EQ(CountingTrace::n_merge_, CountingTrace::n_free_);
+    ASSERT_LT(0u, CountingTrace::n_split_);
+    ASSERT_LT(0u, CountingTrace::n_merge_);
+    size_t n_nodes = PhTreeDebugHelper::GetStats(tree).n_nodes_;
+    ASSERT_EQ(n_nodes + CountingTrace::n_merge_, n_nodes_before + CountingTrace::n_split_);
+}
+
+}  // namespace phtree_test_trace
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "phtree/phtree_workload.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace improbable::phtree;
+
+namespace phtree_test_workload {
+
+using TestPoint = PhPointD<3>;
+using TestBox = PhBoxD<3>;
+using PointRecord = PhTreeWorkloadRecord<TestPoint, TestBox>;
+using PointReader = PhTreeWorkloadReader<TestPoint, TestBox>;
+
+TEST(PhTreeWorkloadTest, TestRecordAndRead) {
+    PhTreeD<3, int> tree;
+    std::stringstream ss;
+    PhTreeWorkloadRecorder recorder(tree, ss);
+    tree.set_listener(&recorder);
+
+    TestPoint p1{1, 2, 3};
+    TestPoint p2{4, 5, 6};
+    TestBox box{{0, 0, 0}, {10, 10, 10}};
+    ASSERT_TRUE(tree.emplace(p1, 1).second);
+    ASSERT_TRUE(tree.emplace(p2, 2).second);
+    ASSERT_EQ(1, *recorder.find(p1));
+    ASSERT_EQ(1u, recorder.count(p2));
+    size_t n = 0;
+    auto callback = [&n](const TestPoint&, const int&) { ++n; };
+    recorder.for_each(box, callback);
+    ASSERT_EQ(2u, n);
+    size_t n_knn = 0;
+    for (auto it = recorder.begin_knn_query(1, p2, DistanceEuclidean<3>()); it != recorder.end();
+         ++it) {
+        ++n_knn;
+    }
+    ASSERT_EQ(1u, n_knn);
+    ASSERT_EQ(1u, tree.erase(p1));
+    tree.insert_or_assign(p2, 3);
+    tree.clear();
+    ASSERT_EQ(0u, tree.size());
+
+    PointReader reader(ss);
+    ASSERT_TRUE(reader.IsValid());
+    ASSERT_EQ(3, reader.GetHeader().dim_);
+    ASSERT_FALSE(reader.GetHeader().IsBoxKeys());
+    ASSERT_FALSE(reader.GetHeader().IsMultiMap());
+
+    std::vector<PointRecord> records;
+    PointRecord record;
+    while (reader.Next(record)) {
+        records.push_back(record);
+    }
+    ASSERT_FALSE(ss.fail());
+    ASSERT_EQ(9u, records.size());
+    ASSERT_EQ(PhTreeWorkloadOperation::EMPLACE, records[0].op_);
+    ASSERT_EQ(p1, records[0].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::EMPLACE, records[1].op_);
+    ASSERT_EQ(p2, records[1].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::FIND, records[2].op_);
+    ASSERT_EQ(p1, records[2].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::FIND, records[3].op_);
+    ASSERT_EQ(p2, records[3].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::WINDOW_QUERY, records[4].op_);
+    ASSERT_EQ(box, records[4].query_box_);
+    ASSERT_EQ(PhTreeWorkloadOperation::KNN_QUERY, records[5].op_);
+    ASSERT_EQ(1u, records[5].k_);
+    ASSERT_EQ(p2, records[5].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::ERASE, records[6].op_);
+    ASSERT_EQ(p1, records[6].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::UPDATE, records[7].op_);
+    ASSERT_EQ(p2, records[7].key_);
+    ASSERT_EQ(PhTreeWorkloadOperation::CLEAR, records[8].op_);
+}
+
+TEST(PhTreeWorkloadTest, TestMultiMapValueIds) {
+    PhTreeMultiMapD<3, int> tree;
+    std::stringstream ss;
+    PhTreeWorkloadRecorder recorder(tree, ss, WorkloadValueIdHash());
+    tree.set_listener(&recorder);
+
+    TestPoint p1{1, 2, 3};
+    TestPoint p2{4, 5, 6};
+    tree.emplace(p1, 1000);
+    tree.emplace(p1, 2000);
+    ASSERT_EQ(1u, tree.relocate(p1, p2, 2000));
+    ASSERT_EQ(1u, tree.erase(p1, 1000));
+    ASSERT_EQ(1u, tree.size());
+
+    PointReader reader(ss);
+    ASSERT_TRUE(reader.IsValid());
+    ASSERT_TRUE(reader.GetHeader().IsMultiMap());
+    PointRecord record;
+    ASSERT_TRUE(reader.Next(record));
+    ASSERT_EQ(std::hash<int>{}(1000), record.value_id_);
+    ASSERT_TRUE(reader.Next(record));
+    ASSERT_EQ(std::hash<int>{}(2000), record.value_id_);
+    ASSERT_TRUE(reader.Next(record));
+    ASSERT_EQ(PhTreeWorkloadOperation::RELOCATE, record.op_);
+    ASSERT_EQ(p1, record.key_);
+    ASSERT_EQ(p2, record.new_key_);
+    ASSERT_EQ(std::hash<int>{}(2000), record.value_id_);
+    ASSERT_TRUE(reader.Next(record));
+    ASSERT_EQ(PhTreeWorkloadOperation::ERASE, record.op_);
+    ASSERT_EQ(std::hash<int>{}(1000), record.value_id_);
+    ASSERT_FALSE(reader.Next(record));
+    ASSERT_FALSE(ss.fail());
+}
+
+TEST(PhTreeWorkloadTest, TestBoxKeysAndRecordEntries) {
+    PhTreeBoxD<3, int> tree;
+    TestBox b1{{1, 2, 3}, {4, 5, 6}};
+    TestBox b2{{2, 3, 4}, {5, 6, 7}};
+    tree.emplace(b1, 1);
+    tree.emplace(b2, 2);
+    std::stringstream ss;
+    PhTreeWorkloadRecorder recorder(tree, ss);
+    recorder.record_entries();
+
+    PhTreeWorkloadReader<TestBox, TestBox> reader(ss);
+    ASSERT_TRUE(reader.IsValid());
+    ASSERT_TRUE(reader.GetHeader().IsBoxKeys());
+    ASSERT_EQ(3, reader.GetHeader().dim_);
+    PhTreeWorkloadRecord<TestBox, TestBox> record;
+    size_t n = 0;
+    while (reader.Next(record)) {
+        ASSERT_EQ(PhTreeWorkloadOperation::EMPLACE, record.op_);
+        ASSERT_TRUE(record.key_ == b1 || record.key_ == b2);
+        ++n;
+    }
+    ASSERT_EQ(2u, n);
+
+    // Point keys can not be read from a workload with box keys
+    ss.clear();
+    ss.seekg(0);
+    PointReader point_reader(ss);
+    ASSERT_FALSE(point_reader.IsValid());
+}
+
+TEST(PhTreeWorkloadTest, TestTruncatedWorkload) {
+    PhTreeD<3, int> tree;
+    std::stringstream ss;
+    PhTreeWorkloadRecorder recorder(tree, ss);
+    tree.set_listener(&recorder);
+    tree.emplace({1, 2, 3}, 1);
+    tree.emplace({4, 5, 6}, 2);
+    std::string data = ss.str();
+
+    std::stringstream truncated(data.substr(0, data.size() - 3));
+    PointReader reader(truncated);
+    ASSERT_TRUE(reader.IsValid());
+    PointRecord record;
+    ASSERT_TRUE(reader.Next(record));
+    ASSERT_FALSE(reader.Next(record));
+    ASSERT_TRUE(truncated.fail());
+
+    std::stringstream empty;
+    PointReader empty_reader(empty);
+    ASSERT_FALSE(empty_reader.IsValid());
+}
+
+}  // namespace phtree_test_workload
@@ -0,0 +1,358 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_PHTREE_WORKLOAD_H
+#define PHTREE_PHTREE_WORKLOAD_H
+
+#include "common/serialization.h"
+#include "phtree.h"
+#include "phtree_multimap.h"
+#include "phtree_operation_log.h"
+#include <istream>
+#include <ostream>
+
+namespace improbable::phtree {
+
+/*
+ * Workload recordings contain the operations (including queries) that an application performs on
+ * a PhTree or PhTreeMultiMap, so that they can be replayed offline, for example to benchmark a
+ * production workload, see workload_replay_benchmark.
+ *
+ * In contrast to operation logs (see PhTreeOperationLogWriter), workloads do not contain values
+ * and are not meant for restoring a tree. Instead, every modification is written with a 64 bit
+ * 'value id', see PhTreeWorkloadRecorder.
+ *
+ * The stream starts with a header (magic number, format version, flags, dimensionality and the
+ * sizes of keys and query boxes in bytes), followed by one record per operation. Modifications are
+ * encoded exactly like operation log records, with the value id (a variable length integer) as
+ * value. Queries have their own operation types:
+ * - FIND: key.
+ * - WINDOW_QUERY: query box.
+ * - KNN_QUERY: k (variable length integer), center.
+ * As with serialize(), workloads can only be read on machines with the same endianness.
+ */
+enum class PhTreeWorkloadOperation : std::uint8_t {
+    EMPLACE = static_cast<std::uint8_t>(PhTreeOperation::EMPLACE),
+    ERASE = static_cast<std::uint8_t>(PhTreeOperation::ERASE),
+    RELOCATE = static_cast<std::uint8_t>(PhTreeOperation::RELOCATE),
+    CLEAR = static_cast<std::uint8_t>(PhTreeOperation::CLEAR),
+    UPDATE = static_cast<std::uint8_t>(PhTreeOperation::UPDATE),
+    // Queries start at 16 to leave room for new types of modifications.
+    FIND = 16,
+    WINDOW_QUERY = 17,
+    KNN_QUERY = 18,
+};
+
+/*
+ * Header of a workload, see PhTreeWorkloadRecorder.
+ */
+struct PhTreeWorkloadHeader {
+    static constexpr std::uint32_t MAGIC = 0x50485731;  // "PHW1"
+    static constexpr std::uint8_t VERSION = 1;
+    static constexpr std::uint8_t FLAG_BOX_KEYS = 1;
+    static constexpr std::uint8_t FLAG_MULTIMAP = 2;
+
+    [[nodiscard]] bool IsBoxKeys() const {
+        return (flags_ & FLAG_BOX_KEYS) != 0;
+    }
+
+    [[nodiscard]] bool IsMultiMap() const {
+        return (flags_ & FLAG_MULTIMAP) != 0;
+    }
+
+    std::uint8_t flags_ = 0;
+    // The dimensionality of the keys, e.g. 3 for PhBoxD<3>
+    std::uint8_t dim_ = 0;
+    std::uint16_t key_size_ = 0;
+    std::uint16_t query_box_size_ = 0;
+};
+
+template <typename KEY, typename QUERY_BOX>
+struct PhTreeWorkloadRecord {
+    PhTreeWorkloadOperation op_ = PhTreeWorkloadOperation::CLEAR;
+    KEY key_{};
+    KEY new_key_{};
+    QUERY_BOX query_box_{};
+    std::uint64_t value_id_ = 0;
+    std::uint64_t k_ = 0;
+};
+
+/*
+ * Default value ids for PhTreeWorkloadRecorder, all values have the id '0'. This is sufficient for
+ * PhTree but not for PhTreeMultiMap, where values with the same key must have different ids.
+ */
+struct WorkloadValueIdNoOp {
+    template <typename T>
+    std::uint64_t operator()(const T&) const {
+        return 0;
+    }
+};
+
+/*
+ * Value ids that are calculated with std::hash.
+ */
+struct WorkloadValueIdHash {
+    template <typename T>
+    std::uint64_t operator()(const T& value) const {
+        return std::hash<T>{}(value);
+    }
+};
+
+namespace detail {
+template <typename TREE>
+struct WorkloadTreeTraits;
+
+template <dimension_t DIM, typename T, typename CONVERTER>
+struct WorkloadTreeTraits<PhTree<DIM, T, CONVERTER>> {
+    using Key = typename CONVERTER::KeyExternal;
+    using QueryBox = typename CONVERTER::QueryBoxExternal;
+    using Value = T;
+    static constexpr dimension_t Dim = DIM;
+    static constexpr bool IS_MULTIMAP = false;
+};
+
+template <
+    dimension_t DIM,
+    typename T,
+    typename CONVERTER,
+    typename BUCKET,
+    bool POINT_KEYS,
+    typename DEFAULT_QUERY_TYPE>
+struct WorkloadTreeTraits<
+    PhTreeMultiMap<DIM, T, CONVERTER, BUCKET, POINT_KEYS, DEFAULT_QUERY_TYPE>> {
+    using Key = typename CONVERTER::KeyExternal;
+    using QueryBox = typename CONVERTER::QueryBoxExternal;
+    using Value = T;
+    static constexpr dimension_t Dim = DIM;
+    static constexpr bool IS_MULTIMAP = true;
+};
+
+/*
+ * Operation log codec that writes value ids instead of values.
+ */
+template <typename VALUE_ID>
+class WorkloadValueIdCodec {
+  public:
+    explicit WorkloadValueIdCodec(const VALUE_ID& value_id = VALUE_ID()) : value_id_{value_id} {}
+
+    template <typename T>
+    void write(std::ostream& os, const T& value) const {
+        WriteVarInt(os, value_id_(value));
+    }
+
+    std::uint64_t read(std::istream& is) const {
+        std::uint64_t value_id = 0;
+        ReadVarInt(is, value_id);
+        return value_id;
+    }
+
+  private:
+    VALUE_ID value_id_;
+};
+}  // namespace detail
+
+/*
+ * Reads a workload that was written with PhTreeWorkloadRecorder. The header is read by the
+ * constructor.
+ */
+template <typename KEY, typename QUERY_BOX>
+class PhTreeWorkloadReader {
+  public:
+    explicit PhTreeWorkloadReader(std::istream& is) : is_{is} {
+        std::uint32_t magic = 0;
+        std::uint8_t version = 0;
+        valid_ = ReadRaw(is_, magic) && ReadRaw(is_, version) && ReadRaw(is_, header_.flags_) &&
+            ReadRaw(is_, header_.dim_) && ReadRaw(is_, header_.key_size_) &&
+            ReadRaw(is_, header_.query_box_size_);
+        valid_ = valid_ && magic == PhTreeWorkloadHeader::MAGIC &&
+            version == PhTreeWorkloadHeader::VERSION && header_.key_size_ == sizeof(KEY) &&
+            header_.query_box_size_ == sizeof(QUERY_BOX) &&
+            header_.IsBoxKeys() == std::is_same_v<KEY, QUERY_BOX>;
+    }
+
+    /*
+     * @return 'false' if the header is invalid or if it does not match KEY and QUERY_BOX.
+     */
+    [[nodiscard]] bool IsValid() const {
+        return valid_;
+    }
+
+    [[nodiscard]] const PhTreeWorkloadHeader& GetHeader() const {
+        return header_;
+    }
+
+    /*
+     * Reads the next record.
+     * @return 'false' at the end of the workload or if the record is incomplete or invalid. The
+     * failbit of the stream is set in the latter two cases.
+     */
+    bool Next(PhTreeWorkloadRecord<KEY, QUERY_BOX>& record) {
+        if (!valid_ || is_.peek() == std::istream::traits_type::eof()) {
+            return false;
+        }
+        std::uint8_t op = 0;
+        ReadRaw(is_, op);
+        record.op_ = static_cast<PhTreeWorkloadOperation>(op);
+        bool success = true;
+        switch (record.op_) {
+        case PhTreeWorkloadOperation::FIND:
+            success = ReadRaw(is_, record.key_);
+            break;
+        case PhTreeWorkloadOperation::WINDOW_QUERY:
+            success = ReadRaw(is_, record.query_box_);
+            break;
+        case PhTreeWorkloadOperation::KNN_QUERY:
+            success = ReadVarInt(is_, record.k_) && ReadRaw(is_, record.key_);
+            break;
+        default: {
+            // Modifications are operation log records
+            detail::LogRecord<KEY, std::uint64_t> log_record;
+            log_record.op_ = static_cast<PhTreeOperation>(op);
+            if (!detail::ReadLogRecordBody(is_, codec_, log_record)) {
+                return false;
+            }
+            record.key_ = log_record.key_;
+            record.new_key_ = log_record.new_key_;
+            record.value_id_ = log_record.value_;
+        }
+        }
+        if (!success) {
+            is_.setstate(std::ios::failbit);
+        }
+        return success;
+    }
+
+  private:
+    std::istream& is_;
+    PhTreeWorkloadHeader header_;
+    bool valid_;
+    const detail::WorkloadValueIdCodec<WorkloadValueIdNoOp> codec_{};
+};
+
+/*
+ * Records the workload of a PhTree or PhTreeMultiMap.
+ *
+ * Modifications are recorded by the recorder's PhTreeOperationLogWriter, i.e. the recorder is a
+ * listener that has to be attached to the tree with set_listener(), possibly via a
+ * PhTreeListenerFanOut. Queries are recorded by calling them on the recorder, which forwards them
+ * to the tree. Queries that are called directly on the tree are not recorded.
+ *
+ * All queries are recorded, regardless of their outcome.
+ *
+ * Workloads are usually replayed on an empty tree. If the tree is not empty when recording starts,
+ * record_entries() can be used to write all current entries as EMPLACE records.
+ *
+ * @tparam VALUE_ID Calculates the value id of a value, see WorkloadValueIdNoOp and
+ * WorkloadValueIdHash. For multimaps, the value ids of all values with the same key must be
+ * different.
+ */
+template <typename TREE, typename VALUE_ID = WorkloadValueIdNoOp>
+class PhTreeWorkloadRecorder
+: public PhTreeOperationLogWriter<
+      typename detail::WorkloadTreeTraits<TREE>::Key,
+      typename detail::WorkloadTreeTraits<TREE>::Value,
+      detail::WorkloadValueIdCodec<VALUE_ID>> {
+    using Traits = detail::WorkloadTreeTraits<TREE>;
+    using Key = typename Traits::Key;
+    using QueryBox = typename Traits::QueryBox;
+    using Value = typename Traits::Value;
+    using LogWriter =
+        PhTreeOperationLogWriter<Key, Value, detail::WorkloadValueIdCodec<VALUE_ID>>;
+    static constexpr bool IS_BOX = std::is_same_v<Key, QueryBox>;
+
+  public:
+    /*
+     * Writes the header. The stream is not flushed by the recorder.
+     */
+    PhTreeWorkloadRecorder(TREE& tree, std::ostream& os, const VALUE_ID& value_id = VALUE_ID())
+    : LogWriter{os, detail::WorkloadValueIdCodec<VALUE_ID>{value_id}}, tree_{tree}, os_{os} {
+        std::uint8_t flags = IS_BOX ? PhTreeWorkloadHeader::FLAG_BOX_KEYS : 0;
+        flags |= Traits::IS_MULTIMAP ? PhTreeWorkloadHeader::FLAG_MULTIMAP : 0;
+        WriteRaw(os_, PhTreeWorkloadHeader::MAGIC);
+        WriteRaw(os_, PhTreeWorkloadHeader::VERSION);
+        WriteRaw(os_, flags);
+        WriteRaw(os_, static_cast<std::uint8_t>(Traits::Dim));
+        WriteRaw(os_, static_cast<std::uint16_t>(sizeof(Key)));
+        WriteRaw(os_, static_cast<std::uint16_t>(sizeof(QueryBox)));
+    }
+
+    /*
+     * Writes EMPLACE records for all entries that are currently in the tree.
+     */
+    void record_entries() {
+        auto callback = [this](const Key& key, const Value& value) { this->OnEmplace(key, value); };
+        tree_.for_each(callback);
+    }
+
+    auto find(const Key& key) {
+        WriteFind(key);
+        return tree_.find(key);
+    }
+
+    size_t count(const Key& key) {
+        WriteFind(key);
+        return tree_.count(key);
+    }
+
+    template <typename CALLBACK_FN, typename... Args>
+    void for_each(const QueryBox& query_box, CALLBACK_FN& callback, Args&&... args) {
+        WriteWindowQuery(query_box);
+        tree_.for_each(query_box, callback, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    auto begin_query(const QueryBox& query_box, Args&&... args) {
+        WriteWindowQuery(query_box);
+        return tree_.begin_query(query_box, std::forward<Args>(args)...);
+    }
+
+    template <typename DISTANCE, typename... Args>
+    auto begin_knn_query(size_t min_results, const Key& center, DISTANCE distance, Args&&... args) {
+        WriteRaw(os_, PhTreeWorkloadOperation::KNN_QUERY);
+        WriteVarInt(os_, min_results);
+        WriteRaw(os_, center);
+        return tree_.begin_knn_query(min_results, center, distance, std::forward<Args>(args)...);
+    }
+
+    auto end() const {
+        return tree_.end();
+    }
+
+    /*
+     * @return The tree, queries on the tree are not recorded.
+     */
+    TREE& tree() {
+        return tree_;
+    }
+
+  private:
+    void WriteFind(const Key& key) {
+        WriteRaw(os_, PhTreeWorkloadOperation::FIND);
+        WriteRaw(os_, key);
+    }
+
+    void WriteWindowQuery(const QueryBox& query_box) {
+        WriteRaw(os_, PhTreeWorkloadOperation::WINDOW_QUERY);
+        WriteRaw(os_, query_box);
+    }
+
+    TREE& tree_;
+    std::ostream& os_;
+};
+
+}  // namespace improbable::phtree
+
+#endif  // PHTREE_PHTREE_WORKLOAD_H
@@ -69,8 +69,16 @@ class DebugHelperV16 : public PhTreeDebugHelper::DebugHelper {
      * @return some statistics about the tree.
      */
     [[nodiscard]] PhTreeStats GetStats() const override {
+        return GetStats(ValueHeapSizeDefault{});
+    }
+
+    /*
+     * @param value_size_fn Returns the heap memory that is owned by a value.
+     */
+    template <typename VALUE_SIZE>
+    [[nodiscard]] PhTreeStats GetStats(const VALUE_SIZE& value_size_fn) const {
         PhTreeStats stats;
-        root_.GetStats(stats);
+        root_.GetStats(stats, value_size_fn);
         return stats;
     }
 
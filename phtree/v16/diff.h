@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_V16_DIFF_H
+#define PHTREE_V16_DIFF_H
+
+#include "../common/common.h"
+#include "node.h"
+#include "phtree_v16.h"
+
+namespace improbable::phtree::v16 {
+
+/*
+ * Reports all differences between two trees.
+ *
+ * Both trees are traversed in parallel. Node hashes (see Node::GetHash()) are the sum of the
+ * hashes of all entries in a node's subtree, they are independent of the structure of the
+ * subtree. Subtrees that cover the same region and have the same hash are skipped, so the cost
+ * of a diff is proportional to the number of differences (times the depth of the tree).
+ */
+template <typename T, typename CONVERT, typename CALLBACK_FN, typename HASH>
+class Diff {
+    static constexpr dimension_t DIM = CONVERT::DimInternal;
+    using SCALAR = typename CONVERT::ScalarInternal;
+    using EntryT = Entry<DIM, T, SCALAR>;
+    using NodeT = Node<DIM, T, SCALAR>;
+
+  public:
+    Diff(const CONVERT& converter, CALLBACK_FN& callback, const HASH& hash_fn)
+    : converter_{converter}, callback_{callback}, hash_fn_{hash_fn} {}
+
+    void run(const EntryT& root_a, const EntryT& root_b) {
+        assert(root_a.IsNode() && root_b.IsNode());
+        DiffEntries(root_a, root_b);
+    }
+
+  private:
+    // The number of trailing bits that are not fixed by the prefix of an entry.
+    static bit_width_t GetRegionBits(const EntryT& entry) {
+        return entry.IsNode() ? entry.GetNode().GetPostfixLen() + 1 : 0;
+    }
+
+    void DiffEntries(const EntryT& a, const EntryT& b) {
+        bit_width_t bits_a = GetRegionBits(a);
+        bit_width_t bits_b = GetRegionBits(b);
+        bit_width_t diverging_bits = NumberOfDivergingBits(a.GetKey(), b.GetKey());
+        if (diverging_bits > std::max(bits_a, bits_b)) {
+            // Disjoint regions
+            Report(a, true);
+            Report(b, false);
+        } else if (bits_a == bits_b) {
+            if (a.IsNode()) {
+                DiffNodes(a.GetNode(), b.GetNode());
+            } else if (hash_fn_(a.GetValue()) != hash_fn_(b.GetValue())) {
+                callback_(converter_.post(a.GetKey()), &a.GetValue(), &b.GetValue());
+            }
+        } else if (bits_a > bits_b) {
+            DiffNested(a.GetNode(), b, true);
+        } else {
+            DiffNested(b.GetNode(), a, false);
+        }
+    }
+
+    // Both nodes cover the same region
+    void DiffNodes(const NodeT& a, const NodeT& b) {
+        if (a.GetHash(hash_fn_) == b.GetHash(hash_fn_)) {
+            return;
+        }
+        auto iter_a = a.Entries().begin();
+        auto iter_b = b.Entries().begin();
+        auto end_a = a.Entries().end();
+        auto end_b = b.Entries().end();
+        while (iter_a != end_a || iter_b != end_b) {
+            if (iter_b == end_b || (iter_a != end_a && iter_a->first < iter_b->first)) {
+                Report(iter_a->second, true);
+                ++iter_a;
+            } else if (iter_a == end_a || iter_b->first < iter_a->first) {
+                Report(iter_b->second, false);
+                ++iter_b;
+            } else {
+                DiffEntries(iter_a->second, iter_b->second);
+                ++iter_a;
+                ++iter_b;
+            }
+        }
+    }
+
+    // The region of 'entry' is a part of the region of 'node'
+    void DiffNested(const NodeT& node, const EntryT& entry, bool node_is_a) {
+        hc_pos_t hc_pos = CalcPosInArray(entry.GetKey(), node.GetPostfixLen());
+        bool found = false;
+        for (auto& node_entry : node.Entries()) {
+            if (node_entry.first == hc_pos) {
+                found = true;
+                if (node_is_a) {
+                    DiffEntries(node_entry.second, entry);
+                } else {
+                    DiffEntries(entry, node_entry.second);
+                }
+            } else {
+                Report(node_entry.second, node_is_a);
+            }
+        }
+        if (!found) {
+            Report(entry, !node_is_a);
+        }
+    }
+
+    // Reports all entries in the subtree as missing in the other tree.
+    void Report(const EntryT& entry, bool is_a) {
+        if (entry.IsNode()) {
+            for (auto& child : entry.GetNode().Entries()) {
+                Report(child.second, is_a);
+            }
+        } else if (is_a) {
+            callback_(converter_.post(entry.GetKey()), &entry.GetValue(), nullptr);
+        } else {
+            callback_(converter_.post(entry.GetKey()), nullptr, &entry.GetValue());
+        }
+    }
+
+    CONVERT converter_;
+    CALLBACK_FN& callback_;
+    const HASH& hash_fn_;
+};
+
+/*
+ * Reports all entries that differ between two trees. Subtrees with equal hashes are skipped, see
+ * PhTreeV16::hash().
+ * The callback requires the following signature:
+ * callback(const KEY& key, const T* value_a, const T* value_b)
+ * One of the value pointers is 'nullptr' if the key exists only in one of the trees.
+ * Both are set if the values have different hashes.
+ */
+template <dimension_t DIM, typename T, typename CONVERT, typename CALLBACK_FN, typename HASH>
+void diff(
+    PhTreeV16<DIM, T, CONVERT>& tree_a,
+    PhTreeV16<DIM, T, CONVERT>& tree_b,
+    CALLBACK_FN& callback,
+    const HASH& hash_fn) {
+    // Update cached hashes
+    (void)tree_a.hash(hash_fn);
+    (void)tree_b.hash(hash_fn);
+    Diff<T, CONVERT, CALLBACK_FN, HASH>(PhTreeAccess::GetConverter(tree_a), callback, hash_fn)
+        .run(PhTreeAccess::GetRoot(tree_a), PhTreeAccess::GetRoot(tree_b));
+}
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_DIFF_H
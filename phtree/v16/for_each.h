@@ -36,8 +36,15 @@ class ForEach {
     using NodeT = Node<DIM, T, SCALAR>;
 
   public:
-    ForEach(const CONVERT& converter, CALLBACK_FN& callback, FILTER filter)
-    : converter_{converter}, callback_{callback}, filter_(std::move(filter)) {}
+    ForEach(
+        const CONVERT& converter,
+        CALLBACK_FN& callback,
+        FILTER filter,
+        PhTreeQueryStats* stats = nullptr)
+    : converter_{converter}
+    , callback_{callback}
+    , filter_(std::move(filter))
+    , stats_{ResolveQueryStats(stats)} {}
 
     void run(const EntryT& root) {
         assert(root.IsNode());
@@ -46,6 +53,7 @@ class ForEach {
 
   private:
     void TraverseNode(const KeyInternal& key, const NodeT& node) {
+        PHTREE_QUERY_STATS_VISIT_NODE(stats_, MAX_BIT_WIDTH<SCALAR> - 1 - node.GetPostfixLen());
         auto iter = node.Entries().begin();
         auto end = node.Entries().end();
         for (; iter != end; ++iter) {
@@ -55,10 +63,14 @@ class ForEach {
                 const auto& child_node = child.GetNode();
                 if (filter_.IsNodeValid(key, node.GetPostfixLen() + 1)) {
                     TraverseNode(child_key, child_node);
+                } else {
+                    PHTREE_QUERY_STATS_INC(stats_, n_nodes_pruned_filter_);
                 }
             } else {
                 T& value = child.GetValue();
+                PHTREE_QUERY_STATS_INC(stats_, n_entries_tested_);
                 if (filter_.IsEntryValid(key, value)) {
+                    PHTREE_QUERY_STATS_INC(stats_, n_entries_returned_);
                     callback_(converter_.post(child_key), value);
                 }
             }
@@ -68,6 +80,7 @@ class ForEach {
     CONVERT converter_;
     CALLBACK_FN& callback_;
     FILTER filter_;
+    PhTreeQueryStats* const stats_;
 };
 }  // namespace improbable::phtree::v16
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PHTREE_V16_FOR_EACH_DIRTY_H
+#define PHTREE_V16_FOR_EACH_DIRTY_H
+
+#include "../common/common.h"
+#include "node.h"
+#include "phtree_v16.h"
+
+namespace improbable::phtree::v16 {
+
+/*
+ * Reports the regions of all nodes that were modified after a given generation, see
+ * PhTreeV16::set_generation_tracking().
+ *
+ * A modified node is reported if it is at 'max_depth' or if its own entries were modified.
+ * Otherwise only its modified child nodes are traversed. Reported regions never overlap.
+ */
+template <typename T, typename CONVERT, typename CALLBACK_FN>
+class ForEachDirty {
+    static constexpr dimension_t DIM = CONVERT::DimInternal;
+    using KeyInternal = typename CONVERT::KeyInternal;
+    using SCALAR = typename CONVERT::ScalarInternal;
+    using EntryT = Entry<DIM, T, SCALAR>;
+    using NodeT = Node<DIM, T, SCALAR>;
+
+  public:
+    ForEachDirty(std::uint64_t since_generation, size_t max_depth, CALLBACK_FN& callback)
+    : since_generation_{since_generation}, max_depth_{max_depth}, callback_{callback} {}
+
+    void run(const EntryT& root) {
+        assert(root.IsNode());
+        TraverseNode(root.GetKey(), root.GetNode(), 0);
+    }
+
+  private:
+    void TraverseNode(const KeyInternal& prefix, const NodeT& node, size_t depth) {
+        if (node.GetGeneration() <= since_generation_) {
+            return;
+        }
+        if (depth >= max_depth_ || node.GetEntryGeneration() > since_generation_) {
+            KeyInternal min;
+            KeyInternal max;
+            CalcNodeBounds(prefix, node.GetPostfixLen() + 1, min, max);
+            callback_(min, max);
+            return;
+        }
+        for (auto& entry : node.Entries()) {
+            const auto& child = entry.second;
+            if (child.IsNode()) {
+                TraverseNode(child.GetKey(), child.GetNode(), depth + 1);
+            }
+        }
+    }
+
+    const std::uint64_t since_generation_;
+    const size_t max_depth_;
+    CALLBACK_FN& callback_;
+};
+
+/*
+ * Reports the regions of all nodes that were modified after 'since_generation'. Nodes whose
+ * own entries were modified are reported as a whole, otherwise only their modified child nodes
+ * are traversed, up to a depth of 'max_depth' nodes (the root has depth 0). Reported regions
+ * do not overlap.
+ * The callback requires the following signature:
+ * callback(const KeyInternal& region_min, const KeyInternal& region_max)
+ */
+template <dimension_t DIM, typename T, typename CONVERT, typename CALLBACK_FN>
+void for_each_dirty_node(
+    const PhTreeV16<DIM, T, CONVERT>& tree,
+    std::uint64_t since_generation,
+    size_t max_depth,
+    CALLBACK_FN& callback) {
+    static_assert(
+        GENERATION_TRACKING_ENABLED && sizeof(CALLBACK_FN) > 0,
+        "for_each_dirty_node() requires PHTREE_GENERATION_TRACKING");
+    ForEachDirty<T, CONVERT, CALLBACK_FN>(since_generation, max_depth, callback)
+        .run(PhTreeAccess::GetRoot(tree));
+}
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_FOR_EACH_DIRTY_H
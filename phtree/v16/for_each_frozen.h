@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_FOR_EACH_FROZEN_H
+#define PHTREE_V16_FOR_EACH_FROZEN_H
+
+#include "../common/common.h"
+#include "frozen_data_v16.h"
+
+namespace improbable::phtree::v16 {
+
+/*
+ * Callback based traversal of frozen trees. This is the equivalent of ForEach (IS_WINDOW=false)
+ * and ForEachHC (IS_WINDOW=true).
+ */
+template <typename T, typename CONVERT, typename CALLBACK_FN, typename FILTER, bool IS_WINDOW>
+class ForEachFrozen {
+    static constexpr dimension_t DIM = CONVERT::DimInternal;
+    using KeyInternal = typename CONVERT::KeyInternal;
+    using SCALAR = typename CONVERT::ScalarInternal;
+    using DataT = FrozenDataV16<DIM, T, SCALAR>;
+    using index_t = typename DataT::index_t;
+
+  public:
+    ForEachFrozen(
+        const DataT& data,
+        const KeyInternal& range_min,
+        const KeyInternal& range_max,
+        const CONVERT& converter,
+        CALLBACK_FN& callback,
+        FILTER filter)
+    : data_{data}
+    , range_min_{range_min}
+    , range_max_{range_max}
+    , converter_{converter}
+    , callback_{callback}
+    , filter_(std::move(filter)) {}
+
+    void run() {
+        TraverseNode(KeyInternal{}, data_.GetRoot());
+    }
+
+  private:
+    void TraverseNode(const KeyInternal& prefix, const FrozenNodeV16& node) {
+        index_t entry = node.first_entry_;
+        index_t end = node.first_entry_ + node.entry_count_;
+        hc_pos_t mask_lower = 0;
+        hc_pos_t mask_upper = 0;
+        if constexpr (IS_WINDOW) {
+            DataT::CalcLimits(
+                node.postfix_len_, prefix, range_min_, range_max_, mask_lower, mask_upper);
+            entry = data_.LowerBound(node, mask_lower);
+        }
+        for (; entry < end; ++entry) {
+            if constexpr (IS_WINDOW) {
+                hc_pos_t hc_pos = data_.GetHcPos(entry);
+                if (hc_pos > mask_upper) {
+                    break;
+                }
+                if (((hc_pos | mask_lower) & mask_upper) != hc_pos ||
+                    !data_.IsEntryInRange(entry, range_min_, range_max_)) {
+                    continue;
+                }
+            }
+            const auto& key = data_.GetKey(entry);
+            if (data_.IsNode(entry)) {
+                const auto& child = data_.GetChildNode(entry);
+                if (filter_.IsNodeValid(key, child.postfix_len_ + 1)) {
+                    TraverseNode(key, child);
+                }
+            } else {
+                const T& value = data_.GetValue(entry);
+                if (filter_.IsEntryValid(key, value)) {
+                    callback_(converter_.post(key), value);
+                }
+            }
+        }
+    }
+
+    const DataT& data_;
+    const KeyInternal range_min_;
+    const KeyInternal range_max_;
+    const CONVERT& converter_;
+    CALLBACK_FN& callback_;
+    FILTER filter_;
+};
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_FOR_EACH_FROZEN_H
@@ -48,12 +48,14 @@ class ForEachHC {
         const KeyInternal& range_max,
         const CONVERT& converter,
         CALLBACK_FN& callback,
-        FILTER filter)
+        FILTER filter,
+        PhTreeQueryStats* stats = nullptr)
     : range_min_{range_min}
     , range_max_{range_max}
     , converter_{converter}
     , callback_{callback}
-    , filter_(std::move(filter)) {}
+    , filter_(std::move(filter))
+    , stats_{ResolveQueryStats(stats)} {}
 
     void run(const EntryT& root) {
         assert(root.IsNode());
@@ -64,10 +66,16 @@ class ForEachHC {
     void TraverseNode(const KeyInternal& key, const NodeT& node) {
         hc_pos_t mask_lower = 0;
         hc_pos_t mask_upper = 0;
+        PHTREE_QUERY_STATS_VISIT_NODE(stats_, MAX_BIT_WIDTH<SCALAR> - 1 - node.GetPostfixLen());
         CalcLimits(node.GetPostfixLen(), key, mask_lower, mask_upper);
         auto iter = node.Entries().lower_bound(mask_lower);
         auto end = node.Entries().end();
+        auto prefetch_iter = iter;
+        for (size_t i = 0; i < PREFETCH_DISTANCE; ++i) {
+            PrefetchNext(prefetch_iter, end, mask_lower, mask_upper);
+        }
         for (; iter != end && iter->first <= mask_upper; ++iter) {
+            PrefetchNext(prefetch_iter, end, mask_lower, mask_upper);
             auto child_hc_pos = iter->first;
             // Use bit-mask magic to check whether we are in a valid quadrant.
             // -> See paper referenced in class description.
@@ -81,11 +89,29 @@ class ForEachHC {
                     }
                 } else {
                     T& value = child.GetValue();
+                    PHTREE_QUERY_STATS_INC(stats_, n_entries_tested_);
                     if (IsInRange(child_key, range_min_, range_max_) &&
                         ApplyFilter(child_key, value)) {
+                        PHTREE_QUERY_STATS_INC(stats_, n_entries_returned_);
                         callback_(converter_.post(child_key), value);
                     }
                 }
+            } else {
+                PHTREE_QUERY_STATS_INC_IF(stats_, iter->second.IsNode(), n_nodes_pruned_hc_);
+            }
+        }
+    }
+
+    // Prefetches the child node of the next valid entry. 'iter' runs ahead of the traversal.
+    template <typename ITER>
+    void PrefetchNext(ITER& iter, const ITER& end, hc_pos_t mask_lower, hc_pos_t mask_upper) {
+        if constexpr (PREFETCH_DISTANCE > 0) {
+            if (iter != end && iter->first <= mask_upper) {
+                auto hc_pos = iter->first;
+                if (((hc_pos | mask_lower) & mask_upper) == hc_pos && iter->second.IsNode()) {
+                    iter->second.GetNode().Prefetch();
+                }
+                ++iter;
             }
         }
     }
@@ -101,11 +127,16 @@ class ForEachHC {
             for (dimension_t dim = 0; dim < DIM; ++dim) {
                 SCALAR prefix = key[dim] & comparison_mask;
                 if (prefix > range_max_[dim] || prefix < (range_min_[dim] & comparison_mask)) {
+                    PHTREE_QUERY_STATS_INC(stats_, n_nodes_pruned_prefix_);
                     return false;
                 }
             }
         }
-        return ApplyFilter(key, node);
+        if (!ApplyFilter(key, node)) {
+            PHTREE_QUERY_STATS_INC(stats_, n_nodes_pruned_filter_);
+            return false;
+        }
+        return true;
     }
 
     [[nodiscard]] bool ApplyFilter(const KeyInternal& key, const NodeT& node) const {
@@ -183,6 +214,7 @@ class ForEachHC {
     CONVERT converter_;
     CALLBACK_FN& callback_;
     FILTER filter_;
+    PhTreeQueryStats* const stats_;
 };
 }  // namespace improbable::phtree::v16
 
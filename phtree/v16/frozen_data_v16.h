@@ -0,0 +1,570 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_FROZEN_DATA_V16_H
+#define PHTREE_V16_FROZEN_DATA_V16_H
+
+#include "../common/common.h"
+#include "node.h"
+#include <algorithm>
+#include <vector>
+
+namespace improbable::phtree::v16 {
+
+/*
+ * The frozen layout is a read-only, pointer-free representation of a PH-Tree. All references
+ * between nodes are array indexes, so a frozen image can be written to a file and later be used
+ * directly from memory mapped bytes without any deserialization.
+ *
+ * An image consists of a header followed by five arrays. Every array starts at an offset that is a
+ * multiple of ALIGNMENT:
+ * - nodes:  One FrozenNodeV16 per node, in depth-first (pre-)order. The root is node 0.
+ * - hc_pos: The hypercube address of every entry. The entries of a node are stored contiguously
+ *           and ordered by their hypercube address, so they can be searched with binary search.
+ * - refs:   For every entry, either the index of the child node (marked with NODE_FLAG) or the
+ *           index of the value in the value array.
+ * - keys:   The (internal) key of every entry.
+ * - values: All values, in z-order. Images that are created in memory with freeze() keep the values
+ *           in a separate array (FLAG_EXTERNAL_VALUES), this allows any copyable value type.
+ *
+ * All numbers are stored in native byte order.
+ */
+struct FrozenHeaderV16 {
+    static constexpr std::uint32_t MAGIC = 0x50484631;  // "PHF1"
+    static constexpr std::uint16_t VERSION = 1;
+    static constexpr std::uint64_t ALIGNMENT = 64;
+    static constexpr std::uint64_t NODE_FLAG = std::uint64_t(1) << 63;
+    static constexpr std::uint32_t FLAG_EXTERNAL_VALUES = 1;
+
+    std::uint32_t magic_;
+    std::uint16_t version_;
+    std::uint8_t dim_;
+    std::uint8_t scalar_size_;
+    std::uint32_t value_size_;
+    std::uint32_t flags_;
+    std::uint64_t num_entries_;
+    std::uint64_t num_nodes_;
+    std::uint64_t num_slots_;
+    std::uint64_t nodes_offset_;
+    std::uint64_t hc_pos_offset_;
+    std::uint64_t refs_offset_;
+    std::uint64_t keys_offset_;
+    std::uint64_t values_offset_;
+    std::uint64_t image_size_;
+};
+
+struct FrozenNodeV16 {
+    std::uint64_t first_entry_;
+    std::uint32_t entry_count_;
+    bit_width_t postfix_len_;
+    bit_width_t infix_len_;
+};
+
+/*
+ * Read-only view of a frozen image. The view does not own the memory.
+ *
+ * Attach() validates the header, the bounds of all arrays and the structure of the tree, see
+ * IsValidTree(). The structure check reads all nodes, hypercube addresses and references, i.e. it
+ * touches most pages of a memory mapped file once.
+ */
+template <dimension_t DIM, typename T, typename SCALAR>
+class FrozenDataV16 {
+    using KeyT = PhPoint<DIM, SCALAR>;
+
+  public:
+    using index_t = std::uint64_t;
+    static constexpr index_t NOT_FOUND = std::numeric_limits<index_t>::max();
+
+    FrozenDataV16()
+    : nodes_{&EMPTY_ROOT}
+    , hc_pos_{nullptr}
+    , refs_{nullptr}
+    , keys_{nullptr}
+    , values_{nullptr}
+    , num_entries_{0} {}
+
+    /*
+     * @param external_values The values of images with FLAG_EXTERNAL_VALUES, otherwise nullptr.
+     * @return 'false' if the memory does not contain a frozen image that matches DIM, T and SCALAR.
+     * In this case the view remains empty.
+     */
+    bool Attach(const char* data, size_t size, const T* external_values = nullptr) {
+        Detach();
+        FrozenHeaderV16 h{};
+        if (data == nullptr || size < sizeof(h)) {
+            return false;
+        }
+        std::copy(data, data + sizeof(h), reinterpret_cast<char*>(&h));
+        if (h.magic_ != FrozenHeaderV16::MAGIC || h.version_ != FrozenHeaderV16::VERSION ||
+            h.dim_ != DIM || h.scalar_size_ != sizeof(SCALAR) || h.value_size_ != sizeof(T) ||
+            h.image_size_ > size || h.num_nodes_ < 1 || h.num_entries_ > h.num_slots_) {
+            return false;
+        }
+        bool has_external_values = (h.flags_ & FrozenHeaderV16::FLAG_EXTERNAL_VALUES) != 0;
+        if (has_external_values != (external_values != nullptr) && h.num_entries_ > 0) {
+            return false;
+        }
+        if (!IsValidArray<FrozenNodeV16>(data, h, h.nodes_offset_, h.num_nodes_) ||
+            !IsValidArray<hc_pos_t>(data, h, h.hc_pos_offset_, h.num_slots_) ||
+            !IsValidArray<std::uint64_t>(data, h, h.refs_offset_, h.num_slots_) ||
+            !IsValidArray<KeyT>(data, h, h.keys_offset_, h.num_slots_) ||
+            (!has_external_values &&
+             !IsValidArray<T>(data, h, h.values_offset_, h.num_entries_))) {
+            return false;
+        }
+        auto* nodes = reinterpret_cast<const FrozenNodeV16*>(data + h.nodes_offset_);
+        auto* hc_pos = reinterpret_cast<const hc_pos_t*>(data + h.hc_pos_offset_);
+        auto* refs = reinterpret_cast<const std::uint64_t*>(data + h.refs_offset_);
+        if (!IsValidTree(h, nodes, hc_pos, refs)) {
+            return false;
+        }
+        nodes_ = nodes;
+        hc_pos_ = hc_pos;
+        refs_ = refs;
+        keys_ = reinterpret_cast<const KeyT*>(data + h.keys_offset_);
+        values_ = has_external_values ? external_values
+                                      : reinterpret_cast<const T*>(data + h.values_offset_);
+        num_entries_ = h.num_entries_;
+        return true;
+    }
+
+    void Detach() {
+        *this = FrozenDataV16();
+    }
+
+    [[nodiscard]] size_t GetEntryCount() const {
+        return num_entries_;
+    }
+
+    [[nodiscard]] const FrozenNodeV16& GetRoot() const {
+        return nodes_[0];
+    }
+
+    [[nodiscard]] const FrozenNodeV16& GetNode(index_t node) const {
+        return nodes_[node];
+    }
+
+    [[nodiscard]] hc_pos_t GetHcPos(index_t entry) const {
+        return hc_pos_[entry];
+    }
+
+    [[nodiscard]] const KeyT& GetKey(index_t entry) const {
+        return keys_[entry];
+    }
+
+    [[nodiscard]] bool IsNode(index_t entry) const {
+        return (refs_[entry] & FrozenHeaderV16::NODE_FLAG) != 0;
+    }
+
+    [[nodiscard]] const FrozenNodeV16& GetChildNode(index_t entry) const {
+        assert(IsNode(entry));
+        return nodes_[refs_[entry] & ~FrozenHeaderV16::NODE_FLAG];
+    }
+
+    [[nodiscard]] const T& GetValue(index_t entry) const {
+        assert(!IsNode(entry));
+        return values_[refs_[entry]];
+    }
+
+    /*
+     * @return The index of the first entry in 'node' with a hypercube address >= hc_pos.
+     */
+    [[nodiscard]] index_t LowerBound(const FrozenNodeV16& node, hc_pos_t hc_pos) const {
+        const hc_pos_t* begin = hc_pos_ + node.first_entry_;
+        const hc_pos_t* end = begin + node.entry_count_;
+        return std::lower_bound(begin, end, hc_pos) - hc_pos_;
+    }
+
+    /*
+     * @return The index of the entry with the given key or NOT_FOUND.
+     */
+    [[nodiscard]] index_t Find(const KeyT& key) const {
+        const FrozenNodeV16* node = &GetRoot();
+        while (true) {
+            hc_pos_t hc_pos = CalcPosInArray(key, node->postfix_len_);
+            index_t entry = LowerBound(*node, hc_pos);
+            if (entry == node->first_entry_ + node->entry_count_ || hc_pos_[entry] != hc_pos) {
+                return NOT_FOUND;
+            }
+            if (!IsNode(entry)) {
+                return keys_[entry] == key ? entry : NOT_FOUND;
+            }
+            node = &GetChildNode(entry);
+            if (node->infix_len_ > 0) {
+                const bit_mask_t<SCALAR> mask = MAX_MASK<SCALAR> << (node->postfix_len_ + 1);
+                if (!KeyEquals(keys_[entry], key, mask)) {
+                    return NOT_FOUND;
+                }
+            }
+        }
+    }
+
+    /*
+     * Calculates the hypercube masks of a node for a window query, see ForEachHC.
+     */
+    static void CalcLimits(
+        bit_width_t postfix_len,
+        const KeyT& prefix,
+        const KeyT& range_min,
+        const KeyT& range_max,
+        hc_pos_t& lower_limit,
+        hc_pos_t& upper_limit) {
+        assert(postfix_len < MAX_BIT_WIDTH<SCALAR>);
+        bit_mask_t<SCALAR> maskHcBit = bit_mask_t<SCALAR>(1) << postfix_len;
+        bit_mask_t<SCALAR> maskVT = MAX_MASK<SCALAR> << postfix_len;
+        constexpr hc_pos_t ONE = 1;
+        lower_limit = 0;
+        upper_limit = 0;
+        if (postfix_len < MAX_BIT_WIDTH<SCALAR> - 1) {
+            for (dimension_t i = 0; i < DIM; ++i) {
+                lower_limit <<= 1;
+                upper_limit <<= 1;
+                SCALAR nodeBisection = (prefix[i] | maskHcBit) & maskVT;
+                if (range_min[i] >= nodeBisection) {
+                    lower_limit |= ONE;
+                }
+                if (range_max[i] >= nodeBisection) {
+                    upper_limit |= ONE;
+                }
+            }
+        } else {
+            // The leading bit of signed scalars indicates a LOWER value, see ForEachHC.
+            for (dimension_t i = 0; i < DIM; ++i) {
+                lower_limit <<= 1;
+                upper_limit <<= 1;
+                if (range_min[i] < 0) {
+                    upper_limit |= ONE;
+                }
+                if (range_max[i] < 0) {
+                    lower_limit |= ONE;
+                }
+            }
+        }
+    }
+
+    /*
+     * @return 'true' if the entry overlaps with the query window. For child nodes this only checks
+     * the prefix of the node.
+     */
+    [[nodiscard]] bool IsEntryInRange(
+        index_t entry, const KeyT& range_min, const KeyT& range_max) const {
+        if (!IsNode(entry)) {
+            return IsInRange(keys_[entry], range_min, range_max);
+        }
+        const auto& node = GetChildNode(entry);
+        // An infix with len=0 implies that at least part of the child node overlaps with the query.
+        if (node.infix_len_ == 0) {
+            return true;
+        }
+        assert(node.postfix_len_ + 1 < MAX_BIT_WIDTH<SCALAR>);
+        SCALAR comparison_mask = MAX_MASK<SCALAR> << (node.postfix_len_ + 1);
+        const auto& key = keys_[entry];
+        for (dimension_t dim = 0; dim < DIM; ++dim) {
+            SCALAR in = key[dim] & comparison_mask;
+            if (in > range_max[dim] || in < (range_min[dim] & comparison_mask)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+  private:
+    template <typename E>
+    static bool IsValidArray(
+        const char* data, const FrozenHeaderV16& h, std::uint64_t offset, std::uint64_t count) {
+        return offset % alignof(E) == 0 &&
+            reinterpret_cast<std::uintptr_t>(data + offset) % alignof(E) == 0 &&
+            offset <= h.image_size_ && count <= (h.image_size_ - offset) / sizeof(E);
+    }
+
+    /*
+     * Checks that all references are in bounds and that the nodes form a tree that can be
+     * traversed safely:
+     * - The entries of every node are in bounds, there are at most 2^DIM of them and their
+     *   hypercube addresses are strictly ascending.
+     * - Every child reference points to a valid node and every value reference to a valid value.
+     * - The postfix length strictly decreases from a node to its child nodes (and is consistent
+     *   with the infix length). This guarantees that the tree is acyclic and that no path is
+     *   longer than the bit width, which is the depth that the iterators support.
+     */
+    static bool IsValidTree(
+        const FrozenHeaderV16& h,
+        const FrozenNodeV16* nodes,
+        const hc_pos_t* hc_pos,
+        const std::uint64_t* refs) {
+        constexpr std::uint64_t MAX_ENTRIES = std::uint64_t(1) << DIM;
+        const auto& root = nodes[0];
+        if (root.postfix_len_ >= MAX_BIT_WIDTH<SCALAR> || root.infix_len_ != 0) {
+            return false;
+        }
+        for (std::uint64_t n = 0; n < h.num_nodes_; ++n) {
+            const auto& node = nodes[n];
+            if (node.first_entry_ > h.num_slots_ ||
+                node.entry_count_ > h.num_slots_ - node.first_entry_ ||
+                node.entry_count_ > MAX_ENTRIES) {
+                return false;
+            }
+            auto end = node.first_entry_ + node.entry_count_;
+            for (auto e = node.first_entry_; e < end; ++e) {
+                if (hc_pos[e] >= MAX_ENTRIES ||
+                    (e > node.first_entry_ && hc_pos[e] <= hc_pos[e - 1])) {
+                    return false;
+                }
+                if ((refs[e] & FrozenHeaderV16::NODE_FLAG) == 0) {
+                    if (refs[e] >= h.num_entries_) {
+                        return false;
+                    }
+                    continue;
+                }
+                auto child = refs[e] & ~FrozenHeaderV16::NODE_FLAG;
+                if (child >= h.num_nodes_ || nodes[child].postfix_len_ >= node.postfix_len_ ||
+                    nodes[child].postfix_len_ + nodes[child].infix_len_ + 1 !=
+                        node.postfix_len_) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Used by empty or detached views.
+    static constexpr FrozenNodeV16 EMPTY_ROOT{0, 0, MAX_BIT_WIDTH<SCALAR> - 1, 0};
+
+    const FrozenNodeV16* nodes_;
+    const hc_pos_t* hc_pos_;
+    const std::uint64_t* refs_;
+    const KeyT* keys_;
+    const T* values_;
+    size_t num_entries_;
+};
+
+/*
+ * An in-memory frozen image. The image owns its memory, see FrozenBuilderV16::Build().
+ * Moving an image does not move the underlying memory, i.e. views of the image remain valid.
+ */
+template <dimension_t DIM, typename T, typename SCALAR>
+class FrozenImageV16 {
+    using ValueT = std::remove_const_t<T>;
+    static constexpr auto A = FrozenHeaderV16::ALIGNMENT;
+    struct alignas(A) Block {
+        char bytes_[A];
+    };
+
+  public:
+    FrozenImageV16() = default;
+
+    FrozenImageV16(size_t size, std::vector<ValueT>&& values)
+    : blocks_((size + A - 1) / A), size_{size}, values_{std::move(values)} {}
+
+    [[nodiscard]] char* data() {
+        return reinterpret_cast<char*>(blocks_.data());
+    }
+
+    [[nodiscard]] const char* data() const {
+        return reinterpret_cast<const char*>(blocks_.data());
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] const T* values() const {
+        return values_.data();
+    }
+
+    /*
+     * @return The number of bytes that are allocated for the image and the values.
+     */
+    [[nodiscard]] size_t GetMemorySize() const {
+        return blocks_.capacity() * sizeof(Block) + values_.capacity() * sizeof(ValueT);
+    }
+
+  private:
+    std::vector<Block> blocks_;
+    size_t size_ = 0;
+    std::vector<ValueT> values_;
+};
+
+/*
+ * The builder converts a PH-Tree into a frozen image, see FrozenHeaderV16 for the layout.
+ */
+template <dimension_t DIM, typename T, typename SCALAR>
+class FrozenBuilderV16 {
+    using KeyT = PhPoint<DIM, SCALAR>;
+    using NodeT = Node<DIM, T, SCALAR>;
+
+  public:
+    FrozenBuilderV16(const NodeT& root, size_t num_entries) {
+        values_.reserve(num_entries);
+        Add(root);
+        assert(values_.size() == num_entries);
+    }
+
+    /*
+     * Writes the image to a stream. Values are written as raw bytes, so this works only for
+     * trivially copyable value types.
+     */
+    void Write(std::ostream& os) const {
+        static_assert(
+            std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>,
+            "Frozen images can only be written for trivially copyable values.");
+        FrozenHeaderV16 h = CreateHeader(false);
+        std::uint64_t pos = 0;
+        WriteArray(os, pos, 0, &h, 1);
+        WriteArray(os, pos, h.nodes_offset_, nodes_.data(), nodes_.size());
+        WriteArray(os, pos, h.hc_pos_offset_, hc_pos_.data(), hc_pos_.size());
+        WriteArray(os, pos, h.refs_offset_, refs_.data(), refs_.size());
+        WriteArray(os, pos, h.keys_offset_, keys_.data(), keys_.size());
+        Pad(os, pos, h.values_offset_);
+        for (auto* value : values_) {
+            os.write(reinterpret_cast<const char*>(value), sizeof(T));
+        }
+    }
+
+    /*
+     * @return The size of the image that is written by Write() and WriteTo().
+     */
+    [[nodiscard]] size_t GetImageSize() const {
+        return CreateHeader(false).image_size_;
+    }
+
+    /*
+     * Writes the image to memory, see Write(). The memory must be aligned to 64 bytes and must be
+     * at least GetImageSize() bytes large.
+     */
+    void WriteTo(char* data) const {
+        static_assert(
+            std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>,
+            "Frozen images can only be written for trivially copyable values.");
+        FrozenHeaderV16 h = CreateHeader(false);
+        CopyArray(data, 0, &h, 1);
+        CopyArray(data, h.nodes_offset_, nodes_.data(), nodes_.size());
+        CopyArray(data, h.hc_pos_offset_, hc_pos_.data(), hc_pos_.size());
+        CopyArray(data, h.refs_offset_, refs_.data(), refs_.size());
+        CopyArray(data, h.keys_offset_, keys_.data(), keys_.size());
+        for (size_t i = 0; i < values_.size(); ++i) {
+            CopyArray(data, h.values_offset_ + i * sizeof(T), values_[i], 1);
+        }
+    }
+
+    /*
+     * Creates an in-memory image. The values are copied into a separate array, so this works for
+     * any copyable value type.
+     */
+    [[nodiscard]] FrozenImageV16<DIM, T, SCALAR> Build() const {
+        std::vector<std::remove_const_t<T>> values;
+        values.reserve(values_.size());
+        for (auto* value : values_) {
+            values.emplace_back(*value);
+        }
+        FrozenHeaderV16 h = CreateHeader(true);
+        FrozenImageV16<DIM, T, SCALAR> image(h.image_size_, std::move(values));
+        char* data = image.data();
+        CopyArray(data, 0, &h, 1);
+        CopyArray(data, h.nodes_offset_, nodes_.data(), nodes_.size());
+        CopyArray(data, h.hc_pos_offset_, hc_pos_.data(), hc_pos_.size());
+        CopyArray(data, h.refs_offset_, refs_.data(), refs_.size());
+        CopyArray(data, h.keys_offset_, keys_.data(), keys_.size());
+        return image;
+    }
+
+  private:
+    std::uint64_t Add(const NodeT& node) {
+        std::uint64_t node_index = nodes_.size();
+        std::uint64_t first = hc_pos_.size();
+        std::uint64_t count = node.GetEntryCount();
+        assert(count <= std::numeric_limits<std::uint32_t>::max());
+        nodes_.push_back(FrozenNodeV16{
+            first,
+            static_cast<std::uint32_t>(count),
+            node.GetPostfixLen(),
+            node.GetInfixLen()});
+        hc_pos_.resize(first + count);
+        refs_.resize(first + count);
+        keys_.resize(first + count);
+        std::uint64_t i = first;
+        for (auto& it : node.Entries()) {
+            const auto& entry = it.second;
+            hc_pos_[i] = it.first;
+            keys_[i] = entry.GetKey();
+            if (entry.IsNode()) {
+                refs_[i] = FrozenHeaderV16::NODE_FLAG | Add(entry.GetNode());
+            } else {
+                refs_[i] = values_.size();
+                values_.push_back(&entry.GetValue());
+            }
+            ++i;
+        }
+        return node_index;
+    }
+
+    [[nodiscard]] FrozenHeaderV16 CreateHeader(bool external_values) const {
+        FrozenHeaderV16 h{};
+        h.magic_ = FrozenHeaderV16::MAGIC;
+        h.version_ = FrozenHeaderV16::VERSION;
+        h.dim_ = static_cast<std::uint8_t>(DIM);
+        h.scalar_size_ = sizeof(SCALAR);
+        h.value_size_ = sizeof(T);
+        h.flags_ = external_values ? FrozenHeaderV16::FLAG_EXTERNAL_VALUES : 0;
+        h.num_entries_ = values_.size();
+        h.num_nodes_ = nodes_.size();
+        h.num_slots_ = hc_pos_.size();
+        h.nodes_offset_ = Align(sizeof(h));
+        h.hc_pos_offset_ = Align(h.nodes_offset_ + nodes_.size() * sizeof(FrozenNodeV16));
+        h.refs_offset_ = Align(h.hc_pos_offset_ + hc_pos_.size() * sizeof(hc_pos_t));
+        h.keys_offset_ = Align(h.refs_offset_ + refs_.size() * sizeof(std::uint64_t));
+        h.values_offset_ = Align(h.keys_offset_ + keys_.size() * sizeof(KeyT));
+        h.image_size_ = h.values_offset_ + (external_values ? 0 : values_.size() * sizeof(T));
+        return h;
+    }
+
+    static std::uint64_t Align(std::uint64_t offset) {
+        constexpr auto A = FrozenHeaderV16::ALIGNMENT;
+        static_assert(alignof(T) <= A && alignof(KeyT) <= A);
+        return (offset + A - 1) / A * A;
+    }
+
+    static void Pad(std::ostream& os, std::uint64_t& pos, std::uint64_t offset) {
+        assert(pos <= offset);
+        for (; pos < offset; ++pos) {
+            os.put(0);
+        }
+    }
+
+    template <typename E>
+    static void WriteArray(
+        std::ostream& os, std::uint64_t& pos, std::uint64_t offset, const E* data, size_t count) {
+        Pad(os, pos, offset);
+        os.write(reinterpret_cast<const char*>(data), count * sizeof(E));
+        pos += count * sizeof(E);
+    }
+
+    template <typename E>
+    static void CopyArray(char* data, std::uint64_t offset, const E* array, size_t count) {
+        auto* src = reinterpret_cast<const char*>(array);
+        std::copy(src, src + count * sizeof(E), data + offset);
+    }
+
+    std::vector<FrozenNodeV16> nodes_;
+    std::vector<hc_pos_t> hc_pos_;
+    std::vector<std::uint64_t> refs_;
+    std::vector<KeyT> keys_;
+    std::vector<const T*> values_;
+};
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_FROZEN_DATA_V16_H
@@ -44,15 +44,21 @@ class IteratorBase {
     , parent_node_{}
     , is_finished_{false}
     , converter_{converter}
-    , filter_{FILTER()} {}
+    , filter_{FILTER()}
+    , stats_{nullptr} {}
 
-    explicit IteratorBase(const CONVERT& converter, FILTER filter)
+    /*
+     * @param stats The query statistics, see ResolveQueryStats().
+     */
+    explicit IteratorBase(
+        const CONVERT& converter, FILTER filter, PhTreeQueryStats* stats = nullptr)
     : current_result_{nullptr}
     , current_node_{}
     , parent_node_{}
     , is_finished_{false}
     , converter_{converter}
-    , filter_(std::move(filter)) {}
+    , filter_(std::move(filter))
+    , stats_{ResolveQueryStats(stats)} {}
 
     T& operator*() const {
         assert(current_result_);
@@ -130,6 +136,11 @@ class IteratorBase {
         return converter_.post(point);
     }
 
+    // The statistics of the query, they are only collected with PHTREE_QUERY_STATS.
+    [[nodiscard]] PhTreeQueryStats* QueryStats() const {
+        return stats_;
+    }
+
   private:
     /*
      * The parent entry contains the parent node. The parent node is the node ABOVE the current node
@@ -149,6 +160,7 @@ class IteratorBase {
     bool is_finished_;
     const CONVERT& converter_;
     FILTER filter_;
+    PhTreeQueryStats* stats_;
 };
 
 }  // namespace improbable::phtree::v16
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_ITERATOR_FROZEN_H
+#define PHTREE_V16_ITERATOR_FROZEN_H
+
+#include "../common/common.h"
+#include "frozen_data_v16.h"
+
+namespace improbable::phtree::v16 {
+
+/*
+ * Base class for all iterators of frozen trees. Frozen trees are read-only, so the iterators
+ * return only const values.
+ *
+ * The iterators keep a copy of the frozen view and of the converter, they remain valid as long as
+ * the underlying frozen image is valid.
+ */
+template <typename T, typename CONVERT>
+class IteratorFrozenBase {
+  protected:
+    static constexpr dimension_t DIM = CONVERT::DimInternal;
+    using KeyInternal = typename CONVERT::KeyInternal;
+    using SCALAR = typename CONVERT::ScalarInternal;
+    using DataT = FrozenDataV16<DIM, T, SCALAR>;
+    using index_t = typename DataT::index_t;
+
+  public:
+    IteratorFrozenBase(const DataT& data, const CONVERT& converter)
+    : data_{data}, current_entry_{DataT::NOT_FOUND}, converter_{converter} {}
+
+    const T& operator*() const {
+        assert(!Finished());
+        return data_.GetValue(current_entry_);
+    }
+
+    const T* operator->() const {
+        assert(!Finished());
+        return &data_.GetValue(current_entry_);
+    }
+
+    friend bool operator==(const IteratorFrozenBase& left, const IteratorFrozenBase& right) {
+        return (left.Finished() && right.Finished()) ||
+            (!left.Finished() && !right.Finished() &&
+             &left.data_.GetValue(left.current_entry_) ==
+                 &right.data_.GetValue(right.current_entry_));
+    }
+
+    friend bool operator!=(const IteratorFrozenBase& left, const IteratorFrozenBase& right) {
+        return !(left == right);
+    }
+
+    auto first() const {
+        return converter_.post(data_.GetKey(current_entry_));
+    }
+
+    const T& second() const {
+        return data_.GetValue(current_entry_);
+    }
+
+    [[nodiscard]] bool Finished() const {
+        return current_entry_ == DataT::NOT_FOUND;
+    }
+
+  protected:
+    void SetFinished() {
+        current_entry_ = DataT::NOT_FOUND;
+    }
+
+    void SetCurrentResult(index_t entry) {
+        current_entry_ = entry;
+    }
+
+    auto post(const KeyInternal& point) const {
+        return converter_.post(point);
+    }
+
+    const DataT data_;
+
+  private:
+    index_t current_entry_;
+    const CONVERT converter_;
+};
+
+/*
+ * Iterator for results of find() and for end().
+ */
+template <typename T, typename CONVERT>
+class IteratorFrozenSimple : public IteratorFrozenBase<T, CONVERT> {
+    using BaseT = IteratorFrozenBase<T, CONVERT>;
+
+  public:
+    IteratorFrozenSimple(
+        const typename BaseT::DataT& data,
+        typename BaseT::index_t entry,
+        const CONVERT& converter)
+    : BaseT(data, converter) {
+        this->SetCurrentResult(entry);
+    }
+
+    IteratorFrozenSimple& operator++() {
+        this->SetFinished();
+        return *this;
+    }
+
+    IteratorFrozenSimple operator++(int) {
+        IteratorFrozenSimple iterator(*this);
+        ++(*this);
+        return iterator;
+    }
+};
+
+/*
+ * Iterator over all entries (IS_WINDOW=false) or over all entries in a query window
+ * (IS_WINDOW=true) of a frozen tree.
+ * Window queries use hypercube navigation, see IteratorHC for details.
+ */
+template <typename T, typename CONVERT, typename FILTER, bool IS_WINDOW>
+class IteratorFrozen : public IteratorFrozenBase<T, CONVERT> {
+    using BaseT = IteratorFrozenBase<T, CONVERT>;
+    using KeyInternal = typename BaseT::KeyInternal;
+    using SCALAR = typename BaseT::SCALAR;
+    using DataT = typename BaseT::DataT;
+    using index_t = typename BaseT::index_t;
+
+    struct Frame {
+        index_t next_;
+        index_t end_;
+        hc_pos_t mask_lower_;
+        hc_pos_t mask_upper_;
+    };
+
+  public:
+    IteratorFrozen(
+        const DataT& data,
+        const KeyInternal& range_min,
+        const KeyInternal& range_max,
+        const CONVERT& converter,
+        FILTER filter)
+    : BaseT(data, converter)
+    , stack_size_{0}
+    , range_min_{range_min}
+    , range_max_{range_max}
+    , filter_{std::move(filter)} {
+        Push(data.GetRoot(), KeyInternal{});
+        FindNextElement();
+    }
+
+    IteratorFrozen& operator++() {
+        FindNextElement();
+        return *this;
+    }
+
+    IteratorFrozen operator++(int) {
+        IteratorFrozen iterator(*this);
+        ++(*this);
+        return iterator;
+    }
+
+  private:
+    void FindNextElement() {
+        const DataT& data = this->data_;
+        while (stack_size_ > 0) {
+            Frame& f = stack_[stack_size_ - 1];
+            bool pushed = false;
+            while (!pushed && f.next_ < f.end_) {
+                index_t entry = f.next_++;
+                if constexpr (IS_WINDOW) {
+                    hc_pos_t hc_pos = data.GetHcPos(entry);
+                    if (hc_pos > f.mask_upper_) {
+                        break;
+                    }
+                    if (((hc_pos | f.mask_lower_) & f.mask_upper_) != hc_pos ||
+                        !data.IsEntryInRange(entry, range_min_, range_max_)) {
+                        continue;
+                    }
+                }
+                const auto& key = data.GetKey(entry);
+                if (data.IsNode(entry)) {
+                    const auto& node = data.GetChildNode(entry);
+                    if (filter_.IsNodeValid(key, node.postfix_len_ + 1)) {
+                        Push(node, key);
+                        pushed = true;
+                    }
+                } else if (filter_.IsEntryValid(key, data.GetValue(entry))) {
+                    this->SetCurrentResult(entry);
+                    return;
+                }
+            }
+            if (!pushed) {
+                // return to parent node
+                --stack_size_;
+            }
+        }
+        this->SetFinished();
+    }
+
+    void Push(const FrozenNodeV16& node, const KeyInternal& prefix) {
+        // The depth is bounded by the bit width, see FrozenDataV16::IsValidTree().
+        assert(stack_size_ < stack_.size());
+        Frame& f = stack_[stack_size_++];
+        f.end_ = node.first_entry_ + node.entry_count_;
+        if constexpr (IS_WINDOW) {
+            DataT::CalcLimits(
+                node.postfix_len_, prefix, range_min_, range_max_, f.mask_lower_, f.mask_upper_);
+            f.next_ = this->data_.LowerBound(node, f.mask_lower_);
+        } else {
+            f.next_ = node.first_entry_;
+        }
+    }
+
+    std::array<Frame, MAX_BIT_WIDTH<SCALAR> + 1> stack_;
+    size_t stack_size_;
+    const KeyInternal range_min_;
+    const KeyInternal range_max_;
+    FILTER filter_;
+};
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_ITERATOR_FROZEN_H
@@ -33,8 +33,17 @@ class IteratorFull : public IteratorBase<T, CONVERT, FILTER> {
     using EntryT = typename IteratorBase<T, CONVERT, FILTER>::EntryT;
 
   public:
-    IteratorFull(const EntryT& root, const CONVERT& converter, FILTER filter)
-    : IteratorBase<T, CONVERT, FILTER>(converter, filter), stack_{}, stack_size_{0} {
+    IteratorFull(
+        const EntryT& root,
+        const CONVERT& converter,
+        FILTER filter,
+        PhTreeQueryStats* stats = nullptr)
+    : IteratorBase<T, CONVERT, FILTER>(converter, filter, stats)
+    , stack_{}
+#if PHTREE_PREFETCH_DISTANCE > 0
+    , prefetch_stack_{}
+#endif
+    , stack_size_{0} {
         PrepareAndPush(root.GetNode());
         FindNextElement();
     }
@@ -55,15 +64,22 @@ class IteratorFull : public IteratorBase<T, CONVERT, FILTER> {
         while (!IsEmpty()) {
             auto* p = &Peek();
             while (*p != PeekEnd()) {
+                PrefetchNext();
                 auto& candidate = (*p)->second;
                 ++(*p);
+                PHTREE_QUERY_STATS_INC_IF(
+                    this->QueryStats(), candidate.IsValue(), n_entries_tested_);
                 if (this->ApplyFilter(candidate)) {
                     if (candidate.IsNode()) {
                         p = &PrepareAndPush(candidate.GetNode());
                     } else {
+                        PHTREE_QUERY_STATS_INC(this->QueryStats(), n_entries_returned_);
                         this->SetCurrentResult(&candidate);
                         return;
                     }
+                } else {
+                    PHTREE_QUERY_STATS_INC_IF(
+                        this->QueryStats(), candidate.IsNode(), n_nodes_pruned_filter_);
                 }
             }
             // return to parent node
@@ -75,13 +91,35 @@ class IteratorFull : public IteratorBase<T, CONVERT, FILTER> {
 
     auto& PrepareAndPush(const NodeT& node) {
         assert(stack_size_ < stack_.size() - 1);
+        PHTREE_QUERY_STATS_VISIT_NODE(
+            this->QueryStats(), MAX_BIT_WIDTH<SCALAR> - 1 - node.GetPostfixLen());
         // No '&'  because this is a temp value
         stack_[stack_size_].first = node.Entries().cbegin();
         stack_[stack_size_].second = node.Entries().end();
+#if PHTREE_PREFETCH_DISTANCE > 0
+        prefetch_stack_[stack_size_] = node.Entries().cbegin();
+#endif
         ++stack_size_;
+        for (size_t i = 0; i < PREFETCH_DISTANCE; ++i) {
+            PrefetchNext();
+        }
         return stack_[stack_size_ - 1].first;
     }
 
+    // Prefetches the child node of the next entry in the current node. The prefetch iterator
+    // runs ahead of the iterator on the stack.
+    void PrefetchNext() {
+#if PHTREE_PREFETCH_DISTANCE > 0
+        auto& iter = prefetch_stack_[stack_size_ - 1];
+        if (iter != PeekEnd()) {
+            if (iter->second.IsNode()) {
+                iter->second.GetNode().Prefetch();
+            }
+            ++iter;
+        }
+#endif
+    }
+
     auto& Peek() {
         assert(stack_size_ > 0);
         return stack_[stack_size_ - 1].first;
@@ -105,6 +143,10 @@ class IteratorFull : public IteratorBase<T, CONVERT, FILTER> {
         std::pair<EntryIteratorC<DIM, EntryT>, EntryIteratorC<DIM, EntryT>>,
         MAX_BIT_WIDTH<SCALAR>>
         stack_;
+#if PHTREE_PREFETCH_DISTANCE > 0
+    // One prefetch iterator per stack level, it runs ahead of the iterator on the stack.
+    std::array<EntryIteratorC<DIM, EntryT>, MAX_BIT_WIDTH<SCALAR>> prefetch_stack_;
+#endif
     size_t stack_size_;
 };
 
@@ -54,8 +54,9 @@ class IteratorHC : public IteratorBase<T, CONVERT, FILTER> {
         const KeyInternal& range_min,
         const KeyInternal& range_max,
         const CONVERT& converter,
-        FILTER filter)
-    : IteratorBase<T, CONVERT, FILTER>(converter, filter)
+        FILTER filter,
+        PhTreeQueryStats* stats = nullptr)
+    : IteratorBase<T, CONVERT, FILTER>(converter, filter, stats)
     , stack_size_{0}
     , range_min_{range_min}
     , range_max_{range_max} {
@@ -80,14 +81,18 @@ class IteratorHC : public IteratorBase<T, CONVERT, FILTER> {
         while (!IsEmpty()) {
             auto* p = &Peek();
             const EntryT* current_result = nullptr;
-            while ((current_result = p->Increment(range_min_, range_max_))) {
+            while ((current_result = p->Increment(range_min_, range_max_, this->QueryStats()))) {
                 if (this->ApplyFilter(*current_result)) {
                     if (current_result->IsNode()) {
                         p = &PrepareAndPush(*current_result);
                     } else {
+                        PHTREE_QUERY_STATS_INC(this->QueryStats(), n_entries_returned_);
                         this->SetCurrentResult(current_result);
                         return;
                     }
+                } else {
+                    PHTREE_QUERY_STATS_INC_IF(
+                        this->QueryStats(), current_result->IsNode(), n_nodes_pruned_filter_);
                 }
             }
             // no matching (more) elements found
@@ -100,7 +105,7 @@ class IteratorHC : public IteratorBase<T, CONVERT, FILTER> {
     auto& PrepareAndPush(const EntryT& entry) {
         assert(stack_size_ < stack_.size() - 1);
         auto& ni = stack_[stack_size_++];
-        ni.init(range_min_, range_max_, entry.GetNode(), entry.GetKey());
+        ni.init(range_min_, range_max_, entry.GetNode(), entry.GetKey(), this->QueryStats());
         return ni;
     }
 
@@ -132,34 +137,64 @@ class NodeIterator {
     using NodeT = Node<DIM, T, SCALAR>;
 
   public:
-    NodeIterator() : iter_{}, node_{nullptr}, mask_lower_{0}, mask_upper_(0) {}
+    NodeIterator()
+    : iter_{}
+#if PHTREE_PREFETCH_DISTANCE > 0
+    , prefetch_iter_{}
+#endif
+    , node_{nullptr}
+    , mask_lower_{0}
+    , mask_upper_(0) {
+    }
 
-    void init(const KeyT& range_min, const KeyT& range_max, const NodeT& node, const KeyT& prefix) {
+    void init(
+        const KeyT& range_min,
+        const KeyT& range_max,
+        const NodeT& node,
+        const KeyT& prefix,
+        PhTreeQueryStats* stats) {
+        PHTREE_QUERY_STATS_VISIT_NODE(stats, MAX_BIT_WIDTH<SCALAR> - 1 - node.GetPostfixLen());
         node_ = &node;
         CalcLimits(node.GetPostfixLen(), range_min, range_max, prefix);
         iter_ = node.Entries().lower_bound(mask_lower_);
+#if PHTREE_PREFETCH_DISTANCE > 0
+        prefetch_iter_ = iter_;
+        for (size_t i = 0; i < PREFETCH_DISTANCE; ++i) {
+            PrefetchNext();
+        }
+#endif
     }
 
     /*
      * Advances the cursor.
      * @return TRUE iff a matching element was found.
      */
-    const EntryT* Increment(const KeyT& range_min, const KeyT& range_max) {
+    const EntryT* Increment(const KeyT& range_min, const KeyT& range_max, PhTreeQueryStats* stats) {
         while (iter_ != node_->Entries().end() && iter_->first <= mask_upper_) {
+#if PHTREE_PREFETCH_DISTANCE > 0
+            PrefetchNext();
+#endif
             if (IsPosValid(iter_->first)) {
                 const auto* be = &iter_->second;
-                if (CheckEntry(*be, range_min, range_max)) {
+                if (CheckEntry(*be, range_min, range_max, stats)) {
                     ++iter_;
                     return be;
                 }
+            } else {
+                PHTREE_QUERY_STATS_INC_IF(stats, iter_->second.IsNode(), n_nodes_pruned_hc_);
             }
             ++iter_;
         }
         return nullptr;
     }
 
-    bool CheckEntry(const EntryT& candidate, const KeyT& range_min, const KeyT& range_max) const {
+    bool CheckEntry(
+        const EntryT& candidate,
+        const KeyT& range_min,
+        const KeyT& range_max,
+        PhTreeQueryStats* stats) const {
         if (candidate.IsValue()) {
+            PHTREE_QUERY_STATS_INC(stats, n_entries_tested_);
             return IsInRange(candidate.GetKey(), range_min, range_max);
         }
 
@@ -177,6 +212,7 @@ class NodeIterator {
         for (dimension_t dim = 0; dim < DIM; ++dim) {
             SCALAR in = key[dim] & comparison_mask;
             if (in > range_max[dim] || in < (range_min[dim] & comparison_mask)) {
+                PHTREE_QUERY_STATS_INC(stats, n_nodes_pruned_prefix_);
                 return false;
             }
         }
@@ -188,6 +224,18 @@ class NodeIterator {
         return ((key | mask_lower_) & mask_upper_) == key;
     }
 
+#if PHTREE_PREFETCH_DISTANCE > 0
+    // Prefetches the child node of the next valid entry. prefetch_iter_ runs ahead of iter_.
+    void PrefetchNext() {
+        if (prefetch_iter_ != node_->Entries().end() && prefetch_iter_->first <= mask_upper_) {
+            if (IsPosValid(prefetch_iter_->first) && prefetch_iter_->second.IsNode()) {
+                prefetch_iter_->second.GetNode().Prefetch();
+            }
+            ++prefetch_iter_;
+        }
+    }
+#endif
+
     void CalcLimits(
         bit_width_t postfix_len, const KeyT& range_min, const KeyT& range_max, const KeyT& prefix) {
         // create limits for the local node. there is a lower and an upper limit. Each limit
@@ -254,6 +302,10 @@ class NodeIterator {
 
   private:
     EntryIteratorC<DIM, EntryT> iter_;
+#if PHTREE_PREFETCH_DISTANCE > 0
+    // Runs PREFETCH_DISTANCE entries ahead of iter_.
+    EntryIteratorC<DIM, EntryT> prefetch_iter_;
+#endif
     const NodeT* node_;
     hc_pos_t mask_lower_;
     hc_pos_t mask_upper_;
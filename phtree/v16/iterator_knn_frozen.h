@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_ITERATOR_KNN_FROZEN_H
+#define PHTREE_V16_ITERATOR_KNN_FROZEN_H
+
+#include "../common/common.h"
+#include "iterator_frozen.h"
+#include <queue>
+
+namespace improbable::phtree::v16 {
+
+/*
+ * kNN query for frozen trees, this is the same algorithm as in IteratorKnnHS.
+ */
+template <typename T, typename CONVERT, typename DISTANCE, typename FILTER>
+class IteratorKnnFrozen : public IteratorFrozenBase<T, CONVERT> {
+    using BaseT = IteratorFrozenBase<T, CONVERT>;
+    static constexpr dimension_t DIM = CONVERT::DimInternal;
+    using KeyExternal = typename CONVERT::KeyExternal;
+    using KeyInternal = typename BaseT::KeyInternal;
+    using SCALAR = typename BaseT::SCALAR;
+    using DataT = typename BaseT::DataT;
+    using index_t = typename BaseT::index_t;
+    using EntryDistT = std::pair<double, index_t>;
+
+    struct CompareByDistance {
+        bool operator()(const EntryDistT& left, const EntryDistT& right) const {
+            return left.first > right.first;
+        };
+    };
+
+  public:
+    IteratorKnnFrozen(
+        const DataT& data,
+        size_t min_results,
+        const KeyInternal& center,
+        const CONVERT& converter,
+        DISTANCE dist,
+        FILTER filter)
+    : BaseT(data, converter)
+    , center_{center}
+    , center_post_{converter.post(center)}
+    , current_distance_{std::numeric_limits<double>::max()}
+    , num_found_results_(0)
+    , num_requested_results_(min_results)
+    , distance_(std::move(dist))
+    , filter_(std::move(filter)) {
+        if (min_results <= 0 || data.GetRoot().entry_count_ == 0) {
+            this->SetFinished();
+            return;
+        }
+        AddEntries(data.GetRoot());
+        FindNextElement();
+    }
+
+    [[nodiscard]] double distance() const {
+        return current_distance_;
+    }
+
+    IteratorKnnFrozen& operator++() {
+        FindNextElement();
+        return *this;
+    }
+
+    IteratorKnnFrozen operator++(int) {
+        IteratorKnnFrozen iterator(*this);
+        ++(*this);
+        return iterator;
+    }
+
+  private:
+    void FindNextElement() {
+        while (num_found_results_ < num_requested_results_ && !queue_.empty()) {
+            auto candidate = queue_.top();
+            queue_.pop();
+            if (!this->data_.IsNode(candidate.second)) {
+                ++num_found_results_;
+                this->SetCurrentResult(candidate.second);
+                current_distance_ = candidate.first;
+                return;
+            }
+            AddEntries(this->data_.GetChildNode(candidate.second));
+        }
+        this->SetFinished();
+        current_distance_ = std::numeric_limits<double>::max();
+    }
+
+    void AddEntries(const FrozenNodeV16& node) {
+        const DataT& data = this->data_;
+        index_t end = node.first_entry_ + node.entry_count_;
+        for (index_t entry = node.first_entry_; entry < end; ++entry) {
+            const auto& key = data.GetKey(entry);
+            if (data.IsNode(entry)) {
+                bit_width_t bits_to_ignore = data.GetChildNode(entry).postfix_len_ + 1;
+                if (filter_.IsNodeValid(key, bits_to_ignore)) {
+                    queue_.emplace(DistanceToNode(key, bits_to_ignore), entry);
+                }
+            } else if (filter_.IsEntryValid(key, data.GetValue(entry))) {
+                queue_.emplace(distance_(center_post_, this->post(key)), entry);
+            }
+        }
+    }
+
+    double DistanceToNode(const KeyInternal& prefix, int bits_to_ignore) {
+        assert(bits_to_ignore < MAX_BIT_WIDTH<SCALAR>);
+        SCALAR mask_min = MAX_MASK<SCALAR> << bits_to_ignore;
+        SCALAR mask_max = ~mask_min;
+        KeyInternal buf;
+        // Find the point inside the node that is closest to center_, see IteratorKnnHS.
+        for (dimension_t i = 0; i < DIM; ++i) {
+            SCALAR min = prefix[i] & mask_min;
+            SCALAR max = prefix[i] | mask_max;
+            buf[i] = min > center_[i] ? min : (max < center_[i] ? max : center_[i]);
+        }
+        return distance_(center_post_, this->post(buf));
+    }
+
+    const KeyInternal center_;
+    // center after post processing == the external representation
+    const KeyExternal center_post_;
+    double current_distance_;
+    std::priority_queue<EntryDistT, std::vector<EntryDistT>, CompareByDistance> queue_;
+    size_t num_found_results_;
+    size_t num_requested_results_;
+    DISTANCE distance_;
+    FILTER filter_;
+};
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_ITERATOR_KNN_FROZEN_H
@@ -59,8 +59,9 @@ class IteratorKnnHS : public IteratorBase<T, CONVERT, FILTER> {
         const KeyInternal& center,
         const CONVERT& converter,
         DISTANCE dist,
-        FILTER filter)
-    : IteratorBase<T, CONVERT, FILTER>(converter, filter)
+        FILTER filter,
+        PhTreeQueryStats* stats = nullptr)
+    : IteratorBase<T, CONVERT, FILTER>(converter, filter, stats)
     , center_{center}
     , center_post_{converter.post(center)}
     , current_distance_{std::numeric_limits<double>::max()}
@@ -99,6 +100,7 @@ class IteratorKnnHS : public IteratorBase<T, CONVERT, FILTER> {
             auto o = candidate.second;
             if (!o->IsNode()) {
                 // data entry
+                PHTREE_QUERY_STATS_INC(this->QueryStats(), n_entries_returned_);
                 ++num_found_results_;
                 this->SetCurrentResult(o);
                 current_distance_ = candidate.first;
@@ -109,9 +111,21 @@ class IteratorKnnHS : public IteratorBase<T, CONVERT, FILTER> {
             } else {
                 // inner node
                 auto& node = o->GetNode();
+                PHTREE_QUERY_STATS_VISIT_NODE(
+                    this->QueryStats(), MAX_BIT_WIDTH<SCALAR> - 1 - node.GetPostfixLen());
                 queue_.pop();
+                // Calculating the distance to a child node requires its postfix length, so we
+                // load all child nodes into the cache before calculating any distances.
+                if constexpr (PREFETCH_DISTANCE > 0) {
+                    for (auto& entry : node.Entries()) {
+                        if (entry.second.IsNode()) {
+                            entry.second.GetNode().Prefetch();
+                        }
+                    }
+                }
                 for (auto& entry : node.Entries()) {
                     auto& e2 = entry.second;
+                    PHTREE_QUERY_STATS_INC_IF(this->QueryStats(), e2.IsValue(), n_entries_tested_);
                     if (this->ApplyFilter(e2)) {
                         if (e2.IsNode()) {
                             auto& sub = e2.GetNode();
@@ -121,6 +135,9 @@ class IteratorKnnHS : public IteratorBase<T, CONVERT, FILTER> {
                             double d = distance_(center_post_, this->post(e2.GetKey()));
                             queue_.emplace(d, &e2);
                         }
+                    } else {
+                        PHTREE_QUERY_STATS_INC_IF(
+                            this->QueryStats(), e2.IsNode(), n_nodes_pruned_filter_);
                     }
                 }
             }
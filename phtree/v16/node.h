@@ -23,6 +23,21 @@
 #include "phtree_v16.h"
 #include <map>
 
+/*
+ * The node container is selected by DIM: array_map for DIM <= PHTREE_ARRAY_MAP_MAX_DIM, sparse_map
+ * for DIM <= PHTREE_SPARSE_MAP_MAX_DIM and std::map otherwise. The default thresholds can be
+ * overridden at compile time, e.g. for benchmarking (see dim_sweep_benchmark). Like
+ * PHTREE_TRACE_POLICY, they must be defined consistently for all translation units of a program.
+ * array_map supports at most 64 entries per node, i.e. PHTREE_ARRAY_MAP_MAX_DIM must be <= 6.
+ */
+#if !defined(PHTREE_ARRAY_MAP_MAX_DIM)
+#define PHTREE_ARRAY_MAP_MAX_DIM 3
+#endif
+#if !defined(PHTREE_SPARSE_MAP_MAX_DIM)
+#define PHTREE_SPARSE_MAP_MAX_DIM 8
+#endif
+static_assert(PHTREE_ARRAY_MAP_MAX_DIM <= 6, "array_map supports at most 64 entries per node");
+
 namespace improbable::phtree::v16 {
 
 /*
@@ -38,9 +53,56 @@ namespace improbable::phtree::v16 {
  */
 template <dimension_t DIM, typename Entry>
 using EntryMap = typename std::conditional<
-    DIM <= 3,
+    DIM <= PHTREE_ARRAY_MAP_MAX_DIM,
     array_map<Entry, (hc_pos_t(1) << DIM)>,
-    typename std::conditional<DIM <= 8, sparse_map<Entry>, std::map<hc_pos_t, Entry>>::type>::type;
+    typename std::conditional<
+        DIM <= PHTREE_SPARSE_MAP_MAX_DIM,
+        sparse_map<Entry>,
+        std::map<hc_pos_t, Entry>>::type>::type;
+
+/*
+ * The heap memory that is allocated by an EntryMap, in addition to sizeof(EntryMap).
+ */
+template <typename Entry, std::size_t SIZE>
+static size_t GetHeapSize(const array_map<Entry, SIZE>&) {
+    return 0;
+}
+
+template <typename Entry>
+static size_t GetHeapSize(const sparse_map<Entry>& map) {
+    return map.capacity() * sizeof(PhFlatMapPair<Entry>);
+}
+
+template <typename Entry>
+static size_t GetHeapSize(const std::map<hc_pos_t, Entry>& map) {
+    // Every map entry is allocated in a tree node with a color and three pointers
+    // (parent, left, right), see _Rb_tree_node in libstdc++ or _Tree_node in MSVC.
+    return map.size() * (sizeof(std::pair<const hc_pos_t, Entry>) + 4 * sizeof(void*));
+}
+
+/*
+ * Prefetches the storage of the entries of an EntryMap, see Node::Prefetch().
+ */
+template <typename Entry, std::size_t SIZE>
+static void PrefetchEntries(const array_map<Entry, SIZE>& map) {
+    // The storage is part of the node, prefetch all its cache lines.
+    constexpr size_t CACHE_LINE = 64;
+    auto* begin = static_cast<const char*>(map.data());
+    for (size_t i = 0; i < SIZE * sizeof(PhFlatMapPair<Entry>); i += CACHE_LINE) {
+        PrefetchRead(begin + i);
+    }
+}
+
+template <typename Entry>
+static void PrefetchEntries(const sparse_map<Entry>& map) {
+    // Loading the storage address has to wait for the node's cache line.
+    PrefetchRead(map.data());
+}
+
+template <typename Entry>
+static void PrefetchEntries(const std::map<hc_pos_t, Entry>&) {
+    // The map's entries are separate allocations, there is no single address to prefetch.
+}
 
 template <dimension_t DIM, typename Entry>
 using EntryIterator = decltype(EntryMap<DIM, Entry>().begin());
@@ -65,6 +127,7 @@ namespace {
 template <dimension_t DIM, typename T, typename SCALAR>
 void MergeIntoParent(Node<DIM, T, SCALAR>& child_node, Node<DIM, T, SCALAR>& parent) {
     assert(child_node.GetEntryCount() == 1);
+    PhTreeTrace::OnMerge(&child_node, child_node.GetPostfixLen());
     // At this point we have found an entry that needs to be removed. We also know that we need to
     // remove the child node because it contains at most one other entry and it is not the root
     // node.
@@ -113,9 +176,24 @@ class Node {
 
   public:
     Node(bit_width_t infix_len, bit_width_t postfix_len)
-    : postfix_len_(postfix_len), infix_len_(infix_len), entries_{} {
+    : postfix_len_(postfix_len)
+    , infix_len_(infix_len)
+#if defined(PHTREE_HASH_TRACKING)
+    , is_hash_dirty_{true}
+    , hash_{0}
+#endif
+#if defined(PHTREE_GENERATION_TRACKING)
+    , generation_{0}
+    , entry_generation_{0}
+#endif
+    , entries_{} {
         assert(infix_len_ < MAX_BIT_WIDTH<SCALAR>);
         assert(infix_len >= 0);
+        PhTreeTrace::OnNodeAlloc(this, postfix_len_);
+    }
+
+    ~Node() {
+        PhTreeTrace::OnNodeFree(this, postfix_len_);
     }
 
     // Nodes should never be copied!
@@ -192,6 +270,18 @@ class Node {
         return nullptr;
     }
 
+    /*
+     * Non-const version of Find().
+     */
+    EntryT* Find(const KeyT& key) {
+        hc_pos_t hc_pos = CalcPosInArray(key, GetPostfixLen());
+        auto entry = entries_.find(hc_pos);
+        if (entry != entries_.end() && DoesEntryMatch(entry->second, key)) {
+            return &entry->second;
+        }
+        return nullptr;
+    }
+
     /*
      * Attempts to erase a key/value pair.
      * This function is not recursive, if the 'key' leads to a child node, the child node
@@ -228,9 +318,29 @@ class Node {
         return entries_;
     }
 
-    void GetStats(PhTreeStats& stats, bit_width_t current_depth = 0) const {
+    /*
+     * Prefetches the node and the storage of its entries, see PHTREE_PREFETCH_DISTANCE and
+     * PrefetchEntries().
+     */
+    void Prefetch() const {
+        PrefetchRead(this);
+        PrefetchRead(&entries_);
+        PrefetchEntries(entries_);
+    }
+
+    /*
+     * @param value_size_fn Returns the heap memory that is owned by a value, see
+     * PhTreeDebugHelper::GetStats().
+     */
+    template <typename VALUE_SIZE>
+    void GetStats(
+        PhTreeStats& stats, const VALUE_SIZE& value_size_fn, bit_width_t current_depth = 0) const {
         size_t num_children = entries_.size();
 
+        size_t container_size = GetHeapSize(entries_);
+        stats.node_size_ += sizeof(Node);
+        stats.entry_container_size_ += container_size;
+        stats.mem_size_ += sizeof(Node) + container_size;
         ++stats.n_nodes_;
         ++stats.infix_hist_[GetInfixLen()];
         ++stats.node_depth_hist_[current_depth];
@@ -244,10 +354,14 @@ class Node {
             auto& child = entry.second;
             if (child.IsNode()) {
                 auto& sub = child.GetNode();
-                sub.GetStats(stats, current_depth + 1);
+                sub.GetStats(stats, value_size_fn, current_depth + 1);
             } else {
                 ++stats.q_n_post_fix_n_[current_depth];
+                ++stats.n_entries_;
                 ++stats.size_;
+                size_t value_size = value_size_fn(child.GetValue());
+                stats.value_heap_size_ += value_size;
+                stats.mem_size_ += value_size;
             }
         }
     }
@@ -273,6 +387,119 @@ class Node {
         return num_entries_local + num_entries_children;
     }
 
+    /*
+     * Returns the hash of all entries in this node and its child nodes. With PHTREE_HASH_TRACKING
+     * this returns the cached hash, which must have been calculated with UpdateHash().
+     *
+     * @param hash_fn The hash function for values.
+     */
+    template <typename HASH>
+    std::uint64_t GetHash([[maybe_unused]] const HASH& hash_fn) const {
+#if defined(PHTREE_HASH_TRACKING)
+        assert(!is_hash_dirty_);
+        return hash_;
+#else
+        std::uint64_t hash = 0;
+        for (auto& entry : entries_) {
+            auto& child = entry.second;
+            if (child.IsNode()) {
+                hash += child.GetNode().GetHash(hash_fn);
+            } else {
+                hash += HashEntry(child.GetKey(), hash_fn(child.GetValue()));
+            }
+        }
+        return hash;
+#endif
+    }
+
+    /*
+     * Calculates the hash of this node, see GetHash(). With PHTREE_HASH_TRACKING, the hashes of
+     * this node and its child nodes are cached.
+     *
+     * @param hash_fn The hash function for values.
+     * @param use_cache If 'true', only hashes of nodes that were marked with MarkHashDirty() are
+     * recalculated. Otherwise all hashes are recalculated.
+     */
+    template <typename HASH>
+    std::uint64_t UpdateHash(const HASH& hash_fn, [[maybe_unused]] bool use_cache) {
+#if defined(PHTREE_HASH_TRACKING)
+        if (use_cache && !is_hash_dirty_) {
+            return hash_;
+        }
+        std::uint64_t hash = 0;
+        for (auto& entry : entries_) {
+            auto& child = entry.second;
+            if (child.IsNode()) {
+                hash += child.GetNode().UpdateHash(hash_fn, use_cache);
+            } else {
+                hash += HashEntry(child.GetKey(), hash_fn(child.GetValue()));
+            }
+        }
+        hash_ = hash;
+        is_hash_dirty_ = false;
+        return hash;
+#else
+        return GetHash(hash_fn);
+#endif
+    }
+
+#if defined(PHTREE_HASH_TRACKING)
+    /*
+     * Marks the cached hash as invalid. This must be called for every node on the path to a
+     * modified entry.
+     */
+    void MarkHashDirty() {
+        is_hash_dirty_ = true;
+    }
+#endif
+
+#if defined(PHTREE_GENERATION_TRACKING)
+    /*
+     * Sets the generation of the latest modification in this node's subtree. This must be called
+     * for every node on the path to a modified entry.
+     *
+     * @param is_entry_modified 'true' if the entries of this node were modified, i.e. if this is
+     * the last node on the path or if a child node was merged into this node.
+     */
+    void SetGeneration(std::uint64_t generation, bool is_entry_modified) {
+        generation_ = generation;
+        if (is_entry_modified) {
+            entry_generation_ = generation;
+        }
+    }
+
+    [[nodiscard]] std::uint64_t GetGeneration() const {
+        return generation_;
+    }
+
+    [[nodiscard]] std::uint64_t GetEntryGeneration() const {
+        return entry_generation_;
+    }
+#endif
+
+    /*
+     * Creates a new node with the same state and moves all entries into it, see
+     * PhTreeV16::compact(). Child nodes are not relocated. This node must be deleted afterwards.
+     */
+    [[nodiscard]] std::unique_ptr<Node> Relocate() {
+        auto node = std::make_unique<Node>(infix_len_, postfix_len_);
+#if defined(PHTREE_HASH_TRACKING)
+        node->is_hash_dirty_ = is_hash_dirty_;
+        node->hash_ = hash_;
+#endif
+#if defined(PHTREE_GENERATION_TRACKING)
+        node->generation_ = generation_;
+        node->entry_generation_ = entry_generation_;
+#endif
+        if constexpr (std::is_same_v<decltype(entries_), sparse_map<EntryT>>) {
+            node->entries_.reserve(entries_.size());
+        }
+        for (auto& entry : entries_) {
+            node->entries_.try_emplace(entry.first, std::move(entry.second));
+        }
+        return node;
+    }
+
     void SetInfixLen(bit_width_t newInfLen) {
         assert(newInfLen < MAX_BIT_WIDTH<SCALAR>);
         assert(newInfLen >= 0);
@@ -362,6 +589,7 @@ class Node {
         auto& new_entry = new_sub_node->WriteValue(pos_sub_1, new_key, std::forward<Args>(args)...);
 
         // Insert new node into local node
+        PhTreeTrace::OnSplit(new_sub_node.get(), new_postfix_len);
         current_entry.SetNode(std::move(new_sub_node));
         return &new_entry;
     }
@@ -396,6 +624,16 @@ class Node {
     // The number of bits between this node and the parent node. For 64bit keys possible values
     // range from 0 to 62.
     bit_width_t infix_len_;
+#if defined(PHTREE_HASH_TRACKING)
+    // Cached hash of the subtree, see UpdateHash()
+    bool is_hash_dirty_;
+    std::uint64_t hash_;
+#endif
+#if defined(PHTREE_GENERATION_TRACKING)
+    // Generations of the latest modification in the subtree and of this node's entries
+    std::uint64_t generation_;
+    std::uint64_t entry_generation_;
+#endif
     EntryMap<DIM, EntryT> entries_;
 };
 
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_PHTREE_FROZEN_V16_H
+#define PHTREE_V16_PHTREE_FROZEN_V16_H
+
+#include "phtree_v16.h"
+#include "for_each_frozen.h"
+#include "frozen_data_v16.h"
+#include "iterator_frozen.h"
+#include "iterator_knn_frozen.h"
+
+namespace improbable::phtree::v16 {
+
+/*
+ * Read-only PH-Tree that operates directly on a frozen image, see FrozenHeaderV16 for the layout.
+ *
+ * The tree does not own the image. All queries read the image in place, i.e. if the image is a
+ * memory mapped file, only the pages that are touched by a query are loaded.
+ *
+ * The API follows the query API of PhTreeV16, except that values are returned as const references.
+ */
+template <dimension_t DIM, typename T, typename CONVERT = ConverterNoOp<DIM, scalar_64_t>>
+class PhTreeFrozenV16 {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    using KeyT = typename CONVERT::KeyInternal;
+    using DataT = FrozenDataV16<DIM, T, ScalarInternal>;
+
+  public:
+    static_assert(!std::is_reference<T>::value, "Reference type value are not supported.");
+    static_assert(DIM >= 1 && DIM <= 63, "This PH-Tree supports between 1 and 63 dimensions");
+
+    explicit PhTreeFrozenV16(const CONVERT& converter = CONVERT())
+    : data_{}, converter_{converter} {}
+
+    /*
+     * Attaches the tree to a frozen image. The memory must remain valid and unmodified until the
+     * tree is detached or destroyed.
+     *
+     * @param external_values The value array of images that were created with freeze().
+     * @return 'false' if the memory does not contain a valid image for this type of tree. In this
+     * case the tree is empty.
+     */
+    bool attach(const char* data, size_t size, const T* external_values = nullptr) {
+        return data_.Attach(data, size, external_values);
+    }
+
+    void detach() {
+        data_.Detach();
+    }
+
+    /*
+     * Analogous to map:count().
+     *
+     * @return '1', if a value is associated with the provided key, otherwise '0'.
+     */
+    size_t count(const KeyT& key) const {
+        return data_.Find(key) == DataT::NOT_FOUND ? 0 : 1;
+    }
+
+    /*
+     * Analogous to map:find().
+     *
+     * @return an iterator that points either to the associated value or to end().
+     */
+    auto find(const KeyT& key) const {
+        return IteratorFrozenSimple<T, CONVERT>(data_, data_.Find(key), converter_);
+    }
+
+    /*
+     * Iterates over all entries in the tree, see PhTreeV16::for_each().
+     * The callback requires the following signature: callback(const KEY &, const T &)
+     */
+    template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
+    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) const {
+        ForEachFrozen<T, CONVERT, CALLBACK_FN, FILTER, false>(
+            data_, KeyT{}, KeyT{}, converter_, callback, filter)
+            .run();
+    }
+
+    /*
+     * Performs a rectangular window query, see PhTreeV16::for_each().
+     * The callback requires the following signature: callback(const KEY &, const T &)
+     */
+    template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
+    void for_each(
+        const PhBox<DIM, ScalarInternal>& query_box,
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER()) const {
+        ForEachFrozen<T, CONVERT, CALLBACK_FN, FILTER, true>(
+            data_, query_box.min(), query_box.max(), converter_, callback, filter)
+            .run();
+    }
+
+    /*
+     * @return an iterator over all (filtered) entries in the tree.
+     */
+    template <typename FILTER = FilterNoOp>
+    auto begin(FILTER filter = FILTER()) const {
+        return IteratorFrozen<T, CONVERT, FILTER, false>(data_, KeyT{}, KeyT{}, converter_, filter);
+    }
+
+    /*
+     * Performs a rectangular window query, see PhTreeV16::begin_query().
+     */
+    template <typename FILTER = FilterNoOp>
+    auto begin_query(const PhBox<DIM, ScalarInternal>& query_box, FILTER filter = FILTER()) const {
+        return IteratorFrozen<T, CONVERT, FILTER, true>(
+            data_, query_box.min(), query_box.max(), converter_, filter);
+    }
+
+    /*
+     * Locate nearest neighbors for a given point in space, see PhTreeV16::begin_knn_query().
+     */
+    template <typename DISTANCE, typename FILTER = FilterNoOp>
+    auto begin_knn_query(
+        size_t min_results,
+        const KeyT& center,
+        DISTANCE distance_function = DISTANCE(),
+        FILTER filter = FILTER()) const {
+        return IteratorKnnFrozen<T, CONVERT, DISTANCE, FILTER>(
+            data_, min_results, center, converter_, distance_function, filter);
+    }
+
+    /*
+     * @return An iterator representing the tree's 'end'.
+     */
+    auto end() const {
+        return IteratorFrozenSimple<T, CONVERT>(data_, DataT::NOT_FOUND, converter_);
+    }
+
+    /*
+     * @return the number of entries (key/value pairs) in the tree.
+     */
+    [[nodiscard]] size_t size() const {
+        return data_.GetEntryCount();
+    }
+
+    /*
+     * @return 'true' if the tree is empty, otherwise 'false'.
+     */
+    [[nodiscard]] bool empty() const {
+        return data_.GetEntryCount() == 0;
+    }
+
+  private:
+    DataT data_;
+    CONVERT converter_;
+};
+
+/*
+ * Writes the tree as frozen image to a stream, see FrozenHeaderV16 for details. Frozen images
+ * can be queried with PhTreeFrozenV16, for example directly from a memory mapped file.
+ *
+ * @param os The output stream.
+ */
+template <dimension_t DIM, typename T, typename CONVERT>
+void write_frozen(const PhTreeV16<DIM, T, CONVERT>& tree, std::ostream& os) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    FrozenBuilderV16<DIM, T, ScalarInternal>(
+        PhTreeAccess::GetRoot(tree).GetNode(), tree.size())
+        .Write(os);
+}
+
+/*
+ * Writes a frozen image of the tree to memory, see write_frozen(tree, std::ostream&). Nothing is
+ * written if the image is larger than 'capacity'.
+ *
+ * @param data Memory that is aligned to 64 bytes.
+ * @return The size of the image.
+ */
+template <dimension_t DIM, typename T, typename CONVERT>
+size_t write_frozen(const PhTreeV16<DIM, T, CONVERT>& tree, char* data, size_t capacity) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    FrozenBuilderV16<DIM, T, ScalarInternal> builder(
+        PhTreeAccess::GetRoot(tree).GetNode(), tree.size());
+    size_t size = builder.GetImageSize();
+    if (size <= capacity) {
+        builder.WriteTo(data);
+    }
+    return size;
+}
+
+/*
+ * Creates an immutable in-memory copy of the tree, see FrozenHeaderV16 for the layout. The copy
+ * can be queried with PhTreeFrozenV16. Values are copied, so this requires copyable value types.
+ */
+template <dimension_t DIM, typename T, typename CONVERT>
+auto freeze(const PhTreeV16<DIM, T, CONVERT>& tree) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    return FrozenBuilderV16<DIM, T, ScalarInternal>(
+               PhTreeAccess::GetRoot(tree).GetNode(), tree.size())
+        .Build();
+}
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_PHTREE_FROZEN_V16_H
@@ -54,11 +54,14 @@ namespace improbable::phtree::v16 {
 template <dimension_t DIM, typename T, typename CONVERT = ConverterNoOp<DIM, scalar_64_t>>
 class PhTreeV16 {
     friend PhTreeDebugHelper;
+    friend PhTreeAccess;
     using ScalarExternal = typename CONVERT::ScalarExternal;
     using ScalarInternal = typename CONVERT::ScalarInternal;
     using KeyT = typename CONVERT::KeyInternal;
     using NodeT = Node<DIM, T, ScalarInternal>;
     using EntryT = Entry<DIM, T, ScalarInternal>;
+    // The nodes on the path from the root to an entry, for hash and generation tracking.
+    using NodePath = std::array<NodeT*, MAX_BIT_WIDTH<ScalarInternal>>;
 
   public:
     static_assert(!std::is_reference<T>::value, "Reference type value are not supported.");
@@ -73,7 +76,9 @@ class PhTreeV16 {
     : num_entries_{0}
     , root_{0, MAX_BIT_WIDTH<ScalarInternal> - 1}
     , the_end_{converter}
-    , converter_{converter} {}
+    , converter_{converter} {
+        PhTreeTrace::OnRootChange(&root_.GetNode());
+    }
 
     /*
      *  Attempts to build and insert a key and a value into the tree.
@@ -93,9 +98,18 @@ class PhTreeV16 {
     std::pair<T&, bool> emplace(const KeyT& key, Args&&... args) {
         auto* current_entry = &root_;
         bool is_inserted = false;
+        const bool is_tracking = IsTrackingModifications();
+        NodePath path;
+        size_t path_len = 0;
         while (current_entry->IsNode()) {
-            current_entry =
-                current_entry->GetNode().Emplace(is_inserted, key, std::forward<Args>(args)...);
+            auto* current_node = &current_entry->GetNode();
+            if (is_tracking) {
+                path[path_len++] = current_node;
+            }
+            current_entry = current_node->Emplace(is_inserted, key, std::forward<Args>(args)...);
+        }
+        if (is_inserted && is_tracking) {
+            MarkPath(path, path_len);
         }
         num_entries_ += is_inserted;
         return {current_entry->GetValue(), is_inserted};
@@ -128,8 +142,10 @@ class PhTreeV16 {
         // - Using 'parent' allows a scenario where the iterator was previously used with
         //   erase(iterator). This is safe because erase() will never erase the 'parent' node.
 
-        if (!iterator.GetParentNodeEntry()) {
-            // No hint available, use standard emplace()
+        if (!iterator.GetParentNodeEntry() || IsTrackingModifications()) {
+            // No hint available, use standard emplace().
+            // With hash or generation tracking we need to traverse the whole path to mark
+            // modified nodes.
             return emplace(key, std::forward<Args>(args)...);
         }
 
@@ -166,7 +182,33 @@ class PhTreeV16 {
      * and returned.
      */
     T& operator[](const KeyT& key) {
-        return emplace(key).first;
+        auto result = emplace(key);
+        if (!result.second) {
+            // The returned value may be modified
+            mark_modified(key);
+        }
+        return result.first;
+    }
+
+    /*
+     * Marks an existing entry as modified for hash and generation tracking, e.g. after its value
+     * was assigned via a reference. This has no effect if the key does not exist.
+     */
+    void mark_modified(const KeyT& key) {
+        if (!IsTrackingModifications()) {
+            return;
+        }
+        EntryT* current_entry = &root_;
+        NodePath path;
+        size_t path_len = 0;
+        while (current_entry != nullptr && current_entry->IsNode()) {
+            auto* current_node = &current_entry->GetNode();
+            path[path_len++] = current_node;
+            current_entry = current_node->Find(key);
+        }
+        if (current_entry != nullptr) {
+            MarkPath(path, path_len);
+        }
     }
 
     /*
@@ -218,12 +260,41 @@ class PhTreeV16 {
     size_t erase(const KeyT& key) {
         auto* current_node = &root_.GetNode();
         NodeT* parent_node = nullptr;
+        NodeT* grand_parent_node = nullptr;
+        bit_width_t postfix_len = 0;
         bool found = false;
+        const bool is_tracking = IsTrackingModifications();
+        NodePath path;
+        size_t path_len = 0;
         while (current_node) {
+            if (is_tracking) {
+                path[path_len++] = current_node;
+            }
+            postfix_len = current_node->GetPostfixLen();
             auto* child_node = current_node->Erase(key, parent_node, found);
+            grand_parent_node = parent_node;
             parent_node = current_node;
             current_node = child_node;
         }
+        if (found && is_tracking) {
+            BeginModification();
+            // The last node of the path ('parent_node') may have been deleted, see below.
+            for (size_t i = 0; i + 1 < path_len; ++i) {
+                MarkModified(*path[i], false);
+            }
+            // 'parent_node' contained the entry. It may have been merged into its own parent
+            // (and deleted), in which case the entries of the parent have been modified.
+            NodeT* modified_node = parent_node;
+            if (grand_parent_node != nullptr) {
+                auto& entries = grand_parent_node->Entries();
+                auto it = entries.find(CalcPosInArray(key, grand_parent_node->GetPostfixLen()));
+                assert(it != entries.end());
+                bool is_merged =
+                    !it->second.IsNode() || it->second.GetNode().GetPostfixLen() != postfix_len;
+                modified_node = is_merged ? grand_parent_node : &it->second.GetNode();
+            }
+            MarkModified(*modified_node, true);
+        }
         num_entries_ -= found;
         return found;
     }
@@ -245,12 +316,16 @@ class PhTreeV16 {
         if (iterator.Finished()) {
             return 0;
         }
-        if (!iterator.GetParentNodeEntry()) {
+        if (!iterator.GetParentNodeEntry() || IsTrackingModifications()) {
             // Why may there be no parent?
             // - we are in the root node
             // - the iterator did not set this value
             // In either case, we need to start searching from the top.
-            return erase(iterator.GetCurrentResult()->GetKey());
+            // With hash or generation tracking we need to traverse the whole path to mark
+            // modified nodes.
+            // The key is copied because erase() destroys the entry before it marks the path.
+            KeyT key = iterator.GetCurrentResult()->GetKey();
+            return erase(key);
         }
         bool found = false;
         assert(iterator.GetCurrentNodeEntry() && iterator.GetCurrentNodeEntry()->IsNode());
@@ -273,10 +348,14 @@ class PhTreeV16 {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h.
      */
     template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
-    void for_each(CALLBACK_FN& callback, FILTER filter = FILTER()) const {
-        ForEach<T, CONVERT, CALLBACK_FN, FILTER>(converter_, callback, filter).run(root_);
+    void for_each(
+        CALLBACK_FN& callback,
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
+        ForEach<T, CONVERT, CALLBACK_FN, FILTER>(converter_, callback, filter, stats).run(root_);
     }
 
     /*
@@ -288,14 +367,16 @@ class PhTreeV16 {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h.
      */
     template <typename CALLBACK_FN, typename FILTER = FilterNoOp>
     void for_each(
         const PhBox<DIM, ScalarInternal>& query_box,
         CALLBACK_FN& callback,
-        FILTER filter = FILTER()) const {
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         ForEachHC<T, CONVERT, CALLBACK_FN, FILTER>(
-            query_box.min(), query_box.max(), converter_, callback, filter)
+            query_box.min(), query_box.max(), converter_, callback, filter, stats)
             .run(root_);
     }
 
@@ -304,11 +385,12 @@ class PhTreeV16 {
      * (=sub-trees) before returning / traversing them. By default all entries are returned. Filter
      * functions must implement the same signature as the default 'FilterNoOp'.
      *
+     * @param stats Optional statistics of the query, see begin_query().
      * @return an iterator over all (filtered) entries in the tree,
      */
     template <typename FILTER = FilterNoOp>
-    auto begin(FILTER filter = FILTER()) const {
-        return IteratorFull<T, CONVERT, FILTER>(root_, converter_, filter);
+    auto begin(FILTER filter = FILTER(), PhTreeQueryStats* stats = nullptr) const {
+        return IteratorFull<T, CONVERT, FILTER>(root_, converter_, filter, stats);
     }
 
     /*
@@ -318,12 +400,17 @@ class PhTreeV16 {
      * @param filter An optional filter function. The filter function allows filtering entries and
      * sub-nodes before they are returned or traversed. Any filter function must follow the
      * signature of the default 'FilterNoOp`.
+     * @param stats Optional statistics of the query, see query_stats.h. The iterator keeps the
+     * pointer, so 'stats' must outlive it.
      * @return Result iterator.
      */
     template <typename FILTER = FilterNoOp>
-    auto begin_query(const PhBox<DIM, ScalarInternal>& query_box, FILTER filter = FILTER()) const {
+    auto begin_query(
+        const PhBox<DIM, ScalarInternal>& query_box,
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         return IteratorHC<T, CONVERT, FILTER>(
-            root_, query_box.min(), query_box.max(), converter_, filter);
+            root_, query_box.min(), query_box.max(), converter_, filter, stats);
     }
 
     /*
@@ -338,6 +425,7 @@ class PhTreeV16 {
      * @param distance_function optional distance function, defaults to euclidean distance
      * @param filter optional filter predicate that excludes nodes/entries before their distance is
      * calculated.
+     * @param stats Optional statistics of the query, see begin_query().
      * @return Result iterator.
      */
     template <typename DISTANCE, typename FILTER = FilterNoOp>
@@ -345,9 +433,10 @@ class PhTreeV16 {
         size_t min_results,
         const KeyT& center,
         DISTANCE distance_function = DISTANCE(),
-        FILTER filter = FILTER()) const {
+        FILTER filter = FILTER(),
+        PhTreeQueryStats* stats = nullptr) const {
         return IteratorKnnHS<T, CONVERT, DISTANCE, FILTER>(
-            root_, min_results, center, converter_, distance_function, filter);
+            root_, min_results, center, converter_, distance_function, filter, stats);
     }
 
     /*
@@ -357,12 +446,110 @@ class PhTreeV16 {
         return the_end_;
     }
 
+    /*
+     * Enables or disables incremental hash tracking. With hash tracking, every modification marks
+     * the nodes on the path to the modified entry, so hash() and diff() only need to recalculate
+     * the hashes of modified nodes. Without hash tracking, hash() and diff() recalculate all
+     * hashes. Hash tracking requires PHTREE_HASH_TRACKING, otherwise this does not compile.
+     *
+     * Hash tracking cannot detect modifications of values via iterators or via references that
+     * are returned by emplace() or find(). Assignments via operator[] are detected.
+     */
+    void set_hash_tracking(bool enabled) {
+        static_assert(
+            HASH_TRACKING_ENABLED && sizeof(T) > 0,
+            "set_hash_tracking() requires PHTREE_HASH_TRACKING");
+        if (enabled && !is_hash_tracking_) {
+            // Modifications were not tracked, the next hash() recalculates all hashes.
+            is_hash_cache_valid_ = false;
+        }
+        is_hash_tracking_ = enabled;
+    }
+
+    /*
+     * Calculates a hash of all entries in the tree. The hash does not depend on the order of
+     * insertion. Node hashes are cached, see set_hash_tracking().
+     *
+     * This is not 'const' because it updates the cached node hashes.
+     *
+     * @param hash_fn The hash function for values, e.g. std::hash<T>.
+     */
+    template <typename HASH>
+    [[nodiscard]] std::uint64_t hash(const HASH& hash_fn) {
+        bool use_cache = is_hash_tracking_ && is_hash_cache_valid_;
+        is_hash_cache_valid_ = is_hash_tracking_;
+        return root_.GetNode().UpdateHash(hash_fn, use_cache);
+    }
+
+    /*
+     * Enables or disables generation tracking. With generation tracking, every modification
+     * increments the generation of the tree and stores it in all nodes on the path to the modified
+     * entry, see for_each_dirty_node(). Modifications that happen while generation tracking is
+     * disabled are not recorded. Generation tracking requires PHTREE_GENERATION_TRACKING,
+     * otherwise this does not compile.
+     *
+     * Generation tracking cannot detect modifications of values via iterators or via references
+     * that are returned by emplace() or find(). Assignments via operator[] are detected.
+     */
+    void set_generation_tracking(bool enabled) {
+        static_assert(
+            GENERATION_TRACKING_ENABLED && sizeof(T) > 0,
+            "set_generation_tracking() requires PHTREE_GENERATION_TRACKING");
+        is_generation_tracking_ = enabled;
+    }
+
+    /*
+     * @return the generation of the latest modification, see set_generation_tracking().
+     */
+    [[nodiscard]] std::uint64_t generation() const {
+        return generation_;
+    }
+
+    /*
+     * Relocates nodes to new memory in depth-first order, see PhTree::compact().
+     * New nodes are allocated with the default allocator (there is no arena). The old node of a
+     * subtree is kept until the whole subtree has been relocated, so the allocator cannot reuse
+     * its memory for the child nodes of the subtree. compact_old_nodes_ holds at most one old node
+     * per level of the current path, also between incremental calls.
+     *
+     * @param max_nodes The maximum number of nodes to relocate in this call.
+     * @return 'true' if all nodes have been relocated, 'false' if compact() needs to be called
+     * again to continue where this call stopped.
+     */
+    bool compact(size_t max_nodes) {
+        auto& old_nodes = compact_old_nodes_;
+        if (!is_compacting_) {
+            if (max_nodes == 0) {
+                return false;
+            }
+            old_nodes.clear();
+            old_nodes.emplace_back(RelocateNode(root_));
+            PhTreeTrace::OnRootChange(&root_.GetNode());
+            --max_nodes;
+            compact_cursor_.clear();
+            is_compacting_ = true;
+        }
+        if (!CompactChildren(root_.GetNode(), 0, max_nodes, old_nodes)) {
+            return false;
+        }
+        compact_cursor_.clear();
+        compact_old_nodes_.clear();
+        is_compacting_ = false;
+        return true;
+    }
+
     /*
      * Remove all entries from the tree.
      */
     void clear() {
+        compact_cursor_.clear();
+        compact_old_nodes_.clear();
+        is_compacting_ = false;
         num_entries_ = 0;
         root_ = EntryT(0, MAX_BIT_WIDTH<ScalarInternal> - 1);
+        PhTreeTrace::OnRootChange(&root_.GetNode());
+        BeginModification();
+        MarkModified(root_.GetNode(), true);
     }
 
     /*
@@ -380,6 +567,101 @@ class PhTreeV16 {
     }
 
   private:
+    [[nodiscard]] bool IsTrackingModifications() const {
+        return (HASH_TRACKING_ENABLED && is_hash_tracking_) ||
+            (GENERATION_TRACKING_ENABLED && is_generation_tracking_);
+    }
+
+    void BeginModification() {
+        if constexpr (GENERATION_TRACKING_ENABLED) {
+            if (is_generation_tracking_) {
+                ++generation_;
+            }
+        }
+    }
+
+    // Starts a new modification and marks the nodes on the path to a modified entry. The last
+    // node of the path contains the entry.
+    void MarkPath(const NodePath& path, size_t path_len) {
+        assert(path_len > 0);
+        BeginModification();
+        for (size_t i = 0; i + 1 < path_len; ++i) {
+            MarkModified(*path[i], false);
+        }
+        MarkModified(*path[path_len - 1], true);
+    }
+
+    // This must be called for every node on the path to a modified entry.
+    void MarkModified(NodeT& node, bool is_entry_modified) {
+        if constexpr (HASH_TRACKING_ENABLED) {
+            if (is_hash_tracking_) {
+                node.MarkHashDirty();
+            }
+        }
+        if constexpr (GENERATION_TRACKING_ENABLED) {
+            if (is_generation_tracking_) {
+                node.SetGeneration(generation_, is_entry_modified);
+            }
+        }
+    }
+
+    [[nodiscard]] std::unique_ptr<NodeT> RelocateNode(EntryT& entry) {
+        std::unique_ptr<NodeT> old_node{entry.ExtractNode()};
+        entry.SetNode(old_node->Relocate());
+        return old_node;
+    }
+
+    /*
+     * Relocates the child nodes of 'node' in depth-first order. compact_cursor_ contains the
+     * hypercube addresses of the path from the root to the next node that should be relocated.
+     * The path is followed as far as possible, so compaction can continue if the tree was modified
+     * between two calls. In the worst case some nodes are relocated twice or not at all.
+     * old_nodes[depth + 1] holds the old node of the child that is currently being compacted, it
+     * is deleted when the child's subtree is complete.
+     *
+     * @return 'false' if 'max_nodes' was exhausted before all child nodes were relocated.
+     */
+    bool CompactChildren(
+        NodeT& node,
+        size_t depth,
+        size_t& max_nodes,
+        std::vector<std::unique_ptr<NodeT>>& old_nodes) {
+        auto iter = node.Entries().begin();
+        auto end = node.Entries().end();
+        // Is the first child node already relocated and do we need to continue inside of it?
+        bool is_resuming_child = false;
+        if (depth < compact_cursor_.size()) {
+            auto hc_pos = compact_cursor_[depth];
+            iter = node.Entries().lower_bound(hc_pos);
+            is_resuming_child = depth + 1 < compact_cursor_.size() && iter != end &&
+                iter->first == hc_pos && iter->second.IsNode();
+        }
+        for (; iter != end; ++iter) {
+            auto& entry = iter->second;
+            if (!entry.IsNode()) {
+                continue;
+            }
+            if (is_resuming_child) {
+                is_resuming_child = false;
+            } else {
+                compact_cursor_.resize(depth);
+                compact_cursor_.emplace_back(iter->first);
+                if (max_nodes == 0) {
+                    return false;
+                }
+                old_nodes.resize(depth + 1);
+                old_nodes.emplace_back(RelocateNode(entry));
+                --max_nodes;
+            }
+            if (!CompactChildren(entry.GetNode(), depth + 1, max_nodes, old_nodes)) {
+                return false;
+            }
+            // The subtree is complete, delete its old node (and any stale deeper nodes)
+            old_nodes.resize(std::min(old_nodes.size(), depth + 1));
+        }
+        return true;
+    }
+
     /*
      * This function is only for debugging.
      */
@@ -387,6 +669,11 @@ class PhTreeV16 {
         return DebugHelperV16(root_.GetNode(), num_entries_);
     }
 
+    // Allows using PhTreeDebugHelper directly with this tree, e.g. for the pages of PhTreePaged.
+    const PhTreeV16& GetInternalTree() const {
+        return *this;
+    }
+
   private:
     size_t num_entries_;
     // Contract: root_ contains a Node with 0 or more entries (the root node is the only Node
@@ -394,6 +681,16 @@ class PhTreeV16 {
     EntryT root_;
     IteratorEnd<T, CONVERT> the_end_;
     CONVERT converter_;
+    bool is_hash_tracking_ = false;
+    // 'false' if the cached node hashes may be outdated although they are not marked as dirty
+    bool is_hash_cache_valid_ = false;
+    bool is_generation_tracking_ = false;
+    std::uint64_t generation_ = 0;
+    // Path to the next node that is relocated by compact()
+    std::vector<hc_pos_t> compact_cursor_;
+    // Old nodes on the path to compact_cursor_, see CompactChildren()
+    std::vector<std::unique_ptr<NodeT>> compact_old_nodes_;
+    bool is_compacting_ = false;
 };
 
 }  // namespace improbable::phtree::v16
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_SERIALIZATION_COMPRESSED_V16_H
+#define PHTREE_V16_SERIALIZATION_COMPRESSED_V16_H
+
+#include "../common/common.h"
+#include "node.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace improbable::phtree::v16 {
+
+/*
+ * The compressed serializer writes the nodes of a PH-Tree in a bit-packed format, see
+ * SerializerV16::WriteCompressed().
+ *
+ * The format uses the fact that all entries in a node share the node's prefix:
+ * - Keys of values are written without the prefix and without the bit that is given by the
+ *   hypercube address, i.e. only the 'postfix_len' lowest bits of every dimension are written.
+ * - Keys of child nodes are written as the infix of the child node, lower bits are not written
+ *   because they are irrelevant for the child node's prefix.
+ * - Hypercube addresses are written with DIM bits per entry, or, for small DIM and densely
+ *   populated nodes, as bitmap with one bit per possible hypercube address.
+ *
+ * Every node is written as one bit-packed block (entry count, hypercube addresses, entry types,
+ * child postfix lengths and keys) that is prefixed with its length in bytes. The block is followed
+ * by the values and child nodes of the node's entries, in z-order. Values are written with the
+ * value codec.
+ * Only the block of a single node is buffered in memory, everything else is written to (or read
+ * from) the stream directly while traversing the tree.
+ */
+template <dimension_t DIM, typename T, typename SCALAR>
+class CompressedSerializerV16 {
+    using KeyT = PhPoint<DIM, SCALAR>;
+    using NodeT = Node<DIM, T, SCALAR>;
+    using BitsT = bit_mask_t<SCALAR>;
+
+    static constexpr bit_width_t SCALAR_BITS = MAX_BIT_WIDTH<SCALAR>;
+    static constexpr bit_width_t POSTFIX_BITS = SCALAR_BITS > 32 ? 6 : 5;
+    static constexpr bit_width_t COUNT_BITS = DIM + 1;
+    // Bitmaps are only used for nodes with at most 2^BITMAP_MAX_DIM possible entries.
+    static constexpr dimension_t BITMAP_MAX_DIM = 10;
+    // Node sizes are limited by the number of entries that an EntryMap can hold.
+    static constexpr std::uint64_t MAX_ENTRY_COUNT = std::numeric_limits<std::uint32_t>::max();
+    // Blocks are read in chunks, so invalid block sizes do not cause huge allocations.
+    static constexpr std::uint64_t READ_CHUNK_SIZE = 1u << 16;
+
+    struct EntryInfo {
+        hc_pos_t hc_pos_;
+        bool is_node_;
+        bit_width_t child_postfix_len_;
+        KeyT key_;
+    };
+
+  public:
+    template <typename CODEC>
+    static void WriteNode(std::ostream& os, const NodeT& root, const CODEC& codec) {
+        std::string buffer;
+        WriteNode(os, root, codec, buffer);
+    }
+
+    /*
+     * Reads the entries of a root node that was written with WriteNode().
+     *
+     * @return 'false' if the stream is invalid.
+     */
+    template <typename CODEC>
+    static bool ReadNode(std::istream& is, NodeT& root, size_t& num_values, const CODEC& codec) {
+        std::string buffer;
+        std::vector<EntryInfo> stack;
+        return ReadNode(is, root, KeyT{}, num_values, codec, buffer, stack);
+    }
+
+  private:
+    template <typename CODEC>
+    static void WriteNode(
+        std::ostream& os, const NodeT& node, const CODEC& codec, std::string& buffer) {
+        buffer.clear();
+        BitWriter out{buffer};
+        bit_width_t postfix_len = node.GetPostfixLen();
+        std::uint64_t entry_count = node.GetEntryCount();
+        out.Write(entry_count, COUNT_BITS);
+        bool use_bitmap = UseBitmap(entry_count);
+        out.Write(use_bitmap, 1);
+        if (use_bitmap) {
+            auto it = node.Entries().begin();
+            for (hc_pos_t hc_pos = 0; hc_pos < MaxEntryCount(); ++hc_pos) {
+                bool is_set = it != node.Entries().end() && it->first == hc_pos;
+                out.Write(is_set, 1);
+                if (is_set) {
+                    ++it;
+                }
+            }
+        } else {
+            for (auto& it : node.Entries()) {
+                out.Write(it.first, DIM);
+            }
+        }
+        for (auto& it : node.Entries()) {
+            const auto& entry = it.second;
+            out.Write(entry.IsNode(), 1);
+            if (entry.IsNode()) {
+                bit_width_t child_postfix_len = entry.GetNode().GetPostfixLen();
+                out.Write(child_postfix_len, POSTFIX_BITS);
+                WriteBits(out, entry.GetKey(), child_postfix_len + 1, postfix_len);
+            } else {
+                WriteBits(out, entry.GetKey(), 0, postfix_len);
+            }
+        }
+        out.Flush();
+        WriteVarInt(os, buffer.size());
+        os.write(buffer.data(), buffer.size());
+
+        for (auto& it : node.Entries()) {
+            const auto& entry = it.second;
+            if (entry.IsNode()) {
+                WriteNode(os, entry.GetNode(), codec, buffer);
+            } else {
+                codec.write(os, entry.GetValue());
+            }
+        }
+    }
+
+    /*
+     * @param prefix Any key inside the node, only the bits above the node's postfix are used.
+     * @param buffer Buffer for the node's block.
+     * @param stack Buffer for the entries of the node and its parents. The entries of a node are
+     * appended to the stack and removed once the node has been read.
+     */
+    template <typename CODEC>
+    static bool ReadNode(
+        std::istream& is,
+        NodeT& node,
+        const KeyT& prefix,
+        size_t& num_values,
+        const CODEC& codec,
+        std::string& buffer,
+        std::vector<EntryInfo>& stack) {
+        if (!ReadBlock(is, buffer)) {
+            return false;
+        }
+        BitReader in{buffer.data(), buffer.size()};
+        bit_width_t postfix_len = node.GetPostfixLen();
+        std::uint64_t entry_count = in.Read(COUNT_BITS);
+        // This also protects against huge allocations when reading invalid streams.
+        if (entry_count > MaxEntryCount() || entry_count > MAX_ENTRY_COUNT ||
+            entry_count * DIM > buffer.size() * 8) {
+            return false;
+        }
+        const size_t base = stack.size();
+        stack.resize(base + entry_count);
+        auto* entries = &stack[base];
+        bool use_bitmap = in.Read(1);
+        if (use_bitmap) {
+            if (!UseBitmap(entry_count)) {
+                return false;
+            }
+            size_t n = 0;
+            for (hc_pos_t hc_pos = 0; hc_pos < MaxEntryCount(); ++hc_pos) {
+                if (in.Read(1)) {
+                    if (n == entry_count) {
+                        return false;
+                    }
+                    entries[n++].hc_pos_ = hc_pos;
+                }
+            }
+            if (n != entry_count) {
+                return false;
+            }
+        } else {
+            for (std::uint64_t i = 0; i < entry_count; ++i) {
+                entries[i].hc_pos_ = in.Read(DIM);
+                // Entries must be written in z-order.
+                if (i > 0 && entries[i].hc_pos_ <= entries[i - 1].hc_pos_) {
+                    return false;
+                }
+            }
+        }
+        for (std::uint64_t i = 0; i < entry_count; ++i) {
+            auto& entry = entries[i];
+            entry.is_node_ = in.Read(1);
+            entry.key_ = CreateKey(prefix, entry.hc_pos_, postfix_len);
+            if (entry.is_node_) {
+                entry.child_postfix_len_ = in.Read(POSTFIX_BITS);
+                if (entry.child_postfix_len_ >= postfix_len) {
+                    return false;
+                }
+                ReadBits(in, entry.key_, entry.child_postfix_len_ + 1, postfix_len);
+            } else {
+                ReadBits(in, entry.key_, 0, postfix_len);
+            }
+        }
+        if (!in.IsValid()) {
+            return false;
+        }
+
+        for (size_t i = base; i < base + entry_count; ++i) {
+            // Copy the entry, reading child nodes may reallocate the stack.
+            const EntryInfo entry = stack[i];
+            if (entry.is_node_) {
+                bit_width_t infix_len = postfix_len - entry.child_postfix_len_ - 1;
+                auto child = std::make_unique<NodeT>(infix_len, entry.child_postfix_len_);
+                auto& child_ref = *child;
+                node.Entries().try_emplace(entry.hc_pos_, entry.key_, std::move(child));
+                if (!ReadNode(is, child_ref, entry.key_, num_values, codec, buffer, stack) ||
+                    child_ref.GetEntryCount() < 2) {
+                    // Only the root node may have fewer than two entries.
+                    return false;
+                }
+            } else {
+                auto value = codec.read(is);
+                if (is.fail()) {
+                    return false;
+                }
+                node.Entries().try_emplace(entry.hc_pos_, entry.key_, std::move(value));
+                ++num_values;
+            }
+        }
+        stack.resize(base);
+        return true;
+    }
+
+    static bool ReadBlock(std::istream& is, std::string& buffer) {
+        std::uint64_t size = 0;
+        if (!ReadVarInt(is, size)) {
+            return false;
+        }
+        buffer.clear();
+        while (buffer.size() < size) {
+            size_t pos = buffer.size();
+            size_t n = std::min(size - pos, READ_CHUNK_SIZE);
+            buffer.resize(pos + n);
+            if (!is.read(buffer.data() + pos, n)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr std::uint64_t MaxEntryCount() {
+        return std::uint64_t{1} << DIM;
+    }
+
+    static constexpr bool UseBitmap(std::uint64_t entry_count) {
+        return DIM <= BITMAP_MAX_DIM && MaxEntryCount() < entry_count * DIM;
+    }
+
+    /*
+     * Writes the bits [min_bit, max_bit) of every dimension of the key.
+     */
+    static void WriteBits(
+        BitWriter& out, const KeyT& key, bit_width_t min_bit, bit_width_t max_bit) {
+        assert(min_bit <= max_bit);
+        bit_width_t n = max_bit - min_bit;
+        if (n == 0) {
+            return;
+        }
+        for (dimension_t d = 0; d < DIM; ++d) {
+            out.Write(static_cast<BitsT>(key[d]) >> min_bit, n);
+        }
+    }
+
+    static void ReadBits(BitReader& in, KeyT& key, bit_width_t min_bit, bit_width_t max_bit) {
+        bit_width_t n = max_bit - min_bit;
+        if (n == 0) {
+            return;
+        }
+        for (dimension_t d = 0; d < DIM; ++d) {
+            BitsT bits = static_cast<BitsT>(in.Read(n)) << min_bit;
+            key[d] = static_cast<SCALAR>(static_cast<BitsT>(key[d]) | bits);
+        }
+    }
+
+    /*
+     * @return A key with the node's prefix and the bit at 'postfix_len' set according to the
+     * hypercube address. All lower bits are '0'.
+     */
+    static KeyT CreateKey(const KeyT& prefix, hc_pos_t hc_pos, bit_width_t postfix_len) {
+        BitsT prefix_mask =
+            postfix_len + 1 >= SCALAR_BITS ? BitsT{0} : MAX_MASK<SCALAR> << (postfix_len + 1);
+        KeyT key;
+        for (dimension_t d = 0; d < DIM; ++d) {
+            BitsT hc_bit = static_cast<BitsT>((hc_pos >> (DIM - 1 - d)) & 1) << postfix_len;
+            key[d] = static_cast<SCALAR>((static_cast<BitsT>(prefix[d]) & prefix_mask) | hc_bit);
+        }
+        return key;
+    }
+};
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_SERIALIZATION_COMPRESSED_V16_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2022 Improbable Worlds Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHTREE_V16_SERIALIZATION_V16_H
+#define PHTREE_V16_SERIALIZATION_V16_H
+
+#include "../common/common.h"
+#include "../common/serialization.h"
+#include "node.h"
+#include "phtree_v16.h"
+#include "serialization_compressed_v16.h"
+#include <memory>
+
+namespace improbable::phtree::v16 {
+
+/*
+ * The serializer writes the node structure of a PH-Tree to a binary stream and reads it back.
+ *
+ * The stream starts with a header (magic number, format version, dimensionality, scalar width and
+ * number of entries). This is followed by a depth-first dump of all nodes in z-order. Every node
+ * is written as its infix length, postfix length and number of entries, followed by its entries.
+ * Every entry is written as its hypercube address, a type flag and its (internal) key, followed
+ * either by the value (written with the value codec) or, recursively, by the child node.
+ *
+ * Reading the stream constructs the nodes directly, i.e. unlike emplace() it does not need to
+ * navigate the tree, compare keys or split nodes.
+ *
+ * Keys are written in their internal representation, so a tree must be read with the same converter
+ * that was used when writing it.
+ *
+ * WriteCompressed() writes the same header (with a different magic number), followed by a
+ * bit-packed dump of the nodes, see CompressedSerializerV16. Read() accepts both formats.
+ */
+template <dimension_t DIM, typename T, typename SCALAR>
+class SerializerV16 {
+    using KeyT = PhPoint<DIM, SCALAR>;
+    using EntryT = Entry<DIM, T, SCALAR>;
+    using NodeT = Node<DIM, T, SCALAR>;
+
+    static constexpr std::uint32_t MAGIC = 0x50485431;             // "PHT1"
+    static constexpr std::uint32_t MAGIC_COMPRESSED = 0x50484331;  // "PHC1"
+    static constexpr std::uint8_t VERSION = 1;
+    static constexpr std::uint8_t ENTRY_VALUE = 0;
+    static constexpr std::uint8_t ENTRY_NODE = 1;
+
+  public:
+    template <typename CODEC>
+    static void Write(
+        std::ostream& os, const NodeT& root, size_t num_entries, const CODEC& codec) {
+        WriteHeader(os, MAGIC, num_entries);
+        WriteNode(os, root, codec);
+    }
+
+    template <typename CODEC>
+    static void WriteCompressed(
+        std::ostream& os, const NodeT& root, size_t num_entries, const CODEC& codec) {
+        WriteHeader(os, MAGIC_COMPRESSED, num_entries);
+        CompressedSerializerV16<DIM, T, SCALAR>::WriteNode(os, root, codec);
+    }
+
+    /*
+     * Reads a tree into an empty root node.
+     * @return 'false' if the stream is not a valid PH-Tree stream or if it was written for a
+     * different tree type. In this case the root node may contain a partial tree.
+     */
+    template <typename CODEC>
+    static bool Read(std::istream& is, NodeT& root, size_t& num_entries, const CODEC& codec) {
+        assert(root.GetEntryCount() == 0);
+        std::uint32_t magic = 0;
+        std::uint8_t version = 0;
+        std::uint8_t dim = 0;
+        std::uint8_t scalar_size = 0;
+        std::uint64_t n = 0;
+        if (!ReadRaw(is, magic) || !ReadRaw(is, version) || !ReadRaw(is, dim) ||
+            !ReadRaw(is, scalar_size) || !ReadRaw(is, n)) {
+            return false;
+        }
+        if ((magic != MAGIC && magic != MAGIC_COMPRESSED) || version != VERSION || dim != DIM ||
+            scalar_size != sizeof(SCALAR)) {
+            return false;
+        }
+        size_t num_values = 0;
+        bool success = magic == MAGIC
+            ? ReadNode(is, root, num_values, codec)
+            : CompressedSerializerV16<DIM, T, SCALAR>::ReadNode(is, root, num_values, codec);
+        if (!success || num_values != n) {
+            return false;
+        }
+        num_entries = num_values;
+        return true;
+    }
+
+  private:
+    static void WriteHeader(std::ostream& os, std::uint32_t magic, size_t num_entries) {
+        WriteRaw(os, magic);
+        WriteRaw(os, VERSION);
+        WriteRaw<std::uint8_t>(os, DIM);
+        WriteRaw<std::uint8_t>(os, sizeof(SCALAR));
+        WriteRaw<std::uint64_t>(os, num_entries);
+    }
+
+    template <typename CODEC>
+    static void WriteNode(std::ostream& os, const NodeT& node, const CODEC& codec) {
+        WriteRaw(os, node.GetInfixLen());
+        WriteRaw(os, node.GetPostfixLen());
+        WriteRaw<std::uint64_t>(os, node.GetEntryCount());
+        for (auto& it : node.Entries()) {
+            const auto& entry = it.second;
+            WriteRaw<hc_pos_t>(os, it.first);
+            WriteRaw(os, entry.IsNode() ? ENTRY_NODE : ENTRY_VALUE);
+            WriteRaw(os, entry.GetKey());
+            if (entry.IsNode()) {
+                WriteNode(os, entry.GetNode(), codec);
+            } else {
+                codec.write(os, entry.GetValue());
+            }
+        }
+    }
+
+    static bool ReadNodeHeader(
+        std::istream& is,
+        bit_width_t& infix_len,
+        bit_width_t& postfix_len,
+        std::uint64_t& entry_count) {
+        return ReadRaw(is, infix_len) && ReadRaw(is, postfix_len) && ReadRaw(is, entry_count);
+    }
+
+    template <typename CODEC>
+    static bool ReadNode(std::istream& is, NodeT& root, size_t& num_values, const CODEC& codec) {
+        bit_width_t infix_len = 0;
+        bit_width_t postfix_len = 0;
+        std::uint64_t entry_count = 0;
+        if (!ReadNodeHeader(is, infix_len, postfix_len, entry_count) ||
+            infix_len != root.GetInfixLen() || postfix_len != root.GetPostfixLen()) {
+            return false;
+        }
+        return ReadEntries(is, root, entry_count, num_values, codec);
+    }
+
+    template <typename CODEC>
+    static bool ReadEntries(
+        std::istream& is,
+        NodeT& node,
+        std::uint64_t entry_count,
+        size_t& num_values,
+        const CODEC& codec) {
+        hc_pos_t previous_hc_pos = 0;
+        for (std::uint64_t i = 0; i < entry_count; ++i) {
+            hc_pos_t hc_pos = 0;
+            std::uint8_t type = 0;
+            KeyT key;
+            if (!ReadRaw(is, hc_pos) || !ReadRaw(is, type) || !ReadRaw(is, key)) {
+                return false;
+            }
+            // Entries must be written in z-order and must match their hypercube address.
+            if ((i > 0 && hc_pos <= previous_hc_pos) ||
+                hc_pos != CalcPosInArray(key, node.GetPostfixLen())) {
+                return false;
+            }
+            previous_hc_pos = hc_pos;
+            if (type == ENTRY_NODE) {
+                if (!ReadChildNode(is, node, hc_pos, key, num_values, codec)) {
+                    return false;
+                }
+            } else if (type == ENTRY_VALUE) {
+                auto value = codec.read(is);
+                if (is.fail()) {
+                    return false;
+                }
+                node.Entries().try_emplace(hc_pos, key, std::move(value));
+                ++num_values;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename CODEC>
+    static bool ReadChildNode(
+        std::istream& is,
+        NodeT& parent,
+        hc_pos_t hc_pos,
+        const KeyT& key,
+        size_t& num_values,
+        const CODEC& codec) {
+        bit_width_t infix_len = 0;
+        bit_width_t postfix_len = 0;
+        std::uint64_t entry_count = 0;
+        if (!ReadNodeHeader(is, infix_len, postfix_len, entry_count)) {
+            return false;
+        }
+        // Only the root node may have fewer than two entries.
+        if (postfix_len >= parent.GetPostfixLen() ||
+            infix_len + 1 + postfix_len != parent.GetPostfixLen() || entry_count < 2) {
+            return false;
+        }
+        auto child = std::make_unique<NodeT>(infix_len, postfix_len);
+        auto& child_ref = *child;
+        parent.Entries().try_emplace(hc_pos, key, std::move(child));
+        return ReadEntries(is, child_ref, entry_count, num_values, codec);
+    }
+};
+
+/*
+ * Writes the tree to a binary stream. The nodes are written in z-order with their entries and
+ * values, see SerializerV16 for details.
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values, see ValueCodec. The default codec supports only
+ * trivially copyable value types.
+ */
+template <dimension_t DIM, typename T, typename CONVERT, typename CODEC = ValueCodec<T>>
+void serialize(
+    const PhTreeV16<DIM, T, CONVERT>& tree, std::ostream& os, const CODEC& codec = CODEC()) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    SerializerV16<DIM, T, ScalarInternal>::Write(
+        os, PhTreeAccess::GetRoot(tree).GetNode(), tree.size(), codec);
+}
+
+/*
+ * Writes the tree to a binary stream in a compressed format, see CompressedSerializerV16.
+ * Keys are written relative to the prefix of their node and hypercube addresses are
+ * bit-packed. The stream is written while traversing the tree, i.e. there is no need to buffer
+ * the whole output in memory. Compressed streams can be read with deserialize().
+ *
+ * @param os The output stream.
+ * @param codec The codec for writing values, see ValueCodec.
+ */
+template <dimension_t DIM, typename T, typename CONVERT, typename CODEC = ValueCodec<T>>
+void serialize_compressed(
+    const PhTreeV16<DIM, T, CONVERT>& tree, std::ostream& os, const CODEC& codec = CODEC()) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    SerializerV16<DIM, T, ScalarInternal>::WriteCompressed(
+        os, PhTreeAccess::GetRoot(tree).GetNode(), tree.size(), codec);
+}
+
+/*
+ * Replaces the content of the tree with a tree that was written with serialize() or with
+ * serialize_compressed(). The nodes are reconstructed directly from the stream, this is
+ * considerably faster than inserting all entries with emplace().
+ *
+ * @param is The input stream.
+ * @param codec The codec for reading values, this must match the codec used for writing.
+ * @return 'true' if the tree was read successfully. If the stream is invalid or was written
+ * by a different type of tree, the tree is left empty and 'false' is returned.
+ */
+template <dimension_t DIM, typename T, typename CONVERT, typename CODEC = ValueCodec<T>>
+bool deserialize(PhTreeV16<DIM, T, CONVERT>& tree, std::istream& is, const CODEC& codec = CODEC()) {
+    using ScalarInternal = typename CONVERT::ScalarInternal;
+    tree.clear();
+    size_t num_entries = 0;
+    if (!SerializerV16<DIM, T, ScalarInternal>::Read(
+            is, PhTreeAccess::GetRoot(tree).GetNode(), num_entries, codec)) {
+        tree.clear();
+        return false;
+    }
+    PhTreeAccess::GetNumEntries(tree) = num_entries;
+    return true;
+}
+
+}  // namespace improbable::phtree::v16
+
+#endif  // PHTREE_V16_SERIALIZATION_V16_H